@@ -2,6 +2,10 @@
 #include "ble_cus.h"
 #include <string.h>
 #include "ble_srv_common.h"
+#include "crash_buffer.h"
+#include "flash_log.h"
+#include "local_clock.h"
+#include "session_index.h"
 #include "nrf_gpio.h"
 #include "boards.h"
 #include "nrf_log.h"
@@ -9,42 +13,1488 @@
 #include <math.h>
 #include <stdlib.h>
 
+/**@brief A notification waiting for a SoftDevice TX buffer. */
+typedef struct
+{
+    uint16_t handle;
+    uint16_t len;
+    uint8_t  data[BLE_CUS_MAX_DATA_LEN];
+} tx_entry_t;
+
+/**@brief A command waiting for room for its response. */
+typedef struct
+{
+    uint8_t len;
+    uint8_t data[BLE_CUS_CMD_REQ_MAX_LEN];
+} cmd_entry_t;
+
+/**@brief Command ring of one link. */
+typedef struct
+{
+    cmd_entry_t entries[BLE_CUS_CMD_RING_SIZE];
+    uint8_t     first;                                                /**< Oldest waiting command. */
+    uint8_t     count;
+} cmd_ring_t;
+
+/**@brief Notification queue of one link. */
+typedef struct
+{
+    tx_entry_t entries[BLE_CUS_TX_QUEUE_SIZE];
+    uint8_t    first;                                                 /**< Oldest queued notification. */
+    uint8_t    count;
+} tx_queue_t;
+
+STATIC_ASSERT(BLE_CUS_TIMESTAMP_LEN <= SAMPLE_POOL_LIVE_STAMP_LEN * sizeof(uint16_t));
+STATIC_ASSERT(BLE_GATT_ATT_MTU_DEFAULT - 3 >= DELTA_CODEC_MIN_LEN);
+STATIC_ASSERT(2 + (SAMPLE_POOL_PACKAGE_LEN - 1) * sizeof(uint16_t) <= BLE_CUS_CMD_RSP_MAX_LEN);
+STATIC_ASSERT(BLE_CUS_CMD_RSP_MAX_LEN <= BLE_GATT_ATT_MTU_DEFAULT - 3);
+STATIC_ASSERT(BLE_CUS_STRIDE_RECORD_LEN <= BLE_GATT_ATT_MTU_DEFAULT - 3);
+STATIC_ASSERT(BLE_CUS_SESSION_STATS_LEN == 3 + 4 * 4 + 7 * 2 + SESSION_STATS_ZONE_COUNT * 4);
+STATIC_ASSERT(3 * SAMPLE_POOL_POWER_LEN <= SAMPLE_POOL_WINDOW_LEN);
+
+static tx_queue_t         m_tx_queues[BLE_CUS_LINK_COUNT];            /**< Indexed like ble_cus_t::links. */
+static cmd_ring_t         m_cmd_rings[BLE_CUS_LINK_COUNT];            /**< Indexed like ble_cus_t::links. */
+static uint8_t            m_bulk_next_link;                           /**< Link whose bulk transfer is pumped first in the next round. */
+static ble_cus_tx_stats_t m_tx_stats;
+
+
+/**@brief Function for finding the link of a connection.
+ *
+ * @return Link, or NULL if the connection is not served.
+ */
+static ble_cus_link_t * link_find(ble_cus_t * p_cus, uint16_t conn_handle)
+{
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        if ((conn_handle != BLE_CONN_HANDLE_INVALID) && (p_cus->links[i].conn_handle == conn_handle))
+        {
+            return &p_cus->links[i];
+        }
+    }
+    return NULL;
+}
+
+
+static tx_queue_t * link_queue(ble_cus_t * p_cus, ble_cus_link_t const * p_link)
+{
+    return &m_tx_queues[p_link - p_cus->links];
+}
+
+
+static cmd_ring_t * link_cmd_ring(ble_cus_t * p_cus, ble_cus_link_t const * p_link)
+{
+    return &m_cmd_rings[p_link - p_cus->links];
+}
+
+
+/**@brief Function for handing one notification to the SoftDevice.
+ */
+static uint32_t link_hvx(ble_cus_link_t * p_link, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    ble_gatts_hvx_params_t hvx_params;
+    uint32_t               err_code;
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+    hvx_params.handle = handle;
+    hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
+    hvx_params.p_len  = &len;
+    hvx_params.p_data = p_data;
+
+    err_code = sd_ble_gatts_hvx(p_link->conn_handle, &hvx_params);
+    if (err_code == NRF_SUCCESS)
+    {
+        p_link->in_flight++;
+    }
+    return err_code;
+}
+
+
+/**@brief Function for passing the queued notifications of a link to the SoftDevice until it runs
+ *        out of TX buffers.
+ *
+ * @return True if the queue is empty.
+ */
+static bool tx_flush(ble_cus_t * p_cus, ble_cus_link_t * p_link)
+{
+    tx_queue_t * p_queue = link_queue(p_cus, p_link);
+
+    while (p_queue->count > 0)
+    {
+        tx_entry_t * p_entry  = &p_queue->entries[p_queue->first];
+        uint32_t     err_code = link_hvx(p_link, p_entry->handle, p_entry->data, p_entry->len);
+
+        if (err_code == NRF_ERROR_RESOURCES)
+        {
+            return false;
+        }
+        if (err_code == NRF_SUCCESS)
+        {
+            m_tx_stats.sent++;
+        }
+        else
+        {
+            m_tx_stats.errors++;
+        }
+
+        p_queue->first = (p_queue->first + 1) % BLE_CUS_TX_QUEUE_SIZE;
+        p_queue->count--;
+    }
+    return true;
+}
+
+
+/**@brief Function for queueing a notification on one link.
+ *
+ * @retval NRF_SUCCESS              Notification queued.
+ * @retval NRF_ERROR_INVALID_LENGTH The data does not fit the ATT MTU of the link.
+ * @retval NRF_ERROR_NO_MEM         The queue is full, the notification was dropped.
+ */
+static uint32_t tx_enqueue(ble_cus_t * p_cus, ble_cus_link_t const * p_link, uint16_t handle,
+                           uint8_t const * p_data, uint16_t len)
+{
+    tx_queue_t * p_queue = link_queue(p_cus, p_link);
+
+    if (len > p_link->max_data_len)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (p_queue->count >= BLE_CUS_TX_QUEUE_SIZE)
+    {
+        m_tx_stats.dropped_full++;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    tx_entry_t * p_entry = &p_queue->entries[(p_queue->first + p_queue->count) % BLE_CUS_TX_QUEUE_SIZE];
+
+    p_entry->handle = handle;
+    p_entry->len    = len;
+    memcpy(p_entry->data, p_data, len);
+
+    p_queue->count++;
+    m_tx_stats.queued++;
+    m_tx_stats.max_depth = MAX(m_tx_stats.max_depth, p_queue->count);
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for dropping all queued notifications of a link. */
+static void tx_clear(ble_cus_t * p_cus, ble_cus_link_t const * p_link)
+{
+    tx_queue_t * p_queue = link_queue(p_cus, p_link);
+
+    m_tx_stats.dropped_disconnected += p_queue->count;
+    p_queue->first = 0;
+    p_queue->count = 0;
+}
+
+
+static void bulk_pump(ble_cus_t * p_cus, ble_cus_link_t * p_link);
+static void history_pump(ble_cus_t * p_cus, ble_cus_link_t * p_link);
+static void read_pump(ble_cus_t * p_cus, ble_cus_link_t * p_link);
+static void link_subscriptions_read(ble_cus_t * p_cus, ble_cus_link_t * p_link);
+
+
+/**@brief Function for sending what the SoftDevice takes on all links.
+ *
+ * @details Live notifications of every link go first. The bulk transfers get the buffers that
+ *          are left, each link in turn starting with a different one every round.
+ */
+static void tx_schedule(ble_cus_t * p_cus)
+{
+    bool idle[BLE_CUS_LINK_COUNT];
+
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        idle[i] = (p_cus->links[i].conn_handle != BLE_CONN_HANDLE_INVALID)
+                  && tx_flush(p_cus, &p_cus->links[i]);
+    }
+
+    for (uint32_t k = 0; k < BLE_CUS_LINK_COUNT; k++)
+    {
+        uint32_t i = (m_bulk_next_link + k) % BLE_CUS_LINK_COUNT;
+
+        if (idle[i] && (p_cus->links[i].bulk.remaining > 0))
+        {
+            bulk_pump(p_cus, &p_cus->links[i]);
+        }
+        if (idle[i] && history_xfer_pending(&p_cus->links[i].history))
+        {
+            history_pump(p_cus, &p_cus->links[i]);
+        }
+        if (idle[i] && (p_cus->links[i].read.remaining > 0))
+        {
+            read_pump(p_cus, &p_cus->links[i]);
+        }
+    }
+    m_bulk_next_link = (m_bulk_next_link + 1) % BLE_CUS_LINK_COUNT;
+}
+
+
+/**@brief Function for passing an event to the application.
+ */
+static void cus_evt_send(ble_cus_t * p_cus, uint16_t conn_handle, ble_cus_evt_type_t evt_type)
+{
+    ble_cus_evt_t evt;
+
+    if (p_cus->evt_handler != NULL)
+    {
+        memset(&evt, 0, sizeof(evt));
+        evt.evt_type    = evt_type;
+        evt.conn_handle = conn_handle;
+        p_cus->evt_handler(p_cus, &evt);
+    }
+}
+
+
+/**@brief Function for telling the application that a transfer ended, unless another one still
+ *        runs on the link.
+ */
+static void transfer_done(ble_cus_t * p_cus, ble_cus_link_t const * p_link)
+{
+    if (!ble_cus_link_transfer_active(p_link))
+    {
+        cus_evt_send(p_cus, p_link->conn_handle, BLE_CUS_EVT_BULK_DONE);
+    }
+}
+
+
+/**@brief Function for averaging the newest config.power_window magnitudes.
+ */
+static uint16_t power_compute(ble_cus_t const * p_cus)
+{
+    // pow_buf_counter is the oldest magnitude, the newest power_window ones end just before it.
+    uint16_t window = p_cus->config.power_window;
+    double   pow_avg = 0;
+    for (int i = 0; i < window; i++)
+        pow_avg = pow_avg + sample_pool_power[(p_cus->pow_buf_counter + SAMPLE_POOL_POWER_LEN - window + i) % SAMPLE_POOL_POWER_LEN];
+    pow_avg = pow_avg / window;
+    return (uint16_t)(pow_avg);
+}
+
+
+/**@brief Function for computing the magnitudes again from the sample window.
+ *
+ * @details Magnitudes are only computed while a client takes the power, so after a reconnect
+ *          they are stale. The window always holds the newest samples.
+ */
+static void power_pool_refill(ble_cus_t * p_cus)
+{
+    for (uint32_t i = 0; i < SAMPLE_POOL_POWER_LEN; i++)
+    {
+        // Oldest first, the newest sample ends just before buff_counter.
+        uint32_t idx = (p_cus->buff_counter + SAMPLE_POOL_WINDOW_LEN - 3 * (SAMPLE_POOL_POWER_LEN - i))
+                       % SAMPLE_POOL_WINDOW_LEN;
+        double   x   = sample_pool_window[idx];
+        double   y   = sample_pool_window[idx + 1];
+        double   z   = sample_pool_window[idx + 2];
+
+        sample_pool_power[i] = (short)sqrt(x * x + y * y + z * z);
+    }
+    p_cus->pow_buf_counter = 0;
+}
+
+
+/**@brief Function for sending the power on a link right away once it subscribed to it, instead of
+ *        at the next power update.
+ */
+static void link_resume(ble_cus_t * p_cus, ble_cus_link_t * p_link)
+{
+    if (!(ble_cus_link_subscriptions(p_cus, p_link) & BLE_CUS_SUB_POWER))
+    {
+        return;
+    }
+
+    power_pool_refill(p_cus);
+    p_cus->power = power_compute(p_cus);
+
+    // Dropped notifications are counted by the TX queue.
+    (void)tx_enqueue(p_cus, p_link, p_cus->power_handles.value_handle,
+                     (uint8_t *)&p_cus->power, sizeof(p_cus->power));
+    tx_schedule(p_cus);
+}
+
+
 /**@brief Function for handling the Connect event.
  *
  * @param[in]   p_cus       Custom Service structure.
- * @param[in]   p_ble_evt   Event received from the BLE stack.
+ * @param[in]   p_ble_evt   Event received from the BLE stack.
+ */
+
+static void on_connect(ble_cus_t * p_cus, ble_evt_t const * p_ble_evt)
+{
+    ble_cus_link_t * p_link = NULL;
+
+    for (uint32_t i = 0; (p_link == NULL) && (i < BLE_CUS_LINK_COUNT); i++)
+    {
+        if (p_cus->links[i].conn_handle == BLE_CONN_HANDLE_INVALID)
+        {
+            p_link = &p_cus->links[i];
+        }
+    }
+    if (p_link == NULL)
+    {
+        NRF_LOG_WARNING("No free link for connection %d.", p_ble_evt->evt.gap_evt.conn_handle);
+        return;
+    }
+
+    memset(p_link, 0, sizeof(ble_cus_link_t));
+    p_link->conn_handle  = p_ble_evt->evt.gap_evt.conn_handle;
+    p_link->max_data_len = BLE_GATT_ATT_MTU_DEFAULT - 3;
+    p_link->stride_next  = stride_events_head();
+
+    // The peer manager handles the event first and has restored the CCCDs of a bonded peer.
+    link_subscriptions_read(p_cus, p_link);
+
+    cus_evt_send(p_cus, p_link->conn_handle, BLE_CUS_EVT_CONNECTED);
+    link_resume(p_cus, p_link);
+}
+
+/**@brief Function for handling the Disconnect event.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_ble_evt   Event received from the BLE stack.
+ */
+
+static void on_disconnect(ble_cus_t * p_cus, ble_evt_t const * p_ble_evt)
+{
+    uint16_t         conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    ble_cus_link_t * p_link      = link_find(p_cus, conn_handle);
+
+    if (p_link == NULL)
+    {
+        return;
+    }
+
+    tx_clear(p_cus, p_link);
+    link_cmd_ring(p_cus, p_link)->count = 0;
+    p_link->conn_handle    = BLE_CONN_HANDLE_INVALID;
+    p_link->subscriptions  = 0;
+    p_link->bulk.remaining = 0;
+    p_link->read.remaining = 0;
+    history_xfer_stop(&p_link->history);
+
+    // Connection handles are reused, so the next central to sync is taken as another one.
+    if (p_cus->sync_conn_handle == conn_handle)
+    {
+        p_cus->sync_conn_handle = BLE_CONN_HANDLE_INVALID;
+    }
+
+    if (!ble_cus_subscribed(p_cus, BLE_CUS_SUB_PACKAGE))
+    {
+        p_cus->live_len = 0;
+    }
+
+    cus_evt_send(p_cus, conn_handle, BLE_CUS_EVT_DISCONNECTED);
+}
+
+/**@brief Function for handling a write to the Session characteristic.
+ *
+ * @details The request is answered by updating the characteristic value, which the client reads
+ *          back. All fields are little endian, times are in milliseconds.
+ *
+ *          SET_EPOCH: op, epoch_s (u32) -> op, status
+ *          INFO:      op, session (u16) -> op, status, session (u16), first_block, block_count,
+ *                                          duration_ms, epoch_start_s (u32 each)
+ *          LOOKUP:    op, session (u16), from_ms, to_ms (u32, relative to the session start)
+ *                                       -> op, status, first_block, block_count (u32 each)
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   conn_handle Link the request was written on.
+ * @param[in]   p_data      Written data.
+ * @param[in]   len         Length of the written data.
+ */
+static void on_session_write(ble_cus_t * p_cus, uint16_t conn_handle, uint8_t const * p_data, uint16_t len)
+{
+    uint8_t  rsp[BLE_CUS_SESSION_RSP_MAX_LEN] = {0};
+    uint16_t rsp_len = 2;
+
+    if (len < 1)
+    {
+        return;
+    }
+
+    rsp[0] = p_data[0];
+    rsp[1] = BLE_CUS_SESSION_STATUS_INVALID;
+
+    switch (p_data[0])
+    {
+        case BLE_CUS_SESSION_OP_SET_EPOCH:
+            if (len == 5)
+            {
+                session_index_epoch_set(uint32_decode(&p_data[1]), local_clock_ms());
+                rsp[1] = BLE_CUS_SESSION_STATUS_SUCCESS;
+            }
+            break;
+
+        case BLE_CUS_SESSION_OP_INFO:
+            if (len == 3)
+            {
+                session_index_info_t info;
+
+                if (session_index_info(uint16_decode(&p_data[1]), &info) != NRF_SUCCESS)
+                {
+                    rsp[1] = BLE_CUS_SESSION_STATUS_NOT_FOUND;
+                    break;
+                }
+                rsp[1]   = BLE_CUS_SESSION_STATUS_SUCCESS;
+                rsp_len += uint16_encode(info.id, &rsp[rsp_len]);
+                rsp_len += uint32_encode(info.first_block, &rsp[rsp_len]);
+                rsp_len += uint32_encode(info.block_count, &rsp[rsp_len]);
+                rsp_len += uint32_encode(info.duration_ms, &rsp[rsp_len]);
+                rsp_len += uint32_encode(info.epoch_start_s, &rsp[rsp_len]);
+            }
+            break;
+
+        case BLE_CUS_SESSION_OP_LOOKUP:
+            if (len == 11)
+            {
+                uint32_t first;
+                uint32_t count;
+
+                if (session_index_lookup(uint16_decode(&p_data[1]), uint32_decode(&p_data[3]),
+                                         uint32_decode(&p_data[7]), &first, &count) != NRF_SUCCESS)
+                {
+                    rsp[1] = BLE_CUS_SESSION_STATUS_NOT_FOUND;
+                    break;
+                }
+
+                // Blocks older than the flash log tail were overwritten.
+                uint32_t tail = flash_log_tail();
+                if (first < tail)
+                {
+                    count = (first + count > tail) ? first + count - tail : 0;
+                    first = tail;
+                }
+
+                rsp[1]   = BLE_CUS_SESSION_STATUS_SUCCESS;
+                rsp_len += uint32_encode(first, &rsp[rsp_len]);
+                rsp_len += uint32_encode(count, &rsp[rsp_len]);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    ble_gatts_value_t tx_data;
+    tx_data.len     = rsp_len;
+    tx_data.offset  = 0;
+    tx_data.p_value = rsp;
+
+    sd_ble_gatts_value_set(conn_handle, p_cus->session_handles.value_handle, &tx_data);
+}
+
+/**@brief Function for sending bulk notifications until the transfer is done or the link has
+ *        BLE_CUS_BULK_IN_FLIGHT_MAX notifications in the SoftDevice.
+ *
+ * @details Every notification is a sequence number (u16) followed by as many accl_arr values
+ *          (u16 each) as fit the ATT MTU, so the client can detect gaps. The remaining TX buffers
+ *          of the link stay free for live notifications. The pump is resumed on
+ *          BLE_GATTS_EVT_HVN_TX_COMPLETE.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_link      Link of the transfer.
+ */
+static void bulk_pump(ble_cus_t * p_cus, ble_cus_link_t * p_link)
+{
+    ble_cus_bulk_t * p_bulk = &p_link->bulk;
+
+    while (p_bulk->remaining > 0)
+    {
+        if (p_link->in_flight >= BLE_CUS_BULK_IN_FLIGHT_MAX)
+        {
+            return;
+        }
+
+        uint8_t  data[BLE_CUS_MAX_DATA_LEN];
+        uint16_t count = MIN(p_bulk->remaining,
+                             (p_link->max_data_len - BLE_CUS_BULK_HEADER_LEN) / sizeof(uint16_t));
+        uint16_t len   = uint16_encode(p_bulk->seq, data);
+
+        for (uint16_t i = 0; i < count; i++)
+        {
+            len += uint16_encode(sample_pool_accl[p_bulk->next + i], &data[len]);
+        }
+
+        uint32_t err_code = link_hvx(p_link, p_cus->bulk_handles.value_handle, data, len);
+        if (err_code == NRF_ERROR_RESOURCES)
+        {
+            return;
+        }
+        if (err_code != NRF_SUCCESS)
+        {
+            NRF_LOG_WARNING("Bulk transfer aborted at seq %d: 0x%x.", p_bulk->seq, err_code);
+            p_bulk->remaining = 0;
+            transfer_done(p_cus, p_link);
+            return;
+        }
+
+        p_bulk->next      += count;
+        p_bulk->remaining -= count;
+        p_bulk->seq++;
+        p_bulk->bytes     += count * sizeof(uint16_t);
+    }
+
+    uint32_t elapsed_ms = local_clock_ms() - p_bulk->start_ms;
+
+    NRF_LOG_INFO("Bulk transfer done: %d bytes in %d notifications, %d ms (%d B/s).",
+                 p_bulk->bytes, p_bulk->seq, elapsed_ms,
+                 (elapsed_ms > 0) ? p_bulk->bytes * 1000 / elapsed_ms : 0);
+    transfer_done(p_cus, p_link);
+}
+
+/**@brief Function for handling a write to the Bulk characteristic.
+ *
+ * @details The client writes start and count (u16 each, little endian, in accl_arr values) and
+ *          gets the values back in notifications on the same characteristic. The range is clipped
+ *          to the values recorded so far (arr_counter), as READ_HISTORY does; a range with none of
+ *          them, like a count of 0, stops a running transfer.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_link      Link the request was written on.
+ * @param[in]   p_data      Written data.
+ * @param[in]   len         Length of the written data.
+ */
+static void on_bulk_write(ble_cus_t * p_cus, ble_cus_link_t * p_link, uint8_t const * p_data, uint16_t len)
+{
+    if (len != BLE_CUS_BULK_REQ_LEN)
+    {
+        return;
+    }
+
+    uint16_t start = uint16_decode(&p_data[0]);
+    uint16_t count = uint16_decode(&p_data[2]);
+
+    bool running = (p_link->bulk.remaining > 0);
+    bool active  = ble_cus_link_transfer_active(p_link);
+
+    p_link->bulk.next      = start;
+    p_link->bulk.remaining = (start < p_cus->arr_counter) ? MIN(count, p_cus->arr_counter - start) : 0;
+    p_link->bulk.seq       = 0;
+    p_link->bulk.start_ms  = local_clock_ms();
+    p_link->bulk.bytes     = 0;
+
+    if (p_link->bulk.remaining == 0)
+    {
+        if (running)
+        {
+            transfer_done(p_cus, p_link);
+        }
+        return;
+    }
+
+    if (!active)
+    {
+        cus_evt_send(p_cus, p_link->conn_handle, BLE_CUS_EVT_BULK_STARTED);
+    }
+    tx_schedule(p_cus);
+}
+
+/**@brief Function for sending history frames until the transfer is done or the link has
+ *        BLE_CUS_BULK_IN_FLIGHT_MAX notifications in the SoftDevice.
+ *
+ * @details Shares the TX buffers of the link with the bulk transfer the same way. Frames are read
+ *          from the flash log as they are sent, so retransmissions cost no RAM.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_link      Link of the transfer.
+ */
+static void history_pump(ble_cus_t * p_cus, ble_cus_link_t * p_link)
+{
+    history_xfer_t * p_xfer = &p_link->history;
+
+    while (history_xfer_pending(p_xfer))
+    {
+        if (p_link->in_flight >= BLE_CUS_BULK_IN_FLIGHT_MAX)
+        {
+            return;
+        }
+
+        uint8_t  data[BLE_CUS_MAX_DATA_LEN];
+        uint16_t len      = history_xfer_frame_get(p_xfer, data);
+        uint32_t err_code = link_hvx(p_link, p_cus->history_handles.value_handle, data, len);
+
+        if (err_code == NRF_ERROR_RESOURCES)
+        {
+            return;
+        }
+        if (err_code != NRF_SUCCESS)
+        {
+            NRF_LOG_WARNING("History transfer aborted: 0x%x.", err_code);
+            history_xfer_stop(p_xfer);
+            transfer_done(p_cus, p_link);
+            return;
+        }
+        history_xfer_advance(p_xfer);
+    }
+
+    NRF_LOG_INFO("History transfer sent: %d frames, %d resent.",
+                 history_xfer_stats()->frames_sent, history_xfer_stats()->frames_resent);
+    transfer_done(p_cus, p_link);
+}
+
+/**@brief Function for handling a write to the History Control characteristic.
+ *
+ * @details Takes writes with and without response. START and STOP are answered by updating the
+ *          characteristic value; NACKs are not answered, the frames simply come again. All fields
+ *          are little endian.
+ *
+ *          START: op, first_block, block_count (u32 each)
+ *                 -> op, status, first_block, block_count (u32 each, clipped to the flash log),
+ *                    frame_count (u16), blocks_per_frame (u8)
+ *          NACK:  op, base_seq (u16), bitmap (u32, bit i for frame base_seq + i)
+ *          STOP:  op -> op, status
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_link      Link the request was written on.
+ * @param[in]   p_data      Written data.
+ * @param[in]   len         Length of the written data.
+ */
+static void on_history_ctrl_write(ble_cus_t * p_cus, ble_cus_link_t * p_link, uint8_t const * p_data, uint16_t len)
+{
+    uint8_t          rsp[BLE_CUS_HISTORY_RSP_MAX_LEN] = {0};
+    uint16_t         rsp_len = 2;
+    history_xfer_t * p_xfer  = &p_link->history;
+    bool             active  = ble_cus_link_transfer_active(p_link);
+
+    if (len < 1)
+    {
+        return;
+    }
+
+    rsp[0] = p_data[0];
+    rsp[1] = BLE_CUS_HISTORY_STATUS_INVALID;
+
+    switch (p_data[0])
+    {
+        case BLE_CUS_HISTORY_OP_START:
+            if (len != 9)
+            {
+                break;
+            }
+            if (!(p_link->subscriptions & BLE_CUS_SUB_HISTORY))
+            {
+                rsp[1] = BLE_CUS_HISTORY_STATUS_NOT_READY;
+                break;
+            }
+            if (history_xfer_start(p_xfer, uint32_decode(&p_data[1]), uint32_decode(&p_data[5]),
+                                   p_link->max_data_len) != NRF_SUCCESS)
+            {
+                break;
+            }
+            rsp[1]        = BLE_CUS_HISTORY_STATUS_SUCCESS;
+            rsp_len      += uint32_encode(p_xfer->first_block, &rsp[rsp_len]);
+            rsp_len      += uint32_encode(p_xfer->block_count, &rsp[rsp_len]);
+            rsp_len      += uint16_encode(p_xfer->frame_count, &rsp[rsp_len]);
+            rsp[rsp_len++] = p_xfer->blocks_per_frame;
+            break;
+
+        case BLE_CUS_HISTORY_OP_NACK:
+            if (len == 7)
+            {
+                history_xfer_nack(p_xfer, uint16_decode(&p_data[1]), uint32_decode(&p_data[3]));
+            }
+            rsp_len = 0;
+            break;
+
+        case BLE_CUS_HISTORY_OP_STOP:
+            if (len == 1)
+            {
+                history_xfer_stop(p_xfer);
+                rsp[1] = BLE_CUS_HISTORY_STATUS_SUCCESS;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (rsp_len > 0)
+    {
+        ble_gatts_value_t tx_data;
+        tx_data.len     = rsp_len;
+        tx_data.offset  = 0;
+        tx_data.p_value = rsp;
+
+        sd_ble_gatts_value_set(p_link->conn_handle, p_cus->history_ctrl_handles.value_handle, &tx_data);
+    }
+
+    if (active)
+    {
+        transfer_done(p_cus, p_link);
+    }
+    else if (ble_cus_link_transfer_active(p_link))
+    {
+        cus_evt_send(p_cus, p_link->conn_handle, BLE_CUS_EVT_BULK_STARTED);
+    }
+    tx_schedule(p_cus);
+}
+
+/**@brief Function for indicating the pending Control Point response, unless an indication
+ *        still waits for its confirmation.
+ */
+static void cp_rsp_send(ble_cus_t * p_cus, ble_cus_link_t * p_link)
+{
+    ble_gatts_hvx_params_t hvx_params;
+    uint16_t               len = p_link->cp_rsp_len;
+    uint32_t               err_code;
+
+    if ((len == 0) || p_link->cp_indicating)
+    {
+        return;
+    }
+    if (!p_link->cp_indications)
+    {
+        NRF_LOG_WARNING("Control Point response dropped, indications disabled on link %d.", p_link->conn_handle);
+        p_link->cp_rsp_len = 0;
+        return;
+    }
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+    hvx_params.handle = p_cus->cp_handles.value_handle;
+    hvx_params.type   = BLE_GATT_HVX_INDICATION;
+    hvx_params.p_len  = &len;
+    hvx_params.p_data = p_link->cp_rsp;
+
+    err_code = sd_ble_gatts_hvx(p_link->conn_handle, &hvx_params);
+    if (err_code == NRF_SUCCESS)
+    {
+        p_link->cp_indicating = true;
+        p_link->cp_rsp_len    = 0;
+    }
+    else if (err_code != NRF_ERROR_BUSY)
+    {
+        NRF_LOG_WARNING("Control Point response dropped: 0x%x.", err_code);
+        p_link->cp_rsp_len = 0;
+    }
+}
+
+
+bool ble_cus_config_valid(ble_cus_config_t const * p_config)
+{
+    uint8_t const range_g = p_config->range_g;
+
+    // Whole sampling timer periods in ms.
+    return (p_config->sample_rate_hz >= BLE_CUS_SAMPLE_RATE_MIN_HZ)
+           && (p_config->sample_rate_hz <= BLE_CUS_SAMPLE_RATE_MAX_HZ)
+           && ((1000 % p_config->sample_rate_hz) == 0)
+           && (p_config->power_window >= 1) && (p_config->power_window <= SAMPLE_POOL_POWER_LEN)
+           && (p_config->notify_interval_ms >= BLE_CUS_NOTIFY_INTERVAL_MIN_MS)
+           && (p_config->notify_interval_ms <= BLE_CUS_NOTIFY_INTERVAL_MAX_MS)
+           && ((range_g == 2) || (range_g == 4) || (range_g == 8))
+           && (p_config->streaming_mode <= BLE_CUS_STREAMING_OFF);
+}
+
+
+/**@brief Function for changing or getting the settings.
+ *
+ * @details Shared by the Control Point and the Command characteristic. A changed setting is
+ *          passed to the application, which may refuse it; the old settings are kept then.
+ *
+ * @param[in]   p_cus           Custom Service structure.
+ * @param[in]   conn_handle     Link the request was written on.
+ * @param[in]   op              BLE_CUS_CP_OP_SET_* or BLE_CUS_CP_OP_GET_CONFIG.
+ * @param[in]   p_params        Parameters following the opcode.
+ * @param[in]   params_len      Length of the parameters.
+ * @param[out]  p_rsp           Buffer of BLE_CUS_CP_CONFIG_LEN bytes for the GET_CONFIG response.
+ * @param[out]  p_rsp_len       Length of the response.
+ *
+ * @return BLE_CUS_CP_STATUS_*.
+ */
+static uint8_t config_request(ble_cus_t * p_cus, uint16_t conn_handle, uint8_t op,
+                              uint8_t const * p_params, uint16_t params_len,
+                              uint8_t * p_rsp, uint8_t * p_rsp_len)
+{
+    ble_cus_config_t   old_config = p_cus->config;
+    ble_cus_config_t * p_config   = &p_cus->config;
+    uint8_t            status     = BLE_CUS_CP_STATUS_INVALID_PARAM;
+    uint8_t            rsp_len    = 0;
+
+    switch (op)
+    {
+        case BLE_CUS_CP_OP_SET_SAMPLE_RATE:
+            if (params_len == 2)
+            {
+                p_config->sample_rate_hz = uint16_decode(p_params);
+                status                   = BLE_CUS_CP_STATUS_SUCCESS;
+            }
+            break;
+
+        case BLE_CUS_CP_OP_SET_POWER_WINDOW:
+            if (params_len == 1)
+            {
+                p_config->power_window = p_params[0];
+                status                 = BLE_CUS_CP_STATUS_SUCCESS;
+            }
+            break;
+
+        case BLE_CUS_CP_OP_SET_NOTIFY_INTERVAL:
+            if (params_len == 2)
+            {
+                p_config->notify_interval_ms = uint16_decode(p_params);
+                status                       = BLE_CUS_CP_STATUS_SUCCESS;
+            }
+            break;
+
+        case BLE_CUS_CP_OP_SET_SENSOR_RANGE:
+            if (params_len == 1)
+            {
+                p_config->range_g = p_params[0];
+                status            = BLE_CUS_CP_STATUS_SUCCESS;
+            }
+            break;
+
+        case BLE_CUS_CP_OP_SET_STREAMING_MODE:
+            if (params_len == 1)
+            {
+                p_config->streaming_mode = p_params[0];
+                status                   = BLE_CUS_CP_STATUS_SUCCESS;
+            }
+            break;
+
+        case BLE_CUS_CP_OP_GET_CONFIG:
+            if (params_len == 0)
+            {
+                rsp_len         += uint16_encode(p_config->sample_rate_hz, &p_rsp[rsp_len]);
+                p_rsp[rsp_len++] = p_config->power_window;
+                rsp_len         += uint16_encode(p_config->notify_interval_ms, &p_rsp[rsp_len]);
+                p_rsp[rsp_len++] = p_config->range_g;
+                p_rsp[rsp_len++] = p_config->streaming_mode;
+                status           = BLE_CUS_CP_STATUS_SUCCESS;
+            }
+            break;
+
+        default:
+            status = BLE_CUS_CP_STATUS_NOT_SUPPORTED;
+            break;
+    }
+
+    if (!ble_cus_config_valid(p_config))
+    {
+        p_cus->config = old_config;
+        status        = BLE_CUS_CP_STATUS_INVALID_PARAM;
+    }
+
+    if ((status == BLE_CUS_CP_STATUS_SUCCESS) && (op != BLE_CUS_CP_OP_GET_CONFIG)
+        && (p_cus->evt_handler != NULL))
+    {
+        ble_cus_evt_t evt;
+
+        memset(&evt, 0, sizeof(evt));
+        evt.evt_type    = BLE_CUS_EVT_CONFIG_CHANGED;
+        evt.conn_handle = conn_handle;
+        evt.cp_opcode   = op;
+        p_cus->evt_handler(p_cus, &evt);
+
+        if (evt.cp_failed)
+        {
+            p_cus->config = old_config;
+            status        = BLE_CUS_CP_STATUS_FAILED;
+        }
+    }
+
+    *p_rsp_len = (status == BLE_CUS_CP_STATUS_SUCCESS) ? rsp_len : 0;
+    return status;
+}
+
+
+/**@brief Function for handling a write to the Control Point.
+ *
+ * @details Every request is answered with an indication: BLE_CUS_CP_OP_RESPONSE, op, status.
+ *          Settings take effect right away and are not stored. All fields are little endian.
+ *
+ *          SET_SAMPLE_RATE:     op, rate_hz (u16)
+ *          SET_POWER_WINDOW:    op, magnitudes (u8)
+ *          SET_NOTIFY_INTERVAL: op, interval_ms (u16)
+ *          SET_SENSOR_RANGE:    op, range_g (u8)
+ *          SET_STREAMING_MODE:  op, mode (u8)
+ *          GET_CONFIG:          op -> response, rate_hz (u16), magnitudes (u8), interval_ms (u16),
+ *                                     range_g (u8), mode (u8)
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_link      Link the request was written on.
+ * @param[in]   p_data      Written data.
+ * @param[in]   len         Length of the written data.
  */
+static void on_cp_write(ble_cus_t * p_cus, ble_cus_link_t * p_link, uint8_t const * p_data, uint16_t len)
+{
+    uint8_t * p_rsp = p_link->cp_rsp;
+    uint8_t   rsp_len;
 
-static void on_connect(ble_cus_t * p_cus, ble_evt_t const * p_ble_evt)
+    if (len < 1)
+    {
+        return;
+    }
+
+    p_rsp[0]           = BLE_CUS_CP_OP_RESPONSE;
+    p_rsp[1]           = p_data[0];
+    p_rsp[2]           = config_request(p_cus, p_link->conn_handle, p_data[0], &p_data[1], len - 1,
+                                        &p_rsp[3], &rsp_len);
+    p_link->cp_rsp_len = 3 + rsp_len;
+
+    cp_rsp_send(p_cus, p_link);
+}
+
+
+/**@brief Function for checking that a package of accl_arr was recorded.
+ */
+static bool package_recorded(ble_cus_t const * p_cus, uint16_t idx)
 {
-    p_cus->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    return ((uint32_t)idx + 1) * (SAMPLE_POOL_PACKAGE_LEN - 1) <= p_cus->arr_counter;
+}
 
-    ble_cus_evt_t evt;
 
-    evt.evt_type = BLE_CUS_EVT_CONNECTED;
+/**@brief Function for sending READ_HISTORY notifications until the read is done or the link has
+ *        BLE_CUS_BULK_IN_FLIGHT_MAX notifications in the SoftDevice.
+ *
+ * @details Like the bulk transfer it only gets the TX buffers the live notifications leave, and is
+ *          resumed on BLE_GATTS_EVT_HVN_TX_COMPLETE.
+ */
+static void read_pump(ble_cus_t * p_cus, ble_cus_link_t * p_link)
+{
+    ble_cus_read_t * p_read = &p_link->read;
+
+    while (p_read->remaining > 0)
+    {
+        if (p_link->in_flight >= BLE_CUS_BULK_IN_FLIGHT_MAX)
+        {
+            return;
+        }
+
+        uint8_t  data[BLE_CUS_MAX_DATA_LEN];
+        uint16_t count = MIN(p_read->remaining,
+                             (p_link->max_data_len - BLE_CUS_READ_HEADER_LEN) / (3 * sizeof(uint16_t)));
+        uint16_t len   = 0;
+        uint16_t next  = p_read->next;
+
+        data[len++] = p_read->tag;
+        data[len++] = BLE_CUS_CP_STATUS_SUCCESS;
+        len        += uint16_encode(p_read->offset, &data[len]);
+
+        for (uint16_t i = 0; i < count; i++)
+        {
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                len += uint16_encode((uint16_t)sample_pool_accl[3 * next + axis], &data[len]);
+            }
+            next += p_read->stride;
+        }
+
+        uint32_t err_code = link_hvx(p_link, p_cus->cmd_handles.value_handle, data, len);
+        if (err_code == NRF_ERROR_RESOURCES)
+        {
+            return;
+        }
+        if (err_code != NRF_SUCCESS)
+        {
+            NRF_LOG_WARNING("History read aborted at sample %d: 0x%x.", p_read->offset, err_code);
+            p_read->remaining = 0;
+            transfer_done(p_cus, p_link);
+            return;
+        }
+
+        p_read->next       = next;
+        p_read->offset    += count;
+        p_read->remaining -= count;
+    }
 
-    p_cus->evt_handler(p_cus, &evt);
+    transfer_done(p_cus, p_link);
 }
 
-/**@brief Function for handling the Disconnect event.
+
+/**@brief Function for starting a READ_HISTORY command.
+ *
+ * @details Sends the accl_arr samples start, start + stride, ... count of them, as x,y,z (u16
+ *          each) in notifications on the Command characteristic: tag, status, offset (u16) of the
+ *          first sample of the notification within the read, then as many samples as fit the ATT
+ *          MTU. The client knows from count when the read is done. A new read on the link
+ *          replaces a running one.
+ *
+ * @return BLE_CUS_CP_STATUS_SUCCESS if the read started, INVALID_PARAM for a count or stride of 0,
+ *         OUT_OF_RANGE if the range reaches past the samples recorded so far.
+ */
+static uint8_t read_start(ble_cus_t * p_cus, ble_cus_link_t * p_link, uint8_t tag,
+                          uint16_t start, uint16_t count, uint8_t stride)
+{
+    bool active = ble_cus_link_transfer_active(p_link);
+
+    if ((count == 0) || (stride == 0))
+    {
+        return BLE_CUS_CP_STATUS_INVALID_PARAM;
+    }
+    if ((uint32_t)start + (uint32_t)(count - 1) * stride >= p_cus->arr_counter / 3u)
+    {
+        return BLE_CUS_CP_STATUS_OUT_OF_RANGE;
+    }
+
+    p_link->read.tag       = tag;
+    p_link->read.stride    = stride;
+    p_link->read.next      = start;
+    p_link->read.offset    = 0;
+    p_link->read.remaining = count;
+
+    if (!active)
+    {
+        cus_evt_send(p_cus, p_link->conn_handle, BLE_CUS_EVT_BULK_STARTED);
+    }
+    return BLE_CUS_CP_STATUS_SUCCESS;
+}
+
+
+/**@brief Function for executing a command and queueing its response.
+ *
+ * @details Command:  op, tag (u8), parameters
+ *          Response: tag, status (BLE_CUS_CP_STATUS_*), result
+ *
+ *          The tag is chosen by the client and tells the responses of commands in flight apart.
+ *          All fields are little endian.
+ *
+ *          SET_* and GET_CONFIG: as on the Control Point, with the tag after the opcode.
+ *          READ_PACKAGE: op, tag, index (u16) -> tag, status, the 9 accl_arr values of the package
+ *          READ_HISTORY: op, tag, start, count (u16 each), stride (u8) -> see read_start
+ *          GET_POWER:    op, tag              -> tag, status, power (u16)
+ *          PING:         op, tag              -> tag, status, local time in ms (u32)
+ *
+ *          A range past the samples recorded so far is answered with OUT_OF_RANGE and the number
+ *          recorded (u16): packages for READ_PACKAGE, samples for READ_HISTORY.
+ */
+static void cmd_execute(ble_cus_t * p_cus, ble_cus_link_t * p_link, cmd_entry_t const * p_cmd)
+{
+    uint8_t         rsp[BLE_CUS_CMD_RSP_MAX_LEN];
+    uint8_t         rsp_len    = 2;
+    uint8_t const * p_params   = &p_cmd->data[2];
+    uint16_t        params_len = p_cmd->len - 2;
+    uint8_t         status     = BLE_CUS_CP_STATUS_INVALID_PARAM;
+
+    switch (p_cmd->data[0])
+    {
+        case BLE_CUS_CMD_OP_READ_PACKAGE:
+            if (params_len == 2)
+            {
+                uint16_t idx = uint16_decode(p_params);
+
+                if (!package_recorded(p_cus, idx))
+                {
+                    status   = BLE_CUS_CP_STATUS_OUT_OF_RANGE;
+                    rsp_len += uint16_encode(p_cus->arr_counter / (SAMPLE_POOL_PACKAGE_LEN - 1), &rsp[rsp_len]);
+                    break;
+                }
+                for (uint32_t i = 0; i < SAMPLE_POOL_PACKAGE_LEN - 1; i++)
+                {
+                    rsp_len += uint16_encode((uint16_t)sample_pool_accl[idx * (SAMPLE_POOL_PACKAGE_LEN - 1) + i],
+                                             &rsp[rsp_len]);
+                }
+                status = BLE_CUS_CP_STATUS_SUCCESS;
+            }
+            break;
+
+        case BLE_CUS_CMD_OP_READ_HISTORY:
+            if (params_len == 5)
+            {
+                status = read_start(p_cus, p_link, p_cmd->data[1], uint16_decode(&p_params[0]),
+                                    uint16_decode(&p_params[2]), p_params[4]);
+                if (status == BLE_CUS_CP_STATUS_SUCCESS)
+                {
+                    // Answered by the data notifications.
+                    return;
+                }
+                if (status == BLE_CUS_CP_STATUS_OUT_OF_RANGE)
+                {
+                    rsp_len += uint16_encode(p_cus->arr_counter / 3, &rsp[rsp_len]);
+                }
+            }
+            break;
+
+        case BLE_CUS_CMD_OP_GET_POWER:
+            if (params_len == 0)
+            {
+                rsp_len += uint16_encode(p_cus->power, &rsp[rsp_len]);
+                status   = BLE_CUS_CP_STATUS_SUCCESS;
+            }
+            break;
+
+        case BLE_CUS_CMD_OP_PING:
+            if (params_len == 0)
+            {
+                rsp_len += uint32_encode(local_clock_ms(), &rsp[rsp_len]);
+                status   = BLE_CUS_CP_STATUS_SUCCESS;
+            }
+            break;
+
+        default:
+        {
+            uint8_t config_len;
+
+            status   = config_request(p_cus, p_link->conn_handle, p_cmd->data[0], p_params,
+                                      params_len, &rsp[rsp_len], &config_len);
+            rsp_len += config_len;
+        } break;
+    }
+
+    if ((status != BLE_CUS_CP_STATUS_SUCCESS) && (status != BLE_CUS_CP_STATUS_OUT_OF_RANGE))
+    {
+        rsp_len = 2;
+    }
+    rsp[0] = p_cmd->data[1];
+    rsp[1] = status;
+
+    // Room in the queue was checked by cmd_pump.
+    (void)tx_enqueue(p_cus, p_link, p_cus->cmd_handles.value_handle, rsp, rsp_len);
+}
+
+
+/**@brief Function for executing the waiting commands of a link while its notification queue has
+ *        room for their responses.
+ *
+ * @details Resumed on BLE_GATTS_EVT_HVN_TX_COMPLETE, so a burst of commands is answered as fast as
+ *          the link takes the responses and none is dropped.
+ */
+static void cmd_pump(ble_cus_t * p_cus, ble_cus_link_t * p_link)
+{
+    cmd_ring_t * p_ring   = link_cmd_ring(p_cus, p_link);
+    tx_queue_t * p_queue  = link_queue(p_cus, p_link);
+    bool         executed = false;
+
+    while ((p_ring->count > 0) && (p_queue->count < BLE_CUS_TX_QUEUE_SIZE))
+    {
+        cmd_execute(p_cus, p_link, &p_ring->entries[p_ring->first]);
+
+        p_ring->first = (p_ring->first + 1) % BLE_CUS_CMD_RING_SIZE;
+        p_ring->count--;
+        executed      = true;
+    }
+
+    if (executed)
+    {
+        tx_schedule(p_cus);
+    }
+}
+
+
+/**@brief Function for handling a write to the Command characteristic.
+ *
+ * @details Clients write commands without response, several per connection event, and get the
+ *          responses as notifications (see cmd_execute). Commands are ignored while notifications
+ *          are disabled, and dropped while BLE_CUS_CMD_RING_SIZE of them wait on the link.
+ */
+static void on_cmd_write(ble_cus_t * p_cus, ble_cus_link_t * p_link, uint8_t const * p_data, uint16_t len)
+{
+    cmd_ring_t * p_ring = link_cmd_ring(p_cus, p_link);
+
+    if ((len < 2) || (len > BLE_CUS_CMD_REQ_MAX_LEN) || !p_link->cmd_notifications)
+    {
+        return;
+    }
+    if (p_ring->count >= BLE_CUS_CMD_RING_SIZE)
+    {
+        NRF_LOG_WARNING("Command 0x%02x dropped, %d waiting on link %d.", p_data[0], p_ring->count,
+                        p_link->conn_handle);
+        return;
+    }
+
+    cmd_entry_t * p_cmd = &p_ring->entries[(p_ring->first + p_ring->count) % BLE_CUS_CMD_RING_SIZE];
+
+    p_cmd->len = (uint8_t)len;
+    memcpy(p_cmd->data, p_data, len);
+    p_ring->count++;
+
+    cmd_pump(p_cus, p_link);
+}
+
+static uint64_t u64_decode(uint8_t const * p_buf)
+{
+    return uint32_decode(p_buf) | ((uint64_t)uint32_decode(&p_buf[4]) << 32);
+}
+
+
+/**@brief Function for handling a write to the Time Sync characteristic.
+ *
+ * @details An exchange is a request and a follow-up, both answered with a notification. All
+ *          fields are little endian, times are in milliseconds; central times are on any 64-bit
+ *          timeline, local times since boot.
+ *
+ *          REQUEST:   op, seq (u8), t1 (u64)  -> op, seq, t2, t3 (u32 each, local)
+ *          FOLLOW_UP: op, seq (u8), t4 (u64)  -> op, seq, status, samples (u8), delay_ms (u16),
+ *                                                drift_ppb (i32)
+ *
+ *          t3 is taken right before the answer is handed to the SoftDevice, so the answer does
+ *          not wait in the notification queue; if the SoftDevice has no TX buffer it is dropped
+ *          and the central sends a new request. Exchanges from another central than the last one
+ *          restart the estimate.
  *
  * @param[in]   p_cus       Custom Service structure.
- * @param[in]   p_ble_evt   Event received from the BLE stack.
+ * @param[in]   p_link      Link the request was written on.
+ * @param[in]   p_data      Written data.
+ * @param[in]   len         Length of the written data.
  */
+static void on_time_sync_write(ble_cus_t * p_cus, ble_cus_link_t * p_link, uint8_t const * p_data, uint16_t len)
+{
+    uint32_t           t2      = local_clock_ms();
+    uint8_t            rsp[BLE_CUS_TIME_SYNC_RSP_LEN];
+    uint16_t           rsp_len = 2;
+    time_sync_status_t status;
 
-static void on_disconnect(ble_cus_t * p_cus, ble_evt_t const * p_ble_evt)
+    if ((len != BLE_CUS_TIME_SYNC_REQ_LEN) || !(p_link->subscriptions & BLE_CUS_SUB_TIME_SYNC))
+    {
+        return;
+    }
+
+    rsp[0] = p_data[0];
+    rsp[1] = p_data[1];
+
+    switch (p_data[0])
+    {
+        case BLE_CUS_TIME_SYNC_OP_REQUEST:
+            p_link->sync.t1      = u64_decode(&p_data[2]);
+            p_link->sync.t2      = t2;
+            p_link->sync_seq     = p_data[1];
+            p_link->sync_pending = false;
+
+            rsp_len += uint32_encode(t2, &rsp[rsp_len]);
+            p_link->sync.t3 = local_clock_ms();
+            rsp_len += uint32_encode(p_link->sync.t3, &rsp[rsp_len]);
+
+            if (link_hvx(p_link, p_cus->time_sync_handles.value_handle, rsp, rsp_len) == NRF_SUCCESS)
+            {
+                p_link->sync_pending = true;
+            }
+            return;
+
+        case BLE_CUS_TIME_SYNC_OP_FOLLOW_UP:
+            rsp[rsp_len] = BLE_CUS_TIME_SYNC_STATUS_NO_REQUEST;
+            if (p_link->sync_pending && (p_link->sync_seq == p_data[1]))
+            {
+                bool               restarted = false;
+                time_sync_result_t result;
+
+                if (p_cus->sync_conn_handle != p_link->conn_handle)
+                {
+                    restarted               = time_sync_is_synced();
+                    p_cus->sync_conn_handle = p_link->conn_handle;
+                    time_sync_reset();
+                }
+
+                p_link->sync.t4      = u64_decode(&p_data[2]);
+                p_link->sync_pending = false;
+                result               = time_sync_exchange_add(&p_link->sync);
+
+                if (result == TIME_SYNC_REJECTED)
+                {
+                    rsp[rsp_len] = BLE_CUS_TIME_SYNC_STATUS_REJECTED;
+                }
+                else if (restarted || (result == TIME_SYNC_RESTARTED))
+                {
+                    rsp[rsp_len] = BLE_CUS_TIME_SYNC_STATUS_RESTARTED;
+                }
+                else
+                {
+                    rsp[rsp_len] = BLE_CUS_TIME_SYNC_STATUS_ACCEPTED;
+                }
+            }
+            rsp_len++;
+
+            time_sync_status_get(&status);
+            rsp[rsp_len++] = status.samples;
+            rsp_len       += uint16_encode(status.delay_ms, &rsp[rsp_len]);
+            rsp_len       += uint32_encode((uint32_t)status.drift_ppb, &rsp[rsp_len]);
+
+            // Dropped notifications are counted by the TX queue.
+            (void)tx_enqueue(p_cus, p_link, p_cus->time_sync_handles.value_handle, rsp, rsp_len);
+            tx_schedule(p_cus);
+            return;
+
+        default:
+            return;
+    }
+}
+
+/**@brief Function for limiting a stride sequence number to the strides in the ring and the next
+ *        one.
+ */
+static uint16_t stride_seq_clip(uint16_t seq)
 {
-    UNUSED_PARAMETER(p_ble_evt);
+    uint16_t oldest = stride_events_oldest();
+    uint16_t head   = stride_events_head();
 
-    p_cus->conn_handle = BLE_CONN_HANDLE_INVALID;
-    
+    if ((int16_t)(seq - oldest) < 0)
+    {
+        return oldest;
+    }
+    if ((int16_t)(head - seq) < 0)
+    {
+        return head;
+    }
+    return seq;
+}
+
+
+static uint16_t stride_record_encode(stride_events_record_t const * p_record, uint8_t * p_buf)
+{
+    bool     synced = time_sync_is_synced();
+    uint16_t len    = uint16_encode(p_record->seq, p_buf);
+
+    p_buf[len++] = synced ? BLE_CUS_STRIDE_FLAG_SYNCED : 0;
+    len         += uint32_encode(synced ? time_sync_stamp(p_record->local_ms) : p_record->local_ms, &p_buf[len]);
+    len         += uint16_encode(p_record->duration_ms, &p_buf[len]);
+    len         += uint16_encode(p_record->gct_ms, &p_buf[len]);
+    len         += uint16_encode(p_record->vertical_osc_mm, &p_buf[len]);
+    len         += uint16_encode(p_record->peak_mg, &p_buf[len]);
+    len         += uint16_encode(p_record->power, &p_buf[len]);
+    return len;
+}
+
+
+/**@brief Function for queueing the strides a link has not had yet.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_link      Link.
+ * @param[in]   flush       Send strides that do not fill a notification even if they may wait.
+ */
+static void stride_pump(ble_cus_t * p_cus, ble_cus_link_t * p_link, bool flush)
+{
+    uint16_t const per_notification = p_link->max_data_len / BLE_CUS_STRIDE_RECORD_LEN;
+    uint16_t const head             = stride_events_head();
+    bool           queued           = false;
+
+    if (!(ble_cus_link_subscriptions(p_cus, p_link) & BLE_CUS_SUB_STRIDE))
+    {
+        return;
+    }
+
+    // Strides that dropped out of the ring meanwhile are lost.
+    p_link->stride_next = stride_seq_clip(p_link->stride_next);
+
+    while (p_link->stride_next != head)
+    {
+        stride_events_record_t record;
+        uint8_t                data[BLE_CUS_MAX_DATA_LEN];
+        uint16_t               len     = 0;
+        uint16_t               pending = head - p_link->stride_next;
+        uint16_t               count   = MIN(pending, per_notification);
+
+        (void)stride_events_get(p_link->stride_next, &record);
+        if ((pending < per_notification) && !flush
+            && (local_clock_ms() - record.local_ms < BLE_CUS_STRIDE_MAX_DELAY_MS))
+        {
+            break;
+        }
+
+        for (uint16_t i = 0; i < count; i++)
+        {
+            (void)stride_events_get(p_link->stride_next + i, &record);
+            len += stride_record_encode(&record, &data[len]);
+        }
+
+        // The strides wait in the ring while the queue is full.
+        if (tx_enqueue(p_cus, p_link, p_cus->stride_handles.value_handle, data, len) != NRF_SUCCESS)
+        {
+            break;
+        }
+        p_link->stride_next += count;
+        queued               = true;
+    }
+
+    if (queued)
+    {
+        tx_schedule(p_cus);
+    }
+}
+
+
+/**@brief Function for handling a write to the Stride characteristic: the sequence number (u16) of
+ *        the first stride the client wants again.
+ */
+static void on_stride_write(ble_cus_t * p_cus, ble_cus_link_t * p_link, uint8_t const * p_data, uint16_t len)
+{
+    if (len != sizeof(uint16_t))
+    {
+        return;
+    }
+
+    p_link->stride_next = stride_seq_clip(uint16_decode(p_data));
+    stride_pump(p_cus, p_link, true);
+}
+
+
+/**@brief Function for getting the subscription bit of a characteristic.
+ *
+ * @param[in]   handle      CCCD or value handle.
+ * @param[in]   is_cccd     True to look the handle up among the CCCDs, false among the values.
+ *
+ * @return BLE_CUS_SUB_* bit, or 0 if the handle is not one of a characteristic with notifications.
+ */
+static uint16_t handle_subscription(ble_cus_t const * p_cus, uint16_t handle, bool is_cccd)
+{
+    struct
+    {
+        ble_gatts_char_handles_t const * p_handles;
+        uint16_t                         subscription;
+    } const chars[] =
+    {
+        {&p_cus->custom_value_handles, BLE_CUS_SUB_CUSTOM_VALUE},
+        {&p_cus->package_handles,      BLE_CUS_SUB_PACKAGE},
+        {&p_cus->power_handles,        BLE_CUS_SUB_POWER},
+        {&p_cus->bulk_handles,         BLE_CUS_SUB_BULK},
+        {&p_cus->metrics_handles,      BLE_CUS_SUB_METRICS},
+        {&p_cus->history_handles,      BLE_CUS_SUB_HISTORY},
+        {&p_cus->time_sync_handles,    BLE_CUS_SUB_TIME_SYNC},
+        {&p_cus->delta_handles,        BLE_CUS_SUB_DELTA},
+        {&p_cus->stride_handles,       BLE_CUS_SUB_STRIDE},
+    };
+
+    for (uint32_t i = 0; (handle != BLE_GATT_HANDLE_INVALID) && (i < ARRAY_SIZE(chars)); i++)
+    {
+        if (handle == (is_cccd ? chars[i].p_handles->cccd_handle : chars[i].p_handles->value_handle))
+        {
+            return chars[i].subscription;
+        }
+    }
+    return 0;
+}
+
+
+/**@brief Function for tracking a CCCD write and passing it to the application.
+ */
+static void on_cccd_write(ble_cus_t * p_cus, ble_cus_link_t * p_link, uint16_t handle, uint8_t const * p_cccd)
+{
     ble_cus_evt_t evt;
+    uint16_t      subscription = handle_subscription(p_cus, handle, true);
+
+    if (subscription == 0)
+    {
+        return;
+    }
 
-    evt.evt_type = BLE_CUS_EVT_DISCONNECTED;
+    memset(&evt, 0, sizeof(evt));
+    if (ble_srv_is_notification_enabled(p_cccd))
+    {
+        p_link->subscriptions |= subscription;
+        evt.evt_type           = BLE_CUS_EVT_NOTIFICATION_ENABLED;
+
+        if (subscription == BLE_CUS_SUB_DELTA)
+        {
+            delta_codec_keyframe_request(&p_cus->delta);
+        }
+        if (subscription == BLE_CUS_SUB_STRIDE)
+        {
+            p_link->stride_next = stride_events_head();
+        }
+    }
+    else
+    {
+        p_link->subscriptions &= ~subscription;
+        evt.evt_type           = BLE_CUS_EVT_NOTIFICATION_DISABLED;
+    }
+    evt.conn_handle  = p_link->conn_handle;
+    evt.subscription = subscription;
 
-    p_cus->evt_handler(p_cus, &evt);
+    if (p_cus->evt_handler != NULL)
+    {
+        p_cus->evt_handler(p_cus, &evt);
+    }
 }
 
+
 /**@brief Function for handling the Write event.
  *
  * @param[in]   p_cus       Custom Service structure.
@@ -53,6 +1503,13 @@ static void on_disconnect(ble_cus_t * p_cus, ble_evt_t const * p_ble_evt)
 static void on_write(ble_cus_t * p_cus, ble_evt_t const * p_ble_evt)
 {
     ble_gatts_evt_write_t const * p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
+    uint16_t                      conn_handle = p_ble_evt->evt.gatts_evt.conn_handle;
+    ble_cus_link_t              * p_link      = link_find(p_cus, conn_handle);
+
+    if (p_link == NULL)
+    {
+        return;
+    }
     
     // Custom Value Characteristic Written to.
     if (p_evt_write->handle == p_cus->custom_value_handles.value_handle)
@@ -67,46 +1524,77 @@ static void on_write(ble_cus_t * p_cus, ble_evt_t const * p_ble_evt)
         rx_data.offset = 0;
         rx_data.p_value = (uint8_t*)&(p_cus->package_idx);
 
-        sd_ble_gatts_value_get(p_cus->conn_handle, p_cus->package_idx_handles.value_handle, &rx_data);
+        sd_ble_gatts_value_get(conn_handle, p_cus->package_idx_handles.value_handle, &rx_data);
         
+        // Only recorded packages; anything else would read past accl_arr.
+        bool recorded = package_recorded(p_cus, p_cus->package_idx);
+
         for(int i=0;i<9;i++)
         {
-            p_cus->package[i] = p_cus->accl_arr[p_cus->package_idx*9 + i];
+            sample_pool_package[i] = recorded ? sample_pool_accl[p_cus->package_idx*9 + i] : 0;
         }
         
-        p_cus->package[9] = p_cus->package_idx;
+        sample_pool_package[9] = recorded ? p_cus->package_idx : BLE_CUS_PACKAGE_IDX_INVALID;
 
         ble_gatts_value_t tx_data;
-        tx_data.len = sizeof(p_cus->package);
+        tx_data.len = sizeof(sample_pool_package);
         tx_data.offset = 0;
-        tx_data.p_value = (uint8_t*)&(p_cus->package);
+        tx_data.p_value = (uint8_t*)sample_pool_package;
 
-        sd_ble_gatts_value_set(p_cus->conn_handle, p_cus->package_handles.value_handle, &tx_data); 
+        sd_ble_gatts_value_set(conn_handle, p_cus->package_handles.value_handle, &tx_data); 
         
     }
 
 
-    // Check if the Custom value CCCD is written to and that the value is the appropriate length, i.e 2 bytes.
-    if ((p_evt_write->handle == p_cus->custom_value_handles.cccd_handle)
-        && (p_evt_write->len == 2)
-       )
+    if (p_evt_write->handle == p_cus->session_handles.value_handle)
+    {
+        on_session_write(p_cus, conn_handle, p_evt_write->data, p_evt_write->len);
+    }
+
+    if (p_evt_write->handle == p_cus->bulk_handles.value_handle)
+    {
+        on_bulk_write(p_cus, p_link, p_evt_write->data, p_evt_write->len);
+    }
+
+    if (p_evt_write->handle == p_cus->history_ctrl_handles.value_handle)
+    {
+        on_history_ctrl_write(p_cus, p_link, p_evt_write->data, p_evt_write->len);
+    }
+
+    if (p_evt_write->handle == p_cus->cp_handles.value_handle)
+    {
+        on_cp_write(p_cus, p_link, p_evt_write->data, p_evt_write->len);
+    }
+
+    if (p_evt_write->handle == p_cus->time_sync_handles.value_handle)
+    {
+        on_time_sync_write(p_cus, p_link, p_evt_write->data, p_evt_write->len);
+    }
+
+    if (p_evt_write->handle == p_cus->cmd_handles.value_handle)
+    {
+        on_cmd_write(p_cus, p_link, p_evt_write->data, p_evt_write->len);
+    }
+
+    if (p_evt_write->handle == p_cus->stride_handles.value_handle)
+    {
+        on_stride_write(p_cus, p_link, p_evt_write->data, p_evt_write->len);
+    }
+
+    if ((p_evt_write->handle == p_cus->cp_handles.cccd_handle) && (p_evt_write->len == BLE_CCCD_VALUE_LEN))
+    {
+        p_link->cp_indications = ble_srv_is_indication_enabled(p_evt_write->data);
+    }
+
+    if ((p_evt_write->handle == p_cus->cmd_handles.cccd_handle) && (p_evt_write->len == BLE_CCCD_VALUE_LEN))
     {
-        // CCCD written, call application event handler
-        if (p_cus->evt_handler != NULL)
-        {
-            ble_cus_evt_t evt;
+        p_link->cmd_notifications = ble_srv_is_notification_enabled(p_evt_write->data);
+    }
 
-            if (ble_srv_is_notification_enabled(p_evt_write->data))
-            {
-                evt.evt_type = BLE_CUS_EVT_NOTIFICATION_ENABLED;
-            }
-            else
-            {
-                evt.evt_type = BLE_CUS_EVT_NOTIFICATION_DISABLED;
-            }
-            // Call the application event handler.
-            p_cus->evt_handler(p_cus, &evt);
-        }
+
+    if (p_evt_write->len == BLE_CCCD_VALUE_LEN)
+    {
+        on_cccd_write(p_cus, p_link, p_evt_write->handle, p_evt_write->data);
     }
 
 }
@@ -134,6 +1622,34 @@ void ble_cus_on_ble_evt( ble_evt_t const * p_ble_evt, void * p_context)
         case BLE_GATTS_EVT_WRITE:
             on_write(p_cus, p_ble_evt);
             break;
+
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+        {
+            ble_cus_link_t * p_link = link_find(p_cus, p_ble_evt->evt.gatts_evt.conn_handle);
+
+            if (p_link != NULL)
+            {
+                uint8_t count = p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count;
+
+                p_link->in_flight -= MIN(count, p_link->in_flight);
+            }
+            tx_schedule(p_cus);
+            if (p_link != NULL)
+            {
+                cmd_pump(p_cus, p_link);
+            }
+        } break;
+
+        case BLE_GATTS_EVT_HVC:
+        {
+            ble_cus_link_t * p_link = link_find(p_cus, p_ble_evt->evt.gatts_evt.conn_handle);
+
+            if ((p_link != NULL) && (p_ble_evt->evt.gatts_evt.params.hvc.handle == p_cus->cp_handles.value_handle))
+            {
+                p_link->cp_indicating = false;
+                cp_rsp_send(p_cus, p_link);
+            }
+        } break;
 /* Handling this event is not necessary
         case BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST:
             NRF_LOG_INFO("EXCHANGE_MTU_REQUEST event received.\r\n");
@@ -378,7 +1894,7 @@ static uint32_t pakage_char_add(ble_cus_t * p_cus, const ble_cus_init_t * p_cus_
     attr_md.vloc       = BLE_GATTS_VLOC_STACK;
     attr_md.rd_auth    = 0;
     attr_md.wr_auth    = 0;
-    attr_md.vlen       = 0;
+    attr_md.vlen       = 1;
 
     memset(&attr_char_value, 0, sizeof(attr_char_value));
 
@@ -386,8 +1902,8 @@ static uint32_t pakage_char_add(ble_cus_t * p_cus, const ble_cus_init_t * p_cus_
     attr_char_value.p_attr_md = &attr_md;
     attr_char_value.init_len  = 20;
     attr_char_value.init_offs = 0;
-    attr_char_value.max_len   = 20;
-    attr_char_value.p_value     = (uint8_t*)&p_cus->package;
+    attr_char_value.max_len   = BLE_CUS_MAX_DATA_LEN;
+    attr_char_value.p_value     = (uint8_t*)sample_pool_package;
 
     err_code = sd_ble_gatts_characteristic_add(p_cus->service_handle, &char_md,
                                                &attr_char_value,
@@ -462,13 +1978,92 @@ static uint32_t pakage_idx_char_add(ble_cus_t * p_cus, const ble_cus_init_t * p_
 
     return NRF_SUCCESS;
 }
+/**@brief Function for adding a characteristic to the Custom Service.
+ *
+ * @details Same attribute setup as the characteristics above, with the properties and lengths
+ *          given by the caller. A CCCD is added if the characteristic can notify or indicate.
+ *
+ * @param[in]   p_cus        Custom Service structure.
+ * @param[in]   p_cus_init   Information needed to initialize the service.
+ * @param[in]   uuid         Characteristic UUID, relative to CUSTOM_SERVICE_UUID_BASE.
+ * @param[in]   props        Characteristic properties.
+ * @param[in]   init_len     Initial value length.
+ * @param[in]   max_len      Maximum value length. The value has variable length if it differs from init_len.
+ * @param[in]   vloc         BLE_GATTS_VLOC_STACK, or BLE_GATTS_VLOC_USER to serve the value
+ *                           straight from p_value, which then has to stay valid.
+ * @param[in]   p_value      Initial value, or NULL.
+ * @param[out]  p_handles    Handles of the new characteristic.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+static uint32_t cus_char_add(ble_cus_t                * p_cus,
+                             const ble_cus_init_t     * p_cus_init,
+                             uint16_t                   uuid,
+                             ble_gatt_char_props_t      props,
+                             uint16_t                   init_len,
+                             uint16_t                   max_len,
+                             uint8_t                    vloc,
+                             uint8_t                  * p_value,
+                             ble_gatts_char_handles_t * p_handles)
+{
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_md_t cccd_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+
+    memset(&cccd_md, 0, sizeof(cccd_md));
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
+    cccd_md.write_perm = p_cus_init->custom_value_char_attr_md.cccd_write_perm;
+    cccd_md.vloc       = BLE_GATTS_VLOC_STACK;
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props = props;
+    char_md.p_cccd_md  = (props.notify || props.indicate) ? &cccd_md : NULL;
+
+    ble_uuid.type = p_cus->uuid_type;
+    ble_uuid.uuid = uuid;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    attr_md.read_perm  = p_cus_init->custom_value_char_attr_md.read_perm;
+    attr_md.write_perm = p_cus_init->custom_value_char_attr_md.write_perm;
+    attr_md.vloc       = vloc;
+    attr_md.vlen       = (init_len != max_len);
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid    = &ble_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = init_len;
+    attr_char_value.max_len   = max_len;
+    attr_char_value.p_value   = p_value;
+
+    return sd_ble_gatts_characteristic_add(p_cus->service_handle, &char_md,
+                                           &attr_char_value, p_handles);
+}
+
 void ble_cus_init(ble_cus_t * p_cus, const ble_cus_init_t * p_cus_init)
 {
     ble_uuid_t ble_uuid;
 
     // Initialize service structure
     p_cus->evt_handler               = p_cus_init->evt_handler;
-    p_cus->conn_handle               = BLE_CONN_HANDLE_INVALID;
+
+    p_cus->config.sample_rate_hz     = BLE_CUS_SAMPLE_RATE_DEFAULT_HZ;
+    p_cus->config.power_window       = SAMPLE_POOL_POWER_LEN;
+    p_cus->config.notify_interval_ms = BLE_CUS_NOTIFY_INTERVAL_DEFAULT_MS;
+    p_cus->config.range_g            = BLE_CUS_SENSOR_RANGE_DEFAULT_G;
+    p_cus->config.streaming_mode     = BLE_CUS_STREAMING_ALL;
+
+    p_cus->sync_conn_handle          = BLE_CONN_HANDLE_INVALID;
+
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        p_cus->links[i].conn_handle = BLE_CONN_HANDLE_INVALID;
+    }
 
     // Add Custom Service UUID
     ble_uuid128_t base_uuid = {CUSTOM_SERVICE_UUID_BASE};
@@ -486,6 +2081,134 @@ void ble_cus_init(ble_cus_t * p_cus, const ble_cus_init_t * p_cus_init)
     pakage_char_add(p_cus, p_cus_init);
     pakage_idx_char_add(p_cus, p_cus_init);
     power_char_add(p_cus, p_cus_init);
+
+    ble_gatt_char_props_t session_props = {.read = 1, .write = 1};
+    uint8_t               session_value[BLE_CUS_SESSION_RSP_MAX_LEN] = {0};
+
+    cus_char_add(p_cus, p_cus_init, SESSION_CHAR_UUID, session_props,
+                 2, BLE_CUS_SESSION_RSP_MAX_LEN, BLE_GATTS_VLOC_STACK, session_value,
+                 &p_cus->session_handles);
+
+    // Served from the crash report in RAM, so the attribute table does not hold a second copy.
+    // Longer than the MTU, so clients fetch it with a long read.
+    ble_gatt_char_props_t crash_props = {.read = 1};
+    crash_buffer_t const * p_report;
+    uint16_t               report_len = crash_buffer_report(&p_report);
+
+    cus_char_add(p_cus, p_cus_init, CRASH_CHAR_UUID, crash_props,
+                 report_len, sizeof(crash_buffer_t), BLE_GATTS_VLOC_USER, (uint8_t *)p_report,
+                 &p_cus->crash_handles);
+
+    ble_gatt_char_props_t bulk_props = {.write = 1, .notify = 1};
+
+    cus_char_add(p_cus, p_cus_init, BULK_CHAR_UUID, bulk_props,
+                 0, BLE_CUS_MAX_DATA_LEN, BLE_GATTS_VLOC_STACK, NULL,
+                 &p_cus->bulk_handles);
+
+    ble_gatt_char_props_t metrics_props = {.notify = 1};
+
+    cus_char_add(p_cus, p_cus_init, METRICS_CHAR_UUID, metrics_props,
+                 0, METRICS_FRAME_MAX_LEN, BLE_GATTS_VLOC_STACK, NULL,
+                 &p_cus->metrics_handles);
+
+    ble_gatt_char_props_t history_props      = {.notify = 1};
+    ble_gatt_char_props_t history_ctrl_props = {.read = 1, .write = 1, .write_wo_resp = 1};
+
+    cus_char_add(p_cus, p_cus_init, HISTORY_CHAR_UUID, history_props,
+                 0, BLE_CUS_MAX_DATA_LEN, BLE_GATTS_VLOC_STACK, NULL,
+                 &p_cus->history_handles);
+    cus_char_add(p_cus, p_cus_init, HISTORY_CTRL_CHAR_UUID, history_ctrl_props,
+                 0, BLE_CUS_HISTORY_RSP_MAX_LEN, BLE_GATTS_VLOC_STACK, NULL,
+                 &p_cus->history_ctrl_handles);
+
+    ble_gatt_char_props_t cp_props = {.write = 1, .indicate = 1};
+
+    cus_char_add(p_cus, p_cus_init, CONTROL_POINT_CHAR_UUID, cp_props,
+                 0, BLE_CUS_CP_RSP_MAX_LEN, BLE_GATTS_VLOC_STACK, NULL,
+                 &p_cus->cp_handles);
+
+    ble_gatt_char_props_t time_sync_props = {.write = 1, .write_wo_resp = 1, .notify = 1};
+
+    cus_char_add(p_cus, p_cus_init, TIME_SYNC_CHAR_UUID, time_sync_props,
+                 0, BLE_CUS_TIME_SYNC_RSP_LEN, BLE_GATTS_VLOC_STACK, NULL,
+                 &p_cus->time_sync_handles);
+
+    ble_gatt_char_props_t delta_props = {.notify = 1};
+
+    cus_char_add(p_cus, p_cus_init, DELTA_CHAR_UUID, delta_props,
+                 0, BLE_CUS_MAX_DATA_LEN, BLE_GATTS_VLOC_STACK, NULL,
+                 &p_cus->delta_handles);
+
+    ble_gatt_char_props_t db_hash_props = {.read = 1};
+    uint8_t               db_hash[sizeof(uint32_t)] = {0};
+
+    cus_char_add(p_cus, p_cus_init, DB_HASH_CHAR_UUID, db_hash_props,
+                 sizeof(db_hash), sizeof(db_hash), BLE_GATTS_VLOC_STACK, db_hash,
+                 &p_cus->db_hash_handles);
+
+    ble_gatt_char_props_t cmd_props = {.write = 1, .write_wo_resp = 1, .notify = 1};
+
+    cus_char_add(p_cus, p_cus_init, COMMAND_CHAR_UUID, cmd_props,
+                 0, BLE_CUS_MAX_DATA_LEN, BLE_GATTS_VLOC_STACK, NULL,
+                 &p_cus->cmd_handles);
+
+    ble_gatt_char_props_t stride_props = {.write = 1, .notify = 1};
+
+    cus_char_add(p_cus, p_cus_init, STRIDE_CHAR_UUID, stride_props,
+                 0, BLE_CUS_MAX_DATA_LEN, BLE_GATTS_VLOC_STACK, NULL,
+                 &p_cus->stride_handles);
+
+    ble_gatt_char_props_t session_stats_props = {.read = 1};
+
+    cus_char_add(p_cus, p_cus_init, SESSION_STATS_CHAR_UUID, session_stats_props,
+                 0, BLE_CUS_SESSION_STATS_LEN, BLE_GATTS_VLOC_STACK, NULL,
+                 &p_cus->session_stats_handles);
+}
+
+void ble_cus_db_hash_set(ble_cus_t * p_cus, uint32_t db_hash)
+{
+    uint8_t           value[sizeof(uint32_t)];
+    ble_gatts_value_t tx_data;
+
+    tx_data.len     = uint32_encode(db_hash, value);
+    tx_data.offset  = 0;
+    tx_data.p_value = value;
+
+    (void)sd_ble_gatts_value_set(BLE_CONN_HANDLE_INVALID, p_cus->db_hash_handles.value_handle, &tx_data);
+}
+
+void ble_cus_session_stats_set(ble_cus_t * p_cus, session_stats_summary_t const * p_summary)
+{
+    uint8_t           value[BLE_CUS_SESSION_STATS_LEN];
+    uint16_t          len = 0;
+    ble_gatts_value_t tx_data;
+
+    if (p_summary != NULL)
+    {
+        len += uint16_encode(p_summary->id, &value[len]);
+        value[len++] = (uint8_t)p_summary->flags;
+        len += uint32_encode(p_summary->start, &value[len]);
+        len += uint32_encode(p_summary->elapsed_ms, &value[len]);
+        len += uint32_encode(p_summary->moving_ms, &value[len]);
+        len += uint32_encode(p_summary->steps, &value[len]);
+        len += uint16_encode(p_summary->cadence, &value[len]);
+        len += uint16_encode(p_summary->power_avg, &value[len]);
+        len += uint16_encode(p_summary->power_max, &value[len]);
+        len += uint16_encode(p_summary->power_p50, &value[len]);
+        len += uint16_encode(p_summary->power_p90, &value[len]);
+        len += uint16_encode(p_summary->gct_ms, &value[len]);
+        len += uint16_encode(p_summary->vertical_osc_mm, &value[len]);
+        for (uint8_t zone = 0; zone < SESSION_STATS_ZONE_COUNT; zone++)
+        {
+            len += uint32_encode(p_summary->zone_ms[zone], &value[len]);
+        }
+    }
+
+    tx_data.len     = len;
+    tx_data.offset  = 0;
+    tx_data.p_value = value;
+
+    (void)sd_ble_gatts_value_set(BLE_CONN_HANDLE_INVALID, p_cus->session_stats_handles.value_handle, &tx_data);
 }
 
 uint32_t ble_cus_custom_value_update(ble_cus_t * p_cus, uint8_t custom_value)
@@ -507,7 +2230,7 @@ uint32_t ble_cus_custom_value_update(ble_cus_t * p_cus, uint8_t custom_value)
     gatts_value.p_value = &custom_value;
 
     // Update database.
-    err_code = sd_ble_gatts_value_set(p_cus->conn_handle,
+    err_code = sd_ble_gatts_value_set(BLE_CONN_HANDLE_INVALID,
                                       p_cus->custom_value_handles.value_handle,
                                       &gatts_value);
     if (err_code != NRF_SUCCESS)
@@ -516,27 +2239,9 @@ uint32_t ble_cus_custom_value_update(ble_cus_t * p_cus, uint8_t custom_value)
     }
 
     // Send value if connected and notifying.
-    if ((p_cus->conn_handle != BLE_CONN_HANDLE_INVALID)) 
-    {
-        ble_gatts_hvx_params_t hvx_params;
-
-        memset(&hvx_params, 0, sizeof(hvx_params));
-
-        hvx_params.handle = p_cus->custom_value_handles.value_handle;
-        hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
-        hvx_params.offset = gatts_value.offset;
-        hvx_params.p_len  = &gatts_value.len;
-        hvx_params.p_data = gatts_value.p_value;
-
-        err_code = sd_ble_gatts_hvx(p_cus->conn_handle, &hvx_params);
-        NRF_LOG_INFO("sd_ble_gatts_hvx result: %x. \r\n", err_code); 
-    }
-    else
-    {
-        err_code = NRF_ERROR_INVALID_STATE;
-        NRF_LOG_INFO("sd_ble_gatts_hvx result: NRF_ERROR_INVALID_STATE. \r\n"); 
-    }
-
+    err_code = ble_cus_notify(p_cus, p_cus->custom_value_handles.value_handle,
+                              gatts_value.p_value, gatts_value.len);
+    NRF_LOG_INFO("ble_cus_notify result: %x. \r\n", err_code); 
 
     return err_code;
 }
@@ -647,30 +2352,292 @@ void power_update(ble_cus_t * p_cus)
 
     // }
 
-    double last_50_avg_pow=0;
-    for(int i=0;i<50;i++)
-        last_50_avg_pow = last_50_avg_pow + p_cus->pow_buf[(p_cus->pow_buf_counter+i)%50];
-    last_50_avg_pow = last_50_avg_pow/50;
-    p_cus->power = (uint16_t)(last_50_avg_pow);
+    p_cus->power = power_compute(p_cus);
 
-    ble_gatts_hvx_params_t hvx_params;
-    uint16_t len = sizeof(p_cus->power);
-    hvx_params.handle		= p_cus->power_handles.value_handle;
-    hvx_params.type	    	= BLE_GATT_HVX_NOTIFICATION;
-    hvx_params.offset		= 0;
-    hvx_params.p_len		= &len;
-    hvx_params.p_data		= (uint8_t*)&(p_cus->power);
-    sd_ble_gatts_hvx(p_cus->conn_handle, &hvx_params);
+    if (!ble_cus_subscribed(p_cus, BLE_CUS_SUB_POWER))
+    {
+        return;
+    }
+
+    // Dropped notifications are counted by the TX queue.
+    (void)ble_cus_notify(p_cus, p_cus->power_handles.value_handle,
+                         (uint8_t*)&(p_cus->power), sizeof(p_cus->power));
+}
+uint32_t ble_cus_metrics_update(ble_cus_t * p_cus, metrics_frame_t * p_frame)
+{
+    uint8_t  frame[METRICS_FRAME_MAX_LEN];
+    uint16_t len;
+
+    p_frame->seq = p_cus->metrics_seq++;
+    len          = metrics_frame_encode(p_frame, frame);
+
+    return ble_cus_notify(p_cus, p_cus->metrics_handles.value_handle, frame, len);
+}
+
+uint32_t ble_cus_notify(ble_cus_t * p_cus, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    uint16_t subscription = handle_subscription(p_cus, handle, false);
+    uint32_t result       = NRF_ERROR_INVALID_STATE;
+
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        ble_cus_link_t * p_link = &p_cus->links[i];
+
+        if ((p_link->conn_handle == BLE_CONN_HANDLE_INVALID) || !(p_link->subscriptions & subscription))
+        {
+            continue;
+        }
+        uint32_t err_code = tx_enqueue(p_cus, p_link, handle, p_data, len);
+
+        if ((err_code != NRF_SUCCESS) || (result == NRF_ERROR_INVALID_STATE))
+        {
+            result = err_code;
+        }
+    }
+
+    if (result == NRF_ERROR_INVALID_STATE)
+    {
+        m_tx_stats.dropped_disconnected++;
+        return result;
+    }
+
+    tx_schedule(p_cus);
+    return result;
+}
+
+uint16_t ble_cus_tx_queue_depth(ble_cus_t * p_cus, uint16_t conn_handle)
+{
+    ble_cus_link_t const * p_link = link_find(p_cus, conn_handle);
+
+    return (p_link != NULL) ? link_queue(p_cus, p_link)->count : 0;
+}
+
+ble_cus_tx_stats_t const * ble_cus_tx_stats(void)
+{
+    return &m_tx_stats;
+}
+
+/**@brief Function for reading whether notifications, or indications, are enabled in a CCCD.
+ */
+static bool cccd_enabled(uint16_t conn_handle, uint16_t cccd_handle, bool indication)
+{
+    uint8_t           cccd[BLE_CCCD_VALUE_LEN] = {0};
+    ble_gatts_value_t value;
+
+    value.len     = sizeof(cccd);
+    value.offset  = 0;
+    value.p_value = cccd;
+
+    if (sd_ble_gatts_value_get(conn_handle, cccd_handle, &value) != NRF_SUCCESS)
+    {
+        return false;
+    }
+    return indication ? ble_srv_is_indication_enabled(cccd) : ble_srv_is_notification_enabled(cccd);
+}
+
+uint16_t ble_cus_link_subscriptions(ble_cus_t const * p_cus, ble_cus_link_t const * p_link)
+{
+    switch (p_cus->config.streaming_mode)
+    {
+        case BLE_CUS_STREAMING_METRICS:
+            return p_link->subscriptions & ~BLE_CUS_SUB_RAW;
+
+        case BLE_CUS_STREAMING_OFF:
+            return p_link->subscriptions & ~BLE_CUS_SUB_LIVE;
+
+        default:
+            return p_link->subscriptions;
+    }
+}
+
+bool ble_cus_subscribed(ble_cus_t const * p_cus, uint16_t mask)
+{
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        if (ble_cus_link_subscriptions(p_cus, &p_cus->links[i]) & mask)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+ble_cus_link_t * ble_cus_link_get(ble_cus_t * p_cus, uint16_t conn_handle)
+{
+    return link_find(p_cus, conn_handle);
+}
+
+bool ble_cus_link_transfer_active(ble_cus_link_t const * p_link)
+{
+    return (p_link->bulk.remaining > 0) || history_xfer_pending(&p_link->history)
+           || (p_link->read.remaining > 0);
+}
+
+uint8_t ble_cus_link_count(ble_cus_t const * p_cus)
+{
+    uint8_t count = 0;
+
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        count += (p_cus->links[i].conn_handle != BLE_CONN_HANDLE_INVALID);
+    }
+    return count;
+}
+
+/**@brief Function for reading the subscriptions of a link from the CCCDs.
+ *
+ * @details Without restored CCCDs the SoftDevice reports them as missing, which reads as off.
+ */
+static void link_subscriptions_read(ble_cus_t * p_cus, ble_cus_link_t * p_link)
+{
+    uint16_t const cccds[] =
+    {
+        p_cus->custom_value_handles.cccd_handle,
+        p_cus->package_handles.cccd_handle,
+        p_cus->power_handles.cccd_handle,
+        p_cus->bulk_handles.cccd_handle,
+        p_cus->metrics_handles.cccd_handle,
+        p_cus->history_handles.cccd_handle,
+        p_cus->time_sync_handles.cccd_handle,
+        p_cus->delta_handles.cccd_handle,
+        p_cus->stride_handles.cccd_handle,
+    };
+
+    p_link->subscriptions = 0;
+    for (uint32_t i = 0; i < ARRAY_SIZE(cccds); i++)
+    {
+        if (cccd_enabled(p_link->conn_handle, cccds[i], false))
+        {
+            p_link->subscriptions |= handle_subscription(p_cus, cccds[i], true);
+        }
+    }
+    p_link->cp_indications    = cccd_enabled(p_link->conn_handle, p_cus->cp_handles.cccd_handle, true);
+    p_link->cmd_notifications = cccd_enabled(p_link->conn_handle, p_cus->cmd_handles.cccd_handle, false);
+}
+
+void ble_cus_subscriptions_refresh(ble_cus_t * p_cus, uint16_t conn_handle)
+{
+    ble_cus_link_t * p_link = link_find(p_cus, conn_handle);
+    uint16_t         old_subscriptions;
+
+    if (p_link == NULL)
+    {
+        return;
+    }
+
+    old_subscriptions = ble_cus_link_subscriptions(p_cus, p_link);
+    link_subscriptions_read(p_cus, p_link);
+    if (!(old_subscriptions & BLE_CUS_SUB_POWER))
+    {
+        link_resume(p_cus, p_link);
+    }
+}
+
+void ble_cus_att_mtu_set(ble_cus_t * p_cus, uint16_t conn_handle, uint16_t att_mtu)
+{
+    ble_cus_link_t * p_link = link_find(p_cus, conn_handle);
+
+    if (p_link == NULL)
+    {
+        return;
+    }
+
+    p_link->max_data_len = MIN(att_mtu - 3, BLE_CUS_MAX_DATA_LEN);
+    NRF_LOG_INFO("Notification payload %d bytes on link %d.", p_link->max_data_len, conn_handle);
 }
+
 void package_update(ble_cus_t * p_cus)
 {
-    ble_gatts_hvx_params_t hvx_params;
-    uint16_t len = sizeof(p_cus->package);
-    hvx_params.handle		= p_cus->package_handles.value_handle;
-    hvx_params.type	    	= BLE_GATT_HVX_NOTIFICATION;
-    hvx_params.offset		= 0;
-    hvx_params.p_len		= &len;
-    hvx_params.p_data		= (uint8_t*)&(p_cus->package);
-    sd_ble_gatts_hvx(p_cus->conn_handle, &hvx_params);
+    if (!ble_cus_subscribed(p_cus, BLE_CUS_SUB_PACKAGE))
+    {
+        p_cus->live_len = 0;
+        return;
+    }
+
+    // Whole packages only, as many as fit sample_pool_live and the MTU of every subscribed link,
+    // leaving room for the timestamp unless not even one package would fit then.
+    uint16_t data_len = BLE_CUS_MAX_DATA_LEN;
+    uint16_t capacity;
+    bool     stamped;
+
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        if (p_cus->links[i].subscriptions & BLE_CUS_SUB_PACKAGE)
+        {
+            data_len = MIN(data_len, p_cus->links[i].max_data_len);
+        }
+    }
+    stamped  = (data_len >= SAMPLE_POOL_PACKAGE_LEN * sizeof(uint16_t) + BLE_CUS_TIMESTAMP_LEN);
+    capacity = MIN(SAMPLE_POOL_LIVE_LEN, (data_len - (stamped ? BLE_CUS_TIMESTAMP_LEN : 0)) / sizeof(uint16_t));
+    capacity -= capacity % SAMPLE_POOL_PACKAGE_LEN;
+
+    for (uint16_t i = 0; i < SAMPLE_POOL_PACKAGE_LEN; i++)
+    {
+        sample_pool_live[p_cus->live_len + i] = sample_pool_package[i];
+    }
+    p_cus->live_len += SAMPLE_POOL_PACKAGE_LEN;
+
+    if (p_cus->live_len + SAMPLE_POOL_PACKAGE_LEN <= capacity)
+    {
+        return;
+    }
+
+    uint8_t * p_data = (uint8_t*)sample_pool_live;
+    uint16_t  len    = p_cus->live_len * sizeof(uint16_t);
+
+    if (stamped && time_sync_is_synced())
+    {
+        len += uint32_encode(time_sync_stamp(local_clock_ms()), &p_data[len]);
+    }
+
+    (void)ble_cus_notify(p_cus, p_cus->package_handles.value_handle, p_data, len);
+
+    p_cus->live_len = 0;
+}
+
+void ble_cus_delta_update(ble_cus_t * p_cus, int16_t x, int16_t y, int16_t z)
+{
+    delta_codec_sample_t const sample  = {.axis = {x, y, z}};
+    uint16_t                   max_len = BLE_CUS_MAX_DATA_LEN;
+    uint8_t                    frame[BLE_CUS_MAX_DATA_LEN];
+    uint16_t                   len;
+
+    if (!ble_cus_subscribed(p_cus, BLE_CUS_SUB_DELTA))
+    {
+        // Starts over once a client subscribes.
+        p_cus->delta.max_len = 0;
+        return;
+    }
 
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        if (p_cus->links[i].subscriptions & BLE_CUS_SUB_DELTA)
+        {
+            max_len = MIN(max_len, p_cus->links[i].max_data_len);
+        }
+    }
+    if (max_len != p_cus->delta.max_len)
+    {
+        // Samples batched for the old length are dropped; the stream goes on with a keyframe.
+        delta_codec_enc_init(&p_cus->delta, max_len);
+    }
+
+    len = delta_codec_push(&p_cus->delta, &sample, time_sync_stamp(local_clock_ms()), frame);
+    if ((len > 0) && (ble_cus_notify(p_cus, p_cus->delta_handles.value_handle, frame, len) != NRF_SUCCESS))
+    {
+        // The next frame refers to samples a client did not get: it has to be a keyframe. Dropped
+        // notifications are counted by the TX queue.
+        delta_codec_keyframe_request(&p_cus->delta);
+    }
+}
+
+void ble_cus_stride_update(ble_cus_t * p_cus)
+{
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        if (p_cus->links[i].conn_handle != BLE_CONN_HANDLE_INVALID)
+        {
+            stride_pump(p_cus, &p_cus->links[i], false);
+        }
+    }
 }
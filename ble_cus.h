@@ -5,6 +5,15 @@
 #include <stdbool.h>
 #include "ble.h"
 #include "ble_srv_common.h"
+#include "sdk_config.h"
+#include "sample_pool.h"
+#include "metrics_frame.h"
+#include "history_xfer.h"
+#include "time_sync.h"
+#include "delta_codec.h"
+#include "stride_events.h"
+#include "session_stats.h"
+#include "conn_policy.h"
 
 /**@brief   Macro for defining a ble_hrs instance.
  *
@@ -29,6 +38,117 @@ NRF_SDH_BLE_OBSERVER(_name ## _obs,
 #define PACKAGE_CHAR_UUID                 0x0003
 #define PACKAGE_IDX_CHAR_UUID             0x0004
 #define POWER_CHAR_UUID                   0x0005
+#define SESSION_CHAR_UUID                 0x0006
+#define CRASH_CHAR_UUID                   0x0007
+#define BULK_CHAR_UUID                    0x0008
+#define METRICS_CHAR_UUID                 0x0009
+#define HISTORY_CHAR_UUID                 0x000A
+#define HISTORY_CTRL_CHAR_UUID            0x000B
+#define CONTROL_POINT_CHAR_UUID           0x000C
+#define TIME_SYNC_CHAR_UUID               0x000D
+#define DELTA_CHAR_UUID                   0x000E
+#define DB_HASH_CHAR_UUID                 0x000F
+#define COMMAND_CHAR_UUID                 0x0010
+#define STRIDE_CHAR_UUID                  0x0011
+#define SESSION_STATS_CHAR_UUID           0x0012
+
+#define BLE_CUS_SESSION_OP_SET_EPOCH      0x01                            /**< Set the wall-clock time. */
+#define BLE_CUS_SESSION_OP_INFO           0x02                            /**< Get the block range and start time of a session. */
+#define BLE_CUS_SESSION_OP_LOOKUP         0x03                            /**< Get the blocks recorded in a time range of a session. */
+
+#define BLE_CUS_SESSION_STATUS_SUCCESS    0x00
+#define BLE_CUS_SESSION_STATUS_NOT_FOUND  0x01                            /**< Unknown session, or its data was overwritten. */
+#define BLE_CUS_SESSION_STATUS_INVALID    0x02                            /**< Unknown opcode or wrong length. */
+
+#define BLE_CUS_SESSION_RSP_MAX_LEN       20                              /**< Longest Session characteristic value (INFO response). */
+
+#define BLE_CUS_HISTORY_OP_START          0x01                            /**< Start a framed download of flash log blocks. */
+#define BLE_CUS_HISTORY_OP_NACK           0x02                            /**< Send frames again. */
+#define BLE_CUS_HISTORY_OP_STOP           0x03                            /**< Stop the download. */
+
+#define BLE_CUS_HISTORY_STATUS_SUCCESS    0x00
+#define BLE_CUS_HISTORY_STATUS_INVALID    0x01                            /**< Unknown opcode or wrong length. */
+#define BLE_CUS_HISTORY_STATUS_NOT_READY  0x02                            /**< Notifications of the History characteristic are disabled. */
+
+#define BLE_CUS_HISTORY_RSP_MAX_LEN       13                              /**< Longest History Control characteristic value (START response). */
+
+#define BLE_CUS_CP_OP_SET_SAMPLE_RATE     0x01                            /**< Sampling rate in Hz (u16). */
+#define BLE_CUS_CP_OP_SET_POWER_WINDOW    0x02                            /**< Magnitudes averaged into the power (u8). */
+#define BLE_CUS_CP_OP_SET_NOTIFY_INTERVAL 0x03                            /**< Power update interval in ms (u16). */
+#define BLE_CUS_CP_OP_SET_SENSOR_RANGE    0x04                            /**< Accelerometer full scale in g (u8). */
+#define BLE_CUS_CP_OP_SET_STREAMING_MODE  0x05                            /**< BLE_CUS_STREAMING_* (u8). */
+#define BLE_CUS_CP_OP_GET_CONFIG          0x06                            /**< Get all settings. */
+#define BLE_CUS_CP_OP_RESPONSE            0x20                            /**< First byte of every indication. */
+
+#define BLE_CUS_CP_STATUS_SUCCESS         0x01
+#define BLE_CUS_CP_STATUS_NOT_SUPPORTED   0x02                            /**< Unknown opcode. */
+#define BLE_CUS_CP_STATUS_INVALID_PARAM   0x03                            /**< Wrong length or value out of range. */
+#define BLE_CUS_CP_STATUS_FAILED          0x04                            /**< The setting could not be applied; the old one is kept. */
+#define BLE_CUS_CP_STATUS_OUT_OF_RANGE    0x05                            /**< Command only: the range reaches past the samples recorded so far. */
+
+#define BLE_CUS_CP_CONFIG_LEN             7                               /**< Encoded ble_cus_config_t. */
+#define BLE_CUS_CP_RSP_MAX_LEN            (3 + BLE_CUS_CP_CONFIG_LEN)     /**< Longest Control Point indication (GET_CONFIG response). */
+
+#define BLE_CUS_CMD_OP_READ_PACKAGE       0x10                            /**< Package of accl_arr, like a write of Package Index and a read of Package. */
+#define BLE_CUS_CMD_OP_GET_POWER          0x11                            /**< Latest power. */
+#define BLE_CUS_CMD_OP_PING               0x12                            /**< Local time; for measuring the round trip. */
+#define BLE_CUS_CMD_OP_READ_HISTORY       0x13                            /**< Range of accl_arr samples, optionally decimated, in as many notifications as it takes. */
+
+#define BLE_CUS_CMD_REQ_MAX_LEN           8                               /**< Longest command: op, tag, parameters. */
+#define BLE_CUS_CMD_RSP_MAX_LEN           20                              /**< Longest single response (READ_PACKAGE); fits the default ATT MTU. */
+#define BLE_CUS_READ_HEADER_LEN           4                               /**< READ_HISTORY notification header: tag, status, offset (u16). */
+#define BLE_CUS_CMD_RING_SIZE             8                               /**< Commands per link waiting for room in the notification queue. */
+
+#define BLE_CUS_TIME_SYNC_OP_REQUEST      0x01                            /**< Central time t1 of an exchange; answered with t2 and t3. */
+#define BLE_CUS_TIME_SYNC_OP_FOLLOW_UP    0x02                            /**< Central time t4 the answer arrived; answered with the result. */
+
+#define BLE_CUS_TIME_SYNC_STATUS_ACCEPTED 0x00
+#define BLE_CUS_TIME_SYNC_STATUS_REJECTED 0x01                            /**< Round trip negative or too long. */
+#define BLE_CUS_TIME_SYNC_STATUS_RESTARTED 0x02                           /**< Step of the central clock or another central; the estimate starts over. */
+#define BLE_CUS_TIME_SYNC_STATUS_NO_REQUEST 0x03                          /**< No answered request with this sequence number. */
+
+#define BLE_CUS_TIME_SYNC_REQ_LEN         10                              /**< op, seq, central time (u64). */
+#define BLE_CUS_TIME_SYNC_RSP_LEN         10                              /**< Both answers fit the default ATT MTU. */
+#define BLE_CUS_TIMESTAMP_LEN             4                               /**< Synced timestamp appended to live packages. */
+
+#define BLE_CUS_STRIDE_RECORD_LEN         17                              /**< Encoded stride record, see ble_cus_stride_update. */
+#define BLE_CUS_STRIDE_FLAG_SYNCED        (1 << 0)                        /**< The timestamp of the record is synced, else local. */
+#define BLE_CUS_STRIDE_MAX_DELAY_MS       5000                            /**< Longest a stride waits for more to fill a notification. */
+
+#define BLE_CUS_SESSION_STATS_LEN         53                              /**< Encoded session summary, see ble_cus_session_stats_set. */
+
+#define BLE_CUS_SAMPLE_RATE_MIN_HZ        10                              /**< Slowest sampling; the step detector needs several samples per step. */
+#define BLE_CUS_SAMPLE_RATE_MAX_HZ        100                             /**< Fastest sampling the 100 kHz TWI keeps up with. */
+#define BLE_CUS_SAMPLE_RATE_DEFAULT_HZ    50
+#define BLE_CUS_NOTIFY_INTERVAL_MIN_MS    100
+#define BLE_CUS_NOTIFY_INTERVAL_MAX_MS    10000
+#define BLE_CUS_NOTIFY_INTERVAL_DEFAULT_MS 500
+#define BLE_CUS_SENSOR_RANGE_DEFAULT_G    2
+
+#define BLE_CUS_STREAMING_ALL             0x00                            /**< Packages, power and metrics. */
+#define BLE_CUS_STREAMING_METRICS         0x01                            /**< Power and metrics only, no raw samples. */
+#define BLE_CUS_STREAMING_OFF             0x02                            /**< No live notifications; sampling and the flash log go on. */
+
+#define BLE_CUS_MAX_DATA_LEN              (NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3) /**< Longest notification payload the configured ATT MTU allows. */
+#define BLE_CUS_BULK_REQ_LEN              4                               /**< Bulk request: start, count (u16 each, in accl_arr values). */
+#define BLE_CUS_BULK_HEADER_LEN           2                               /**< Bulk notification header: sequence number (u16). */
+#define BLE_CUS_PACKAGE_IDX_INVALID       0xFFFF                          /**< Index in the Package value after a write of an index not recorded yet. */
+
+#define BLE_CUS_TX_QUEUE_SIZE             8                               /**< Notifications per link that can wait for a SoftDevice TX buffer. */
+#define BLE_CUS_BULK_IN_FLIGHT_MAX        6                               /**< Bulk notifications a link may have in the SoftDevice; the rest of its TX buffers (LINK_PROFILE_HVN_TX_QUEUE_SIZE) stay free for live data. */
+#define BLE_CUS_LINK_COUNT                NRF_SDH_BLE_PERIPHERAL_LINK_COUNT /**< Links served at the same time. */
+
+#define BLE_CUS_SUB_CUSTOM_VALUE          (1 << 0)                        /**< Subscription bits, one per characteristic with notifications. */
+#define BLE_CUS_SUB_PACKAGE               (1 << 1)
+#define BLE_CUS_SUB_POWER                 (1 << 2)
+#define BLE_CUS_SUB_BULK                  (1 << 3)
+#define BLE_CUS_SUB_METRICS               (1 << 4)
+#define BLE_CUS_SUB_HISTORY               (1 << 5)
+#define BLE_CUS_SUB_TIME_SYNC             (1 << 6)
+#define BLE_CUS_SUB_DELTA                 (1 << 7)
+#define BLE_CUS_SUB_STRIDE                (1 << 8)
+#define BLE_CUS_SUB_RAW                   (BLE_CUS_SUB_PACKAGE | BLE_CUS_SUB_DELTA) /**< Characteristics streaming raw samples. */
+#define BLE_CUS_SUB_LIVE                  (BLE_CUS_SUB_RAW | BLE_CUS_SUB_POWER | BLE_CUS_SUB_METRICS | BLE_CUS_SUB_STRIDE) /**< Characteristics streaming live data. */
 
  
 
@@ -36,18 +156,88 @@ NRF_SDH_BLE_OBSERVER(_name ## _obs,
 /**@brief Custom Service event type. */
 typedef enum
 {
-    BLE_CUS_EVT_NOTIFICATION_ENABLED,                             /**< Custom value notification enabled event. */
-    BLE_CUS_EVT_NOTIFICATION_DISABLED,                             /**< Custom value notification disabled event. */
+    BLE_CUS_EVT_NOTIFICATION_ENABLED,                             /**< Notifications of a characteristic enabled. */
+    BLE_CUS_EVT_NOTIFICATION_DISABLED,                            /**< Notifications of a characteristic disabled. */
     BLE_CUS_EVT_DISCONNECTED,
-    BLE_CUS_EVT_CONNECTED
+    BLE_CUS_EVT_CONNECTED,
+    BLE_CUS_EVT_BULK_STARTED,                                     /**< A bulk, history or READ_HISTORY transfer was requested while none was running on the link. */
+    BLE_CUS_EVT_BULK_DONE,                                        /**< The last transfer of the link completed or was stopped. */
+    BLE_CUS_EVT_CONFIG_CHANGED                                    /**< A setting was changed through the Control Point or the Command characteristic; ble_cus_t::config holds the new value. */
 } ble_cus_evt_type_t;
 
 /**@brief Custom Service event. */
 typedef struct
 {
     ble_cus_evt_type_t evt_type;                                  /**< Type of event. */
+    uint16_t           conn_handle;                               /**< Link the event belongs to. */
+    uint16_t           subscription;                              /**< BLE_CUS_SUB_* bit of the characteristic, for the notification events. */
+    uint8_t            cp_opcode;                                 /**< BLE_CUS_CP_OP_SET_* of the setting, for BLE_CUS_EVT_CONFIG_CHANGED. */
+    bool               cp_failed;                                 /**< Set by the handler of BLE_CUS_EVT_CONFIG_CHANGED if it could not apply the setting. */
 } ble_cus_evt_t;
 
+/**@brief Settings changed at runtime through the Control Point. */
+typedef struct
+{
+    uint16_t sample_rate_hz;                                      /**< Accelerometer sampling rate, BLE_CUS_SAMPLE_RATE_MIN_HZ to BLE_CUS_SAMPLE_RATE_MAX_HZ, a divisor of 1000. */
+    uint8_t  power_window;                                        /**< Newest magnitudes averaged into the power, 1 to SAMPLE_POOL_POWER_LEN. */
+    uint16_t notify_interval_ms;                                  /**< Power update interval. */
+    uint8_t  range_g;                                             /**< Accelerometer full scale: 2, 4 or 8 g. Samples stay in 1/1024 g. */
+    uint8_t  streaming_mode;                                      /**< BLE_CUS_STREAMING_*. */
+} ble_cus_config_t;
+
+/**@brief Notification TX queue counters. */
+typedef struct
+{
+    uint32_t queued;                                              /**< Notifications accepted by the queue. */
+    uint32_t sent;                                                /**< Notifications accepted by the SoftDevice. */
+    uint32_t dropped_full;                                        /**< Notifications rejected because the queue was full. */
+    uint32_t dropped_disconnected;                                /**< Notifications rejected or flushed without a connection. */
+    uint32_t errors;                                              /**< Notifications the SoftDevice refused, e.g. with notifications disabled. */
+    uint16_t max_depth;                                           /**< Highest queue depth seen. */
+} ble_cus_tx_stats_t;
+
+/**@brief State of a bulk download. */
+typedef struct
+{
+    uint16_t next;                                                /**< Next accl_arr value to send. */
+    uint16_t remaining;                                           /**< Values left to send, 0 if no transfer is running. */
+    uint16_t seq;                                                 /**< Sequence number of the next notification. */
+    uint32_t start_ms;                                            /**< Local time the transfer was requested. */
+    uint32_t bytes;                                               /**< Payload bytes sent so far. */
+} ble_cus_bulk_t;
+
+/**@brief State of a READ_HISTORY command. */
+typedef struct
+{
+    uint8_t  tag;                                                 /**< Tag of the command. */
+    uint8_t  stride;                                              /**< Samples from one sent sample to the next. */
+    uint16_t next;                                                /**< Next accl_arr sample (x,y,z) to send. */
+    uint16_t offset;                                              /**< Samples of the command sent so far. */
+    uint16_t remaining;                                           /**< Samples left to send, 0 if no read is running. */
+} ble_cus_read_t;
+
+/**@brief State of one link. */
+typedef struct
+{
+    uint16_t             conn_handle;                             /**< BLE_CONN_HANDLE_INVALID if the slot is free. */
+    uint16_t             subscriptions;                           /**< BLE_CUS_SUB_* bits of the characteristics the client has enabled notifications of. */
+    uint8_t              in_flight;                               /**< Notifications in the SoftDevice, not yet reported by BLE_GATTS_EVT_HVN_TX_COMPLETE. */
+    uint16_t             max_data_len;                            /**< Notification payload that fits the ATT MTU of the link. */
+    ble_cus_bulk_t       bulk;                                    /**< Bulk download in progress. */
+    history_xfer_t       history;                                 /**< Framed flash log download in progress. */
+    ble_cus_read_t       read;                                    /**< READ_HISTORY command in progress. */
+    bool                 cp_indications;                          /**< Indications of the Control Point enabled. */
+    bool                 cp_indicating;                           /**< A Control Point indication waits for its confirmation. */
+    uint8_t              cp_rsp_len;                              /**< Control Point response still to indicate, 0 if none; a newer response replaces it. */
+    uint8_t              cp_rsp[BLE_CUS_CP_RSP_MAX_LEN];
+    bool                 cmd_notifications;                       /**< Notifications of the Command characteristic enabled. */
+    uint16_t             stride_next;                             /**< Sequence number of the next stride to send. */
+    time_sync_exchange_t sync;                                    /**< Time sync exchange waiting for its follow-up. */
+    uint8_t              sync_seq;                                /**< Sequence number of that exchange. */
+    bool                 sync_pending;                            /**< The request was answered and the follow-up is due. */
+    conn_policy_link_t   policy;                                  /**< Connection parameter mode of the link, see conn_policy.h. */
+} ble_cus_link_t;
+
 // Forward declaration of the ble_cus_t type.
 typedef struct ble_cus_s ble_cus_t;
 
@@ -74,17 +264,31 @@ struct ble_cus_s
     ble_gatts_char_handles_t      package_handles;           /**< Handles related to the Custom Value characteristic. */
     ble_gatts_char_handles_t      package_idx_handles;           /**< Handles related to the Custom Value characteristic. */
     ble_gatts_char_handles_t      power_handles;           /**< Handles related to the Custom Value characteristic. */
+    ble_gatts_char_handles_t      session_handles;                /**< Handles related to the Session characteristic. */
+    ble_gatts_char_handles_t      crash_handles;                  /**< Handles related to the Crash Report characteristic. */
+    ble_gatts_char_handles_t      bulk_handles;                   /**< Handles related to the Bulk characteristic. */
+    ble_gatts_char_handles_t      metrics_handles;                /**< Handles related to the Metrics characteristic. */
+    ble_gatts_char_handles_t      history_handles;                /**< Handles related to the History characteristic. */
+    ble_gatts_char_handles_t      history_ctrl_handles;           /**< Handles related to the History Control characteristic. */
+    ble_gatts_char_handles_t      cp_handles;                     /**< Handles related to the Control Point characteristic. */
+    ble_gatts_char_handles_t      time_sync_handles;              /**< Handles related to the Time Sync characteristic. */
+    ble_gatts_char_handles_t      delta_handles;                  /**< Handles related to the Delta characteristic. */
+    ble_gatts_char_handles_t      db_hash_handles;                /**< Handles related to the DB Hash characteristic. */
+    ble_gatts_char_handles_t      cmd_handles;                    /**< Handles related to the Command characteristic. */
+    ble_gatts_char_handles_t      stride_handles;                 /**< Handles related to the Stride characteristic. */
+    ble_gatts_char_handles_t      session_stats_handles;          /**< Handles related to the Session Stats characteristic. */
+    uint16_t                      sync_conn_handle;               /**< Link of the central the clock is synced to. */
+    ble_cus_config_t              config;                         /**< Runtime settings. */
+    uint16_t                      metrics_seq;                    /**< Sequence number of the next metrics frame. */
+    ble_cus_link_t                links[BLE_CUS_LINK_COUNT];      /**< Connected clients. */
+    uint16_t                      live_len;                       /**< Values batched in sample_pool_live. */
+    delta_codec_enc_t             delta;                          /**< Encoder of the Delta characteristic. */
     uint16_t                      acc_x;
     uint16_t                      power;
-    short                         accl_arr[10000];
-    short                         buff[450];
-    short                         pow_buf[50];
     uint16_t                      pow_buf_counter;
-    uint16_t                      package[10];
     uint16_t                      package_idx;
-    uint16_t                      arr_counter;
+    uint16_t                      arr_counter;                    /**< Next accl_arr value to write; the values before it are recorded. */
     uint16_t                      buff_counter;
-    uint16_t                      conn_handle;                    /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
     uint8_t                       uuid_type; 
 };
 
@@ -125,9 +329,161 @@ void ble_cus_on_ble_evt( ble_evt_t const * p_ble_evt, void * p_context);
 
 uint32_t ble_cus_custom_value_update(ble_cus_t * p_cus, uint8_t custom_value);
 
+/**@brief Function for queueing a notification to every link subscribed to the characteristic.
+ *
+ * @details Every link has its own queue. The notification is passed to the SoftDevice right away
+ *          if the link has a free TX buffer, otherwise it waits in the queue until
+ *          BLE_GATTS_EVT_HVN_TX_COMPLETE. Queued notifications go out before bulk transfer data.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   handle      Value handle of the characteristic.
+ * @param[in]   p_data      Notification data, copied.
+ * @param[in]   len         Length of the data, at most the link's max_data_len.
+ *
+ * @retval NRF_SUCCESS              Notification sent or queued on every subscribed link.
+ * @retval NRF_ERROR_INVALID_STATE  No link subscribed, the notification was dropped.
+ * @retval NRF_ERROR_INVALID_LENGTH The data does not fit the ATT MTU of a link.
+ * @retval NRF_ERROR_NO_MEM         The queue of a link is full, the notification was dropped there.
+ */
+uint32_t ble_cus_notify(ble_cus_t * p_cus, uint16_t handle, uint8_t const * p_data, uint16_t len);
+
+/**@brief Function for getting the number of notifications queued for a link. */
+uint16_t ble_cus_tx_queue_depth(ble_cus_t * p_cus, uint16_t conn_handle);
+
+/**@brief Function for getting the state of a link.
+ *
+ * @return The link, or NULL if conn_handle is not connected.
+ */
+ble_cus_link_t * ble_cus_link_get(ble_cus_t * p_cus, uint16_t conn_handle);
+
+/**@brief Function for checking whether a bulk, history or READ_HISTORY transfer runs on a link. */
+bool ble_cus_link_transfer_active(ble_cus_link_t const * p_link);
+
+/**@brief Function for getting the number of connected links. */
+uint8_t ble_cus_link_count(ble_cus_t const * p_cus);
+
+/**@brief Function for getting the notification TX queue counters. */
+ble_cus_tx_stats_t const * ble_cus_tx_stats(void);
+
+/**@brief Function for checking that every setting is in its range. */
+bool ble_cus_config_valid(ble_cus_config_t const * p_config);
+
+/**@brief Function for setting the value of the DB Hash characteristic (see peer_state.h). */
+void ble_cus_db_hash_set(ble_cus_t * p_cus, uint32_t db_hash);
+
+/**@brief Function for setting the value of the Session Stats characteristic.
+ *
+ * @details Read only; longer than the default MTU, so clients fetch it with a long read. The
+ *          value, little endian:
+ *
+ *          id (u16), flags (u8, SESSION_STATS_FLAG_*), start (u32), elapsed_ms, moving_ms,
+ *          steps (u32 each), cadence, power_avg, power_max, power_p50, power_p90, gct_ms,
+ *          vertical_osc_mm (u16 each), zone_ms (u32 for each of the SESSION_STATS_ZONE_COUNT
+ *          zones)
+ *
+ *          See session_stats.h for the fields.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_summary   Summary, or NULL for an empty value while there was no session.
+ */
+void ble_cus_session_stats_set(ble_cus_t * p_cus, session_stats_summary_t const * p_summary);
+
+/**@brief Function for getting the subscriptions in effect on a link: the client's, less the live
+ *        characteristics the streaming mode turns off.
+ */
+uint16_t ble_cus_link_subscriptions(ble_cus_t const * p_cus, ble_cus_link_t const * p_link);
+
+/**@brief Function for checking whether a client on any link has enabled notifications of any of
+ *        the given characteristics.
+ *
+ * @details Subscriptions are tracked from the CCCD writes, so this does not call into the
+ *          SoftDevice and is cheap enough to gate every pipeline stage. Live characteristics the
+ *          streaming mode turns off count as not subscribed.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   mask        BLE_CUS_SUB_* bits.
+ */
+bool ble_cus_subscribed(ble_cus_t const * p_cus, uint16_t mask);
+
+/**@brief Function for reading the subscriptions of a link back from the CCCDs.
+ *
+ * @details CCCDs restored for a bonded peer are not written by the client. They are read when the
+ *          link connects; call on PM_EVT_LOCAL_DB_CACHE_APPLIED for CCCDs restored later. A link
+ *          that subscribed to the power gets it right away.
+ */
+void ble_cus_subscriptions_refresh(ble_cus_t * p_cus, uint16_t conn_handle);
+
+/**@brief Function for setting the ATT MTU negotiated on the link.
+ *
+ * @details Live and bulk notifications are sized to fit it. Call on
+ *          NRF_BLE_GATT_EVT_ATT_MTU_UPDATED.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   conn_handle Link the ATT MTU was negotiated on.
+ * @param[in]   att_mtu     Effective ATT MTU.
+ */
+void ble_cus_att_mtu_set(ble_cus_t * p_cus, uint16_t conn_handle, uint16_t att_mtu);
+
+/**@brief Function for computing the power over the last config.power_window magnitudes and
+ *        sending it if the client subscribed to it. */
 void power_update(ble_cus_t * p_cus);
 
+/**@brief Function for sending a metrics frame.
+ *
+ * @details Gives the frame the next sequence number and sends it as one notification on the
+ *          metrics characteristic.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_frame     Frame to send; seq is set by this function.
+ *
+ * @return      Result of @ref ble_cus_notify.
+ */
+uint32_t ble_cus_metrics_update(ble_cus_t * p_cus, metrics_frame_t * p_frame);
+
+/**@brief Function for sending the package in sample_pool_package.
+ *
+ * @details Packages are batched into one notification on the package characteristic, as many as
+ *          fit the ATT MTU. With the default MTU every package is sent on its own. Nothing is
+ *          batched while the client has not subscribed to the package characteristic.
+ *
+ *          Once the clock is synced and the MTU leaves room, the notification ends with the
+ *          synced timestamp (u32) of its newest sample, so its length is 4 more than a multiple
+ *          of the package size.
+ */
 void package_update(ble_cus_t * p_cus);
 
+/**@brief Function for adding a sample to the delta-compressed stream.
+ *
+ * @details Frames are sized to the smallest ATT MTU of the subscribed links and sent on the Delta
+ *          characteristic when full (see delta_codec.h). A client that subscribes gets a keyframe
+ *          next, as do all clients after a frame was dropped. Nothing is encoded while no client
+ *          has subscribed.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   x           Sample, in 1/1024 g like the packages.
+ * @param[in]   y
+ * @param[in]   z
+ */
+void ble_cus_delta_update(ble_cus_t * p_cus, int16_t x, int16_t y, int16_t z);
+
+/**@brief Function for sending the strides of stride_events.h.
+ *
+ * @details Every subscribed link gets the strides it has not had yet, as many records per
+ *          notification on the Stride characteristic as fit its ATT MTU. Strides wait until a
+ *          notification is full, or at most BLE_CUS_STRIDE_MAX_DELAY_MS. A record, little endian:
+ *
+ *          seq (u16), flags (u8, BLE_CUS_STRIDE_FLAG_*), timestamp (u32, synced as in
+ *          time_sync.h, else local ms), duration_ms, gct_ms, vertical_osc_mm, peak_mg,
+ *          power (u16 each)
+ *
+ *          A client that subscribes gets the strides from then on. To catch up after a
+ *          reconnect it writes the sequence number (u16) of the first stride it missed to the
+ *          Stride characteristic and gets those still in the ring right away.
+ *
+ *          Call when a stride completed, and about once a second for the delay.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ */
+void ble_cus_stride_update(ble_cus_t * p_cus);
 
 #endif // BLE_CUS_H__
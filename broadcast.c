@@ -0,0 +1,134 @@
+#include "sdk_common.h"
+#include "broadcast.h"
+#include <string.h>
+#include "app_timer.h"
+#include "nrf_log.h"
+
+APP_TIMER_DEF(m_broadcast_timer_id);
+
+static ble_advertising_t        * m_p_advertising;
+static broadcast_data_handler_t   m_data_handler;
+static ble_advdata_t              m_advdata;
+static ble_advdata_manuf_data_t   m_manuf_data;
+static uint8_t                    m_payload[BROADCAST_PAYLOAD_LEN];
+static uint8_t                    m_counter;
+static bool                       m_started;
+
+static uint8_t                    m_adv_buf[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+static uint8_t                    m_sr_buf[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+static uint16_t                   m_sr_len;
+static uint8_t                    m_buf_idx;                                /**< Buffer pair the next update is encoded into. */
+
+
+static void payload_encode(broadcast_data_t const * p_data)
+{
+    m_payload[0] = BROADCAST_FORMAT;
+    m_payload[1] = m_counter;
+    (void)uint16_encode(p_data->power, &m_payload[2]);
+    m_payload[4] = p_data->cadence;
+}
+
+
+static void broadcast_update(void)
+{
+    ret_code_t         err_code;
+    broadcast_data_t   data    = {0};
+    uint16_t           adv_len = BLE_GAP_ADV_SET_DATA_SIZE_MAX;
+    ble_gap_adv_data_t gap_adv_data;
+
+    m_data_handler(&data);
+    m_counter++;
+    payload_encode(&data);
+
+    err_code = ble_advdata_encode(&m_advdata, m_adv_buf[m_buf_idx], &adv_len);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("Broadcast data encoding failed: %d.", err_code);
+        return;
+    }
+
+    memset(&gap_adv_data, 0, sizeof(gap_adv_data));
+
+    gap_adv_data.adv_data.p_data      = m_adv_buf[m_buf_idx];
+    gap_adv_data.adv_data.len         = adv_len;
+    gap_adv_data.scan_rsp_data.p_data = m_sr_buf[m_buf_idx];
+    gap_adv_data.scan_rsp_data.len    = m_sr_len;
+
+    // Fails with NRF_ERROR_INVALID_STATE while connected; the next update after the connection
+    // ends goes out again.
+    err_code = sd_ble_gap_adv_set_configure(&m_p_advertising->adv_handle, &gap_adv_data, NULL);
+    if (err_code == NRF_SUCCESS)
+    {
+        m_buf_idx ^= 1;
+    }
+}
+
+
+static void broadcast_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    broadcast_update();
+}
+
+
+ret_code_t broadcast_init(ble_advertising_t        * p_advertising,
+                          ble_advdata_t            * p_advdata,
+                          ble_advdata_t const      * p_srdata,
+                          broadcast_data_handler_t   data_handler)
+{
+    ret_code_t       err_code;
+    broadcast_data_t data = {0};
+
+    m_p_advertising = p_advertising;
+    m_data_handler  = data_handler;
+
+    payload_encode(&data);
+
+    m_manuf_data.company_identifier = BROADCAST_COMPANY_ID;
+    m_manuf_data.data.p_data        = m_payload;
+    m_manuf_data.data.size          = sizeof(m_payload);
+
+    p_advdata->p_manuf_specific_data = &m_manuf_data;
+    m_advdata                        = *p_advdata;
+
+    // The scan response does not change, but the SoftDevice takes both buffers with every update.
+    m_sr_len = BLE_GAP_ADV_SET_DATA_SIZE_MAX;
+    err_code = ble_advdata_encode(p_srdata, m_sr_buf[0], &m_sr_len);
+    VERIFY_SUCCESS(err_code);
+    memcpy(m_sr_buf[1], m_sr_buf[0], m_sr_len);
+
+    return app_timer_create(&m_broadcast_timer_id, APP_TIMER_MODE_REPEATED, broadcast_timeout_handler);
+}
+
+
+ret_code_t broadcast_start(uint32_t interval_ms)
+{
+    ret_code_t err_code;
+
+    if (interval_ms < BROADCAST_INTERVAL_MIN_MS)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    broadcast_stop();
+
+    err_code = app_timer_start(m_broadcast_timer_id, APP_TIMER_TICKS(interval_ms), NULL);
+    VERIFY_SUCCESS(err_code);
+
+    m_started = true;
+    return NRF_SUCCESS;
+}
+
+
+void broadcast_stop(void)
+{
+    (void)app_timer_stop(m_broadcast_timer_id);
+    m_started = false;
+}
+
+
+bool broadcast_is_started(void)
+{
+    return m_started;
+}
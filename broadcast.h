@@ -0,0 +1,86 @@
+#ifndef BROADCAST_H__
+#define BROADCAST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+#include "ble_advdata.h"
+#include "ble_advertising.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Live metrics in the manufacturer specific advertising data.
+ *
+ * @details Any number of scanners can follow the metrics without a connection. The data is
+ *          re-encoded at the broadcast interval and handed to the SoftDevice with
+ *          sd_ble_gap_adv_set_configure() while advertising continues. The SoftDevice keeps
+ *          using the buffers it was given, so every update goes to the other one of two buffers.
+ *
+ *          Manufacturer specific data, after the company identifier:
+ *
+ *          | Offset | Size | Field                                            |
+ *          |--------|------|--------------------------------------------------|
+ *          | 0      | 1    | Format, BROADCAST_FORMAT                         |
+ *          | 1      | 1    | Counter, incremented for every update            |
+ *          | 2      | 2    | Power, little endian                             |
+ *          | 4      | 1    | Cadence, steps per minute                        |
+ *
+ *          The peripheral stops advertising while connected, so broadcasting pauses for the
+ *          duration of a connection.
+ */
+
+#define BROADCAST_COMPANY_ID            0x0059                              /**< Nordic Semiconductor ASA. */
+#define BROADCAST_FORMAT                0x01
+#define BROADCAST_PAYLOAD_LEN           5
+#define BROADCAST_INTERVAL_MIN_MS       100                                 /**< Updates faster than the advertising interval are never seen. */
+#define BROADCAST_INTERVAL_DEFAULT_MS   1000
+
+/**@brief Metrics to broadcast. */
+typedef struct
+{
+    uint16_t power;
+    uint8_t  cadence;
+} broadcast_data_t;
+
+/**@brief Handler providing the metrics for the next update. */
+typedef void (*broadcast_data_handler_t)(broadcast_data_t * p_data);
+
+/**@brief Function for initializing the broadcast.
+ *
+ * @details Call before ble_advertising_init(), so the first advertising data already has room
+ *          for the metrics.
+ *
+ * @param[in]     p_advertising Advertising module instance.
+ * @param[in,out] p_advdata     Advertising data; the manufacturer specific data is set.
+ * @param[in]     p_srdata      Scan response data.
+ * @param[in]     data_handler  Handler providing the metrics.
+ */
+ret_code_t broadcast_init(ble_advertising_t        * p_advertising,
+                          ble_advdata_t            * p_advdata,
+                          ble_advdata_t const      * p_srdata,
+                          broadcast_data_handler_t   data_handler);
+
+/**@brief Function for starting the broadcast or changing its interval.
+ *
+ * @param[in] interval_ms   Interval between updates, at least BROADCAST_INTERVAL_MIN_MS.
+ *
+ * @retval NRF_SUCCESS              Broadcast started.
+ * @retval NRF_ERROR_INVALID_PARAM  The interval is too short.
+ */
+ret_code_t broadcast_start(uint32_t interval_ms);
+
+/**@brief Function for stopping the broadcast. The last metrics stay in the advertising data. */
+void broadcast_stop(void);
+
+/**@brief Function for checking whether the broadcast is started. */
+bool broadcast_is_started(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BROADCAST_H__
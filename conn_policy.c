@@ -0,0 +1,110 @@
+#include "sdk_common.h"
+#include "conn_policy.h"
+#include "ble.h"
+#include "ble_conn_params.h"
+#include "nrf_log.h"
+
+static ble_gap_conn_params_t const m_mode_params[] =
+{
+    [CONN_POLICY_MODE_IDLE] =
+    {
+        .min_conn_interval = MSEC_TO_UNITS(200, UNIT_1_25_MS),
+        .max_conn_interval = MSEC_TO_UNITS(400, UNIT_1_25_MS),
+        .slave_latency     = 4,
+        .conn_sup_timeout  = MSEC_TO_UNITS(6000, UNIT_10_MS),
+    },
+    [CONN_POLICY_MODE_LIVE] =
+    {
+        .min_conn_interval = MSEC_TO_UNITS(50, UNIT_1_25_MS),
+        .max_conn_interval = MSEC_TO_UNITS(100, UNIT_1_25_MS),
+        .slave_latency     = 4,
+        .conn_sup_timeout  = MSEC_TO_UNITS(4000, UNIT_10_MS),
+    },
+    [CONN_POLICY_MODE_FAST] =
+    {
+        .min_conn_interval = MSEC_TO_UNITS(7.5, UNIT_1_25_MS),
+        .max_conn_interval = MSEC_TO_UNITS(15, UNIT_1_25_MS),
+        .slave_latency     = 0,
+        .conn_sup_timeout  = MSEC_TO_UNITS(4000, UNIT_10_MS),
+    },
+};
+
+static uint32_t m_request_count;
+
+
+static conn_policy_mode_t mode_wanted(conn_policy_link_t const  * p_link,
+                                      conn_policy_input_t const * p_input)
+{
+    if (p_input->bulk_active || (p_input->queue_depth >= CONN_POLICY_QUEUE_HIGH))
+    {
+        return CONN_POLICY_MODE_FAST;
+    }
+    if ((p_link->mode == CONN_POLICY_MODE_FAST) && (p_input->queue_depth > CONN_POLICY_QUEUE_LOW))
+    {
+        return CONN_POLICY_MODE_FAST;
+    }
+    return p_input->live_subscribed ? CONN_POLICY_MODE_LIVE : CONN_POLICY_MODE_IDLE;
+}
+
+
+static void mode_request(conn_policy_link_t * p_link, uint16_t conn_handle, conn_policy_mode_t mode)
+{
+    ret_code_t err_code;
+
+    err_code = ble_conn_params_change_conn_params(conn_handle,
+                                                  (ble_gap_conn_params_t *)&m_mode_params[mode]);
+    if (err_code != NRF_SUCCESS)
+    {
+        // Retried at the next evaluation.
+        NRF_LOG_WARNING("Connection parameter request failed: 0x%x.", err_code);
+        return;
+    }
+
+    NRF_LOG_INFO("Connection parameters: mode %d on link %d.", mode, conn_handle);
+    p_link->mode = mode;
+    m_request_count++;
+}
+
+
+void conn_policy_update(conn_policy_link_t * p_link, conn_policy_input_t const * p_input)
+{
+    if (p_input->conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        return;
+    }
+
+    conn_policy_mode_t wanted = mode_wanted(p_link, p_input);
+
+    if (wanted == p_link->mode)
+    {
+        p_link->candidate  = CONN_POLICY_MODE_NONE;
+        p_link->calm_count = 0;
+        return;
+    }
+
+    if (wanted == CONN_POLICY_MODE_FAST)
+    {
+        p_link->candidate  = CONN_POLICY_MODE_NONE;
+        p_link->calm_count = 0;
+        mode_request(p_link, p_input->conn_handle, wanted);
+        return;
+    }
+
+    if (wanted != p_link->candidate)
+    {
+        p_link->candidate  = wanted;
+        p_link->calm_count = 0;
+    }
+    if (++p_link->calm_count >= CONN_POLICY_CALM_COUNT)
+    {
+        p_link->candidate  = CONN_POLICY_MODE_NONE;
+        p_link->calm_count = 0;
+        mode_request(p_link, p_input->conn_handle, wanted);
+    }
+}
+
+
+uint32_t conn_policy_request_count(void)
+{
+    return m_request_count;
+}
@@ -0,0 +1,80 @@
+#ifndef CONN_POLICY_H__
+#define CONN_POLICY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Connection parameters that follow what the link is used for.
+ *
+ * @details Three modes are requested through ble_conn_params:
+ *
+ *          - Fast (7.5-15 ms, no latency): a bulk transfer runs or the notification queue backs up.
+ *          - Live (50-100 ms, latency 4): a client is subscribed to the live data.
+ *          - Idle (200-400 ms, latency 4): connected, but nothing is streamed.
+ *
+ *          Fast is requested as soon as it is needed. Any other change waits until the same mode
+ *          has been wanted for CONN_POLICY_CALM_COUNT evaluations in a row and the queue has
+ *          drained to CONN_POLICY_QUEUE_LOW, so a short burst does not cause a renegotiation in
+ *          both directions.
+ *
+ *          Every link is evaluated on its own, so a bulk transfer to one central does not change
+ *          the parameters of another.
+ */
+
+#define CONN_POLICY_QUEUE_HIGH          6                                   /**< Queue depth that asks for the fast mode. */
+#define CONN_POLICY_QUEUE_LOW           1                                   /**< Queue depth the fast mode is kept above. */
+#define CONN_POLICY_CALM_COUNT          6                                   /**< Evaluations a slower mode has to be wanted for before it is requested. */
+
+/**@brief Connection parameter modes, slowest first after NONE. */
+typedef enum
+{
+    CONN_POLICY_MODE_NONE,                                                  /**< The peripheral preferred parameters of the connection setup. */
+    CONN_POLICY_MODE_IDLE,
+    CONN_POLICY_MODE_LIVE,
+    CONN_POLICY_MODE_FAST,
+} conn_policy_mode_t;
+
+/**@brief Policy state of one link, kept with the other state of the link (see ble_cus_link_t).
+ *
+ * @details All zero is the state of a new connection.
+ */
+typedef struct
+{
+    conn_policy_mode_t mode;                                                /**< Mode last requested. */
+    conn_policy_mode_t candidate;                                           /**< Slower mode waiting for the calm period. */
+    uint8_t            calm_count;
+} conn_policy_link_t;
+
+/**@brief State of the link the decision is based on. */
+typedef struct
+{
+    uint16_t conn_handle;                                                   /**< Link the state belongs to. */
+    bool     bulk_active;                                                   /**< A bulk transfer is running. */
+    bool     live_subscribed;                                               /**< Notifications of live data are enabled. */
+    uint16_t queue_depth;                                                   /**< Notifications waiting in the TX queue. */
+} conn_policy_input_t;
+
+/**@brief Function for evaluating the link state and requesting new parameters if needed.
+ *
+ * @details Call periodically, and when a bulk transfer starts. Links with the conn_handle
+ *          BLE_CONN_HANDLE_INVALID are skipped.
+ *
+ * @param[in,out] p_link   Policy state of the link.
+ * @param[in]     p_input  State of the link.
+ */
+void conn_policy_update(conn_policy_link_t * p_link, conn_policy_input_t const * p_input);
+
+/**@brief Function for getting the number of parameter update requests since boot. */
+uint32_t conn_policy_request_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONN_POLICY_H__
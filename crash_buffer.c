@@ -0,0 +1,74 @@
+#include "sdk_common.h"
+#include "crash_buffer.h"
+#include <string.h>
+#include "crc16.h"
+
+#define MAGIC_RUNNING   0x52554E31                                          /**< Record is being filled. */
+#define MAGIC_SEALED    0x43525348                                          /**< Record was sealed by a fault handler. */
+
+STATIC_ASSERT(sizeof(crash_buffer_t) <= 512);
+
+static crash_buffer_t m_live __attribute__((section(".noinit_crash")));
+static crash_buffer_t m_report;                                             /**< Copy of the previous run's record, served over BLE. */
+static bool           m_report_valid;
+
+
+static uint16_t record_crc(crash_buffer_t const * p_record)
+{
+    uint8_t const * p_start = (uint8_t const *)&p_record->sample_count;
+
+    return crc16_compute(p_start, sizeof(crash_buffer_t) - offsetof(crash_buffer_t, sample_count), NULL);
+}
+
+
+void crash_buffer_init(void)
+{
+    if ((m_live.magic == MAGIC_SEALED)
+        && (m_live.sample_count <= CRASH_BUFFER_SAMPLES)
+        && (m_live.crc == record_crc(&m_live)))
+    {
+        memcpy(&m_report, &m_live, sizeof(m_report));
+        m_report_valid = true;
+    }
+
+    memset(&m_live, 0, sizeof(m_live));
+    m_live.magic = MAGIC_RUNNING;
+}
+
+
+void crash_buffer_sample_add(int16_t x, int16_t y, int16_t z)
+{
+    m_live.samples[m_live.head][0] = x;
+    m_live.samples[m_live.head][1] = y;
+    m_live.samples[m_live.head][2] = z;
+
+    m_live.head = (m_live.head + 1) % CRASH_BUFFER_SAMPLES;
+    if (m_live.sample_count < CRASH_BUFFER_SAMPLES)
+    {
+        m_live.sample_count++;
+    }
+}
+
+
+void crash_buffer_state_set(crash_buffer_state_t const * p_state)
+{
+    m_live.state = *p_state;
+}
+
+
+void crash_buffer_seal(crash_reason_t reason, uint32_t info, uint32_t pc, uint32_t uptime_ms)
+{
+    m_live.reason    = reason;
+    m_live.info      = info;
+    m_live.pc        = pc;
+    m_live.uptime_ms = uptime_ms;
+    m_live.crc       = record_crc(&m_live);
+    m_live.magic     = MAGIC_SEALED;
+}
+
+
+uint16_t crash_buffer_report(crash_buffer_t const ** pp_report)
+{
+    *pp_report = &m_report;
+    return m_report_valid ? sizeof(m_report) : 0;
+}
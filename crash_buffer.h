@@ -0,0 +1,81 @@
+#ifndef CRASH_BUFFER_H__
+#define CRASH_BUFFER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Last samples and pipeline state kept in RAM across a soft reset.
+ *
+ * @details The live record sits in the .noinit_crash section, which the startup code does not
+ *          clear. The fault handlers seal it with a magic number and a CRC16 before resetting. At
+ *          the next boot a sealed record with a matching CRC is copied to the crash report; any
+ *          other content, e.g. random RAM after a power-on reset, is discarded.
+ */
+
+#define CRASH_BUFFER_SAMPLES        80                                      /**< x,y,z samples kept (1.6 s at 50 Hz); the record stays within one 512-byte attribute. */
+
+/**@brief What caused the reset that the report describes. */
+typedef enum
+{
+    CRASH_REASON_HARDFAULT = 1,                                             /**< info is 0, pc is the faulting PC. */
+    CRASH_REASON_ERROR     = 2,                                             /**< APP_ERROR_CHECK or assert; info is the fault id, pc is the PC. */
+} crash_reason_t;
+
+/**@brief Pipeline state saved with the samples. */
+typedef struct
+{
+    uint16_t power;
+    uint16_t arr_counter;
+    uint16_t buff_counter;
+    uint16_t pow_buf_counter;
+} crash_buffer_state_t;
+
+/**@brief Crash record, also the format of the crash report characteristic (little endian). */
+typedef struct
+{
+    uint32_t             magic;
+    uint16_t             crc;                                               /**< CRC16 over the rest of the record. */
+    uint16_t             sample_count;                                      /**< Valid samples, at most CRASH_BUFFER_SAMPLES. */
+    uint16_t             reason;                                            /**< @ref crash_reason_t. */
+    uint16_t             head;                                              /**< Next sample to overwrite, i.e. the oldest one once the ring is full. */
+    uint32_t             info;
+    uint32_t             pc;
+    uint32_t             uptime_ms;
+    crash_buffer_state_t state;
+    int16_t              samples[CRASH_BUFFER_SAMPLES][3];
+} crash_buffer_t;
+
+/**@brief Function for checking the record left by the previous run and starting a new one.
+ *
+ * @details Call first thing in main, before anything can fault.
+ */
+void crash_buffer_init(void);
+
+/**@brief Function for adding an x,y,z sample, overwriting the oldest one. */
+void crash_buffer_sample_add(int16_t x, int16_t y, int16_t z);
+
+/**@brief Function for saving the pipeline state. */
+void crash_buffer_state_set(crash_buffer_state_t const * p_state);
+
+/**@brief Function for sealing the record before a reset. Safe to call from fault handlers. */
+void crash_buffer_seal(crash_reason_t reason, uint32_t info, uint32_t pc, uint32_t uptime_ms);
+
+/**@brief Function for getting the record of the previous run.
+ *
+ * @param[out] pp_report    Report buffer. Always set, so it can back a characteristic value.
+ *
+ * @return Report length, or 0 if the previous run did not end in a sealed fault.
+ */
+uint16_t crash_buffer_report(crash_buffer_t const ** pp_report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CRASH_BUFFER_H__
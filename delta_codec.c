@@ -0,0 +1,323 @@
+#include "delta_codec.h"
+#include <string.h>
+
+#define WIDTH_BITS  5                                                       /**< Bits of one delta width in the header. */
+#define WIDTH_MAX   16
+
+
+static uint16_t u16_encode(uint16_t value, uint8_t * p_buf)
+{
+    p_buf[0] = (uint8_t)value;
+    p_buf[1] = (uint8_t)(value >> 8);
+    return 2;
+}
+
+
+static uint16_t u32_encode(uint32_t value, uint8_t * p_buf)
+{
+    (void)u16_encode((uint16_t)value, p_buf);
+    (void)u16_encode((uint16_t)(value >> 16), p_buf + 2);
+    return 4;
+}
+
+
+static uint16_t u16_decode(uint8_t const * p_buf)
+{
+    return (uint16_t)(p_buf[0] | (p_buf[1] << 8));
+}
+
+
+static uint32_t u32_decode(uint8_t const * p_buf)
+{
+    return u16_decode(p_buf) | ((uint32_t)u16_decode(p_buf + 2) << 16);
+}
+
+
+/**@brief Function for getting the zigzag coded difference of two values, modulo 2^16. */
+static uint16_t zigzag(int16_t value, int16_t ref)
+{
+    int16_t delta = (int16_t)(uint16_t)((uint16_t)value - (uint16_t)ref);
+
+    return (uint16_t)(((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15));
+}
+
+
+static int16_t unzigzag(uint16_t code, int16_t ref)
+{
+    uint16_t delta = (uint16_t)((code >> 1) ^ (uint16_t)-(code & 1));
+
+    return (int16_t)(uint16_t)((uint16_t)ref + delta);
+}
+
+
+static uint8_t bits_needed(uint16_t value)
+{
+    uint8_t bits = 0;
+
+    for (; value != 0; value >>= 1)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+
+/**@brief Function for getting the length of a frame. */
+static uint16_t frame_len(uint8_t count, uint8_t const * p_widths, bool key)
+{
+    uint32_t deltas = key ? count - 1 : count;
+    uint32_t bits   = deltas * (p_widths[0] + p_widths[1] + p_widths[2]);
+
+    return DELTA_CODEC_HEADER_LEN + (key ? DELTA_CODEC_KEY_LEN : 0) + (bits + 7) / 8;
+}
+
+
+/**@brief Bit writer, least significant bit first. */
+typedef struct
+{
+    uint8_t * p_buf;
+    uint16_t  len;
+    uint32_t  acc;
+    uint8_t   acc_bits;
+} bit_writer_t;
+
+
+static void bits_put(bit_writer_t * p_writer, uint16_t value, uint8_t width)
+{
+    p_writer->acc      |= (uint32_t)value << p_writer->acc_bits;
+    p_writer->acc_bits += width;
+    while (p_writer->acc_bits >= 8)
+    {
+        p_writer->p_buf[p_writer->len++] = (uint8_t)p_writer->acc;
+        p_writer->acc      >>= 8;
+        p_writer->acc_bits  -= 8;
+    }
+}
+
+
+static void bits_end(bit_writer_t * p_writer)
+{
+    if (p_writer->acc_bits > 0)
+    {
+        p_writer->p_buf[p_writer->len++] = (uint8_t)p_writer->acc;
+    }
+}
+
+
+/**@brief Bit reader, least significant bit first. */
+typedef struct
+{
+    uint8_t const * p_buf;
+    uint16_t        pos;
+    uint32_t        acc;
+    uint8_t         acc_bits;
+} bit_reader_t;
+
+
+static uint16_t bits_get(bit_reader_t * p_reader, uint8_t width)
+{
+    uint16_t value;
+
+    while (p_reader->acc_bits < width)
+    {
+        p_reader->acc      |= (uint32_t)p_reader->p_buf[p_reader->pos++] << p_reader->acc_bits;
+        p_reader->acc_bits += 8;
+    }
+    value                = (uint16_t)(p_reader->acc & ((1UL << width) - 1));
+    p_reader->acc      >>= width;
+    p_reader->acc_bits  -= width;
+    return value;
+}
+
+
+/**@brief Function for starting a frame with its first sample. */
+static void frame_start(delta_codec_enc_t * p_enc, delta_codec_sample_t const * p_sample, uint32_t timestamp)
+{
+    p_enc->key        = (p_enc->frames_to_key == 0);
+    p_enc->samples[0] = *p_sample;
+    p_enc->count      = 1;
+    p_enc->timestamp  = timestamp;
+
+    for (uint32_t a = 0; a < 3; a++)
+    {
+        p_enc->widths[a] = p_enc->key ? 0 : bits_needed(zigzag(p_sample->axis[a], p_enc->ref.axis[a]));
+    }
+}
+
+
+static uint16_t frame_encode(delta_codec_enc_t * p_enc, uint8_t * p_buf)
+{
+    bit_writer_t         writer = {.p_buf = p_buf};
+    delta_codec_sample_t prev   = p_enc->ref;
+    uint32_t             first  = 0;
+
+    writer.p_buf[writer.len++] = p_enc->seq;
+    writer.p_buf[writer.len++] = (p_enc->key ? DELTA_CODEC_KEYFRAME : 0) | p_enc->count;
+    writer.len += u16_encode(p_enc->widths[0] | (p_enc->widths[1] << WIDTH_BITS)
+                             | (p_enc->widths[2] << (2 * WIDTH_BITS)), &p_buf[writer.len]);
+
+    if (p_enc->key)
+    {
+        for (uint32_t a = 0; a < 3; a++)
+        {
+            writer.len += u16_encode((uint16_t)p_enc->samples[0].axis[a], &p_buf[writer.len]);
+        }
+        writer.len += u32_encode(p_enc->timestamp, &p_buf[writer.len]);
+        prev  = p_enc->samples[0];
+        first = 1;
+    }
+
+    for (uint32_t i = first; i < p_enc->count; i++)
+    {
+        for (uint32_t a = 0; a < 3; a++)
+        {
+            bits_put(&writer, zigzag(p_enc->samples[i].axis[a], prev.axis[a]), p_enc->widths[a]);
+        }
+        prev = p_enc->samples[i];
+    }
+    bits_end(&writer);
+
+    p_enc->ref           = prev;
+    p_enc->seq++;
+    p_enc->frames_to_key = p_enc->key ? DELTA_CODEC_KEYFRAME_INTERVAL - 1 : p_enc->frames_to_key - 1;
+    p_enc->count         = 0;
+
+    return writer.len;
+}
+
+
+void delta_codec_enc_init(delta_codec_enc_t * p_enc, uint16_t max_len)
+{
+    memset(p_enc, 0, sizeof(delta_codec_enc_t));
+    p_enc->max_len = max_len;
+}
+
+
+void delta_codec_keyframe_request(delta_codec_enc_t * p_enc)
+{
+    p_enc->frames_to_key = 0;
+}
+
+
+uint16_t delta_codec_push(delta_codec_enc_t * p_enc, delta_codec_sample_t const * p_sample,
+                          uint32_t timestamp, uint8_t * p_buf)
+{
+    uint16_t len = 0;
+
+    if (p_enc->count == 0)
+    {
+        frame_start(p_enc, p_sample, timestamp);
+    }
+    else
+    {
+        delta_codec_sample_t const * p_prev = &p_enc->samples[p_enc->count - 1];
+        uint8_t                      widths[3];
+
+        for (uint32_t a = 0; a < 3; a++)
+        {
+            uint8_t width = bits_needed(zigzag(p_sample->axis[a], p_prev->axis[a]));
+
+            widths[a] = (width > p_enc->widths[a]) ? width : p_enc->widths[a];
+        }
+
+        if (frame_len(p_enc->count + 1, widths, p_enc->key) > p_enc->max_len)
+        {
+            len = frame_encode(p_enc, p_buf);
+            frame_start(p_enc, p_sample, timestamp);
+        }
+        else
+        {
+            p_enc->samples[p_enc->count++] = *p_sample;
+            memcpy(p_enc->widths, widths, sizeof(widths));
+        }
+    }
+
+    if (p_enc->count == DELTA_CODEC_MAX_SAMPLES)
+    {
+        len = frame_encode(p_enc, p_buf);
+    }
+    return len;
+}
+
+
+uint16_t delta_codec_flush(delta_codec_enc_t * p_enc, uint8_t * p_buf)
+{
+    return (p_enc->count > 0) ? frame_encode(p_enc, p_buf) : 0;
+}
+
+
+void delta_codec_dec_init(delta_codec_dec_t * p_dec)
+{
+    memset(p_dec, 0, sizeof(delta_codec_dec_t));
+}
+
+
+bool delta_codec_decode(delta_codec_dec_t * p_dec, uint8_t const * p_buf, uint16_t len,
+                        delta_codec_sample_t * p_samples, uint8_t * p_count)
+{
+    bit_reader_t         reader = {.p_buf = p_buf, .pos = DELTA_CODEC_HEADER_LEN};
+    delta_codec_sample_t prev   = p_dec->ref;
+    uint8_t              widths[3];
+    uint8_t              count;
+    bool                 key;
+    uint32_t             first  = 0;
+
+    *p_count = 0;
+
+    if (len < DELTA_CODEC_HEADER_LEN)
+    {
+        return false;
+    }
+
+    count = p_buf[1] & ~DELTA_CODEC_KEYFRAME;
+    key   = (p_buf[1] & DELTA_CODEC_KEYFRAME) != 0;
+    for (uint32_t a = 0; a < 3; a++)
+    {
+        widths[a] = (u16_decode(&p_buf[2]) >> (a * WIDTH_BITS)) & ((1 << WIDTH_BITS) - 1);
+        if (widths[a] > WIDTH_MAX)
+        {
+            return false;
+        }
+    }
+    if ((count == 0) || (count > DELTA_CODEC_MAX_SAMPLES) || (len < frame_len(count, widths, key)))
+    {
+        return false;
+    }
+
+    if (p_dec->synced && (p_buf[0] != p_dec->next_seq))
+    {
+        p_dec->lost  += (uint8_t)(p_buf[0] - p_dec->next_seq);
+        p_dec->synced = false;
+    }
+    p_dec->next_seq = p_buf[0] + 1;
+
+    if (key)
+    {
+        for (uint32_t a = 0; a < 3; a++)
+        {
+            prev.axis[a] = (int16_t)u16_decode(&p_buf[DELTA_CODEC_HEADER_LEN + 2 * a]);
+        }
+        p_dec->timestamp = u32_decode(&p_buf[DELTA_CODEC_HEADER_LEN + 6]);
+        p_samples[0]     = prev;
+        reader.pos      += DELTA_CODEC_KEY_LEN;
+        first            = 1;
+        p_dec->synced    = true;
+    }
+    else if (!p_dec->synced)
+    {
+        return false;
+    }
+
+    for (uint32_t i = first; i < count; i++)
+    {
+        for (uint32_t a = 0; a < 3; a++)
+        {
+            prev.axis[a] = unzigzag(bits_get(&reader, widths[a]), prev.axis[a]);
+        }
+        p_samples[i] = prev;
+    }
+
+    p_dec->ref = prev;
+    *p_count   = count;
+    return true;
+}
@@ -0,0 +1,134 @@
+#ifndef DELTA_CODEC_H__
+#define DELTA_CODEC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Encoder and decoder of the delta-compressed live stream of x,y,z samples.
+ *
+ * @details Frame layout, little endian:
+ *
+ *          | Offset | Size | Field                                                    |
+ *          |--------|------|----------------------------------------------------------|
+ *          | 0      | 1    | Sequence number, incremented for every frame             |
+ *          | 1      | 1    | Bit 7: keyframe; bits 0-6: samples in the frame          |
+ *          | 2      | 2    | Delta width in bits per axis: x bits 0-4, y 5-9, z 10-14 |
+ *          | 4      | 6    | Keyframe only: first sample, x,y,z (i16 each)            |
+ *          | 10     | 4    | Keyframe only: timestamp of the first sample (u32)       |
+ *          | ...    | ...  | Deltas                                                   |
+ *
+ *          Every sample not given in full is sent as the difference to the sample before it, per
+ *          axis, modulo 2^16 and zigzag coded, with the width of its axis. The deltas follow each
+ *          other x,y,z, sample by sample, packed from the least significant bit of each byte on.
+ *          The first delta of a frame that is not a keyframe refers to the last sample of the
+ *          frame before.
+ *
+ *          The encoder puts as many samples into a frame as fit the payload length, so quiet
+ *          signals need few bits per sample. Every DELTA_CODEC_KEYFRAME_INTERVAL frames, and when
+ *          asked to, it starts a keyframe, so a client that joins late or lost a frame syncs up
+ *          again. A frame holds at most DELTA_CODEC_MAX_SAMPLES samples, which bounds the latency.
+ *
+ *          The timestamp is passed through as it is; see time_sync.h.
+ *
+ *          The module only depends on the C library, so hosts can build it as it is.
+ */
+
+#define DELTA_CODEC_HEADER_LEN          4
+#define DELTA_CODEC_KEY_LEN             10                                  /**< Absolute sample and timestamp of a keyframe. */
+#define DELTA_CODEC_MAX_SAMPLES         24                                  /**< Samples per frame at most. */
+#define DELTA_CODEC_KEYFRAME_INTERVAL   16                                  /**< Frames from one keyframe to the next. */
+#define DELTA_CODEC_MIN_LEN             (DELTA_CODEC_HEADER_LEN + DELTA_CODEC_KEY_LEN + 6) /**< Shortest payload; holds a keyframe of two samples. */
+
+#define DELTA_CODEC_KEYFRAME            (1 << 7)
+
+/**@brief One x,y,z sample. */
+typedef struct
+{
+    int16_t axis[3];
+} delta_codec_sample_t;
+
+/**@brief Encoder state. */
+typedef struct
+{
+    uint16_t             max_len;                                           /**< Payload length of a frame at most. */
+    uint8_t              seq;                                               /**< Sequence number of the next frame. */
+    uint8_t              frames_to_key;                                     /**< Frames until the next keyframe, 0 for a keyframe next. */
+    bool                 key;                                               /**< The frame being built is a keyframe. */
+    delta_codec_sample_t ref;                                               /**< Last sample of the frame before. */
+    delta_codec_sample_t samples[DELTA_CODEC_MAX_SAMPLES];                  /**< Samples of the frame being built. */
+    uint8_t              count;
+    uint8_t              widths[3];                                         /**< Delta widths the samples need. */
+    uint32_t             timestamp;                                         /**< Timestamp of the first sample. */
+} delta_codec_enc_t;
+
+/**@brief Decoder state. */
+typedef struct
+{
+    bool                 synced;                                            /**< A keyframe was decoded and no frame was lost since. */
+    uint8_t              next_seq;
+    delta_codec_sample_t ref;                                               /**< Last sample decoded. */
+    uint32_t             timestamp;                                         /**< Timestamp of the last keyframe. */
+    uint32_t             lost;                                              /**< Frames missing in the sequence. */
+} delta_codec_dec_t;
+
+/**@brief Function for starting an encoder over; the next frame is a keyframe.
+ *
+ * @param[out] p_enc    Encoder.
+ * @param[in]  max_len  Payload length of a frame at most, not less than DELTA_CODEC_MIN_LEN.
+ */
+void delta_codec_enc_init(delta_codec_enc_t * p_enc, uint16_t max_len);
+
+/**@brief Function for making the next frame started a keyframe, e.g. for a client that just
+ *        subscribed.
+ */
+void delta_codec_keyframe_request(delta_codec_enc_t * p_enc);
+
+/**@brief Function for adding a sample.
+ *
+ * @param[in]  p_enc        Encoder.
+ * @param[in]  p_sample     Sample.
+ * @param[in]  timestamp    Timestamp of the sample; only the one of the first sample of a
+ *                          keyframe is sent.
+ * @param[out] p_buf        Buffer of at least max_len bytes, for a frame that is done.
+ *
+ * @return Length of the frame written to p_buf, 0 if the frame is not done yet.
+ */
+uint16_t delta_codec_push(delta_codec_enc_t * p_enc, delta_codec_sample_t const * p_sample,
+                          uint32_t timestamp, uint8_t * p_buf);
+
+/**@brief Function for encoding the samples added so far, even if more would fit.
+ *
+ * @return Length of the frame written to p_buf, 0 if there were no samples.
+ */
+uint16_t delta_codec_flush(delta_codec_enc_t * p_enc, uint8_t * p_buf);
+
+/**@brief Function for starting a decoder over; it waits for a keyframe. */
+void delta_codec_dec_init(delta_codec_dec_t * p_dec);
+
+/**@brief Function for decoding a frame.
+ *
+ * @details After a lost frame the decoder drops frames until the next keyframe.
+ *
+ * @param[in]  p_dec        Decoder.
+ * @param[in]  p_buf        Frame.
+ * @param[in]  len          Frame length.
+ * @param[out] p_samples    Buffer of DELTA_CODEC_MAX_SAMPLES samples.
+ * @param[out] p_count      Samples decoded.
+ *
+ * @return True if the frame was decoded, false if it is malformed or the decoder waits for a
+ *         keyframe.
+ */
+bool delta_codec_decode(delta_codec_dec_t * p_dec, uint8_t const * p_buf, uint16_t len,
+                        delta_codec_sample_t * p_samples, uint8_t * p_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DELTA_CODEC_H__
@@ -0,0 +1,376 @@
+#include "sdk_common.h"
+#include "flash_log.h"
+#include <string.h>
+#include "app_util_platform.h"
+#include "nrf_fstorage.h"
+#include "nrf_fstorage_sd.h"
+#include "crc16.h"
+#include "nrf_log.h"
+
+#define PAGE_MAGIC      0x324F4C52                                          /**< "RLO2", marks a page that has a valid header. Changed with the record size. */
+#define ERASED_WORD     0xFFFFFFFF
+
+/**@brief Header at the start of every page. */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t page_seq;                                                      /**< Incremented every time a new page is opened. */
+} page_header_t;
+
+/**@brief One record slot. The sequence number is written first, so an erased first word means a free slot. */
+typedef struct
+{
+    uint32_t seq;
+    uint16_t len;
+    uint16_t crc;                                                           /**< CRC16 over seq, len and the first len bytes of data. */
+    uint8_t  data[FLASH_LOG_DATA_SIZE];
+} record_t;
+
+STATIC_ASSERT(sizeof(page_header_t) == FLASH_LOG_PAGE_HEADER_SIZE);
+STATIC_ASSERT(sizeof(record_t) == FLASH_LOG_RECORD_SIZE);
+STATIC_ASSERT((FLASH_LOG_DATA_SIZE % 4) == 0);
+
+static void fstorage_evt_handler(nrf_fstorage_evt_t * p_evt);
+
+NRF_FSTORAGE_DEF(nrf_fstorage_t m_fstorage) =
+{
+    .evt_handler = fstorage_evt_handler,
+    .start_addr  = FLASH_LOG_START_ADDR,
+    .end_addr    = FLASH_LOG_END_ADDR,
+};
+
+static page_header_t     m_page_header;                                     /**< Source of the page header write in flight. */
+static record_t          m_queue[FLASH_LOG_QUEUE_SIZE];                     /**< Sources of the record writes in flight, used in order. */
+static uint8_t           m_queue_next;
+static volatile uint8_t  m_queue_used;
+
+static bool              m_mounted;
+static bool              m_empty;                                           /**< No page has been opened yet. */
+static uint16_t          m_head_page;                                       /**< Index of the page records are appended to. */
+static uint32_t          m_head_page_seq;
+static uint16_t          m_head_slot;                                       /**< Next free slot in the head page. */
+static uint32_t          m_tail_seq;
+static flash_log_stats_t m_stats;
+
+
+static uint32_t page_addr(uint16_t page)
+{
+    return FLASH_LOG_START_ADDR + page * FLASH_LOG_PAGE_SIZE;
+}
+
+
+static uint32_t slot_addr(uint16_t page, uint16_t slot)
+{
+    return page_addr(page) + FLASH_LOG_PAGE_HEADER_SIZE + slot * FLASH_LOG_RECORD_SIZE;
+}
+
+
+static uint16_t record_crc(record_t const * p_rec)
+{
+    uint16_t crc = crc16_compute((uint8_t const *)p_rec, offsetof(record_t, crc), NULL);
+    return crc16_compute(p_rec->data, p_rec->len, &crc);
+}
+
+
+/**@brief Function for reading a page header.
+ *
+ * @return True if the page has a valid header, false if it is erased, being erased or its header
+ *         is torn.
+ */
+static bool page_header_read(uint16_t page, uint32_t * p_page_seq)
+{
+    page_header_t header;
+
+    m_stats.mount_reads++;
+    if (nrf_fstorage_read(&m_fstorage, page_addr(page), &header, sizeof(header)) != NRF_SUCCESS)
+    {
+        return false;
+    }
+    if ((header.magic != PAGE_MAGIC) || (header.page_seq == ERASED_WORD))
+    {
+        // An erased page_seq means the header write was cut after the magic.
+        return false;
+    }
+    *p_page_seq = header.page_seq;
+    return true;
+}
+
+
+static bool slot_is_used(uint16_t page, uint16_t slot)
+{
+    uint32_t word = ERASED_WORD;
+
+    m_stats.mount_reads++;
+    (void)nrf_fstorage_read(&m_fstorage, slot_addr(page, slot), &word, sizeof(word));
+    return (word != ERASED_WORD);
+}
+
+
+/**@brief Function for finding head and tail of the log.
+ *
+ * @details Pages are opened in ring order with increasing sequence numbers. Starting from page 0,
+ *          the pages with a valid header and a sequence number not lower than page 0's form a
+ *          prefix of the ring that ends at the head page, so the head can be found by binary
+ *          search. Within the head page the used slots are a prefix as well.
+ */
+static void log_mount(void)
+{
+    uint32_t first_seq;
+    uint32_t seq;
+
+    m_empty = false;
+
+    if (page_header_read(0, &first_seq))
+    {
+        uint16_t lo = 0;
+        uint16_t hi = FLASH_LOG_PAGE_COUNT - 1;
+
+        m_head_page_seq = first_seq;
+        while (lo < hi)
+        {
+            uint16_t mid = (lo + hi + 1) / 2;
+
+            if (page_header_read(mid, &seq) && (seq >= first_seq))
+            {
+                lo              = mid;
+                m_head_page_seq = seq;
+            }
+            else
+            {
+                hi = mid - 1;
+            }
+        }
+        m_head_page = lo;
+    }
+    else if (page_header_read(FLASH_LOG_PAGE_COUNT - 1, &seq))
+    {
+        // Page 0 was being erased when the head wrapped around to it.
+        m_head_page     = FLASH_LOG_PAGE_COUNT - 1;
+        m_head_page_seq = seq;
+    }
+    else
+    {
+        m_empty     = true;
+        m_head_page = FLASH_LOG_PAGE_COUNT - 1;
+        m_head_slot = FLASH_LOG_SLOTS_PER_PAGE;
+        m_tail_seq  = 0;
+        return;
+    }
+
+    uint16_t lo = 0;
+    uint16_t hi = FLASH_LOG_SLOTS_PER_PAGE;
+
+    while (lo < hi)
+    {
+        uint16_t mid = (lo + hi) / 2;
+
+        if (slot_is_used(m_head_page, mid))
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    m_head_slot = lo;
+
+    // The oldest page follows the head, possibly after one page whose erase was interrupted.
+    // If neither holds an older page, the ring has not wrapped yet and page 0 is the oldest.
+    m_tail_seq = 0;
+    for (uint16_t i = 1; i <= 2; i++)
+    {
+        if (page_header_read((m_head_page + i) % FLASH_LOG_PAGE_COUNT, &seq) && (seq < m_head_page_seq))
+        {
+            m_tail_seq = seq * FLASH_LOG_SLOTS_PER_PAGE;
+            break;
+        }
+    }
+}
+
+
+/**@brief Function for erasing the next page and writing its header.
+ */
+static ret_code_t page_open(void)
+{
+    ret_code_t err_code;
+    uint16_t   page     = m_empty ? 0 : (m_head_page + 1) % FLASH_LOG_PAGE_COUNT;
+    uint32_t   page_seq = m_empty ? 0 : m_head_page_seq + 1;
+
+    err_code = nrf_fstorage_erase(&m_fstorage, page_addr(page), 1, NULL);
+    VERIFY_SUCCESS(err_code);
+
+    m_page_header.magic    = PAGE_MAGIC;
+    m_page_header.page_seq = page_seq;
+
+    err_code = nrf_fstorage_write(&m_fstorage, page_addr(page), &m_page_header,
+                                  sizeof(m_page_header), &m_page_header);
+    VERIFY_SUCCESS(err_code);
+
+    m_empty         = false;
+    m_head_page     = page;
+    m_head_page_seq = page_seq;
+    m_head_slot     = 0;
+
+    // The erased page held the oldest records.
+    if (page_seq >= FLASH_LOG_PAGE_COUNT)
+    {
+        m_tail_seq = (page_seq - FLASH_LOG_PAGE_COUNT + 1) * FLASH_LOG_SLOTS_PER_PAGE;
+    }
+
+    m_stats.pages_erased++;
+    return NRF_SUCCESS;
+}
+
+
+static void fstorage_evt_handler(nrf_fstorage_evt_t * p_evt)
+{
+    if (p_evt->result != NRF_SUCCESS)
+    {
+        m_stats.errors++;
+        NRF_LOG_WARNING("Flash log operation failed at 0x%x: %d.", p_evt->addr, p_evt->result);
+    }
+
+    if ((p_evt->id != NRF_FSTORAGE_EVT_WRITE_RESULT) || (p_evt->p_param == &m_page_header))
+    {
+        return;
+    }
+
+    if (p_evt->result == NRF_SUCCESS)
+    {
+        m_stats.records_written++;
+    }
+
+    CRITICAL_REGION_ENTER();
+    m_queue_used--;
+    CRITICAL_REGION_EXIT();
+}
+
+
+ret_code_t flash_log_init(void)
+{
+    ret_code_t err_code;
+
+    err_code = nrf_fstorage_init(&m_fstorage, &nrf_fstorage_sd, NULL);
+    VERIFY_SUCCESS(err_code);
+
+    log_mount();
+    m_mounted = true;
+
+    NRF_LOG_INFO("Flash log mounted: %d headers read, records %d to %d.",
+                 m_stats.mount_reads, m_tail_seq, flash_log_head());
+    return NRF_SUCCESS;
+}
+
+
+ret_code_t flash_log_append(void const * p_data, uint16_t len, uint32_t * p_seq)
+{
+    ret_code_t err_code;
+
+    if (!m_mounted)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (len > FLASH_LOG_DATA_SIZE)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (m_queue_used >= FLASH_LOG_QUEUE_SIZE)
+    {
+        m_stats.records_dropped++;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    if (m_empty || (m_head_slot >= FLASH_LOG_SLOTS_PER_PAGE))
+    {
+        err_code = page_open();
+        if (err_code != NRF_SUCCESS)
+        {
+            m_stats.records_dropped++;
+            return err_code;
+        }
+    }
+
+    record_t * p_rec = &m_queue[m_queue_next];
+
+    memset(p_rec, 0, sizeof(record_t));
+    memcpy(p_rec->data, p_data, len);
+    p_rec->seq = m_head_page_seq * FLASH_LOG_SLOTS_PER_PAGE + m_head_slot;
+    p_rec->len = len;
+    p_rec->crc = record_crc(p_rec);
+
+    err_code = nrf_fstorage_write(&m_fstorage, slot_addr(m_head_page, m_head_slot), p_rec,
+                                  sizeof(record_t), p_rec);
+    if (err_code != NRF_SUCCESS)
+    {
+        m_stats.records_dropped++;
+        return err_code;
+    }
+
+    CRITICAL_REGION_ENTER();
+    m_queue_used++;
+    CRITICAL_REGION_EXIT();
+
+    m_queue_next = (m_queue_next + 1) % FLASH_LOG_QUEUE_SIZE;
+    m_head_slot++;
+
+    if (p_seq != NULL)
+    {
+        *p_seq = p_rec->seq;
+    }
+    return NRF_SUCCESS;
+}
+
+
+ret_code_t flash_log_read(uint32_t seq, void * p_data, uint16_t * p_len)
+{
+    record_t rec;
+
+    if (!m_mounted || m_empty || (seq < m_tail_seq) || (seq >= flash_log_head()))
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint32_t page_seq = seq / FLASH_LOG_SLOTS_PER_PAGE;
+    uint16_t slot     = seq % FLASH_LOG_SLOTS_PER_PAGE;
+    uint16_t page     = (m_head_page + FLASH_LOG_PAGE_COUNT - (m_head_page_seq - page_seq))
+                        % FLASH_LOG_PAGE_COUNT;
+
+    VERIFY_SUCCESS(nrf_fstorage_read(&m_fstorage, slot_addr(page, slot), &rec, sizeof(rec)));
+
+    if (rec.seq == ERASED_WORD)
+    {
+        // Still waiting in the write queue.
+        return NRF_ERROR_NOT_FOUND;
+    }
+    if ((rec.seq != seq) || (rec.len > FLASH_LOG_DATA_SIZE) || (rec.crc != record_crc(&rec)))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    memcpy(p_data, rec.data, rec.len);
+    *p_len = rec.len;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t flash_log_tail(void)
+{
+    return m_tail_seq;
+}
+
+
+uint32_t flash_log_head(void)
+{
+    if (m_empty)
+    {
+        return 0;
+    }
+    return m_head_page_seq * FLASH_LOG_SLOTS_PER_PAGE + m_head_slot;
+}
+
+
+flash_log_stats_t const * flash_log_stats(void)
+{
+    return &m_stats;
+}
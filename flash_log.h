@@ -0,0 +1,100 @@
+#ifndef FLASH_LOG_H__
+#define FLASH_LOG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Circular append-only record log in a dedicated flash area, written through nrf_fstorage.
+ *
+ * @details The area is a ring of pages that is written in order and erased one page at a time,
+ *          so every page is erased once per lap. Each page starts with a header holding a page
+ *          sequence number; record slots have a fixed size, so record sequence number
+ *          page_seq * FLASH_LOG_SLOTS_PER_PAGE + slot also gives its address. Every record carries
+ *          a CRC16 over its sequence number, length and data. A record torn by a brown-out
+ *          fails the CRC and is skipped, the rest of the log stays readable.
+ *
+ *          Mounting reads O(log n) page headers to find the newest page and O(log n) slot
+ *          headers to find its first free slot instead of scanning the whole area.
+ *
+ *          The area sits right below the FDS pages at the end of the flash; the linker script
+ *          ends the application at FLASH_LOG_START_ADDR.
+ */
+
+#define FLASH_LOG_PAGE_SIZE         0x1000                                  /**< nRF52832 flash page size. */
+#define FLASH_LOG_PAGE_COUNT        16                                      /**< Pages in the ring. */
+#define FLASH_LOG_END_ADDR          0x7D000                                 /**< First FDS page (FDS_VIRTUAL_PAGES pages below the end of the flash). */
+#define FLASH_LOG_START_ADDR        (FLASH_LOG_END_ADDR - FLASH_LOG_PAGE_COUNT * FLASH_LOG_PAGE_SIZE)
+
+#define FLASH_LOG_DATA_SIZE         24                                      /**< Maximum payload of one record, a multiple of 4 (a sample block, see sample_block.h). */
+#define FLASH_LOG_QUEUE_SIZE        8                                       /**< Records that can wait for nrf_fstorage at the same time. */
+
+#define FLASH_LOG_PAGE_HEADER_SIZE  8
+#define FLASH_LOG_RECORD_SIZE       (8 + FLASH_LOG_DATA_SIZE)
+#define FLASH_LOG_SLOTS_PER_PAGE    ((FLASH_LOG_PAGE_SIZE - FLASH_LOG_PAGE_HEADER_SIZE) / FLASH_LOG_RECORD_SIZE)
+
+/**@brief Flash log counters. */
+typedef struct
+{
+    uint32_t mount_reads;                                                   /**< Page and slot headers read while mounting. */
+    uint32_t records_written;                                               /**< Records confirmed written by nrf_fstorage. */
+    uint32_t records_dropped;                                               /**< Records rejected because the queue was full. */
+    uint32_t pages_erased;                                                  /**< Pages erased since boot. */
+    uint32_t errors;                                                        /**< Failed flash operations. */
+} flash_log_stats_t;
+
+/**@brief Function for initializing nrf_fstorage and mounting the log.
+ *
+ * @details Must be called after the SoftDevice is enabled.
+ *
+ * @return NRF_SUCCESS, or an error code from nrf_fstorage.
+ */
+ret_code_t flash_log_init(void);
+
+/**@brief Function for appending one record.
+ *
+ * @details The record is queued; it is in flash once nrf_fstorage reports the write.
+ *
+ * @param[in] p_data    Record payload.
+ * @param[in] len       Payload length, at most FLASH_LOG_DATA_SIZE.
+ * @param[out] p_seq    Sequence number given to the record. Can be NULL.
+ *
+ * @retval NRF_SUCCESS              Record queued.
+ * @retval NRF_ERROR_INVALID_LENGTH len is too large.
+ * @retval NRF_ERROR_INVALID_STATE  The log is not mounted.
+ * @retval NRF_ERROR_NO_MEM         The queue is full, the record was dropped.
+ */
+ret_code_t flash_log_append(void const * p_data, uint16_t len, uint32_t * p_seq);
+
+/**@brief Function for reading one record.
+ *
+ * @param[in]     seq       Sequence number of the record.
+ * @param[out]    p_data    Buffer for the payload, FLASH_LOG_DATA_SIZE bytes.
+ * @param[out]    p_len     Payload length.
+ *
+ * @retval NRF_SUCCESS              Record read.
+ * @retval NRF_ERROR_NOT_FOUND      seq is outside of [tail, head) or not written yet.
+ * @retval NRF_ERROR_INVALID_DATA   The record was torn and failed its CRC.
+ */
+ret_code_t flash_log_read(uint32_t seq, void * p_data, uint16_t * p_len);
+
+/**@brief Function for getting the oldest readable sequence number. */
+uint32_t flash_log_tail(void);
+
+/**@brief Function for getting the sequence number the next record will get. */
+uint32_t flash_log_head(void);
+
+/**@brief Function for getting the flash log counters. */
+flash_log_stats_t const * flash_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLASH_LOG_H__
@@ -0,0 +1,243 @@
+#include "sdk_common.h"
+#include "history_xfer.h"
+#include <string.h>
+#include "crc16.h"
+#include "sample_block.h"
+
+#define FRAME_OVERHEAD  (HISTORY_XFER_HEADER_LEN + HISTORY_XFER_CRC_LEN)
+
+static history_xfer_stats_t m_stats;
+
+
+static uint8_t bits_count(uint32_t bitmap)
+{
+    uint8_t count = 0;
+
+    for (; bitmap != 0; bitmap &= bitmap - 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+
+static uint8_t lowest_bit(uint32_t bitmap)
+{
+    uint8_t bit = 0;
+
+    while ((bitmap & 1) == 0)
+    {
+        bitmap >>= 1;
+        bit++;
+    }
+    return bit;
+}
+
+
+/**@brief Function for moving a bitmap to a lower base; bits that move past the window are lost.
+ */
+static uint32_t bitmap_rebase(uint32_t bitmap, uint32_t shift)
+{
+    if (shift >= HISTORY_XFER_NACK_BITS)
+    {
+        m_stats.nack_bits_dropped += bits_count(bitmap);
+        return 0;
+    }
+    if (shift > 0)
+    {
+        m_stats.nack_bits_dropped += bits_count(bitmap >> (HISTORY_XFER_NACK_BITS - shift));
+    }
+    return bitmap << shift;
+}
+
+
+/**@brief Function for keeping the oldest frame to send again at bit 0 of the retransmit window,
+ *        so the window reaches as far as possible.
+ */
+static void retx_trim(history_xfer_t * p_xfer)
+{
+    if (p_xfer->retx_bitmap != 0)
+    {
+        uint8_t skip = lowest_bit(p_xfer->retx_bitmap);
+
+        p_xfer->retx_bitmap >>= skip;
+        p_xfer->retx_base    += skip;
+    }
+}
+
+
+/**@brief Function for getting the frame history_xfer_frame_get builds next.
+ *
+ * @return True if a frame is left, false otherwise.
+ */
+static bool next_seq(history_xfer_t const * p_xfer, uint16_t * p_seq)
+{
+    if (p_xfer->retx_bitmap != 0)
+    {
+        *p_seq = p_xfer->retx_base + lowest_bit(p_xfer->retx_bitmap);
+        return true;
+    }
+
+    *p_seq = p_xfer->next_seq;
+    return (p_xfer->next_seq < p_xfer->frame_count);
+}
+
+
+uint32_t history_xfer_start(history_xfer_t * p_xfer, uint32_t first_block, uint32_t block_count,
+                            uint16_t max_len)
+{
+    uint32_t tail = flash_log_tail();
+    uint32_t head = flash_log_head();
+
+    memset(p_xfer, 0, sizeof(history_xfer_t));
+
+    if (max_len < FRAME_OVERHEAD + HISTORY_XFER_RECORD_MAX_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    // The length field is one byte.
+    p_xfer->blocks_per_frame = MIN((max_len - FRAME_OVERHEAD), UINT8_MAX) / HISTORY_XFER_RECORD_MAX_LEN;
+
+    if (first_block < tail)
+    {
+        block_count = (block_count > tail - first_block) ? block_count - (tail - first_block) : 0;
+        first_block = tail;
+    }
+    if (first_block >= head)
+    {
+        return NRF_SUCCESS;
+    }
+    block_count = MIN(block_count, head - first_block);
+    block_count = MIN(block_count, (uint32_t)UINT16_MAX * p_xfer->blocks_per_frame);
+
+    p_xfer->first_block = first_block;
+    p_xfer->block_count = block_count;
+    p_xfer->frame_count = CEIL_DIV(block_count, p_xfer->blocks_per_frame);
+    return NRF_SUCCESS;
+}
+
+
+void history_xfer_stop(history_xfer_t * p_xfer)
+{
+    p_xfer->frame_count = 0;
+    p_xfer->next_seq    = 0;
+    p_xfer->retx_bitmap = 0;
+}
+
+
+void history_xfer_nack(history_xfer_t * p_xfer, uint16_t base, uint32_t bitmap)
+{
+    m_stats.nacks++;
+
+    // Frames not sent yet come anyway.
+    if (base >= p_xfer->next_seq)
+    {
+        return;
+    }
+    if (p_xfer->next_seq - base < HISTORY_XFER_NACK_BITS)
+    {
+        bitmap &= (1UL << (p_xfer->next_seq - base)) - 1;
+    }
+    if (bitmap == 0)
+    {
+        return;
+    }
+
+    if (p_xfer->retx_bitmap == 0)
+    {
+        p_xfer->retx_base = base;
+    }
+    else if (base < p_xfer->retx_base)
+    {
+        p_xfer->retx_bitmap = bitmap_rebase(p_xfer->retx_bitmap, p_xfer->retx_base - base);
+        p_xfer->retx_base   = base;
+    }
+    else
+    {
+        bitmap = bitmap_rebase(bitmap, base - p_xfer->retx_base);
+    }
+    p_xfer->retx_bitmap |= bitmap;
+    retx_trim(p_xfer);
+}
+
+
+bool history_xfer_pending(history_xfer_t const * p_xfer)
+{
+    uint16_t seq;
+
+    return next_seq(p_xfer, &seq);
+}
+
+
+uint16_t history_xfer_frame_get(history_xfer_t const * p_xfer, uint8_t * p_buf)
+{
+    uint16_t seq;
+
+    if (!next_seq(p_xfer, &seq))
+    {
+        return 0;
+    }
+
+    uint32_t first = p_xfer->first_block + (uint32_t)seq * p_xfer->blocks_per_frame;
+    uint32_t count = MIN(p_xfer->blocks_per_frame, p_xfer->block_count - (first - p_xfer->first_block));
+    uint16_t len   = HISTORY_XFER_HEADER_LEN;
+
+    for (uint32_t block = first; block < first + count; block++)
+    {
+        uint16_t data_len;
+
+        if (sample_block_read(block, &p_buf[len + 1], &data_len) != NRF_SUCCESS)
+        {
+            data_len = 0;
+        }
+        p_buf[len] = (uint8_t)data_len;
+        len       += 1 + data_len;
+    }
+
+    (void)uint16_encode(seq, &p_buf[0]);
+    p_buf[2] = (uint8_t)(len - HISTORY_XFER_HEADER_LEN);
+    (void)uint32_encode(first, &p_buf[3]);
+
+    len += uint16_encode(crc16_compute(p_buf, len, NULL), &p_buf[len]);
+    return len;
+}
+
+
+void history_xfer_advance(history_xfer_t * p_xfer)
+{
+    if (p_xfer->retx_bitmap != 0)
+    {
+        p_xfer->retx_bitmap &= p_xfer->retx_bitmap - 1;
+        retx_trim(p_xfer);
+        m_stats.frames_resent++;
+    }
+    else if (p_xfer->next_seq < p_xfer->frame_count)
+    {
+        p_xfer->next_seq++;
+        m_stats.frames_sent++;
+    }
+}
+
+
+bool history_xfer_frame_check(uint8_t const * p_buf, uint16_t len, uint16_t * p_seq, uint32_t * p_block)
+{
+    if ((len < FRAME_OVERHEAD) || (p_buf[2] + FRAME_OVERHEAD != len))
+    {
+        return false;
+    }
+    if (crc16_compute(p_buf, len - HISTORY_XFER_CRC_LEN, NULL) != uint16_decode(&p_buf[len - HISTORY_XFER_CRC_LEN]))
+    {
+        return false;
+    }
+
+    *p_seq   = uint16_decode(&p_buf[0]);
+    *p_block = uint32_decode(&p_buf[3]);
+    return true;
+}
+
+
+history_xfer_stats_t const * history_xfer_stats(void)
+{
+    return &m_stats;
+}
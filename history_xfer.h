@@ -0,0 +1,124 @@
+#ifndef HISTORY_XFER_H__
+#define HISTORY_XFER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Framed download of a block range from the flash log, with selective retransmission.
+ *
+ * @details A transfer splits the range into frames of a fixed number of blocks. Frame layout,
+ *          little endian:
+ *
+ *          | Offset | Size | Field                                              |
+ *          |--------|------|----------------------------------------------------|
+ *          | 0      | 2    | Sequence number, 0 for the first frame             |
+ *          | 2      | 1    | Length of the records                              |
+ *          | 3      | 4    | Block number of the first record                   |
+ *          | 7      | ...  | Records: length (1), data; length 0 if the block   |
+ *          |        |      | was overwritten or failed its flash CRC            |
+ *          | 7+len  | 2    | CRC16-CCITT over everything before it              |
+ *
+ *          Frame seq holds the blocks first + seq * blocks_per_frame onwards, so any frame can be
+ *          built again from the flash log. The client NACKs the frames it missed or that failed
+ *          the CRC with a base sequence number and a bitmap of 32 frames after it; these are sent
+ *          before any new frame. The transfer keeps streaming meanwhile and never restarts.
+ *
+ *          Frames are regenerated, so a block that was overwritten between the original and the
+ *          retransmitted frame comes back with length 0.
+ */
+
+#define HISTORY_XFER_HEADER_LEN     7
+#define HISTORY_XFER_CRC_LEN        2
+#define HISTORY_XFER_RECORD_MAX_LEN (1 + FLASH_LOG_DATA_SIZE)
+#define HISTORY_XFER_NACK_BITS      32                                      /**< Frames a NACK and the retransmit window cover. */
+
+/**@brief History transfer counters. */
+typedef struct
+{
+    uint32_t frames_sent;                                                   /**< Frames sent for the first time. */
+    uint32_t frames_resent;                                                 /**< Frames sent again after a NACK. */
+    uint32_t nacks;                                                         /**< NACKs received. */
+    uint32_t nack_bits_dropped;                                             /**< Requested frames that did not fit the retransmit window. */
+} history_xfer_stats_t;
+
+/**@brief State of one transfer. */
+typedef struct
+{
+    uint32_t first_block;
+    uint32_t block_count;
+    uint16_t frame_count;
+    uint16_t next_seq;                                                      /**< Next frame sent for the first time. */
+    uint8_t  blocks_per_frame;
+    uint16_t retx_base;                                                     /**< Frame of bit 0 of retx_bitmap. */
+    uint32_t retx_bitmap;                                                   /**< Frames to send again. */
+} history_xfer_t;
+
+/**@brief Function for starting a transfer.
+ *
+ * @details The range is clipped to the records still in the flash log.
+ *
+ * @param[out] p_xfer       Transfer state.
+ * @param[in]  first_block  First block to send.
+ * @param[in]  block_count  Number of blocks.
+ * @param[in]  max_len      Longest frame the link can carry.
+ *
+ * @retval NRF_SUCCESS              Transfer started; it is empty if nothing of the range is left.
+ * @retval NRF_ERROR_INVALID_LENGTH max_len cannot hold a frame with one record.
+ */
+uint32_t history_xfer_start(history_xfer_t * p_xfer, uint32_t first_block, uint32_t block_count,
+                            uint16_t max_len);
+
+/**@brief Function for stopping a transfer; later NACKs are ignored. */
+void history_xfer_stop(history_xfer_t * p_xfer);
+
+/**@brief Function for requesting frames again.
+ *
+ * @param[in] base      Sequence number of bit 0.
+ * @param[in] bitmap    One bit per missing frame, bit i for frame base + i.
+ */
+void history_xfer_nack(history_xfer_t * p_xfer, uint16_t base, uint32_t bitmap);
+
+/**@brief Function for checking whether frames are left to send. */
+bool history_xfer_pending(history_xfer_t const * p_xfer);
+
+/**@brief Function for building the next frame.
+ *
+ * @details Retransmissions go first. The transfer only moves on with @ref history_xfer_advance,
+ *          so a frame the link did not take is built again next time.
+ *
+ * @param[in]  p_xfer   Transfer state.
+ * @param[out] p_buf    Buffer of at least the max_len given at the start.
+ *
+ * @return Frame length, 0 if nothing is left to send.
+ */
+uint16_t history_xfer_frame_get(history_xfer_t const * p_xfer, uint8_t * p_buf);
+
+/**@brief Function for marking the frame last built as sent. */
+void history_xfer_advance(history_xfer_t * p_xfer);
+
+/**@brief Function for checking a received frame.
+ *
+ * @param[in]  p_buf        Frame.
+ * @param[in]  len          Frame length.
+ * @param[out] p_seq        Sequence number.
+ * @param[out] p_block      Block number of the first record.
+ *
+ * @return True if the length fields and the CRC match.
+ */
+bool history_xfer_frame_check(uint8_t const * p_buf, uint16_t len, uint16_t * p_seq, uint32_t * p_block);
+
+/**@brief Function for getting the history transfer counters. */
+history_xfer_stats_t const * history_xfer_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HISTORY_XFER_H__
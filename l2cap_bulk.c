@@ -0,0 +1,431 @@
+#include "sdk_common.h"
+#include "l2cap_bulk.h"
+#include <string.h>
+#include "nrf_sdh_ble.h"
+#include "flash_log.h"
+#include "sample_block.h"
+#include "local_clock.h"
+#include "sample_pool.h"
+#include "nrf_log.h"
+
+#define SEQ_LEN         2                                                   /**< Sequence number at the start of every SDU. */
+#define BLOCK_SDU_LEN   (SEQ_LEN + 1 + FLASH_LOG_DATA_SIZE)                 /**< Shortest SDU that holds a flash log block. */
+
+/**@brief Download in progress. */
+typedef struct
+{
+    uint8_t  source;
+    uint32_t next;                                                          /**< Next value or block to send. */
+    uint32_t remaining;                                                     /**< Values or blocks left to send. */
+    uint16_t seq;                                                           /**< Sequence number of the next SDU. */
+    bool     end_pending;                                                   /**< The end SDU still has to be queued. */
+    uint32_t start_ms;
+    uint32_t bytes;
+} download_t;
+
+static l2cap_bulk_evt_handler_t m_evt_handler;
+static uint16_t const *         mp_recorded;                                /**< accl_arr values recorded. */
+static uint16_t                 m_conn_handle = BLE_CONN_HANDLE_INVALID;   /**< Link of the open channel. */
+static uint16_t                 m_cid         = BLE_L2CAP_CID_INVALID;
+static uint16_t                 m_sdu_len;                                  /**< SDU length, limited by the peer MTU. */
+static download_t               m_download;
+
+static uint8_t                  m_rx_buf[L2CAP_BULK_RX_MTU];
+static uint8_t                  m_tx_bufs[L2CAP_BULK_TX_QUEUE_SIZE][L2CAP_BULK_SDU_MAX_LEN]; /**< Used in order; a buffer is owned by the SoftDevice until BLE_L2CAP_EVT_CH_TX. */
+static uint8_t                  m_tx_next;
+static uint8_t                  m_tx_queued;
+static uint8_t                  m_tx_queue_size;                            /**< SDUs the SoftDevice queues, 0 without a channel. */
+
+
+static void evt_send(l2cap_bulk_evt_type_t evt_type)
+{
+    l2cap_bulk_evt_t evt =
+    {
+        .evt_type    = evt_type,
+        .conn_handle = m_conn_handle,
+    };
+
+    if (m_evt_handler != NULL)
+    {
+        m_evt_handler(&evt);
+    }
+}
+
+
+static bool download_active(void)
+{
+    return (m_download.remaining > 0) || m_download.end_pending;
+}
+
+
+/**@brief Function for filling an SDU with the next values or blocks.
+ *
+ * @return SDU length.
+ */
+static uint16_t sdu_fill(uint8_t * p_buf)
+{
+    uint16_t len = uint16_encode(m_download.seq, p_buf);
+
+    if (m_download.source == L2CAP_BULK_SOURCE_ACCL)
+    {
+        uint32_t count = MIN(m_download.remaining, (m_sdu_len - len) / sizeof(uint16_t));
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            len += uint16_encode(sample_pool_accl[m_download.next + i], &p_buf[len]);
+        }
+        m_download.next      += count;
+        m_download.remaining -= count;
+    }
+    else
+    {
+        while ((m_download.remaining > 0) && (len + 1 + FLASH_LOG_DATA_SIZE <= m_sdu_len))
+        {
+            uint16_t data_len;
+
+            if (sample_block_read(m_download.next, &p_buf[len + 1], &data_len) != NRF_SUCCESS)
+            {
+                data_len = 0;
+            }
+            p_buf[len] = (uint8_t)data_len;
+            len       += 1 + data_len;
+
+            m_download.next++;
+            m_download.remaining--;
+        }
+    }
+    return len;
+}
+
+
+/**@brief Function for queueing SDUs until the download is done or the SoftDevice queue is full.
+ */
+static void download_pump(void)
+{
+    while (download_active() && (m_tx_queued < m_tx_queue_size))
+    {
+        download_t saved = m_download;
+        ble_data_t sdu;
+
+        sdu.p_data = m_tx_bufs[m_tx_next];
+        sdu.len    = sdu_fill(sdu.p_data);
+
+        uint32_t err_code = sd_ble_l2cap_ch_tx(m_conn_handle, m_cid, &sdu);
+        if (err_code == NRF_ERROR_RESOURCES)
+        {
+            // Filled again from the same position once an SDU is sent.
+            m_download = saved;
+            return;
+        }
+        if (err_code != NRF_SUCCESS)
+        {
+            NRF_LOG_WARNING("L2CAP download aborted at SDU %d: 0x%x.", m_download.seq, err_code);
+            memset(&m_download, 0, sizeof(m_download));
+            evt_send(L2CAP_BULK_EVT_DONE);
+            return;
+        }
+
+        if (sdu.len == SEQ_LEN)
+        {
+            m_download.end_pending = false;
+        }
+        m_download.seq++;
+        m_download.bytes += sdu.len - SEQ_LEN;
+        m_tx_next         = (m_tx_next + 1) % m_tx_queue_size;
+        m_tx_queued++;
+
+        if (!download_active())
+        {
+            uint32_t elapsed_ms = local_clock_ms() - m_download.start_ms;
+
+            NRF_LOG_INFO("L2CAP download done: %d bytes in %d SDUs, %d ms (%d B/s).",
+                         m_download.bytes, m_download.seq, elapsed_ms,
+                         (elapsed_ms > 0) ? m_download.bytes * 1000 / elapsed_ms : 0);
+            evt_send(L2CAP_BULK_EVT_DONE);
+        }
+    }
+}
+
+
+/**@brief Function for handling a request SDU.
+ *
+ * @details While a download runs, only a request without data is taken: it stops the download
+ *          after the SDUs already queued and the end SDU, so the client sees where the stream
+ *          ends before the sequence numbers of the next download start over.
+ */
+static void on_request(uint8_t const * p_data, uint16_t len)
+{
+    bool     running = download_active();
+    uint32_t first;
+    uint32_t count;
+    uint32_t limit_first;
+    uint32_t limit_end;
+
+    if ((len != L2CAP_BULK_REQ_LEN) || (p_data[0] > L2CAP_BULK_SOURCE_FLASH_LOG))
+    {
+        NRF_LOG_WARNING("L2CAP request ignored.");
+        return;
+    }
+
+    first = uint32_decode(&p_data[1]);
+    count = uint32_decode(&p_data[5]);
+
+    if (p_data[0] == L2CAP_BULK_SOURCE_ACCL)
+    {
+        limit_first = 0;
+        limit_end   = (mp_recorded != NULL) ? *mp_recorded : 0;
+    }
+    else if (m_sdu_len < BLOCK_SDU_LEN)
+    {
+        // sdu_fill could not put a single block into an SDU and would never get to the end.
+        NRF_LOG_WARNING("L2CAP flash log request ignored, peer MTU %d is below %d.", m_sdu_len, BLOCK_SDU_LEN);
+        limit_first = 0;
+        limit_end   = 0;
+    }
+    else
+    {
+        limit_first = flash_log_tail();
+        limit_end   = flash_log_head();
+    }
+
+    if (first < limit_first)
+    {
+        count = (count > limit_first - first) ? count - (limit_first - first) : 0;
+        first = limit_first;
+    }
+    count = (first < limit_end) ? MIN(count, limit_end - first) : 0;
+
+    if (running)
+    {
+        if (count > 0)
+        {
+            NRF_LOG_WARNING("L2CAP request ignored, download %d SDUs in.", m_download.seq);
+            return;
+        }
+        m_download.remaining = 0;
+        download_pump();
+        return;
+    }
+    if (count == 0)
+    {
+        return;
+    }
+
+    memset(&m_download, 0, sizeof(m_download));
+    m_download.source      = p_data[0];
+    m_download.next        = first;
+    m_download.remaining   = count;
+    m_download.end_pending = true;
+    m_download.start_ms    = local_clock_ms();
+
+    evt_send(L2CAP_BULK_EVT_STARTED);
+    download_pump();
+}
+
+
+static void rx_buf_give(void)
+{
+    ble_data_t const sdu_buf = {.p_data = m_rx_buf, .len = sizeof(m_rx_buf)};
+    uint32_t         err_code;
+
+    err_code = sd_ble_l2cap_ch_rx(m_conn_handle, m_cid, &sdu_buf);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("L2CAP RX buffer not accepted: 0x%x.", err_code);
+    }
+}
+
+
+static void on_setup_request(ble_l2cap_evt_t const * p_evt)
+{
+    ble_l2cap_ch_setup_params_t params;
+    uint16_t                    cid = p_evt->local_cid;
+
+    memset(&params, 0, sizeof(params));
+
+    if (p_evt->params.ch_setup_request.le_psm != L2CAP_BULK_PSM)
+    {
+        params.status = BLE_L2CAP_CH_STATUS_CODE_LE_PSM_NOT_SUPPORTED;
+    }
+    else if (m_cid != BLE_L2CAP_CID_INVALID)
+    {
+        params.status = BLE_L2CAP_CH_STATUS_CODE_NO_RESOURCES;
+    }
+    else
+    {
+        params.status                   = BLE_L2CAP_CH_STATUS_CODE_SUCCESS;
+        params.rx_params.rx_mtu         = L2CAP_BULK_RX_MTU;
+        params.rx_params.rx_mps         = BLE_L2CAP_MPS_MIN;
+        params.rx_params.sdu_buf.p_data = m_rx_buf;
+        params.rx_params.sdu_buf.len    = sizeof(m_rx_buf);
+    }
+
+    uint32_t err_code = sd_ble_l2cap_ch_setup(p_evt->conn_handle, &cid, &params);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("L2CAP setup reply failed: 0x%x.", err_code);
+    }
+}
+
+
+static void on_released(void)
+{
+    bool running = download_active();
+
+    memset(&m_download, 0, sizeof(m_download));
+    if (running)
+    {
+        evt_send(L2CAP_BULK_EVT_DONE);
+    }
+
+    m_conn_handle = BLE_CONN_HANDLE_INVALID;
+    m_cid         = BLE_L2CAP_CID_INVALID;
+    m_tx_next     = 0;
+    m_tx_queued   = 0;
+}
+
+
+static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
+{
+    ble_l2cap_evt_t const * p_evt = &p_ble_evt->evt.l2cap_evt;
+
+    UNUSED_PARAMETER(p_context);
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_L2CAP_EVT_CH_SETUP_REQUEST:
+            on_setup_request(p_evt);
+            break;
+
+        case BLE_L2CAP_EVT_CH_SETUP:
+            m_conn_handle = p_evt->conn_handle;
+            m_cid         = p_evt->local_cid;
+            m_sdu_len     = MIN(L2CAP_BULK_SDU_MAX_LEN, p_evt->params.ch_setup.tx_params.tx_mtu);
+            NRF_LOG_INFO("L2CAP channel open: SDU %d bytes, MPS %d, %d credits.", m_sdu_len,
+                         p_evt->params.ch_setup.tx_params.tx_mps,
+                         p_evt->params.ch_setup.tx_params.credits);
+            break;
+
+        case BLE_L2CAP_EVT_CH_RELEASED:
+            if (p_evt->local_cid == m_cid)
+            {
+                on_released();
+            }
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            if (p_ble_evt->evt.gap_evt.conn_handle == m_conn_handle)
+            {
+                on_released();
+            }
+            break;
+
+        case BLE_L2CAP_EVT_CH_RX:
+            if (p_evt->local_cid == m_cid)
+            {
+                on_request(p_evt->params.rx.sdu_buf.p_data, p_evt->params.rx.sdu_len);
+                rx_buf_give();
+            }
+            break;
+
+        case BLE_L2CAP_EVT_CH_TX:
+            if ((p_evt->local_cid == m_cid) && (m_tx_queued > 0))
+            {
+                m_tx_queued--;
+                download_pump();
+            }
+            break;
+
+        case BLE_L2CAP_EVT_CH_CREDIT:
+            NRF_LOG_DEBUG("L2CAP credits: %d.", p_evt->params.credit.credits);
+            break;
+
+        default:
+            break;
+    }
+}
+
+NRF_SDH_BLE_OBSERVER(m_l2cap_bulk_obs, L2CAP_BULK_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
+
+
+/**@brief Function for configuring one channel with the given TX queue, or none if it is 0. */
+static ret_code_t channel_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start, uint8_t tx_queue_size)
+{
+    ret_code_t err_code;
+    ble_cfg_t  ble_cfg;
+
+    memset(&ble_cfg, 0, sizeof(ble_cfg));
+    ble_cfg.conn_cfg.conn_cfg_tag                          = conn_cfg_tag;
+    ble_cfg.conn_cfg.params.l2cap_conn_cfg.rx_mps          = BLE_L2CAP_MPS_MIN;
+    ble_cfg.conn_cfg.params.l2cap_conn_cfg.tx_mps          = (tx_queue_size > 0) ? L2CAP_BULK_MPS : BLE_L2CAP_MPS_MIN;
+    ble_cfg.conn_cfg.params.l2cap_conn_cfg.rx_queue_size   = 1;
+    ble_cfg.conn_cfg.params.l2cap_conn_cfg.tx_queue_size   = MAX(tx_queue_size, 1);
+    ble_cfg.conn_cfg.params.l2cap_conn_cfg.ch_count        = (tx_queue_size > 0) ? 1 : 0;
+
+    err_code = sd_ble_cfg_set(BLE_CONN_CFG_L2CAP, &ble_cfg, ram_start);
+    if (err_code == NRF_SUCCESS)
+    {
+        m_tx_queue_size = tx_queue_size;
+    }
+    return err_code;
+}
+
+
+ret_code_t l2cap_bulk_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start)
+{
+    ret_code_t err_code = channel_cfg_set(conn_cfg_tag, ram_start, L2CAP_BULK_TX_QUEUE_SIZE);
+
+    if (err_code == NRF_ERROR_NO_MEM)
+    {
+        NRF_LOG_WARNING("No RAM for %d queued L2CAP SDUs, trying %d.",
+                        L2CAP_BULK_TX_QUEUE_SIZE, L2CAP_BULK_TX_QUEUE_SIZE_MIN);
+        err_code = channel_cfg_set(conn_cfg_tag, ram_start, L2CAP_BULK_TX_QUEUE_SIZE_MIN);
+    }
+    if (err_code == NRF_ERROR_NO_MEM)
+    {
+        NRF_LOG_WARNING("No RAM for the L2CAP channel, bulk downloads use GATT.");
+        m_tx_queue_size = 0;
+        err_code        = NRF_SUCCESS;
+    }
+    return err_code;
+}
+
+
+ret_code_t l2cap_bulk_cfg_reduce(uint8_t conn_cfg_tag, uint32_t ram_start)
+{
+    if (m_tx_queue_size <= L2CAP_BULK_TX_QUEUE_SIZE_MIN)
+    {
+        // Nothing left to give up.
+        return NRF_SUCCESS;
+    }
+    return channel_cfg_set(conn_cfg_tag, ram_start, L2CAP_BULK_TX_QUEUE_SIZE_MIN);
+}
+
+
+ret_code_t l2cap_bulk_cfg_disable(uint8_t conn_cfg_tag, uint32_t ram_start)
+{
+    if (m_tx_queue_size == 0)
+    {
+        return NRF_SUCCESS;
+    }
+    return channel_cfg_set(conn_cfg_tag, ram_start, 0);
+}
+
+
+uint8_t l2cap_bulk_tx_queue_size(void)
+{
+    return m_tx_queue_size;
+}
+
+
+void l2cap_bulk_init(l2cap_bulk_evt_handler_t evt_handler, uint16_t const * p_recorded)
+{
+    m_evt_handler = evt_handler;
+    mp_recorded   = p_recorded;
+}
+
+
+bool l2cap_bulk_active(uint16_t conn_handle)
+{
+    return (conn_handle != BLE_CONN_HANDLE_INVALID) && (conn_handle == m_conn_handle) && download_active();
+}
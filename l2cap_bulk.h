@@ -0,0 +1,119 @@
+#ifndef L2CAP_BULK_H__
+#define L2CAP_BULK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "sdk_errors.h"
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Bulk download over an LE L2CAP connection-oriented channel.
+ *
+ * @details The central opens a channel on L2CAP_BULK_PSM and writes a request SDU on it, little
+ *          endian:
+ *
+ *          | Offset | Size | Field                                                   |
+ *          |--------|------|---------------------------------------------------------|
+ *          | 0      | 1    | Source, L2CAP_BULK_SOURCE_*                             |
+ *          | 1      | 4    | First accl_arr value or flash log block                 |
+ *          | 5      | 4    | Number of values or blocks, 0 stops a running download  |
+ *
+ *          A request for data while a download runs is ignored.
+ *
+ *          The data comes back in SDUs of up to L2CAP_BULK_SDU_MAX_LEN bytes (less if the peer MTU
+ *          is smaller): a sequence number (u16) followed by accl_arr values (u16 each) or by flash
+ *          log records (length u8, data; length 0 for a block that is gone or failed its CRC). An
+ *          SDU with only the sequence number ends the download. The range is clipped to the data
+ *          that exists: the accl_arr values recorded so far, or the blocks still in the flash log.
+ *          Flash log requests are treated as empty if the peer MTU is below 27 bytes, too small
+ *          for an SDU with one block.
+ *
+ *          Compared to the GATT bulk characteristic there is no ATT header per packet, an SDU
+ *          spans several LL packets with a single L2CAP header, and the SoftDevice keeps
+ *          L2CAP_BULK_TX_QUEUE_SIZE SDUs queued instead of a few notifications. The peer paces
+ *          the transfer with credits, so it never has to drop data. One channel is served at a
+ *          time; live data stays on GATT.
+ */
+
+#define L2CAP_BULK_PSM                  0x0080                              /**< First LE dynamic PSM. */
+#define L2CAP_BULK_MPS                  (NRF_SDH_BLE_GAP_DATA_LENGTH - 4)   /**< K-frame payload that fills one LL packet. */
+#define L2CAP_BULK_SDU_MAX_LEN          (4 * L2CAP_BULK_MPS - 2)            /**< Four LL packets per SDU; the first K-frame carries the SDU length. */
+#define L2CAP_BULK_TX_QUEUE_SIZE        3                                   /**< SDUs queued in the SoftDevice. */
+#define L2CAP_BULK_TX_QUEUE_SIZE_MIN    2                                   /**< Queue size if the SoftDevice RAM is short; still one SDU behind the one on air. */
+#define L2CAP_BULK_RX_MTU               BLE_L2CAP_MTU_MIN                   /**< Requests are short. */
+#define L2CAP_BULK_REQ_LEN              9
+#define L2CAP_BULK_BLE_OBSERVER_PRIO    2                                   /**< Priority of the BLE event observer. */
+
+#define L2CAP_BULK_SOURCE_ACCL          0x00                                /**< Raw accl_arr values in RAM. */
+#define L2CAP_BULK_SOURCE_FLASH_LOG     0x01                                /**< Flash log blocks. */
+
+/**@brief L2CAP bulk event types. */
+typedef enum
+{
+    L2CAP_BULK_EVT_STARTED,                                                 /**< A download was requested. */
+    L2CAP_BULK_EVT_DONE,                                                    /**< The download completed, was stopped, or the channel closed. */
+} l2cap_bulk_evt_type_t;
+
+/**@brief L2CAP bulk event. */
+typedef struct
+{
+    l2cap_bulk_evt_type_t evt_type;
+    uint16_t              conn_handle;                                      /**< Link of the channel. */
+} l2cap_bulk_evt_t;
+
+/**@brief L2CAP bulk event handler type. */
+typedef void (*l2cap_bulk_evt_handler_t)(l2cap_bulk_evt_t const * p_evt);
+
+/**@brief Function for adding the channel settings to the SoftDevice configuration.
+ *
+ * @details Call after nrf_sdh_ble_default_cfg_set and before nrf_sdh_ble_enable. If the RAM given
+ *          to the SoftDevice is too small for L2CAP_BULK_TX_QUEUE_SIZE, the channel queues
+ *          L2CAP_BULK_TX_QUEUE_SIZE_MIN SDUs, or there is no channel and downloads use GATT.
+ *
+ * @param[in] conn_cfg_tag  Connection configuration tag used by the application.
+ * @param[in] ram_start     Application RAM start address.
+ *
+ * @return NRF_SUCCESS, or an error code from sd_ble_cfg_set.
+ */
+ret_code_t l2cap_bulk_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start);
+
+/**@brief Function for configuring the smaller SDU queue after nrf_sdh_ble_enable ran out of RAM.
+ *
+ * @details Does nothing if the queue is L2CAP_BULK_TX_QUEUE_SIZE_MIN or smaller already.
+ *
+ * @return NRF_SUCCESS, or an error code from sd_ble_cfg_set.
+ */
+ret_code_t l2cap_bulk_cfg_reduce(uint8_t conn_cfg_tag, uint32_t ram_start);
+
+/**@brief Function for configuring no channel after nrf_sdh_ble_enable ran out of RAM.
+ *
+ * @details The SoftDevice then refuses channels on L2CAP_BULK_PSM; downloads use GATT.
+ *
+ * @return NRF_SUCCESS, or an error code from sd_ble_cfg_set.
+ */
+ret_code_t l2cap_bulk_cfg_disable(uint8_t conn_cfg_tag, uint32_t ram_start);
+
+/**@brief Function for getting the SDUs queued in the SoftDevice, 0 if there is no channel. */
+uint8_t l2cap_bulk_tx_queue_size(void);
+
+/**@brief Function for setting the event handler and the accl_arr values that can be downloaded.
+ *
+ * @param[in] evt_handler   Event handler. Can be NULL.
+ * @param[in] p_recorded    Number of accl_arr values recorded, read at every request (arr_counter).
+ */
+void l2cap_bulk_init(l2cap_bulk_evt_handler_t evt_handler, uint16_t const * p_recorded);
+
+/**@brief Function for checking whether a download runs on a link. */
+bool l2cap_bulk_active(uint16_t conn_handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // L2CAP_BULK_H__
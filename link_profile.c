@@ -0,0 +1,241 @@
+#include "sdk_common.h"
+#include "link_profile.h"
+#include <string.h>
+#include "app_error.h"
+#include "nrf_sdh_ble.h"
+#include "nrf_log.h"
+
+/**@brief Runtime settings of one profile. */
+typedef struct
+{
+    bool    conn_evt_ext;
+    uint8_t phys;
+} profile_cfg_t;
+
+static profile_cfg_t const m_profiles[] =
+{
+    [LINK_PROFILE_LIVE] = {.conn_evt_ext = false, .phys = BLE_GAP_PHY_AUTO},
+    [LINK_PROFILE_BULK] = {.conn_evt_ext = true,  .phys = BLE_GAP_PHY_2MBPS},
+};
+
+/**@brief Profile of one link. */
+typedef struct
+{
+    bool           connected;
+    uint16_t       conn_handle;
+    link_profile_t profile;
+} link_t;
+
+static link_t  m_links[NRF_SDH_BLE_PERIPHERAL_LINK_COUNT];
+static uint8_t m_hvn_tx_queue_size = BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT;  /**< Queue size configured in the SoftDevice. */
+
+
+/**@brief Function for finding a link, or a free slot if conn_handle is BLE_CONN_HANDLE_INVALID. */
+static link_t * link_find(uint16_t conn_handle)
+{
+    for (uint32_t i = 0; i < ARRAY_SIZE(m_links); i++)
+    {
+        if (m_links[i].connected ? (m_links[i].conn_handle == conn_handle)
+                                 : (conn_handle == BLE_CONN_HANDLE_INVALID))
+        {
+            return &m_links[i];
+        }
+    }
+    return NULL;
+}
+
+
+static link_profile_t link_profile(uint16_t conn_handle)
+{
+    link_t const * p_link = (conn_handle == BLE_CONN_HANDLE_INVALID) ? NULL : link_find(conn_handle);
+
+    return (p_link != NULL) ? p_link->profile : LINK_PROFILE_LIVE;
+}
+
+
+static ret_code_t conn_evt_ext_set(bool enable)
+{
+    ble_opt_t opt;
+
+    memset(&opt, 0, sizeof(opt));
+    opt.common_opt.conn_evt_ext.enable = enable;
+
+    return sd_ble_opt_set(BLE_COMMON_OPT_CONN_EVT_EXT, &opt);
+}
+
+
+/**@brief Function for turning event extension on while any link wants it. */
+static ret_code_t conn_evt_ext_apply(void)
+{
+    bool enable = false;
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(m_links); i++)
+    {
+        enable |= m_links[i].connected && m_profiles[m_links[i].profile].conn_evt_ext;
+    }
+    return conn_evt_ext_set(enable);
+}
+
+
+static ret_code_t profile_apply(link_t const * p_link)
+{
+    ret_code_t           err_code;
+    ble_gap_phys_t const phys =
+    {
+        .tx_phys = m_profiles[p_link->profile].phys,
+        .rx_phys = m_profiles[p_link->profile].phys,
+    };
+
+    err_code = conn_evt_ext_apply();
+    VERIFY_SUCCESS(err_code);
+
+    err_code = sd_ble_gap_phy_update(p_link->conn_handle, &phys);
+    if (err_code == NRF_ERROR_BUSY)
+    {
+        // A PHY procedure is running; the answer to the next peer request uses the new profile.
+        return NRF_SUCCESS;
+    }
+    return err_code;
+}
+
+
+static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
+{
+    ret_code_t err_code;
+    link_t   * p_link;
+    uint16_t   conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+
+    UNUSED_PARAMETER(p_context);
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            p_link = link_find(BLE_CONN_HANDLE_INVALID);
+            if (p_link != NULL)
+            {
+                p_link->connected   = true;
+                p_link->conn_handle = conn_handle;
+                p_link->profile     = LINK_PROFILE_LIVE;
+            }
+            err_code = conn_evt_ext_apply();
+            APP_ERROR_CHECK(err_code);
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            p_link = link_find(conn_handle);
+            if (p_link != NULL)
+            {
+                p_link->connected = false;
+            }
+            err_code = conn_evt_ext_apply();
+            APP_ERROR_CHECK(err_code);
+            break;
+
+        case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
+        {
+            NRF_LOG_DEBUG("PHY update request.");
+            link_profile_t       profile = link_profile(conn_handle);
+            ble_gap_phys_t const phys    =
+            {
+                .rx_phys = m_profiles[profile].phys,
+                .tx_phys = m_profiles[profile].phys,
+            };
+            err_code = sd_ble_gap_phy_update(conn_handle, &phys);
+            APP_ERROR_CHECK(err_code);
+        } break;
+
+        case BLE_GAP_EVT_PHY_UPDATE:
+            NRF_LOG_INFO("PHY tx %d, rx %d (status %d).",
+                         p_ble_evt->evt.gap_evt.params.phy_update.tx_phy,
+                         p_ble_evt->evt.gap_evt.params.phy_update.rx_phy,
+                         p_ble_evt->evt.gap_evt.params.phy_update.status);
+            break;
+
+        default:
+            break;
+    }
+}
+
+NRF_SDH_BLE_OBSERVER(m_link_profile_obs, LINK_PROFILE_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
+
+
+static ret_code_t hvn_tx_queue_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start, uint8_t size)
+{
+    ret_code_t err_code;
+    ble_cfg_t  ble_cfg;
+
+    memset(&ble_cfg, 0, sizeof(ble_cfg));
+    ble_cfg.conn_cfg.conn_cfg_tag                            = conn_cfg_tag;
+    ble_cfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = size;
+
+    err_code = sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &ble_cfg, ram_start);
+    if (err_code == NRF_SUCCESS)
+    {
+        m_hvn_tx_queue_size = size;
+    }
+    return err_code;
+}
+
+
+ret_code_t link_profile_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start)
+{
+    ret_code_t err_code = hvn_tx_queue_cfg_set(conn_cfg_tag, ram_start, LINK_PROFILE_HVN_TX_QUEUE_SIZE);
+
+    if (err_code == NRF_ERROR_NO_MEM)
+    {
+        NRF_LOG_WARNING("No RAM for %d queued notifications per link, trying %d.",
+                        LINK_PROFILE_HVN_TX_QUEUE_SIZE, LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN);
+        err_code = hvn_tx_queue_cfg_set(conn_cfg_tag, ram_start, LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN);
+    }
+    if (err_code == NRF_ERROR_NO_MEM)
+    {
+        NRF_LOG_WARNING("Keeping the default of %d queued notification per link.",
+                        BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT);
+        m_hvn_tx_queue_size = BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT;
+        err_code            = NRF_SUCCESS;
+    }
+    return err_code;
+}
+
+
+ret_code_t link_profile_cfg_reduce(uint8_t conn_cfg_tag, uint32_t ram_start)
+{
+    if (m_hvn_tx_queue_size <= LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN)
+    {
+        // Nothing left to give up.
+        return NRF_SUCCESS;
+    }
+    return hvn_tx_queue_cfg_set(conn_cfg_tag, ram_start, LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN);
+}
+
+
+uint8_t link_profile_hvn_tx_queue_size(void)
+{
+    return m_hvn_tx_queue_size;
+}
+
+
+ret_code_t link_profile_set(uint16_t conn_handle, link_profile_t profile)
+{
+    link_t * p_link = (conn_handle == BLE_CONN_HANDLE_INVALID) ? NULL : link_find(conn_handle);
+
+    if (p_link == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    if (profile == p_link->profile)
+    {
+        return NRF_SUCCESS;
+    }
+
+    p_link->profile = profile;
+    NRF_LOG_INFO("Link profile %s on link %d.", (profile == LINK_PROFILE_BULK) ? "bulk" : "live", conn_handle);
+
+    return profile_apply(p_link);
+}
+
+
+link_profile_t link_profile_get(uint16_t conn_handle)
+{
+    return link_profile(conn_handle);
+}
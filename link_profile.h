@@ -0,0 +1,95 @@
+#ifndef LINK_PROFILE_H__
+#define LINK_PROFILE_H__
+
+#include <stdint.h>
+#include "ble.h"
+#include "sdk_errors.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Radio settings of the link for live streaming and for bulk transfers.
+ *
+ * @details The SoftDevice configuration is shared by both profiles: NRF_SDH_BLE_GAP_EVENT_LENGTH
+ *          reserves 15 ms per connection event and LINK_PROFILE_HVN_TX_QUEUE_SIZE notifications
+ *          can be queued in the SoftDevice. At runtime the profile switches connection event
+ *          length extension and the preferred PHY:
+ *
+ *          - Live: no event extension, PHY left to the peer. The few notifications per interval
+ *            go out at the start of the event and the radio is off for the rest of it.
+ *          - Bulk: event extension on, 2M PHY requested and preferred when the peer asks. Events
+ *            run as long as there is data, up to the next connection event.
+ *
+ *          Link model, 244-byte notifications with DLE (251-byte LL payload), one empty
+ *          acknowledgement per packet, 150 us inter frame space:
+ *
+ *          PHY   packet + ack   packets in 7.5 ms   throughput at 7.5 ms
+ *          1M    2468 us        3                   97 kB/s
+ *          2M    1392 us        5                   162 kB/s
+ *
+ *          The bulk profile on a 7.5 ms interval reaches the 2M row. In the live profile a
+ *          connection event ends after the reserved 15 ms at the latest, less if the SoftDevice
+ *          schedules other activity. The bulk transfer logs the throughput it reaches on the
+ *          device when it completes.
+ *
+ *          The PHY is set per link. Event length extension is a SoftDevice-wide option, it is on
+ *          while any link uses the bulk profile; live links keep few notifications per event, so
+ *          their events stay short anyway.
+ */
+
+#define LINK_PROFILE_HVN_TX_QUEUE_SIZE  8                                   /**< Notifications queued in the SoftDevice per link. */
+#define LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN 2                                /**< Queue size if the SoftDevice RAM is short; still one notification behind the one on air. */
+#define LINK_PROFILE_BLE_OBSERVER_PRIO  2                                   /**< Priority of the BLE event observer. */
+
+/**@brief Link profiles. */
+typedef enum
+{
+    LINK_PROFILE_LIVE,                                                      /**< Low power, for live streaming. */
+    LINK_PROFILE_BULK,                                                      /**< High throughput, for bulk transfers. */
+} link_profile_t;
+
+/**@brief Function for adding the profile settings to the SoftDevice configuration.
+ *
+ * @details Call after nrf_sdh_ble_default_cfg_set and before nrf_sdh_ble_enable. If the RAM
+ *          given to the SoftDevice is too small for LINK_PROFILE_HVN_TX_QUEUE_SIZE, the queue gets
+ *          LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN notifications, or keeps the SoftDevice default.
+ *
+ * @param[in] conn_cfg_tag  Connection configuration tag used by the application.
+ * @param[in] ram_start     Application RAM start address.
+ *
+ * @return NRF_SUCCESS, or an error code from sd_ble_cfg_set.
+ */
+ret_code_t link_profile_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start);
+
+/**@brief Function for configuring the smaller queue after nrf_sdh_ble_enable ran out of RAM.
+ *
+ * @details Does nothing if the queue is LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN or smaller already.
+ *
+ * @return NRF_SUCCESS, or an error code from sd_ble_cfg_set.
+ */
+ret_code_t link_profile_cfg_reduce(uint8_t conn_cfg_tag, uint32_t ram_start);
+
+/**@brief Function for getting the notifications queued per link in the SoftDevice. */
+uint8_t link_profile_hvn_tx_queue_size(void);
+
+/**@brief Function for switching the profile of a link.
+ *
+ * @details Every new connection starts with the live profile.
+ *
+ * @retval NRF_SUCCESS              Profile applied.
+ * @retval NRF_ERROR_NOT_FOUND      No such link.
+ * @return Other error codes from the SoftDevice.
+ */
+ret_code_t link_profile_set(uint16_t conn_handle, link_profile_t profile);
+
+/**@brief Function for getting the profile of a link. */
+link_profile_t link_profile_get(uint16_t conn_handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LINK_PROFILE_H__
@@ -0,0 +1,22 @@
+#include "sdk_common.h"
+#include "local_clock.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+static uint64_t m_ticks;                                                    /**< RTC ticks since boot. */
+static uint32_t m_last_cnt;                                                 /**< RTC counter at the previous call. */
+
+
+uint32_t local_clock_ms(void)
+{
+    uint64_t ticks;
+
+    CRITICAL_REGION_ENTER();
+    uint32_t cnt = app_timer_cnt_get();
+    m_ticks     += app_timer_cnt_diff_compute(cnt, m_last_cnt);
+    m_last_cnt   = cnt;
+    ticks        = m_ticks;
+    CRITICAL_REGION_EXIT();
+
+    return (uint32_t)((ticks * 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / APP_TIMER_CLOCK_FREQ);
+}
@@ -0,0 +1,22 @@
+#ifndef LOCAL_CLOCK_H__
+#define LOCAL_CLOCK_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief Function for getting the time since boot in milliseconds.
+ *
+ * @details Extends the 24-bit app_timer RTC counter, so it has to be called at least once per RTC
+ *          overflow period (512 s with the default prescaler). The sampling timer does that.
+ *          Requires APP_TIMER_KEEPS_RTC_ACTIVE so the counter also runs with no timer active.
+ */
+uint32_t local_clock_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOCAL_CLOCK_H__
@@ -64,6 +64,8 @@
 #include "ble_advdata.h"
 #include "ble_advertising.h"
 #include "ble_conn_params.h"
+#include "ble_rscs.h"
+#include "ble_sc_ctrlpt.h"
 #include "nrf_sdh.h"
 #include "nrf_sdh_soc.h"
 #include "nrf_sdh_ble.h"
@@ -76,11 +78,28 @@
 #include "nrf_ble_gatt.h"
 #include "nrf_ble_qwr.h"
 #include "nrf_pwr_mgmt.h"
+#include "hardfault.h"
 
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
 #include "ble_cus.h"
+#include "sample_pool.h"
+#include "sample_soa.h"
+#include "flash_log.h"
+#include "local_clock.h"
+#include "sample_block.h"
+#include "time_sync.h"
+#include "session_index.h"
+#include "link_profile.h"
+#include "conn_policy.h"
+#include "crash_buffer.h"
+#include "running_metrics.h"
+#include "broadcast.h"
+#include "l2cap_bulk.h"
+#include "peer_state.h"
+#include "stride_events.h"
+#include "session_stats.h"
 #include "nrf_twi_mngr.h"
 #include "nrf_delay.h"
 #include <math.h>
@@ -106,8 +125,10 @@
 #define NEXT_CONN_PARAMS_UPDATE_DELAY   APP_TIMER_TICKS(30000)                  /**< Time between each call to sd_ble_gap_conn_param_update after the first call (30 seconds). */
 #define MAX_CONN_PARAMS_UPDATE_COUNT    3                                       /**< Number of attempts before giving up the connection parameter negotiation. */
 
-#define NOTIFICATION_INTERVAL           APP_TIMER_TICKS(20)     
-#define NOTIFICATION_INTERVAL1          APP_TIMER_TICKS(500)     
+#define METRICS_INTERVAL                APP_TIMER_TICKS(RUNNING_METRICS_UPDATE_INTERVAL_MS) /**< Running metrics interval. */
+
+#define SESSION_SUMMARY_FILE_ID         0x5E55                                  /**< FDS file of the session summary, below the peer manager files. */
+#define SESSION_SUMMARY_REC_KEY         0x0001                                  /**< FDS record of the session summary; changes with session_stats_summary_t. */
 
 #define SEC_PARAM_BOND                  1                                       /*< Perform bonding. */
 #define SEC_PARAM_MITM                  0                                       /**< Man In The Middle protection not required. */
@@ -127,12 +148,31 @@ NRF_TWI_MNGR_DEF(m_nrf_twi_mngr, MAX_PENDING_TRANSACTIONS, TWI_INSTANCE_ID);
   
 
 NRF_BLE_GATT_DEF(m_gatt);
-NRF_BLE_QWR_DEF(m_qwr);                                                         /**< GATT module instance. */
+NRF_BLE_QWRS_DEF(m_qwr, NRF_SDH_BLE_TOTAL_LINK_COUNT);                          /**< Queued Write module instances, one per link. */
 BLE_CUS_DEF(m_cus);                                                             /**< Context for the Queued Write module.*/
+BLE_RSCS_DEF(m_rscs);                                                           /**< Running Speed and Cadence Service instance. */
 BLE_ADVERTISING_DEF(m_advertising);                                             /**< Advertising module instance. */
 
 APP_TIMER_DEF(m_notification_timer_id);
 APP_TIMER_DEF(m_notification_timer_id1);
+APP_TIMER_DEF(m_metrics_timer_id);
+
+static ble_sc_ctrlpt_t m_sc_ctrlpt;                                             /**< SC Control Point of the RSCS. */
+static bool            m_rsc_meas_subscribed;                                   /**< The client enabled RSC Measurement notifications. */
+static uint8_t         m_range_scale = 1;                                       /**< Scales samples of the accelerometer range to 1/1024 g (2 g range). */
+static bool            m_range_pending;                                         /**< A sensor range change waits for the TWI. */
+static bool            m_range_restore;                                         /**< The pending range change puts back the range the sensor had. */
+static uint16_t        m_range_conn_handle = BLE_CONN_HANDLE_INVALID;           /**< Link of the central that asked for the pending range change. */
+static uint32_t        m_db_hash;                                               /**< Hash of the attribute table, see peer_state.h. */
+static session_stats_summary_t m_session_record;                                /**< Summary being stored; FDS writes from it. */
+static bool            m_session_store_pending;                                 /**< The summary waits for garbage collection. */
+static uint16_t        m_att_mtu_max = NRF_SDH_BLE_GATT_MAX_MTU_SIZE;           /**< ATT MTU configured in the SoftDevice, the default one after a RAM fallback. */
+
+static void sc_ctrlpt_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context);
+static void rscs_subscription_refresh(void);
+static void peer_state_save(uint16_t conn_handle);
+static ret_code_t sensor_range_set(uint8_t range_g, uint16_t conn_handle, bool restore);
+NRF_SDH_BLE_OBSERVER(m_sc_ctrlpt_obs, BLE_RSCS_BLE_OBSERVER_PRIO, sc_ctrlpt_on_ble_evt, &m_sc_ctrlpt);
 
 
 // static uint8_t m_custom_value = 0;s
@@ -195,6 +235,11 @@ void read_all_cb(ret_code_t result, void * p_user_data)
     {
          zAccl -= 4096;
     }
+
+    // Same unit in every range, so power, metrics and the history do not depend on it.
+    xAccl *= m_range_scale;
+    yAccl *= m_range_scale;
+    zAccl *= m_range_scale;
     
 
     NRF_LOG_RAW_INFO( "X: %d ", xAccl);
@@ -227,6 +272,78 @@ static void read_all(void)
 
 }
 
+static void sensor_range_cb(ret_code_t result, void * p_user_data)
+{
+    uint8_t range_g = (uint8_t)(uintptr_t)p_user_data;
+
+    m_range_pending = false;
+    if (result == NRF_SUCCESS)
+    {
+        m_range_scale = range_g / 2;
+        return;
+    }
+
+    NRF_LOG_WARNING("Sensor range %d g not set: %d.", range_g, (int)result);
+    if (m_range_restore)
+    {
+        NRF_LOG_ERROR("Sensor range %d g not restored, the sensor may be in standby.", range_g);
+        return;
+    }
+
+    // The setting and the stored peer state go back to the range the samples are scaled for.
+    m_cus.config.range_g = m_range_scale * 2;
+    if (m_range_conn_handle != BLE_CONN_HANDLE_INVALID)
+    {
+        peer_state_save(m_range_conn_handle);
+    }
+
+    // The transfers may have stopped after the standby write: write the old range and the active
+    // mode again.
+    ret_code_t err_code = sensor_range_set(m_cus.config.range_g, m_range_conn_handle, true);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_ERROR("Sensor range %d g not restored: 0x%x.", m_cus.config.range_g, err_code);
+    }
+}
+
+/**@brief Function for switching the accelerometer to another full scale range.
+ *
+ * @details Samples keep the unit of the 2 g range once the sensor runs in the new one. If the
+ *          transaction fails, the setting goes back to the old range and the range is written
+ *          again, once.
+ *
+ * @param[in] range_g       Full scale range.
+ * @param[in] conn_handle   Link of the central whose stored settings hold the range.
+ * @param[in] restore       The range is the one the sensor had before a failed change.
+ */
+static ret_code_t sensor_range_set(uint8_t range_g, uint16_t conn_handle, bool restore)
+{
+    static nrf_twi_mngr_transaction_t NRF_TWI_MNGR_BUFFER_LOC_IND transaction =
+    {
+        .callback            = sensor_range_cb,
+        .p_transfers         = mma8452_range_transfers,
+        .number_of_transfers = MMA8452_RANGE_TRANSFER_COUNT
+    };
+    ret_code_t err_code;
+
+    // The transaction and its register buffer are reused.
+    if (m_range_pending)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    if (!mma8452_range_prepare(range_g))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    transaction.p_user_data = (void *)(uintptr_t)range_g;
+    m_range_restore         = restore;
+    m_range_conn_handle     = conn_handle;
+    err_code = nrf_twi_mngr_schedule(&m_nrf_twi_mngr, &transaction);
+    m_range_pending = (err_code == NRF_SUCCESS);
+    return err_code;
+}
+
 static void twi_config(void)
 {
     uint32_t err_code;
@@ -245,20 +362,43 @@ static void twi_config(void)
     NRF_LOG_RAW_INFO("\r\nWow. \r\n");
 }
 
-static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;         
 static ble_uuid_t m_adv_uuids[] =                                
 {
+    {BLE_UUID_RUNNING_SPEED_AND_CADENCE, BLE_UUID_TYPE_BLE},
     {CUSTOM_SERVICE_UUID, BLE_UUID_TYPE_VENDOR_BEGIN }
 };
 
 
 static void advertising_start(bool erase_bonds);
+static void advertising_resume(void);
 
 void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
 {
     app_error_handler(DEAD_BEEF, line_num, p_file_name);
 }
 
+/**@brief Function for handling fatal errors.
+ *
+ * @details Overrides the SDK handler: seals the crash buffer so the last samples survive the
+ *          reset, then resets instead of halting.
+ */
+void app_error_fault_handler(uint32_t id, uint32_t pc, uint32_t info)
+{
+    crash_buffer_seal(CRASH_REASON_ERROR, id, pc, local_clock_ms());
+
+    NRF_LOG_ERROR("Fatal error 0x%x at 0x%x, resetting.", id, pc);
+    NRF_LOG_FINAL_FLUSH();
+    NVIC_SystemReset();
+}
+
+/**@brief Function for handling a HardFault, called by the SDK HardFault handler.
+ */
+void HardFault_process(HardFault_stack_t * p_stack)
+{
+    crash_buffer_seal(CRASH_REASON_HARDFAULT, 0, p_stack->pc, local_clock_ms());
+    NVIC_SystemReset();
+}
+
 static void pm_evt_handler(pm_evt_t const * p_evt)
 {
     ret_code_t err_code;
@@ -338,10 +478,15 @@ static void pm_evt_handler(pm_evt_t const * p_evt)
             APP_ERROR_CHECK(p_evt->params.error_unexpected.error);
         } break;
 
+        case PM_EVT_LOCAL_DB_CACHE_APPLIED:
+            // CCCDs of the bonded peer were restored.
+            ble_cus_subscriptions_refresh(&m_cus, p_evt->conn_handle);
+            rscs_subscription_refresh();
+            break;
+
         case PM_EVT_CONN_SEC_START:
         case PM_EVT_PEER_DATA_UPDATE_SUCCEEDED:
         case PM_EVT_PEER_DELETE_SUCCEEDED:
-        case PM_EVT_LOCAL_DB_CACHE_APPLIED:
         case PM_EVT_LOCAL_DB_CACHE_APPLY_FAILED:
             // This can happen when the local DB has changed.
         case PM_EVT_SERVICE_CHANGED_IND_SENT:
@@ -352,6 +497,37 @@ static void pm_evt_handler(pm_evt_t const * p_evt)
 }
 
 
+/**@brief Function for passing the state of every link to the connection parameter policy.
+ */
+static void conn_policy_evaluate(void)
+{
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        ble_cus_link_t    * p_link = &m_cus.links[i];
+        conn_policy_input_t input  =
+        {
+            .conn_handle     = p_link->conn_handle,
+            .bulk_active     = ble_cus_link_transfer_active(p_link)
+                               || l2cap_bulk_active(p_link->conn_handle),
+            .live_subscribed = (ble_cus_link_subscriptions(&m_cus, p_link) & BLE_CUS_SUB_LIVE) != 0,
+            .queue_depth     = ble_cus_tx_queue_depth(&m_cus, p_link->conn_handle),
+        };
+
+        conn_policy_update(&p_link->policy, &input);
+    }
+}
+
+
+/**@brief Function for checking whether live metrics are broadcast.
+ *
+ * @details The peripheral only advertises while it has a free link.
+ */
+static bool broadcasting(void)
+{
+    return broadcast_is_started() && (ble_cus_link_count(&m_cus) < BLE_CUS_LINK_COUNT);
+}
+
+
 /**@brief Function for handling the Battery measurement timer timeout.
  *
  * @details This function will be called each time the battery level measurement timer expires.
@@ -361,8 +537,226 @@ static void pm_evt_handler(pm_evt_t const * p_evt)
  */
 static void notification_timeout_handler1(void * p_context)
 {
-    power_update(&m_cus);
+    if (ble_cus_subscribed(&m_cus, BLE_CUS_SUB_POWER | BLE_CUS_SUB_METRICS) || broadcasting())
+    {
+        power_update(&m_cus);
+    }
+    conn_policy_evaluate();
+}
+
+/**@brief Function for sending the running metrics as an RSC Measurement.
+ *
+ * @details The SDK encodes the measurement straight into the notification buffer.
+ */
+static void rsc_measurement_send(running_metrics_t const * p_metrics)
+{
+    ret_code_t      err_code;
+    ble_rscs_meas_t meas;
+
+    if (!m_rsc_meas_subscribed)
+    {
+        return;
+    }
+
+    meas.is_inst_stride_len_present = true;
+    meas.is_total_distance_present  = true;
+    meas.is_running                 = p_metrics->running;
+    meas.inst_speed                 = ((uint32_t)p_metrics->speed_cm_s * 256) / 100;   // 1/256 m/s.
+    meas.inst_cadence               = MIN(p_metrics->cadence, UINT8_MAX);
+    meas.inst_stride_length         = 2 * p_metrics->step_length_cm;                    // A stride is two steps.
+    meas.total_distance             = p_metrics->distance_cm / 10;                      // 1/10 m.
+
+    err_code = ble_rscs_measurement_send(&m_rscs, &meas);
+    if ((err_code != NRF_SUCCESS) &&
+        (err_code != NRF_ERROR_INVALID_STATE) &&
+        (err_code != NRF_ERROR_RESOURCES) &&
+        (err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING))
+    {
+        APP_ERROR_HANDLER(err_code);
+    }
+}
+
+
+/**@brief Function for sending all metrics in one metrics frame.
+ */
+static void metrics_frame_send(running_metrics_t const * p_metrics)
+{
+    if (!ble_cus_subscribed(&m_cus, BLE_CUS_SUB_METRICS))
+    {
+        return;
+    }
+
+    metrics_frame_t frame =
+    {
+        .flags           = METRICS_FRAME_POWER | METRICS_FRAME_CADENCE | METRICS_FRAME_GCT |
+                           METRICS_FRAME_VERTICAL_OSC | METRICS_FRAME_STEPS,
+        .power           = m_cus.power,
+        .cadence         = MIN(p_metrics->cadence, UINT8_MAX),
+        .gct_ms          = p_metrics->gct_ms,
+        .vertical_osc_mm = p_metrics->vertical_osc_mm,
+        .steps           = p_metrics->steps,
+    };
+
+    if (time_sync_is_synced())
+    {
+        frame.flags    |= METRICS_FRAME_TIMESTAMP;
+        frame.timestamp = time_sync_stamp(local_clock_ms());
+    }
+
+    // Dropped notifications are counted by the TX queue.
+    (void)ble_cus_metrics_update(&m_cus, &frame);
+}
+
+
+STATIC_ASSERT((sizeof(session_stats_summary_t) % sizeof(uint32_t)) == 0);
+
+
+/**@brief Function for storing the summary in m_session_record, replacing the one stored before.
+ */
+static void session_summary_store(void)
+{
+    fds_record_desc_t desc;
+    fds_find_token_t  token;
+    ret_code_t        err_code;
+    fds_record_t      record =
+    {
+        .file_id           = SESSION_SUMMARY_FILE_ID,
+        .key               = SESSION_SUMMARY_REC_KEY,
+        .data.p_data       = &m_session_record,
+        .data.length_words = sizeof(m_session_record) / sizeof(uint32_t),
+    };
+
+    memset(&token, 0, sizeof(token));
+    if (fds_record_find(SESSION_SUMMARY_FILE_ID, SESSION_SUMMARY_REC_KEY, &desc, &token) == NRF_SUCCESS)
+    {
+        err_code = fds_record_update(&desc, &record);
+    }
+    else
+    {
+        err_code = fds_record_write(NULL, &record);
+    }
+
+    // Stored again once the garbage collection is done.
+    m_session_store_pending = (err_code == FDS_ERR_NO_SPACE_IN_FLASH);
+    if (m_session_store_pending)
+    {
+        (void)fds_gc();
+    }
+    else if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("Session summary not stored: 0x%x.", err_code);
+    }
+}
+
+
+/**@brief Function for restoring the summary stored by session_summary_store.
+ */
+static void session_summary_load(void)
+{
+    fds_record_desc_t  desc;
+    fds_find_token_t   token;
+    fds_flash_record_t flash_record;
+
+    memset(&token, 0, sizeof(token));
+    if ((fds_record_find(SESSION_SUMMARY_FILE_ID, SESSION_SUMMARY_REC_KEY, &desc, &token) != NRF_SUCCESS)
+        || (fds_record_open(&desc, &flash_record) != NRF_SUCCESS))
+    {
+        return;
+    }
+
+    if (flash_record.p_header->length_words == sizeof(m_session_record) / sizeof(uint32_t))
+    {
+        session_stats_summary_t summary;
+
+        memcpy(&summary, flash_record.p_data, sizeof(summary));
+        session_stats_restore(&summary);
+        if (!session_stats_active())
+        {
+            ble_cus_session_stats_set(&m_cus, &summary);
+        }
+        NRF_LOG_INFO("Session %d restored.", summary.id);
+    }
+    (void)fds_record_close(&desc);
+}
+
+
+static void fds_evt_handler(fds_evt_t const * p_evt)
+{
+    switch (p_evt->id)
+    {
+        case FDS_EVT_INIT:
+            if (p_evt->result == NRF_SUCCESS)
+            {
+                session_summary_load();
+            }
+            break;
+
+        case FDS_EVT_GC:
+            if (m_session_store_pending)
+            {
+                session_summary_store();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**@brief Function for ending an idle session and serving the summary.
+ *
+ * @details The summary of a session is stored once the session ended, so it is one flash write per
+ *          session. A session going on is lost on a reset.
+ */
+static void session_summary_update(void)
+{
+    session_stats_summary_t summary;
+    session_stats_tick_t    tick = session_stats_tick(local_clock_ms());
+
+    if (!session_stats_active() && (tick == SESSION_STATS_NONE))
+    {
+        return;
+    }
+
+    ble_cus_session_stats_set(&m_cus, session_stats_get(&summary) ? &summary : NULL);
+
+    if (tick == SESSION_STATS_ENDED)
+    {
+        NRF_LOG_INFO("Session %d ended: %d steps in %d s.", summary.id, summary.steps,
+                     summary.moving_ms / 1000);
+        m_session_record = summary;
+        session_summary_store();
+    }
+}
+
+
+/**@brief Function for handling the metrics timer timeout.
+ *
+ * @details Updates the running metrics from the latest strides and sends them. Also sends the
+ *          strides that waited long enough and updates the session summary.
+ */
+static void metrics_timeout_handler(void * p_context)
+{
+    running_metrics_t const * p_metrics;
+
+    UNUSED_PARAMETER(p_context);
+
+    session_summary_update();
+    ble_cus_stride_update(&m_cus);
+    running_metrics_update(local_clock_ms());
+
+    if (!m_rsc_meas_subscribed && !ble_cus_subscribed(&m_cus, BLE_CUS_SUB_METRICS) && !broadcasting())
+    {
+        return;
+    }
+
+    p_metrics = running_metrics_get();
+
+    rsc_measurement_send(p_metrics);
+    metrics_frame_send(p_metrics);
 }
+
 static void notification_timeout_handler(void * p_context)
 {
     read_all();
@@ -371,35 +765,84 @@ static void notification_timeout_handler(void * p_context)
 
     if(m_cus.arr_counter!=9999)
     {
-    m_cus.accl_arr[m_cus.arr_counter]=xAccl;
-    m_cus.arr_counter = (m_cus.arr_counter+1)%10000;
-    m_cus.accl_arr[m_cus.arr_counter]=yAccl;
-    m_cus.arr_counter = (m_cus.arr_counter+1)%10000;
-    m_cus.accl_arr[m_cus.arr_counter]=zAccl;
-    m_cus.arr_counter = (m_cus.arr_counter+1)%10000;
+    sample_pool_accl[m_cus.arr_counter]=xAccl;
+    m_cus.arr_counter = (m_cus.arr_counter+1)%SAMPLE_POOL_ACCL_LEN;
+    sample_pool_accl[m_cus.arr_counter]=yAccl;
+    m_cus.arr_counter = (m_cus.arr_counter+1)%SAMPLE_POOL_ACCL_LEN;
+    sample_pool_accl[m_cus.arr_counter]=zAccl;
+    m_cus.arr_counter = (m_cus.arr_counter+1)%SAMPLE_POOL_ACCL_LEN;
     }
     
-    m_cus.buff[m_cus.buff_counter]=xAccl;
-    m_cus.buff_counter = (m_cus.buff_counter+1)%450;
-    m_cus.buff[m_cus.buff_counter]=yAccl;
-    m_cus.buff_counter = (m_cus.buff_counter+1)%450;
-    m_cus.buff[m_cus.buff_counter]=zAccl;
-    m_cus.buff_counter = (m_cus.buff_counter+1)%450;
-
-    m_cus.package[package_counter] = xAccl;
-    m_cus.package[package_counter+1] = yAccl;
-    m_cus.package[package_counter+2] = zAccl;
+    sample_pool_window[m_cus.buff_counter]=xAccl;
+    m_cus.buff_counter = (m_cus.buff_counter+1)%SAMPLE_POOL_WINDOW_LEN;
+    sample_pool_window[m_cus.buff_counter]=yAccl;
+    m_cus.buff_counter = (m_cus.buff_counter+1)%SAMPLE_POOL_WINDOW_LEN;
+    sample_pool_window[m_cus.buff_counter]=zAccl;
+    m_cus.buff_counter = (m_cus.buff_counter+1)%SAMPLE_POOL_WINDOW_LEN;
+
+    sample_soa_push(xAccl, yAccl, zAccl);
+    crash_buffer_sample_add(xAccl, yAccl, zAccl);
+
+    sample_pool_package[package_counter] = xAccl;
+    sample_pool_package[package_counter+1] = yAccl;
+    sample_pool_package[package_counter+2] = zAccl;
     package_counter = package_counter + 3;
 
+    ble_cus_delta_update(&m_cus, xAccl, yAccl, zAccl);
+
+    // Strides are kept for clients to catch up, summed up per session and counted into the steps
+    // and the distance of the RSC Measurement, so they are detected without a client too.
+    if (stride_events_push(xAccl, yAccl, zAccl, local_clock_ms()))
+    {
+        stride_events_record_t stride;
+
+        if (stride_events_get(stride_events_head() - 1, &stride))
+        {
+            session_stats_stride_add(&stride);
+            running_metrics_stride_add(&stride);
+        }
+        ble_cus_stride_update(&m_cus);
+    }
+
     if(package_counter==9)
     {
         package_counter = 0;
         package_update(&m_cus);
     }
+
+    // The history is recorded while a session is, decimated so the flash log holds hours of
+    // sessions and its pages last (see sample_block.h).
+    if (session_stats_active())
+    {
+        uint32_t block;
+        uint32_t block_ms;
+
+        if (sample_block_sample_add(xAccl, yAccl, zAccl, local_clock_ms(), &block, &block_ms))
+        {
+            session_index_block_add(block, block_ms);
+        }
+    }
+    else
+    {
+        sample_block_record_stop();
+    }
+    // Everything above is kept for the history; power is only computed for a client.
+    if (ble_cus_subscribed(&m_cus, BLE_CUS_SUB_POWER | BLE_CUS_SUB_METRICS) || broadcasting())
+    {
     double temp_pow;
     temp_pow = ((sqrt(pow((double)xAccl,2)+(pow((double)yAccl,2) +(pow((double)zAccl,2))))));    
-    m_cus.pow_buf[m_cus.pow_buf_counter] = temp_pow;
-    m_cus.pow_buf_counter = (m_cus.pow_buf_counter+1)%50;
+    sample_pool_power[m_cus.pow_buf_counter] = temp_pow;
+    m_cus.pow_buf_counter = (m_cus.pow_buf_counter+1)%SAMPLE_POOL_POWER_LEN;
+    }
+
+    crash_buffer_state_t state =
+    {
+        .power           = m_cus.power,
+        .arr_counter     = m_cus.arr_counter,
+        .buff_counter    = m_cus.buff_counter,
+        .pow_buf_counter = m_cus.pow_buf_counter,
+    };
+    crash_buffer_state_set(&state);
 }
 
 /**@brief Function for the Timer initialization.
@@ -418,6 +861,9 @@ static void timers_init(void)
 
     err_code = app_timer_create(&m_notification_timer_id1, APP_TIMER_MODE_REPEATED, notification_timeout_handler1);
     APP_ERROR_CHECK(err_code);
+
+    err_code = app_timer_create(&m_metrics_timer_id, APP_TIMER_MODE_REPEATED, metrics_timeout_handler);
+    APP_ERROR_CHECK(err_code);
 }
 
 
@@ -451,11 +897,35 @@ static void gap_params_init(void)
 }
 
 
+/**@brief Function for handling events from the GATT module.
+ */
+static void gatt_evt_handler(nrf_ble_gatt_t * p_gatt, nrf_ble_gatt_evt_t const * p_evt)
+{
+    switch (p_evt->evt_id)
+    {
+        case NRF_BLE_GATT_EVT_ATT_MTU_UPDATED:
+            ble_cus_att_mtu_set(&m_cus, p_evt->conn_handle, p_evt->params.att_mtu_effective);
+            break;
+
+        case NRF_BLE_GATT_EVT_DATA_LENGTH_UPDATED:
+            NRF_LOG_INFO("Data length updated to %d bytes.", p_evt->params.data_length);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
 /**@brief Function for initializing the GATT module.
  */
 static void gatt_init(void)
 {
-    ret_code_t err_code = nrf_ble_gatt_init(&m_gatt, NULL);
+    ret_code_t err_code = nrf_ble_gatt_init(&m_gatt, gatt_evt_handler);
+    APP_ERROR_CHECK(err_code);
+
+    // The data length (NRF_SDH_BLE_GAP_DATA_LENGTH) is requested by the module on connection.
+    err_code = nrf_ble_gatt_att_mtu_periph_set(&m_gatt, m_att_mtu_max);
     APP_ERROR_CHECK(err_code);
 }
 
@@ -472,6 +942,269 @@ static void nrf_qwr_error_handler(uint32_t nrf_error)
     APP_ERROR_HANDLER(nrf_error);
 }
 
+/**@brief Function for tracking the RSC Measurement subscription.
+ */
+static void rscs_evt_handler(ble_rscs_t * p_rscs, ble_rscs_evt_t * p_evt)
+{
+    m_rsc_meas_subscribed = (p_evt->evt_type == BLE_RSCS_EVT_NOTIFICATION_ENABLED);
+}
+
+
+/**@brief Function for reading the RSC Measurement subscription back from its CCCD.
+ *
+ * @details CCCDs restored for a bonded peer are not written by the client.
+ */
+static void rscs_subscription_refresh(void)
+{
+    uint8_t           cccd[BLE_CCCD_VALUE_LEN] = {0};
+    ble_gatts_value_t value;
+
+    value.len     = sizeof(cccd);
+    value.offset  = 0;
+    value.p_value = cccd;
+
+    m_rsc_meas_subscribed = (m_rscs.conn_handle != BLE_CONN_HANDLE_INVALID)
+                            && (sd_ble_gatts_value_get(m_rscs.conn_handle,
+                                                       m_rscs.meas_handles.cccd_handle,
+                                                       &value) == NRF_SUCCESS)
+                            && ble_srv_is_notification_enabled(cccd);
+}
+
+
+/**@brief Function for handling the SC Control Point events.
+ *
+ * @details Only Set Cumulative Value is supported; it sets the total distance (1/10 m).
+ */
+static ble_scpt_response_t sc_ctrlpt_evt_handler(ble_sc_ctrlpt_t     * p_sc_ctrlpt,
+                                                 ble_sc_ctrlpt_evt_t * p_evt)
+{
+    switch (p_evt->evt_type)
+    {
+        case BLE_SC_CTRLPT_EVT_SET_CUMUL_VALUE:
+            running_metrics_distance_set(p_evt->params.cumulative_value * 10);
+            return BLE_SCPT_SUCCESS;
+
+        default:
+            return BLE_SCPT_OP_CODE_NOT_SUPPORTED;
+    }
+}
+
+
+static void sc_ctrlpt_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context)
+{
+    ble_sc_ctrlpt_on_ble_evt((ble_sc_ctrlpt_t *)p_context, p_ble_evt);
+}
+
+
+/**@brief Function for initializing the Running Speed and Cadence Service and its SC Control Point.
+ */
+static void rscs_init(void)
+{
+    ret_code_t           err_code;
+    ble_rscs_init_t      rscs_init;
+    ble_cs_ctrlpt_init_t sc_ctrlpt_init;
+
+    memset(&rscs_init, 0, sizeof(rscs_init));
+
+    rscs_init.evt_handler = rscs_evt_handler;
+    rscs_init.feature     = BLE_RSCS_FEATURE_INSTANT_STRIDE_LEN_BIT |
+                            BLE_RSCS_FEATURE_TOTAL_DISTANCE_BIT |
+                            BLE_RSCS_FEATURE_WALKING_OR_RUNNING_STATUS_BIT;
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&rscs_init.rsc_meas_attr_md.cccd_write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&rscs_init.rsc_meas_attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&rscs_init.rsc_meas_attr_md.write_perm);
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&rscs_init.rsc_feature_attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&rscs_init.rsc_feature_attr_md.write_perm);
+
+    err_code = ble_rscs_init(&m_rscs, &rscs_init);
+    APP_ERROR_CHECK(err_code);
+
+    memset(&sc_ctrlpt_init, 0, sizeof(sc_ctrlpt_init));
+
+    sc_ctrlpt_init.supported_functions    = BLE_SRV_SC_CTRLPT_CUM_VAL_OP_SUPPORTED;
+    sc_ctrlpt_init.service_handle         = m_rscs.service_handle;
+    sc_ctrlpt_init.evt_handler            = sc_ctrlpt_evt_handler;
+    sc_ctrlpt_init.sensor_location_handle = BLE_GATT_HANDLE_INVALID;
+    sc_ctrlpt_init.error_handler          = nrf_qwr_error_handler;
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sc_ctrlpt_init.sc_ctrlpt_attr_md.cccd_write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&sc_ctrlpt_init.sc_ctrlpt_attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sc_ctrlpt_init.sc_ctrlpt_attr_md.write_perm);
+
+    err_code = ble_sc_ctrlpt_init(&m_sc_ctrlpt, &sc_ctrlpt_init);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for switching the link profile of a link to what its transfers need.
+ *
+ * @details Bulk transfers run over GATT (Custom Service) and over L2CAP; the link keeps the bulk
+ *          profile while either of them runs.
+ */
+static void transfer_profile_update(uint16_t conn_handle)
+{
+    ret_code_t err_code;
+    bool       active = l2cap_bulk_active(conn_handle);
+
+    for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
+    {
+        if (m_cus.links[i].conn_handle == conn_handle)
+        {
+            active |= ble_cus_link_transfer_active(&m_cus.links[i]);
+        }
+    }
+
+    err_code = link_profile_set(conn_handle, active ? LINK_PROFILE_BULK : LINK_PROFILE_LIVE);
+    if (err_code != NRF_ERROR_NOT_FOUND)
+    {
+        // A transfer also ends when the link goes down.
+        APP_ERROR_CHECK(err_code);
+    }
+    conn_policy_evaluate();
+}
+
+
+/**@brief Function for handling L2CAP bulk events.
+ */
+static void l2cap_bulk_evt_handler(l2cap_bulk_evt_t const * p_evt)
+{
+    transfer_profile_update(p_evt->conn_handle);
+}
+
+
+/**@brief Function for restarting a repeated timer with a new interval. */
+static ret_code_t timer_restart(app_timer_id_t timer_id, uint32_t interval_ms)
+{
+    ret_code_t err_code = app_timer_stop(timer_id);
+
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = app_timer_start(timer_id, APP_TIMER_TICKS(interval_ms), NULL);
+    }
+    return err_code;
+}
+
+
+/**@brief Function for applying a setting changed through the Control Point.
+ */
+static void config_apply(ble_cus_evt_t * p_evt)
+{
+    ble_cus_config_t const * p_config = &m_cus.config;
+    ret_code_t               err_code = NRF_SUCCESS;
+
+    switch (p_evt->cp_opcode)
+    {
+        case BLE_CUS_CP_OP_SET_SAMPLE_RATE:
+            err_code = timer_restart(m_notification_timer_id, 1000 / p_config->sample_rate_hz);
+            break;
+
+        case BLE_CUS_CP_OP_SET_NOTIFY_INTERVAL:
+            err_code = timer_restart(m_notification_timer_id1, p_config->notify_interval_ms);
+            break;
+
+        case BLE_CUS_CP_OP_SET_SENSOR_RANGE:
+            err_code = sensor_range_set(p_config->range_g, p_evt->conn_handle, false);
+            break;
+
+        case BLE_CUS_CP_OP_SET_STREAMING_MODE:
+            conn_policy_evaluate();
+            break;
+
+        default:
+            // The power window is read by power_update.
+            break;
+    }
+
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("Setting 0x%02x not applied: 0x%x.", p_evt->cp_opcode, err_code);
+        p_evt->cp_failed = true;
+    }
+}
+
+
+/**@brief Function for storing the database hash and the settings with the bond of a peer.
+ */
+static void peer_state_save(uint16_t conn_handle)
+{
+    pm_peer_id_t peer_id;
+    peer_state_t state =
+    {
+        .db_hash = m_db_hash,
+        .config  = m_cus.config,
+    };
+
+    if ((pm_peer_id_get(conn_handle, &peer_id) != NRF_SUCCESS) || (peer_id == PM_PEER_ID_INVALID))
+    {
+        return;
+    }
+
+    ret_code_t err_code = peer_state_store(peer_id, &state);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("Peer %d state not stored: 0x%x.", peer_id, err_code);
+    }
+}
+
+
+/**@brief Function for resuming where a bonded peer left off.
+ *
+ * @details Sends Service Changed if the attribute table changed since the peer last saw it, and
+ *          restores the settings it made unless another central is connected and uses the
+ *          current ones. The CCCDs were restored by the peer manager already.
+ */
+static void peer_resume(uint16_t conn_handle)
+{
+    pm_peer_id_t peer_id;
+    peer_state_t state;
+
+    if ((pm_peer_id_get(conn_handle, &peer_id) != NRF_SUCCESS) || (peer_id == PM_PEER_ID_INVALID))
+    {
+        return;
+    }
+
+    if (!peer_state_load(peer_id, &state))
+    {
+        peer_state_save(conn_handle);
+        return;
+    }
+
+    if (state.db_hash != m_db_hash)
+    {
+        NRF_LOG_INFO("Attribute table changed, peer %d has to discover it again.", peer_id);
+        pm_local_database_has_changed();
+    }
+
+    if ((ble_cus_link_count(&m_cus) == 1) && ble_cus_config_valid(&state.config))
+    {
+        static uint8_t const ops[] =
+        {
+            BLE_CUS_CP_OP_SET_SAMPLE_RATE,
+            BLE_CUS_CP_OP_SET_POWER_WINDOW,
+            BLE_CUS_CP_OP_SET_NOTIFY_INTERVAL,
+            BLE_CUS_CP_OP_SET_SENSOR_RANGE,
+            BLE_CUS_CP_OP_SET_STREAMING_MODE,
+        };
+
+        m_cus.config = state.config;
+        for (uint32_t i = 0; i < ARRAY_SIZE(ops); i++)
+        {
+            ble_cus_evt_t evt = {.evt_type = BLE_CUS_EVT_CONFIG_CHANGED, .conn_handle = conn_handle, .cp_opcode = ops[i]};
+
+            config_apply(&evt);
+        }
+        NRF_LOG_INFO("Settings of peer %d restored.", peer_id);
+    }
+
+    if (state.db_hash != m_db_hash)
+    {
+        peer_state_save(conn_handle);
+    }
+}
+
+
 /**@brief Function for handling the Custom Service Service events.
  *
  * @details This function will be called for all Custom Service events which are passed to
@@ -484,28 +1217,36 @@ static void nrf_qwr_error_handler(uint32_t nrf_error)
 static void on_cus_evt(ble_cus_t     * p_cus_service,
                        ble_cus_evt_t * p_evt)
 {
-    // ret_code_t err_code;
-    
     switch(p_evt->evt_type)
     {
         case BLE_CUS_EVT_NOTIFICATION_ENABLED:
-            
-            //  err_code = app_timer_start(m_notification_timer_id, NOTIFICATION_INTERVAL, NULL);
-            //  APP_ERROR_CHECK(err_code);
-             break;
-
         case BLE_CUS_EVT_NOTIFICATION_DISABLED:
-
-            // err_code = app_timer_stop(m_notification_timer_id);
-            // APP_ERROR_CHECK(err_code);
+            // Sampling keeps running for the history; the stages behind each characteristic
+            // check the subscriptions themselves.
+            NRF_LOG_INFO("Link %d subscriptions 0x%04x.", p_evt->conn_handle, p_evt->subscription);
+            conn_policy_evaluate();
             break;
 
         case BLE_CUS_EVT_CONNECTED:
+            peer_resume(p_evt->conn_handle);
             break;
 
         case BLE_CUS_EVT_DISCONNECTED:
               break;
 
+        case BLE_CUS_EVT_BULK_STARTED:
+        case BLE_CUS_EVT_BULK_DONE:
+            transfer_profile_update(p_evt->conn_handle);
+            break;
+
+        case BLE_CUS_EVT_CONFIG_CHANGED:
+            config_apply(p_evt);
+            if (!p_evt->cp_failed)
+            {
+                peer_state_save(p_evt->conn_handle);
+            }
+            break;
+
         default:
               // No implementation needed.
               break;
@@ -523,8 +1264,11 @@ static void services_init(void)
         // Initialize Queued Write Module.
         qwr_init.error_handler = nrf_qwr_error_handler;
 
-        err_code = nrf_ble_qwr_init(&m_qwr, &qwr_init);
-        APP_ERROR_CHECK(err_code);
+        for (uint32_t i = 0; i < NRF_SDH_BLE_TOTAL_LINK_COUNT; i++)
+        {
+            err_code = nrf_ble_qwr_init(&m_qwr[i], &qwr_init);
+            APP_ERROR_CHECK(err_code);
+        }
 
          // Initialize CUS Service init structure to zero.
         cus_init.evt_handler                = on_cus_evt;
@@ -534,16 +1278,19 @@ static void services_init(void)
         BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cus_init.custom_value_char_attr_md.write_perm);
     
         ble_cus_init(&m_cus, &cus_init);
+
+        rscs_init();
+        l2cap_bulk_init(l2cap_bulk_evt_handler, &m_cus.arr_counter);
         m_cus.arr_counter = 0;
         m_cus.buff_counter = 0;
         m_cus.pow_buf_counter = 0;
-        for(int i=0; i<50; i++)
-            m_cus.pow_buf[i] = 0;
-        for(int i=0; i<450; i++)
-            m_cus.buff[i] = 2000;
-        for(int i=0; i<10000; i++)
-            m_cus.accl_arr[i] = 9;
         m_cus.power = 0;
+
+        // Sample storage lives in .bss and is already zeroed by the startup code.
+        sample_pool_report();
+#if SAMPLE_SOA_BENCHMARK_ENABLED
+        sample_soa_benchmark(sample_pool_window, m_cus.buff_counter);
+#endif
                 
 }
 
@@ -552,20 +1299,19 @@ static void services_init(void)
  *
  * @details This function will be called for all events in the Connection Parameters Module which
  *          are passed to the application.
- *          @note All this function does is to disconnect. This could have been done by simply
- *                setting the disconnect_on_fail config parameter, but instead we use the event
- *                handler mechanism to demonstrate its use.
+ *          @note The connection policy changes the preferred parameters while connected, and a
+ *                central may well refuse a mode (e.g. a 7.5 ms interval). The connection is kept
+ *                with the parameters the central chose.
  *
  * @param[in] p_evt  Event received from the Connection Parameters Module.
  */
 static void on_conn_params_evt(ble_conn_params_evt_t * p_evt)
 {
-    ret_code_t err_code;
+    ble_cus_link_t const * p_link = ble_cus_link_get(&m_cus, p_evt->conn_handle);
 
-    if (p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED)
+    if ((p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED) && (p_link != NULL))
     {
-        err_code = sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_CONN_INTERVAL_UNACCEPTABLE);
-        APP_ERROR_CHECK(err_code);
+        NRF_LOG_WARNING("Central refused connection parameters of mode %d.", p_link->policy.mode);
     }
 }
 
@@ -607,8 +1353,9 @@ static void conn_params_init(void)
  */
 static void application_timers_start(void)
 {
-    app_timer_start(m_notification_timer_id, NOTIFICATION_INTERVAL, NULL);
-    app_timer_start(m_notification_timer_id1, NOTIFICATION_INTERVAL1, NULL);
+    app_timer_start(m_notification_timer_id, APP_TIMER_TICKS(1000 / m_cus.config.sample_rate_hz), NULL);
+    app_timer_start(m_notification_timer_id1, APP_TIMER_TICKS(m_cus.config.notify_interval_ms), NULL);
+    app_timer_start(m_metrics_timer_id, METRICS_INTERVAL, NULL);
 }
 
 
@@ -652,7 +1399,10 @@ static void on_adv_evt(ble_adv_evt_t ble_adv_evt)
             break;
 
         case BLE_ADV_EVT_IDLE:
-            sleep_mode_enter();
+            if (ble_cus_link_count(&m_cus) == 0)
+            {
+                sleep_mode_enter();
+            }
             break;
 
         default:
@@ -673,30 +1423,33 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
     switch (p_ble_evt->header.evt_id)
     {
         case BLE_GAP_EVT_DISCONNECTED:
-            NRF_LOG_INFO("Disconnected.");
+            NRF_LOG_INFO("Link %d disconnected.", p_ble_evt->evt.gap_evt.conn_handle);
+            if (p_ble_evt->evt.gap_evt.conn_handle == m_rscs.conn_handle)
+            {
+                m_rsc_meas_subscribed = false;
+            }
             // LED indication will be changed when advertising starts.
+            advertising_resume();
             break;
 
         case BLE_GAP_EVT_CONNECTED:
-            NRF_LOG_INFO("Connected.");
+            NRF_LOG_INFO("Link %d connected.", p_ble_evt->evt.gap_evt.conn_handle);
             err_code = bsp_indication_set(BSP_INDICATE_CONNECTED);
             APP_ERROR_CHECK(err_code);
-            m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
-            err_code = nrf_ble_qwr_conn_handle_assign(&m_qwr, m_conn_handle);
-            APP_ERROR_CHECK(err_code);
+            for (uint32_t i = 0; i < NRF_SDH_BLE_TOTAL_LINK_COUNT; i++)
+            {
+                if (m_qwr[i].conn_handle == BLE_CONN_HANDLE_INVALID)
+                {
+                    err_code = nrf_ble_qwr_conn_handle_assign(&m_qwr[i], p_ble_evt->evt.gap_evt.conn_handle);
+                    APP_ERROR_CHECK(err_code);
+                    break;
+                }
+            }
+            // Advertising stops on a connection; keep it going for the next central.
+            advertising_resume();
             break;
 
-        case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
-        {
-            NRF_LOG_DEBUG("PHY update request.");
-            ble_gap_phys_t const phys =
-            {
-                .rx_phys = BLE_GAP_PHY_AUTO,
-                .tx_phys = BLE_GAP_PHY_AUTO,
-            };
-            err_code = sd_ble_gap_phy_update(p_ble_evt->evt.gap_evt.conn_handle, &phys);
-            APP_ERROR_CHECK(err_code);
-        } break;
+        // PHY update requests are answered by the link profile module.
 
         case BLE_GATTC_EVT_TIMEOUT:
             // Disconnect on GATT Client timeout event.
@@ -721,12 +1474,78 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
 }
 
 
+/**@brief Function for logging the RAM start the SoftDevice needs against the linked one.
+ *
+ * @details RAM ORIGIN in the linker script has to be at least the start the SoftDevice asks for
+ *          with this configuration; anything below it is RAM the application could use.
+ *
+ * @param[in] ram_linked    RAM start of the application as linked.
+ * @param[in] ram_required  RAM start the SoftDevice needs, from nrf_sdh_ble_enable.
+ */
+static void ram_start_log(uint32_t ram_linked, uint32_t ram_required)
+{
+    if (ram_required > ram_linked)
+    {
+        NRF_LOG_ERROR("SoftDevice needs RAM up to 0x%x, linked at 0x%x: raise RAM ORIGIN by %d bytes.",
+                      ram_required, ram_linked, ram_required - ram_linked);
+    }
+    else if (ram_required < ram_linked)
+    {
+        NRF_LOG_WARNING("SoftDevice needs RAM up to 0x%x, linked at 0x%x: %d bytes unused.",
+                        ram_required, ram_linked, ram_linked - ram_required);
+    }
+    else
+    {
+        NRF_LOG_INFO("RAM start 0x%x matches the SoftDevice configuration.", ram_linked);
+    }
+}
+
+
+/**@brief Function for configuring the default ATT MTU instead of NRF_SDH_BLE_GATT_MAX_MTU_SIZE.
+ *
+ * @details Frees the SoftDevice RAM of the large ATT buffers; notifications are 20 bytes then.
+ */
+static ret_code_t att_mtu_cfg_reduce(uint8_t conn_cfg_tag, uint32_t ram_start)
+{
+    ret_code_t err_code;
+    ble_cfg_t  ble_cfg;
+
+    memset(&ble_cfg, 0, sizeof(ble_cfg));
+    ble_cfg.conn_cfg.conn_cfg_tag                 = conn_cfg_tag;
+    ble_cfg.conn_cfg.params.gatt_conn_cfg.att_mtu = BLE_GATT_ATT_MTU_DEFAULT;
+
+    err_code = sd_ble_cfg_set(BLE_CONN_CFG_GATT, &ble_cfg, ram_start);
+    VERIFY_SUCCESS(err_code);
+
+    m_att_mtu_max = BLE_GATT_ATT_MTU_DEFAULT;
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function giving up part of the SoftDevice configuration for RAM. */
+typedef ret_code_t (*ble_cfg_fallback_t)(uint8_t conn_cfg_tag, uint32_t ram_start);
+
+
 /**@brief Function for initializing the BLE stack.
  *
  * @details Initializes the SoftDevice and the BLE event interrupt.
+ *
+ *          If the SoftDevice does not fit below the linked RAM start, features are given up until
+ *          it does; every attempt logs the RAM start it needs.
  */
 static void ble_stack_init(void)
 {
+    // Tried in order while the SoftDevice does not fit below the linked RAM start, the features
+    // needed least first: the smaller queues cost no throughput in test/l2cap_bulk_sim, without
+    // the channel downloads fall back to GATT, and a small ATT MTU slows down every transfer.
+    static ble_cfg_fallback_t const fallbacks[] =
+    {
+        link_profile_cfg_reduce,
+        l2cap_bulk_cfg_reduce,
+        l2cap_bulk_cfg_disable,
+        att_mtu_cfg_reduce,
+    };
+
     ret_code_t err_code;
 
     err_code = nrf_sdh_enable_request();
@@ -738,10 +1557,33 @@ static void ble_stack_init(void)
     err_code = nrf_sdh_ble_default_cfg_set(APP_BLE_CONN_CFG_TAG, &ram_start);
     APP_ERROR_CHECK(err_code);
 
+    uint32_t const ram_linked = ram_start;
+
+    err_code = link_profile_cfg_set(APP_BLE_CONN_CFG_TAG, ram_start);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = l2cap_bulk_cfg_set(APP_BLE_CONN_CFG_TAG, ram_start);
+    APP_ERROR_CHECK(err_code);
+
     // Enable BLE stack.
     err_code = nrf_sdh_ble_enable(&ram_start);
+    ram_start_log(ram_linked, ram_start);
+
+    for (uint32_t i = 0; (err_code == NRF_ERROR_NO_MEM) && (i < ARRAY_SIZE(fallbacks)); i++)
+    {
+        NRF_LOG_WARNING("Not enough RAM for the SoftDevice, fallback %d.", i);
+        err_code = fallbacks[i](APP_BLE_CONN_CFG_TAG, ram_linked);
+        APP_ERROR_CHECK(err_code);
+
+        ram_start = ram_linked;
+        err_code  = nrf_sdh_ble_enable(&ram_start);
+        ram_start_log(ram_linked, ram_start);
+    }
     APP_ERROR_CHECK(err_code);
 
+    NRF_LOG_INFO("ATT MTU up to %d, %d notifications queued per link, %d L2CAP SDUs queued.",
+                 m_att_mtu_max, link_profile_hvn_tx_queue_size(), l2cap_bulk_tx_queue_size());
+
     // Register a handler for BLE events.
     NRF_SDH_BLE_OBSERVER(m_ble_observer, APP_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
 }
@@ -754,6 +1596,10 @@ static void peer_manager_init(void)
     ble_gap_sec_params_t sec_param;
     ret_code_t           err_code;
 
+    // Registered before the peer manager initializes FDS, so the session summary is loaded.
+    err_code = fds_register(fds_evt_handler);
+    APP_ERROR_CHECK(err_code);
+
     err_code = pm_init();
     APP_ERROR_CHECK(err_code);
 
@@ -809,16 +1655,23 @@ static void bsp_event_handler(bsp_event_t event)
             break; // BSP_EVENT_SLEEP
 
         case BSP_EVENT_DISCONNECT:
-            err_code = sd_ble_gap_disconnect(m_conn_handle,
-                                             BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
-            if (err_code != NRF_ERROR_INVALID_STATE)
+            for (uint32_t i = 0; i < BLE_CUS_LINK_COUNT; i++)
             {
-                APP_ERROR_CHECK(err_code);
+                if (m_cus.links[i].conn_handle == BLE_CONN_HANDLE_INVALID)
+                {
+                    continue;
+                }
+                err_code = sd_ble_gap_disconnect(m_cus.links[i].conn_handle,
+                                                 BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+                if (err_code != NRF_ERROR_INVALID_STATE)
+                {
+                    APP_ERROR_CHECK(err_code);
+                }
             }
             break; // BSP_EVENT_DISCONNECT
 
         case BSP_EVENT_WHITELIST_OFF:
-            if (m_conn_handle == BLE_CONN_HANDLE_INVALID)
+            if (ble_cus_link_count(&m_cus) < BLE_CUS_LINK_COUNT)
             {
                 err_code = ble_advertising_restart_without_whitelist(&m_advertising);
                 if (err_code != NRF_ERROR_INVALID_STATE)
@@ -834,6 +1687,15 @@ static void bsp_event_handler(bsp_event_t event)
 }
 
 
+/**@brief Function for providing the metrics to the broadcast.
+ */
+static void broadcast_data_handler(broadcast_data_t * p_data)
+{
+    p_data->power   = m_cus.power;
+    p_data->cadence = MIN(running_metrics_get()->cadence, UINT8_MAX);
+}
+
+
 /**@brief Function for initializing the Advertising functionality.
  */
 static void advertising_init(void)
@@ -846,15 +1708,22 @@ static void advertising_init(void)
     init.advdata.name_type               = BLE_ADVDATA_FULL_NAME;
     init.advdata.include_appearance      = false;
     init.advdata.flags                   = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
-    init.advdata.uuids_complete.uuid_cnt = sizeof(m_adv_uuids) / sizeof(m_adv_uuids[0]);
-    init.advdata.uuids_complete.p_uuids  = m_adv_uuids;
+
+    // A 128-bit UUID does not fit next to the flags and the full name.
+    init.srdata.uuids_complete.uuid_cnt = sizeof(m_adv_uuids) / sizeof(m_adv_uuids[0]);
+    init.srdata.uuids_complete.p_uuids  = m_adv_uuids;
 
     init.config.ble_adv_fast_enabled  = true;
     init.config.ble_adv_fast_interval = APP_ADV_INTERVAL;
+    // Restarted by advertising_resume, which knows about the other links.
+    init.config.ble_adv_on_disconnect_disabled = true;
     // init.config.ble_adv_fast_timeout  = APP_ADV_DURATION;
 
     init.evt_handler = on_adv_evt;
 
+    err_code = broadcast_init(&m_advertising, &init.advdata, &init.srdata, broadcast_data_handler);
+    APP_ERROR_CHECK(err_code);
+
     err_code = ble_advertising_init(&m_advertising, &init);
     APP_ERROR_CHECK(err_code);
 
@@ -915,6 +1784,28 @@ static void idle_state_handle(void)
 }
 
 
+/**@brief Function for advertising again while a link is free.
+ *
+ * @details Called on connection and disconnection. Advertising may already run (a link went down
+ *          while another central was being waited for); that is not an error.
+ */
+static void advertising_resume(void)
+{
+    ret_code_t err_code;
+
+    if (ble_cus_link_count(&m_cus) >= BLE_CUS_LINK_COUNT)
+    {
+        return;
+    }
+
+    err_code = ble_advertising_start(&m_advertising, BLE_ADV_MODE_FAST);
+    if (err_code != NRF_ERROR_INVALID_STATE)
+    {
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
 /**@brief Function for starting advertising.
  */
 static void advertising_start(bool erase_bonds)
@@ -940,6 +1831,7 @@ int main(void)
     bool erase_bonds;
 
     // Initialize.
+    crash_buffer_init();
     log_init();
     timers_init();
     if (false) {
@@ -952,9 +1844,14 @@ int main(void)
     gap_params_init();
     gatt_init();
     services_init();
+    m_db_hash = peer_state_db_hash_compute();
+    ble_cus_db_hash_set(&m_cus, m_db_hash);
     advertising_init();
     conn_params_init();
     peer_manager_init();
+    APP_ERROR_CHECK(flash_log_init());
+    sample_block_init();
+    session_index_rebuild();
 
     twi_config();
     if (true) {
@@ -962,11 +1859,19 @@ int main(void)
         MMA8452_INIT_TRANSFER_COUNT, NULL));
     }
 
+    crash_buffer_t const * p_crash;
+    if (crash_buffer_report(&p_crash) != 0)
+    {
+        NRF_LOG_WARNING("Reset by fault %d (0x%x) at pc 0x%x after %d ms.",
+                        p_crash->reason, p_crash->info, p_crash->pc, p_crash->uptime_ms);
+    }
+
     // Start execution.
     NRF_LOG_INFO("Template example started.");
     if (true) {
         application_timers_start();
     }
+    APP_ERROR_CHECK(broadcast_start(BROADCAST_INTERVAL_DEFAULT_MS));
     
     erase_bonds = false;
     advertising_start(erase_bonds);
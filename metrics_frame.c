@@ -0,0 +1,144 @@
+#include "metrics_frame.h"
+#include <string.h>
+
+
+static uint16_t u16_encode(uint16_t value, uint8_t * p_buf)
+{
+    p_buf[0] = (uint8_t)value;
+    p_buf[1] = (uint8_t)(value >> 8);
+    return 2;
+}
+
+
+static uint16_t u32_encode(uint32_t value, uint8_t * p_buf)
+{
+    (void)u16_encode((uint16_t)value, p_buf);
+    (void)u16_encode((uint16_t)(value >> 16), p_buf + 2);
+    return 4;
+}
+
+
+static uint16_t u16_decode(uint8_t const * p_buf)
+{
+    return (uint16_t)(p_buf[0] | (p_buf[1] << 8));
+}
+
+
+static uint32_t u32_decode(uint8_t const * p_buf)
+{
+    return u16_decode(p_buf) | ((uint32_t)u16_decode(p_buf + 2) << 16);
+}
+
+
+uint16_t metrics_frame_encode(metrics_frame_t const * p_frame, uint8_t * p_buf)
+{
+    uint16_t len = 0;
+
+    p_buf[len++] = METRICS_FRAME_VERSION;
+    p_buf[len++] = p_frame->flags;
+    len += u16_encode(p_frame->seq, &p_buf[len]);
+
+    if (p_frame->flags & METRICS_FRAME_POWER)
+    {
+        len += u16_encode(p_frame->power, &p_buf[len]);
+    }
+    if (p_frame->flags & METRICS_FRAME_CADENCE)
+    {
+        p_buf[len++] = p_frame->cadence;
+    }
+    if (p_frame->flags & METRICS_FRAME_GCT)
+    {
+        len += u16_encode(p_frame->gct_ms, &p_buf[len]);
+    }
+    if (p_frame->flags & METRICS_FRAME_VERTICAL_OSC)
+    {
+        len += u16_encode(p_frame->vertical_osc_mm, &p_buf[len]);
+    }
+    if (p_frame->flags & METRICS_FRAME_STEPS)
+    {
+        len += u32_encode(p_frame->steps, &p_buf[len]);
+    }
+    if (p_frame->flags & METRICS_FRAME_TIMESTAMP)
+    {
+        len += u32_encode(p_frame->timestamp, &p_buf[len]);
+    }
+    return len;
+}
+
+
+/**@brief Function for checking that a field of the given size is left in the frame. */
+static bool field_fits(uint16_t offset, uint16_t size, uint16_t len)
+{
+    return (offset + size <= len);
+}
+
+
+bool metrics_frame_decode(uint8_t const * p_buf, uint16_t len, metrics_frame_t * p_frame)
+{
+    uint16_t offset = METRICS_FRAME_HEADER_LEN;
+
+    memset(p_frame, 0, sizeof(metrics_frame_t));
+
+    if ((len < METRICS_FRAME_HEADER_LEN) || (p_buf[0] != METRICS_FRAME_VERSION))
+    {
+        return false;
+    }
+
+    p_frame->flags = p_buf[1];
+    p_frame->seq   = u16_decode(&p_buf[2]);
+
+    if (p_frame->flags & METRICS_FRAME_POWER)
+    {
+        if (!field_fits(offset, 2, len))
+        {
+            return false;
+        }
+        p_frame->power = u16_decode(&p_buf[offset]);
+        offset        += 2;
+    }
+    if (p_frame->flags & METRICS_FRAME_CADENCE)
+    {
+        if (!field_fits(offset, 1, len))
+        {
+            return false;
+        }
+        p_frame->cadence = p_buf[offset];
+        offset          += 1;
+    }
+    if (p_frame->flags & METRICS_FRAME_GCT)
+    {
+        if (!field_fits(offset, 2, len))
+        {
+            return false;
+        }
+        p_frame->gct_ms = u16_decode(&p_buf[offset]);
+        offset         += 2;
+    }
+    if (p_frame->flags & METRICS_FRAME_VERTICAL_OSC)
+    {
+        if (!field_fits(offset, 2, len))
+        {
+            return false;
+        }
+        p_frame->vertical_osc_mm = u16_decode(&p_buf[offset]);
+        offset                  += 2;
+    }
+    if (p_frame->flags & METRICS_FRAME_STEPS)
+    {
+        if (!field_fits(offset, 4, len))
+        {
+            return false;
+        }
+        p_frame->steps = u32_decode(&p_buf[offset]);
+        offset        += 4;
+    }
+    if (p_frame->flags & METRICS_FRAME_TIMESTAMP)
+    {
+        if (!field_fits(offset, 4, len))
+        {
+            return false;
+        }
+        p_frame->timestamp = u32_decode(&p_buf[offset]);
+    }
+    return true;
+}
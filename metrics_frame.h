@@ -0,0 +1,76 @@
+#ifndef METRICS_FRAME_H__
+#define METRICS_FRAME_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Encoder and decoder of the metrics frame, the one notification carrying all metrics.
+ *
+ * @details Frame layout, little endian:
+ *
+ *          | Offset | Size | Field                                            |
+ *          |--------|------|--------------------------------------------------|
+ *          | 0      | 1    | Version, METRICS_FRAME_VERSION                   |
+ *          | 1      | 1    | Flags, one bit per field present                 |
+ *          | 2      | 2    | Sequence number, incremented for every frame     |
+ *          | 4      | ...  | Present fields in flag bit order                 |
+ *
+ *          New fields get the next free flag bit and are appended, so a decoder skips fields it
+ *          does not know as trailing bytes. The version only changes when existing fields do.
+ *
+ *          The module only depends on the C library, so hosts can build it as it is.
+ */
+
+#define METRICS_FRAME_VERSION       1
+#define METRICS_FRAME_HEADER_LEN    4
+#define METRICS_FRAME_MAX_LEN       (METRICS_FRAME_HEADER_LEN + 2 + 1 + 2 + 2 + 4 + 4)
+
+#define METRICS_FRAME_POWER         (1 << 0)                                /**< uint16, power (raw magnitude average). */
+#define METRICS_FRAME_CADENCE       (1 << 1)                                /**< uint8, steps per minute. */
+#define METRICS_FRAME_GCT           (1 << 2)                                /**< uint16, ground contact time in ms. */
+#define METRICS_FRAME_VERTICAL_OSC  (1 << 3)                                /**< uint16, vertical oscillation in mm. */
+#define METRICS_FRAME_STEPS         (1 << 4)                                /**< uint32, step count. */
+#define METRICS_FRAME_TIMESTAMP     (1 << 5)                                /**< uint32, synced timestamp of the metrics (see time_sync.h). */
+
+/**@brief Metrics frame contents. */
+typedef struct
+{
+    uint8_t  flags;                                                         /**< Fields present, METRICS_FRAME_* bits. */
+    uint16_t seq;
+    uint16_t power;
+    uint8_t  cadence;
+    uint16_t gct_ms;
+    uint16_t vertical_osc_mm;
+    uint32_t steps;
+    uint32_t timestamp;
+} metrics_frame_t;
+
+/**@brief Function for encoding a frame.
+ *
+ * @param[in]  p_frame  Frame; only the fields flagged are encoded.
+ * @param[out] p_buf    Buffer of at least METRICS_FRAME_MAX_LEN bytes.
+ *
+ * @return Encoded length.
+ */
+uint16_t metrics_frame_encode(metrics_frame_t const * p_frame, uint8_t * p_buf);
+
+/**@brief Function for decoding a frame.
+ *
+ * @details Fields that are not flagged are set to 0. Flags of fields this decoder does not know
+ *          are kept in p_frame->flags.
+ *
+ * @return True if the frame was decoded, false if the version is unknown or the frame is too short.
+ */
+bool metrics_frame_decode(uint8_t const * p_buf, uint16_t len, metrics_frame_t * p_frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_FRAME_H__
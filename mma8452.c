@@ -60,3 +60,26 @@ nrf_twi_mngr_transfer_t const mma8452_init_transfers[MMA8452_INIT_TRANSFER_COUNT
 {
     NRF_TWI_MNGR_WRITE(MMA8452_ADDR, default_config, sizeof(default_config), 0)
 };
+
+// XYZ_DATA_CFG can only be written in standby.
+static uint8_t NRF_TWI_MNGR_BUFFER_LOC_IND standby_config[] = { CTRL_REG_1, 0 };
+static uint8_t NRF_TWI_MNGR_BUFFER_LOC_IND range_config[]   = { XYZ_DATA_CFG, 0 };
+
+nrf_twi_mngr_transfer_t const mma8452_range_transfers[MMA8452_RANGE_TRANSFER_COUNT] =
+{
+    NRF_TWI_MNGR_WRITE(MMA8452_ADDR, standby_config, sizeof(standby_config), 0),
+    NRF_TWI_MNGR_WRITE(MMA8452_ADDR, range_config,   sizeof(range_config),   0),
+    NRF_TWI_MNGR_WRITE(MMA8452_ADDR, default_config, sizeof(default_config), 0)
+};
+
+bool mma8452_range_prepare(uint8_t range_g)
+{
+    switch (range_g)
+    {
+        case 2: range_config[1] = 0x00; break;
+        case 4: range_config[1] = 0x01; break;
+        case 8: range_config[1] = 0x02; break;
+        default: return false;
+    }
+    return true;
+}
@@ -41,6 +41,7 @@
 #define MMA8452_H__
 
 
+#include <stdbool.h>
 #include "nrf_twi_mngr.h"
 
 #ifdef __cplusplus
@@ -60,6 +61,7 @@ extern "C" {
  
 #define SYSMOD 0x0B                         // Type 'read' : This tells you if device is active, sleep or standy 0x00=STANDBY 0x01=WAKE 0x02=SLEEP
 #define WHO_AM_I 0x0D                       // Type 'read' : This should return the device id of 0x2A
+#define XYZ_DATA_CFG 0x0E                   // Type 'read/write' : Full scale range, written in standby
  
 #define PL_STATUS 0x10                      // Type 'read' : This shows portrait landscape mode orientation
 #define PL_CFG 0x11                         // Type 'read/write' : This allows portrait landscape configuration
@@ -114,6 +116,20 @@ extern uint8_t NRF_TWI_MNGR_BUFFER_LOC_IND mma8452_xout_reg_addr;
 extern nrf_twi_mngr_transfer_t const
     mma8452_init_transfers[MMA8452_INIT_TRANSFER_COUNT];
 
+// Standby, full scale range, active again.
+#define MMA8452_RANGE_TRANSFER_COUNT 3
+
+extern nrf_twi_mngr_transfer_t const
+    mma8452_range_transfers[MMA8452_RANGE_TRANSFER_COUNT];
+
+/**@brief Function for setting the full scale range mma8452_range_transfers write.
+ *
+ * @param[in] range_g   2, 4 or 8.
+ *
+ * @return True if the range is supported.
+ */
+bool mma8452_range_prepare(uint8_t range_g);
+
 #ifdef __cplusplus
 }
 #endif
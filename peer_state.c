@@ -0,0 +1,76 @@
+#include "sdk_common.h"
+#include "peer_state.h"
+#include <string.h>
+#include "ble.h"
+#include "crc32.h"
+
+#define RECORD_VERSION      1                                               /**< Changes with peer_state_t. */
+#define STORE_QUEUE_SIZE    4                                               /**< Records that can wait for flash at the same time. */
+
+/**@brief Record as stored; word aligned as the peer manager requires. */
+typedef struct
+{
+    uint32_t     version;
+    peer_state_t state;
+} record_t;
+
+STATIC_ASSERT((sizeof(record_t) % sizeof(uint32_t)) == 0);
+
+static record_t m_store_queue[STORE_QUEUE_SIZE];                            /**< The peer manager writes from these, so they are used in turn. */
+static uint8_t  m_store_next;
+
+
+uint32_t peer_state_db_hash_compute(void)
+{
+    uint32_t crc = 0;
+
+    for (uint16_t handle = BLE_GATT_HANDLE_START; handle != BLE_GATT_HANDLE_INVALID; handle++)
+    {
+        ble_uuid_t          uuid;
+        ble_gatts_attr_md_t md;
+        uint8_t             data[sizeof(uint16_t) + 16];
+        uint8_t             uuid_len = 0;
+
+        if (sd_ble_gatts_attr_get(handle, &uuid, &md) != NRF_SUCCESS)
+        {
+            break;
+        }
+
+        // The full UUID, since vendor UUID types are numbered in the order they were added.
+        (void)uint16_encode(handle, data);
+        if (sd_ble_uuid_encode(&uuid, &uuid_len, &data[sizeof(uint16_t)]) != NRF_SUCCESS)
+        {
+            uuid_len = 0;
+        }
+        crc = crc32_compute(data, sizeof(uint16_t) + uuid_len, (handle == BLE_GATT_HANDLE_START) ? NULL : &crc);
+    }
+    return crc;
+}
+
+
+bool peer_state_load(pm_peer_id_t peer_id, peer_state_t * p_state)
+{
+    record_t record;
+    uint32_t len = sizeof(record);
+
+    if ((pm_peer_data_app_data_load(peer_id, (uint8_t *)&record, &len) != NRF_SUCCESS)
+        || (len != sizeof(record)) || (record.version != RECORD_VERSION))
+    {
+        return false;
+    }
+
+    *p_state = record.state;
+    return true;
+}
+
+
+ret_code_t peer_state_store(pm_peer_id_t peer_id, peer_state_t const * p_state)
+{
+    record_t * p_record = &m_store_queue[m_store_next];
+
+    m_store_next      = (m_store_next + 1) % STORE_QUEUE_SIZE;
+    p_record->version = RECORD_VERSION;
+    p_record->state   = *p_state;
+
+    return pm_peer_data_app_data_store(peer_id, (uint8_t const *)p_record, sizeof(record_t), NULL);
+}
@@ -0,0 +1,65 @@
+#ifndef PEER_STATE_H__
+#define PEER_STATE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+#include "peer_manager.h"
+#include "ble_cus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief State kept with the bond of every peer, for a fast reconnect.
+ *
+ * @details The attribute table is built in the same order at every boot, so its handles only
+ *          change with the firmware. The database hash covers the handle and type of every
+ *          attribute and is served in the DB Hash characteristic: a bonded central reads it by
+ *          UUID after connecting and skips service discovery if it matches the one it cached.
+ *          S132 v6 has no GATT caching (Bluetooth 5.1), so this is the vendor equivalent of the
+ *          Database Hash characteristic.
+ *
+ *          The hash a peer last saw is stored with its bond. If it differs on reconnect the table
+ *          changed with a firmware update, and the peer manager sends Service Changed.
+ *
+ *          The CCCDs of a bonded peer are restored by the peer manager before the link is served.
+ *          The settings the peer made through the Control Point are stored with its bond as well
+ *          and restored when it reconnects while no other central is connected.
+ */
+
+/**@brief Record stored as peer manager application data. */
+typedef struct
+{
+    uint32_t         db_hash;                                               /**< Database hash the peer last saw. */
+    ble_cus_config_t config;                                                /**< Settings the peer made. */
+} peer_state_t;
+
+/**@brief Function for computing the database hash.
+ *
+ * @details CRC32 over the handle and the full UUID of every attribute. Call once all services are
+ *          added.
+ */
+uint32_t peer_state_db_hash_compute(void);
+
+/**@brief Function for loading the record of a peer.
+ *
+ * @return True if the peer has a record of the current layout.
+ */
+bool peer_state_load(pm_peer_id_t peer_id, peer_state_t * p_state);
+
+/**@brief Function for storing the record of a peer.
+ *
+ * @details The record is copied, so it does not have to stay valid until it is written.
+ *
+ * @return Result of pm_peer_data_app_data_store.
+ */
+ret_code_t peer_state_store(pm_peer_id_t peer_id, peer_state_t const * p_state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PEER_STATE_H__
@@ -0,0 +1,86 @@
+#include "sdk_common.h"
+#include "running_metrics.h"
+#include <math.h>
+
+#define WEINBERG_K      0.41f                                               /**< Weinberg constant for accelerations in m/s^2, result in m. */
+#define G_MS2           9.81f
+
+static running_metrics_t m_metrics;
+
+
+/**@brief Function for getting the Weinberg step length of a stride, in cm. */
+static uint16_t step_length_cm(stride_events_record_t const * p_stride)
+{
+    uint16_t swing_mg  = (p_stride->peak_mg > p_stride->low_mg) ? p_stride->peak_mg - p_stride->low_mg : 0;
+    float    swing_ms2 = swing_mg * G_MS2 / 1000.0f;
+
+    return (uint16_t)(WEINBERG_K * sqrtf(sqrtf(swing_ms2)) * 100.0f);
+}
+
+
+static void metrics_still(void)
+{
+    m_metrics.cadence         = 0;
+    m_metrics.speed_cm_s      = 0;
+    m_metrics.gct_ms          = 0;
+    m_metrics.vertical_osc_mm = 0;
+    m_metrics.running         = false;
+}
+
+
+void running_metrics_stride_add(stride_events_record_t const * p_stride)
+{
+    m_metrics.steps++;
+    m_metrics.distance_cm += step_length_cm(p_stride);
+}
+
+
+void running_metrics_update(uint32_t local_ms)
+{
+    stride_events_record_t stride;
+    uint32_t               strides     = 0;
+    uint32_t               duration_ms = 0;
+    uint32_t               gct_ms      = 0;
+    uint32_t               osc_mm      = 0;
+    uint32_t               length_cm   = 0;
+
+    // Newest first, until a stride ended before the window or is no longer in the ring.
+    for (uint16_t seq = stride_events_head() - 1; stride_events_get(seq, &stride); seq--)
+    {
+        if (local_ms - stride.local_ms > RUNNING_METRICS_WINDOW_MS)
+        {
+            break;
+        }
+        strides++;
+        duration_ms += stride.duration_ms;
+        gct_ms      += stride.gct_ms;
+        osc_mm      += stride.vertical_osc_mm;
+        length_cm   += step_length_cm(&stride);
+    }
+
+    if (strides == 0)
+    {
+        metrics_still();
+        return;
+    }
+
+    m_metrics.cadence         = (uint16_t)(60000 * strides / duration_ms);
+    m_metrics.gct_ms          = (uint16_t)(gct_ms / strides);
+    m_metrics.vertical_osc_mm = (uint16_t)(osc_mm / strides);
+    m_metrics.step_length_cm  = (uint16_t)(length_cm / strides);
+    m_metrics.speed_cm_s      = (uint16_t)((uint32_t)m_metrics.step_length_cm * 1000 * strides / duration_ms);
+    m_metrics.running         = (m_metrics.cadence >= RUNNING_METRICS_RUNNING_CADENCE);
+}
+
+
+running_metrics_t const * running_metrics_get(void)
+{
+    return &m_metrics;
+}
+
+
+void running_metrics_distance_set(uint32_t distance_cm)
+{
+    m_metrics.distance_cm = distance_cm;
+    m_metrics.steps       = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef RUNNING_METRICS_H__
+#define RUNNING_METRICS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stride_events.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Cadence, step length, speed and distance from the strides of stride_events.h.
+ *
+ * @details Every stride is added as stride_events_push finds it, whether a client listens or
+ *          not, so the steps and the distance count the strides the Stride characteristic and
+ *          the session summary see. The step length of a stride uses the Weinberg estimate
+ *          K * (a_max - a_min)^(1/4) over its magnitude.
+ *
+ *          Once per second the strides that ended in the last RUNNING_METRICS_WINDOW_MS are
+ *          averaged: cadence from their durations, ground contact, vertical oscillation and step
+ *          length from theirs. Without such strides the wearer is taken to stand still.
+ */
+
+#define RUNNING_METRICS_UPDATE_INTERVAL_MS  1000                            /**< Time between two updates. */
+#define RUNNING_METRICS_WINDOW_MS           3000                            /**< Strides averaged into the current metrics. */
+#define RUNNING_METRICS_RUNNING_CADENCE     140                             /**< Cadence from which the wearer is taken to run. */
+
+/**@brief Running metrics. */
+typedef struct
+{
+    uint16_t cadence;                                                       /**< Steps per minute. */
+    uint16_t step_length_cm;
+    uint16_t speed_cm_s;
+    uint16_t gct_ms;                                                        /**< Ground contact time per step. */
+    uint16_t vertical_osc_mm;                                               /**< Vertical oscillation, 0 without a flight phase. */
+    bool     running;                                                       /**< Running rather than walking. */
+    uint32_t steps;                                                         /**< Steps since the distance was last set. */
+    uint32_t distance_cm;                                                   /**< Distance since it was last set. */
+} running_metrics_t;
+
+/**@brief Function for adding a stride to the steps and the distance.
+ *
+ * @details Call for every stride stride_events_push completes.
+ */
+void running_metrics_stride_add(stride_events_record_t const * p_stride);
+
+/**@brief Function for updating cadence, step length, speed, ground contact and oscillation from
+ *        the strides in the ring of stride_events.h.
+ *
+ * @details Call every RUNNING_METRICS_UPDATE_INTERVAL_MS.
+ *
+ * @param[in] local_ms  Local time now.
+ */
+void running_metrics_update(uint32_t local_ms);
+
+/**@brief Function for getting the metrics of the last update. */
+running_metrics_t const * running_metrics_get(void);
+
+/**@brief Function for setting the total distance, e.g. from the SC control point. Resets the step count. */
+void running_metrics_distance_set(uint32_t distance_cm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RUNNING_METRICS_H__
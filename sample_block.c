@@ -0,0 +1,140 @@
+#include "sdk_common.h"
+#include "sample_block.h"
+#include "time_sync.h"
+
+STATIC_ASSERT(SAMPLE_BLOCK_LEN <= FLASH_LOG_DATA_SIZE);
+
+static uint32_t m_boot_block;                                               /**< First block written since boot. */
+
+static bool     m_recording;
+static int32_t  m_sum[3];                                                   /**< Sum of the samples of the average being taken. */
+static uint16_t m_sum_count;
+static uint32_t m_sample_end_ms;                                            /**< End of the average being taken. */
+static uint16_t m_values[SAMPLE_BLOCK_SAMPLES];                             /**< Averages of the block being filled. */
+static uint8_t  m_value_count;
+static bool     m_block_written;                                            /**< A block was appended since boot. */
+static uint32_t m_last_block_ms;                                            /**< Local time of the last block appended. */
+
+
+void sample_block_init(void)
+{
+    m_boot_block = flash_log_head();
+}
+
+
+ret_code_t sample_block_append(uint16_t const * p_samples, uint32_t local_ms, uint32_t * p_block)
+{
+    uint8_t  data[SAMPLE_BLOCK_LEN];
+    uint16_t len = 0;
+
+    for (uint32_t i = 0; i < SAMPLE_BLOCK_SAMPLES; i++)
+    {
+        len += uint16_encode(p_samples[i], &data[len]);
+    }
+    len += uint32_encode(local_ms, &data[len]);
+
+    return flash_log_append(data, len, p_block);
+}
+
+
+/**@brief Function for starting a recording at a sample.
+ *
+ * @details The first block ends at least two periods after the last one, so a recording right
+ *          after another one is not taken for its continuation; its first average is longer then.
+ */
+static void record_start(uint32_t local_ms)
+{
+    uint32_t start_ms = local_ms;
+
+    if (m_block_written && ((int32_t)(m_last_block_ms + SAMPLE_BLOCK_PERIOD_MS - local_ms) > 0))
+    {
+        start_ms = m_last_block_ms + SAMPLE_BLOCK_PERIOD_MS;
+    }
+
+    m_recording     = true;
+    m_sum[0]        = 0;
+    m_sum[1]        = 0;
+    m_sum[2]        = 0;
+    m_sum_count     = 0;
+    m_value_count   = 0;
+    m_sample_end_ms = start_ms + SAMPLE_BLOCK_SAMPLE_MS;
+}
+
+
+/**@brief Function for ending the average being taken, and appending the block once it is full.
+ *
+ * @return True if a block was appended.
+ */
+static bool average_end(uint32_t * p_block, uint32_t * p_block_ms)
+{
+    ret_code_t err_code;
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        m_values[m_value_count++] = (uint16_t)(int16_t)(m_sum[i] / m_sum_count);
+        m_sum[i]                  = 0;
+    }
+    m_sum_count = 0;
+
+    if (m_value_count < SAMPLE_BLOCK_SAMPLES)
+    {
+        return false;
+    }
+
+    m_value_count   = 0;
+    m_block_written = true;
+    m_last_block_ms = m_sample_end_ms;
+
+    err_code = sample_block_append(m_values, m_sample_end_ms, p_block);
+    *p_block_ms = m_sample_end_ms;
+    return (err_code == NRF_SUCCESS);
+}
+
+
+bool sample_block_sample_add(int16_t x, int16_t y, int16_t z, uint32_t local_ms,
+                             uint32_t * p_block, uint32_t * p_block_ms)
+{
+    bool appended = false;
+
+    if (!m_recording || ((int32_t)(local_ms - m_sample_end_ms) >= SAMPLE_BLOCK_SAMPLE_MS))
+    {
+        // Samples missing for a whole average leave a gap, which ends the session in the index.
+        record_start(local_ms);
+    }
+    else if ((int32_t)(local_ms - m_sample_end_ms) >= 0)
+    {
+        appended         = average_end(p_block, p_block_ms);
+        m_sample_end_ms += SAMPLE_BLOCK_SAMPLE_MS;
+    }
+
+    m_sum[0] += x;
+    m_sum[1] += y;
+    m_sum[2] += z;
+    m_sum_count++;
+    return appended;
+}
+
+
+void sample_block_record_stop(void)
+{
+    m_recording = false;
+}
+
+
+ret_code_t sample_block_read(uint32_t block, uint8_t * p_buf, uint16_t * p_len)
+{
+    ret_code_t err_code = flash_log_read(block, p_buf, p_len);
+
+    if ((err_code == NRF_SUCCESS) && (*p_len == SAMPLE_BLOCK_LEN))
+    {
+        uint8_t * p_stamp = &p_buf[SAMPLE_BLOCK_LEN - SAMPLE_BLOCK_TIMESTAMP_LEN];
+        uint32_t  stamp   = TIME_SYNC_STAMP_UNKNOWN;
+
+        if (block >= m_boot_block)
+        {
+            stamp = time_sync_stamp(uint32_decode(p_stamp));
+        }
+        (void)uint32_encode(stamp, p_stamp);
+    }
+    return err_code;
+}
@@ -0,0 +1,86 @@
+#ifndef SAMPLE_BLOCK_H__
+#define SAMPLE_BLOCK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+#include "flash_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Sample blocks as stored in the flash log.
+ *
+ * @details A block holds SAMPLE_BLOCK_SAMPLES values (three x,y,z samples) followed by a
+ *          timestamp, little endian. In flash the timestamp is the local time of the newest
+ *          sample; reading a block turns it into the synced timestamp of time_sync.h, so a block
+ *          recorded before the first time sync gets a synced timestamp once the clock is synced.
+ *          Local time starts over at boot, so blocks of an earlier boot read as
+ *          TIME_SYNC_STAMP_UNKNOWN.
+ *
+ *          Sessions are recorded decimated: every stored sample is the average of the
+ *          accelerometer over SAMPLE_BLOCK_SAMPLE_MS, whatever the sampling rate, and a block
+ *          covers SAMPLE_BLOCK_PERIOD_MS. The flash log then holds about three hours of sessions
+ *          and erases a page every 127 blocks, about 13 minutes of recording. The timestamp of a
+ *          block is the end of its period; within a recording blocks are exactly
+ *          SAMPLE_BLOCK_PERIOD_MS apart, and the first block of a recording comes at least two
+ *          periods after the last block of the one before, so the gap tells recordings apart.
+ */
+
+#define SAMPLE_BLOCK_SAMPLES        9
+#define SAMPLE_BLOCK_TIMESTAMP_LEN  4
+#define SAMPLE_BLOCK_LEN            (SAMPLE_BLOCK_SAMPLES * 2 + SAMPLE_BLOCK_TIMESTAMP_LEN)
+
+#define SAMPLE_BLOCK_SAMPLE_MS      2000                                    /**< Time a stored x,y,z sample averages over. */
+#define SAMPLE_BLOCK_PERIOD_MS      (SAMPLE_BLOCK_SAMPLE_MS * SAMPLE_BLOCK_SAMPLES / 3)  /**< Time a block covers. */
+
+/**@brief Function for noting the first block of this boot. Call after flash_log_init. */
+void sample_block_init(void);
+
+/**@brief Function for appending a block to the flash log.
+ *
+ * @param[in]  p_samples    SAMPLE_BLOCK_SAMPLES values.
+ * @param[in]  local_ms     Local time of the newest sample.
+ * @param[out] p_block      Block number.
+ *
+ * @return Result of flash_log_append.
+ */
+ret_code_t sample_block_append(uint16_t const * p_samples, uint32_t local_ms, uint32_t * p_block);
+
+/**@brief Function for adding an accelerometer sample to the recording.
+ *
+ * @details Starts a recording if none is going on. Samples are averaged over
+ *          SAMPLE_BLOCK_SAMPLE_MS and a block is appended once it holds three averages. If no
+ *          sample came for SAMPLE_BLOCK_SAMPLE_MS, the recording starts over.
+ *
+ * @param[in]  x, y, z      Sample.
+ * @param[in]  local_ms     Local time of the sample.
+ * @param[out] p_block      Number of the block appended.
+ * @param[out] p_block_ms   Local time of the block appended.
+ *
+ * @return True if a block was appended. Dropped blocks are counted by the flash log.
+ */
+bool sample_block_sample_add(int16_t x, int16_t y, int16_t z, uint32_t local_ms,
+                             uint32_t * p_block, uint32_t * p_block_ms);
+
+/**@brief Function for ending the recording. The samples not in a block yet are dropped. */
+void sample_block_record_stop(void);
+
+/**@brief Function for reading a block with its synced timestamp.
+ *
+ * @param[in]  block    Block number.
+ * @param[out] p_buf    Buffer of FLASH_LOG_DATA_SIZE bytes.
+ * @param[out] p_len    Block length.
+ *
+ * @return Result of flash_log_read.
+ */
+ret_code_t sample_block_read(uint32_t block, uint8_t * p_buf, uint16_t * p_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_BLOCK_H__
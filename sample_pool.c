@@ -0,0 +1,31 @@
+#include "sdk_common.h"
+#include "sample_pool.h"
+#include "nrf_log.h"
+
+STATIC_ASSERT(SAMPLE_POOL_SIZE <= SAMPLE_POOL_MAX_SIZE);
+
+// Regions are plain zero-initialised globals, so they are placed in .bss and cleared on boot.
+#define SAMPLE_POOL_DEFINE(_name, _type, _len)  _type sample_pool_ ## _name[_len] __ALIGN(SAMPLE_POOL_ALIGN);
+SAMPLE_POOL_REGIONS(SAMPLE_POOL_DEFINE)
+#undef SAMPLE_POOL_DEFINE
+
+#define SAMPLE_POOL_ENTRY(_name, _type, _len)   {#_name, sample_pool_ ## _name, sizeof(sample_pool_ ## _name)},
+sample_pool_region_t const sample_pool_regions[] =
+{
+    SAMPLE_POOL_REGIONS(SAMPLE_POOL_ENTRY)
+};
+#undef SAMPLE_POOL_ENTRY
+
+size_t const sample_pool_region_count = ARRAY_SIZE(sample_pool_regions);
+
+
+void sample_pool_report(void)
+{
+    for (size_t i = 0; i < sample_pool_region_count; i++)
+    {
+        NRF_LOG_INFO("Pool region %s: %d bytes.",
+                     sample_pool_regions[i].p_name,
+                     (int)sample_pool_regions[i].size);
+    }
+    NRF_LOG_INFO("Pool total: %d of %d bytes.", (int)SAMPLE_POOL_SIZE, SAMPLE_POOL_MAX_SIZE);
+}
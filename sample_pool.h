@@ -0,0 +1,70 @@
+#ifndef SAMPLE_POOL_H__
+#define SAMPLE_POOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_POOL_ACCL_LEN        10000                                   /**< Raw x,y,z history that clients download (interleaved). */
+#define SAMPLE_POOL_WINDOW_LEN      450                                     /**< Sliding window of the last 150 x,y,z samples. */
+#define SAMPLE_POOL_POWER_LEN       50                                      /**< Acceleration magnitudes averaged into the power value. */
+#define SAMPLE_POOL_PACKAGE_LEN     10                                      /**< 9 samples plus the block index, as sent in the package characteristic. */
+#define SAMPLE_POOL_LIVE_LEN        (12 * SAMPLE_POOL_PACKAGE_LEN)          /**< Packages batched into one live notification, as many as fit a 247-byte ATT MTU. */
+#define SAMPLE_POOL_LIVE_STAMP_LEN  2                                       /**< Room after the live packages for their u32 timestamp. */
+#define SAMPLE_POOL_SOA_LEN         (2 * SAMPLE_POOL_WINDOW_LEN / 3)        /**< One axis of the window, stored twice so that every window is contiguous (see sample_soa.h). */
+
+#define SAMPLE_POOL_ALIGN           8                                       /**< Alignment of every region, so kernels can load 16-bit pairs as words. */
+
+#define SAMPLE_POOL_MAX_SIZE        (24 * 1024)                             /**< RAM budget for all regions together, checked at compile time. */
+
+/**@brief Sample pool regions.
+ *
+ * @details Every entry is X(name, type, length) and becomes a statically allocated array called
+ *          sample_pool_<name>. The arrays live in .bss, so the startup code zeroes them and the
+ *          BLE service context only keeps counters and handles.
+ */
+#define SAMPLE_POOL_REGIONS(X)                                              \
+    X(accl,    short,    SAMPLE_POOL_ACCL_LEN)                              \
+    X(window,  short,    SAMPLE_POOL_WINDOW_LEN)                            \
+    X(power,   short,    SAMPLE_POOL_POWER_LEN)                             \
+    X(package, uint16_t, SAMPLE_POOL_PACKAGE_LEN)                           \
+    X(live,    uint16_t, SAMPLE_POOL_LIVE_LEN + SAMPLE_POOL_LIVE_STAMP_LEN) \
+    X(soa_x,   int16_t,  SAMPLE_POOL_SOA_LEN)                               \
+    X(soa_y,   int16_t,  SAMPLE_POOL_SOA_LEN)                               \
+    X(soa_z,   int16_t,  SAMPLE_POOL_SOA_LEN)
+
+#define SAMPLE_POOL_EXTERN(_name, _type, _len)  extern _type sample_pool_ ## _name[_len];
+SAMPLE_POOL_REGIONS(SAMPLE_POOL_EXTERN)
+#undef SAMPLE_POOL_EXTERN
+
+#define SAMPLE_POOL_REGION_SIZE(_name, _type, _len)  + sizeof(_type) * (_len)
+#define SAMPLE_POOL_SIZE    (0 SAMPLE_POOL_REGIONS(SAMPLE_POOL_REGION_SIZE))
+
+/**@brief Description of one pool region, used for the memory report. */
+typedef struct
+{
+    char const * p_name;                                                    /**< Region name as given in SAMPLE_POOL_REGIONS. */
+    void       * p_base;                                                    /**< Start of the region. */
+    size_t       size;                                                      /**< Region size in bytes. */
+} sample_pool_region_t;
+
+/**@brief Table of all pool regions, in the order of SAMPLE_POOL_REGIONS. */
+extern sample_pool_region_t const sample_pool_regions[];
+
+/**@brief Number of entries in @ref sample_pool_regions. */
+extern size_t const sample_pool_region_count;
+
+/**@brief Function for logging the size of every pool region and the pool total.
+ *
+ * @details The same numbers are available at build time with "make pool_report".
+ */
+void sample_pool_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_POOL_H__
@@ -0,0 +1,214 @@
+#include "sdk_common.h"
+#include "sample_soa.h"
+#include <math.h>
+#include "nrf.h"
+#include "nrf_log.h"
+
+static int16_t * const m_axes[SAMPLE_SOA_AXIS_COUNT] =
+{
+    sample_pool_soa_x,
+    sample_pool_soa_y,
+    sample_pool_soa_z
+};
+
+static uint16_t m_head;                                                     /**< Next write position, also the oldest sample of the window. */
+
+
+void sample_soa_push(int16_t x, int16_t y, int16_t z)
+{
+    uint16_t mirror = m_head + SAMPLE_SOA_WINDOW_LEN;
+
+    sample_pool_soa_x[m_head] = x;
+    sample_pool_soa_x[mirror] = x;
+    sample_pool_soa_y[m_head] = y;
+    sample_pool_soa_y[mirror] = y;
+    sample_pool_soa_z[m_head] = z;
+    sample_pool_soa_z[mirror] = z;
+
+    m_head = (m_head + 1) % SAMPLE_SOA_WINDOW_LEN;
+}
+
+
+int16_t const * sample_soa_axis(sample_soa_axis_t axis)
+{
+    return &m_axes[axis][m_head];
+}
+
+
+uint32_t sample_soa_interleave(uint32_t first, uint32_t count, int16_t * p_out)
+{
+    if (first >= SAMPLE_SOA_WINDOW_LEN)
+    {
+        return 0;
+    }
+    count = MIN(count, SAMPLE_SOA_WINDOW_LEN - first);
+
+    int16_t const * p_x = sample_soa_axis(SAMPLE_SOA_AXIS_X) + first;
+    int16_t const * p_y = sample_soa_axis(SAMPLE_SOA_AXIS_Y) + first;
+    int16_t const * p_z = sample_soa_axis(SAMPLE_SOA_AXIS_Z) + first;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        *p_out++ = p_x[i];
+        *p_out++ = p_y[i];
+        *p_out++ = p_z[i];
+    }
+    return count;
+}
+
+
+void sample_soa_magnitude(uint16_t * p_out)
+{
+    int16_t const * p_x = sample_soa_axis(SAMPLE_SOA_AXIS_X);
+    int16_t const * p_y = sample_soa_axis(SAMPLE_SOA_AXIS_Y);
+    int16_t const * p_z = sample_soa_axis(SAMPLE_SOA_AXIS_Z);
+
+    for (uint32_t i = 0; i < SAMPLE_SOA_WINDOW_LEN; i++)
+    {
+        int32_t sq = p_x[i] * p_x[i] + p_y[i] * p_y[i] + p_z[i] * p_z[i];
+        p_out[i]   = (uint16_t)sqrtf((float)sq);
+    }
+}
+
+
+/**@brief Two adjacent 16-bit values read as one word, without assuming word alignment. */
+typedef struct
+{
+    uint32_t word;
+} __PACKED pair_t;
+
+
+/**@brief Function for multiplying two pairs of 16-bit values and adding both products to acc.
+ */
+static __INLINE int32_t dual_mac(int16_t const * p_a, int16_t const * p_b, int32_t acc)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    // The window can start at any sample, so the pairs may be only halfword aligned.
+    uint32_t a = ((pair_t const *)p_a)->word;
+    uint32_t b = ((pair_t const *)p_b)->word;
+
+    return (int32_t)__SMLAD(a, b, (uint32_t)acc);
+#else
+    return acc + p_a[0] * p_b[0] + p_a[1] * p_b[1];
+#endif
+}
+
+
+uint32_t sample_soa_fir(sample_soa_axis_t axis, int16_t const * p_coeffs, uint32_t taps, int16_t * p_out)
+{
+    if ((taps == 0) || (taps % 2) || (taps > SAMPLE_SOA_FIR_MAX_TAPS))
+    {
+        return 0;
+    }
+
+    int16_t const * p_in  = sample_soa_axis(axis);
+    uint32_t        count = SAMPLE_SOA_WINDOW_LEN - taps + 1;
+
+    for (uint32_t n = 0; n < count; n++)
+    {
+        int32_t acc = 0;
+        for (uint32_t k = 0; k < taps; k += 2)
+        {
+            acc = dual_mac(&p_coeffs[k], &p_in[n + k], acc);
+        }
+        acc = acc >> 15;
+        p_out[n] = (int16_t)MAX(MIN(acc, INT16_MAX), INT16_MIN);
+    }
+    return count;
+}
+
+
+void sample_aos_magnitude(int16_t const * p_ring, uint16_t head, uint16_t * p_out)
+{
+    for (uint32_t i = 0; i < SAMPLE_SOA_WINDOW_LEN; i++)
+    {
+        int32_t x = p_ring[(head + i * 3)     % SAMPLE_POOL_WINDOW_LEN];
+        int32_t y = p_ring[(head + i * 3 + 1) % SAMPLE_POOL_WINDOW_LEN];
+        int32_t z = p_ring[(head + i * 3 + 2) % SAMPLE_POOL_WINDOW_LEN];
+
+        p_out[i] = (uint16_t)sqrtf((float)(x * x + y * y + z * z));
+    }
+}
+
+
+uint32_t sample_aos_fir(int16_t const * p_ring, uint16_t head, sample_soa_axis_t axis,
+                        int16_t const * p_coeffs, uint32_t taps, int16_t * p_out)
+{
+    if ((taps == 0) || (taps % 2) || (taps > SAMPLE_SOA_FIR_MAX_TAPS))
+    {
+        return 0;
+    }
+
+    uint32_t count = SAMPLE_SOA_WINDOW_LEN - taps + 1;
+
+    for (uint32_t n = 0; n < count; n++)
+    {
+        int32_t acc = 0;
+        for (uint32_t k = 0; k < taps; k++)
+        {
+            acc += p_coeffs[k] * p_ring[(head + (n + k) * 3 + axis) % SAMPLE_POOL_WINDOW_LEN];
+        }
+        acc = acc >> 15;
+        p_out[n] = (int16_t)MAX(MIN(acc, INT16_MAX), INT16_MIN);
+    }
+    return count;
+}
+
+
+#if SAMPLE_SOA_BENCHMARK_ENABLED
+
+#define BENCHMARK_TAPS  8
+
+static uint32_t cycles_since(uint32_t start)
+{
+    return DWT->CYCCNT - start;
+}
+
+
+void sample_soa_benchmark(int16_t const * p_ring, uint16_t head)
+{
+    static uint16_t magnitude[SAMPLE_SOA_WINDOW_LEN];
+    static int16_t  filtered[SAMPLE_SOA_WINDOW_LEN];
+
+    // 8-tap moving average in Q15.
+    static int16_t const coeffs[BENCHMARK_TAPS] =
+    {
+        4096, 4096, 4096, 4096, 4096, 4096, 4096, 4096
+    };
+
+    uint32_t start;
+    uint32_t aos_mag;
+    uint32_t soa_mag;
+    uint32_t aos_fir;
+    uint32_t soa_fir;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+    start = DWT->CYCCNT;
+    sample_aos_magnitude(p_ring, head, magnitude);
+    aos_mag = cycles_since(start);
+
+    start = DWT->CYCCNT;
+    sample_soa_magnitude(magnitude);
+    soa_mag = cycles_since(start);
+
+    start = DWT->CYCCNT;
+    for (uint32_t axis = 0; axis < SAMPLE_SOA_AXIS_COUNT; axis++)
+    {
+        (void)sample_aos_fir(p_ring, head, (sample_soa_axis_t)axis, coeffs, BENCHMARK_TAPS, filtered);
+    }
+    aos_fir = cycles_since(start);
+
+    start = DWT->CYCCNT;
+    for (uint32_t axis = 0; axis < SAMPLE_SOA_AXIS_COUNT; axis++)
+    {
+        (void)sample_soa_fir((sample_soa_axis_t)axis, coeffs, BENCHMARK_TAPS, filtered);
+    }
+    soa_fir = cycles_since(start);
+
+    NRF_LOG_INFO("Magnitude cycles: interleaved %d, SoA %d.", aos_mag, soa_mag);
+    NRF_LOG_INFO("FIR x3 cycles: interleaved %d, SoA %d.", aos_fir, soa_fir);
+}
+
+#endif // SAMPLE_SOA_BENCHMARK_ENABLED
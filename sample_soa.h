@@ -0,0 +1,113 @@
+#ifndef SAMPLE_SOA_H__
+#define SAMPLE_SOA_H__
+
+#include <stdint.h>
+#include "app_util.h"
+#include "sample_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Struct-of-arrays window of the last accelerometer samples.
+ *
+ * @details Each axis has its own ring in the sample pool. Every sample is written twice, at
+ *          head and at head + SAMPLE_SOA_WINDOW_LEN, so the whole window is always one contiguous,
+ *          oldest-first array per axis and the kernels below never wrap an index. The
+ *          interleaved x,y,z wire format is produced on demand by @ref sample_soa_interleave.
+ */
+
+#define SAMPLE_SOA_WINDOW_LEN       (SAMPLE_POOL_SOA_LEN / 2)               /**< Samples per axis in the window. */
+#define SAMPLE_SOA_FIR_MAX_TAPS     16                                      /**< Maximum FIR length accepted by the filter kernels. */
+
+#ifndef SAMPLE_SOA_BENCHMARK_ENABLED
+#define SAMPLE_SOA_BENCHMARK_ENABLED 0                                      /**< Build @ref sample_soa_benchmark, e.g. with CFLAGS += -DSAMPLE_SOA_BENCHMARK_ENABLED=1. */
+#endif
+
+STATIC_ASSERT((SAMPLE_SOA_WINDOW_LEN % 2) == 0);
+
+/**@brief Accelerometer axes. */
+typedef enum
+{
+    SAMPLE_SOA_AXIS_X,
+    SAMPLE_SOA_AXIS_Y,
+    SAMPLE_SOA_AXIS_Z,
+    SAMPLE_SOA_AXIS_COUNT
+} sample_soa_axis_t;
+
+/**@brief Function for appending one x,y,z sample to the window, dropping the oldest one.
+ */
+void sample_soa_push(int16_t x, int16_t y, int16_t z);
+
+/**@brief Function for getting the window of one axis.
+ *
+ * @return Pointer to SAMPLE_SOA_WINDOW_LEN contiguous samples, oldest first.
+ */
+int16_t const * sample_soa_axis(sample_soa_axis_t axis);
+
+/**@brief Function for copying samples out of the window in the interleaved x,y,z wire format.
+ *
+ * @param[in]  first    Index of the first sample, 0 being the oldest in the window.
+ * @param[in]  count    Number of x,y,z samples to copy.
+ * @param[out] p_out    Destination, 3 * count values.
+ *
+ * @return Number of samples copied, clipped to the end of the window.
+ */
+uint32_t sample_soa_interleave(uint32_t first, uint32_t count, int16_t * p_out);
+
+/**@brief Function for computing the acceleration magnitude of every sample in the window.
+ *
+ * @param[out] p_out    SAMPLE_SOA_WINDOW_LEN magnitudes, oldest first.
+ */
+void sample_soa_magnitude(uint16_t * p_out);
+
+/**@brief Function for running a Q15 FIR filter over one axis of the window.
+ *
+ * @details Output n is sum(p_coeffs[k] * axis[n + k]) >> 15, saturated to 16 bits, for the
+ *          SAMPLE_SOA_WINDOW_LEN - taps + 1 positions where the filter fits in the window.
+ *          The sum is kept in 32 bits, so the gain (sum of |p_coeffs[k]| / 32768) has to stay
+ *          below 65536 / max|sample|, e.g. 8 for samples up to 8 g.
+ *          Coefficient and sample pairs are multiplied with the dual 16-bit SMLAD instruction
+ *          when the core has the DSP extension.
+ *
+ * @param[in]  axis     Axis to filter.
+ * @param[in]  p_coeffs Filter coefficients in Q15.
+ * @param[in]  taps     Number of coefficients, even and at most SAMPLE_SOA_FIR_MAX_TAPS.
+ * @param[out] p_out    Filtered samples.
+ *
+ * @return Number of output samples, or 0 if taps is not valid.
+ */
+uint32_t sample_soa_fir(sample_soa_axis_t axis, int16_t const * p_coeffs, uint32_t taps, int16_t * p_out);
+
+/**@brief Function for computing magnitudes from an interleaved x,y,z ring.
+ *
+ * @details Reference for @ref sample_soa_magnitude on the @ref sample_pool_window layout.
+ *
+ * @param[in]  p_ring   Interleaved ring of SAMPLE_POOL_WINDOW_LEN values.
+ * @param[in]  head     Next write position in the ring, i.e. the oldest x value.
+ * @param[out] p_out    SAMPLE_SOA_WINDOW_LEN magnitudes, oldest first.
+ */
+void sample_aos_magnitude(int16_t const * p_ring, uint16_t head, uint16_t * p_out);
+
+/**@brief Function for running a Q15 FIR filter over one axis of an interleaved x,y,z ring.
+ *
+ * @details Reference for @ref sample_soa_fir on the @ref sample_pool_window layout.
+ */
+uint32_t sample_aos_fir(int16_t const * p_ring, uint16_t head, sample_soa_axis_t axis,
+                        int16_t const * p_coeffs, uint32_t taps, int16_t * p_out);
+
+#if SAMPLE_SOA_BENCHMARK_ENABLED
+/**@brief Function for timing the magnitude and filter kernels on both layouts.
+ *
+ * @details Uses the DWT cycle counter and logs the cycle count of each kernel.
+ */
+void sample_soa_benchmark(int16_t const * p_ring, uint16_t head);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_SOA_H__
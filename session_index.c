@@ -0,0 +1,275 @@
+#include "sdk_common.h"
+#include "session_index.h"
+#include "flash_log.h"
+#include "sample_block.h"
+#include "nrf_log.h"
+
+/**@brief One indexed session. */
+typedef struct
+{
+    uint16_t id;
+    uint32_t first_block;
+    uint32_t last_block;
+    uint32_t start_ms;
+    uint32_t last_ms;
+    uint32_t first_entry;                                                   /**< Entry number of the first block, counted over all sessions. */
+    uint32_t epoch_start_s;
+} session_t;
+
+/**@brief A point of the time to block mapping. */
+typedef struct
+{
+    uint32_t block;
+    uint32_t time_ms;                                                       /**< Relative to the session start. */
+} point_t;
+
+static uint32_t  m_entries[SESSION_INDEX_ENTRY_COUNT];                      /**< Local time of every SESSION_INDEX_INTERVAL-th block. */
+static uint32_t  m_entry_total;                                             /**< Entries written since boot. */
+static session_t m_sessions[SESSION_INDEX_SESSION_COUNT];
+static uint16_t  m_session_total;                                           /**< Sessions started since boot. */
+static bool      m_epoch_synced;
+static uint32_t  m_epoch_at_boot_s;                                         /**< Wall-clock time at local time 0. */
+static uint32_t  m_boot_block;                                              /**< First block of this boot, set by session_index_rebuild. */
+
+
+static session_t * session_current(void)
+{
+    if (m_session_total == 0)
+    {
+        return NULL;
+    }
+    return &m_sessions[(m_session_total - 1) % SESSION_INDEX_SESSION_COUNT];
+}
+
+
+static void entry_add(uint32_t time_ms)
+{
+    m_entries[m_entry_total % SESSION_INDEX_ENTRY_COUNT] = time_ms;
+    m_entry_total++;
+}
+
+
+/**@brief Function for finding an indexed session.
+ *
+ * @param[out] p_first_entry    First entry of the session that was not overwritten yet.
+ * @param[out] p_entry_count    Number of entries of the session that were not overwritten yet.
+ */
+static session_t const * session_find(uint16_t id, uint32_t * p_first_entry, uint32_t * p_entry_count)
+{
+    if ((id >= m_session_total) || (m_session_total - id > SESSION_INDEX_SESSION_COUNT))
+    {
+        return NULL;
+    }
+
+    session_t const * p_session = &m_sessions[id % SESSION_INDEX_SESSION_COUNT];
+    uint32_t          end       = p_session->first_entry
+                                  + (p_session->last_block - p_session->first_block) / SESSION_INDEX_INTERVAL
+                                  + 1;
+    uint32_t          first     = p_session->first_entry;
+    uint32_t          tail      = flash_log_tail();
+
+    if (m_entry_total > SESSION_INDEX_ENTRY_COUNT)
+    {
+        first = MAX(first, m_entry_total - SESSION_INDEX_ENTRY_COUNT);
+    }
+    if (tail > p_session->first_block)
+    {
+        // Blocks the flash log erased since they were indexed.
+        first = MAX(first, p_session->first_entry + CEIL_DIV(tail - p_session->first_block, SESSION_INDEX_INTERVAL));
+    }
+    if (first >= end)
+    {
+        return NULL;
+    }
+
+    *p_first_entry = first;
+    *p_entry_count = end - first;
+    return p_session;
+}
+
+
+static point_t entry_point(session_t const * p_session, uint32_t entry)
+{
+    point_t point;
+
+    point.block   = p_session->first_block + (entry - p_session->first_entry) * SESSION_INDEX_INTERVAL;
+    point.time_ms = m_entries[entry % SESSION_INDEX_ENTRY_COUNT] - p_session->start_ms;
+    return point;
+}
+
+
+/**@brief Function for finding the first block recorded at or after a time.
+ */
+static uint32_t block_at(session_t const * p_session, uint32_t first_entry, uint32_t entry_count,
+                         uint32_t time_ms)
+{
+    point_t first = entry_point(p_session, first_entry);
+    point_t last  = {p_session->last_block, p_session->last_ms - p_session->start_ms};
+
+    if (time_ms <= first.time_ms)
+    {
+        return first.block;
+    }
+    if (time_ms > last.time_ms)
+    {
+        return last.block + 1;
+    }
+
+    // Last entry at or before time_ms.
+    uint32_t lo = 0;
+    uint32_t hi = entry_count - 1;
+
+    while (lo < hi)
+    {
+        uint32_t mid = (lo + hi + 1) / 2;
+
+        if (entry_point(p_session, first_entry + mid).time_ms <= time_ms)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    point_t before = entry_point(p_session, first_entry + lo);
+    point_t after  = (lo + 1 < entry_count) ? entry_point(p_session, first_entry + lo + 1) : last;
+
+    if (after.time_ms <= before.time_ms)
+    {
+        return before.block;
+    }
+
+    uint32_t span = after.time_ms - before.time_ms;
+    return before.block + CEIL_DIV((time_ms - before.time_ms) * (after.block - before.block), span);
+}
+
+
+uint16_t session_index_start(uint32_t first_block, uint32_t time_ms)
+{
+    session_t * p_session = &m_sessions[m_session_total % SESSION_INDEX_SESSION_COUNT];
+
+    p_session->id            = m_session_total;
+    p_session->first_block   = first_block;
+    p_session->last_block    = first_block;
+    p_session->start_ms      = time_ms;
+    p_session->last_ms       = time_ms;
+    p_session->first_entry   = m_entry_total;
+    p_session->epoch_start_s = (m_epoch_synced && (first_block >= m_boot_block))
+                               ? m_epoch_at_boot_s + time_ms / 1000
+                               : SESSION_INDEX_EPOCH_UNKNOWN;
+    entry_add(time_ms);
+
+    return m_session_total++;
+}
+
+
+void session_index_block_add(uint32_t block, uint32_t time_ms)
+{
+    session_t * p_session = session_current();
+
+    if ((p_session == NULL)
+        || (block != p_session->last_block + 1)
+        || (block == m_boot_block)
+        || (time_ms < p_session->last_ms)
+        || (time_ms - p_session->last_ms > SESSION_INDEX_MAX_GAP_MS))
+    {
+        (void)session_index_start(block, time_ms);
+        return;
+    }
+
+    p_session->last_block = block;
+    p_session->last_ms    = time_ms;
+
+    if (((block - p_session->first_block) % SESSION_INDEX_INTERVAL) == 0)
+    {
+        entry_add(time_ms);
+    }
+}
+
+
+void session_index_rebuild(void)
+{
+    uint8_t  data[FLASH_LOG_DATA_SIZE];
+    uint16_t len;
+    uint32_t indexed = 0;
+
+    m_boot_block = flash_log_head();
+
+    for (uint32_t block = flash_log_tail(); block < m_boot_block; block++)
+    {
+        // Torn blocks are skipped, so they end a session like a block dropped while recording.
+        if ((flash_log_read(block, data, &len) == NRF_SUCCESS) && (len == SAMPLE_BLOCK_LEN))
+        {
+            uint32_t time_ms = uint32_decode(&data[SAMPLE_BLOCK_LEN - SAMPLE_BLOCK_TIMESTAMP_LEN]);
+
+            session_index_block_add(block, time_ms);
+            indexed++;
+        }
+    }
+
+    NRF_LOG_INFO("Session index rebuilt: %d blocks in %d sessions.", indexed, m_session_total);
+}
+
+
+void session_index_epoch_set(uint32_t epoch_s, uint32_t now_ms)
+{
+    m_epoch_synced    = true;
+    m_epoch_at_boot_s = epoch_s - now_ms / 1000;
+
+    for (uint32_t i = 0; i < MIN(m_session_total, SESSION_INDEX_SESSION_COUNT); i++)
+    {
+        if (m_sessions[i].first_block >= m_boot_block)
+        {
+            m_sessions[i].epoch_start_s = m_epoch_at_boot_s + m_sessions[i].start_ms / 1000;
+        }
+    }
+}
+
+
+ret_code_t session_index_info(uint16_t id, session_index_info_t * p_info)
+{
+    uint32_t          first_entry;
+    uint32_t          entry_count;
+    session_t const * p_session = session_find(id, &first_entry, &entry_count);
+
+    if (p_session == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    p_info->id            = p_session->id;
+    p_info->first_block   = MAX(p_session->first_block, flash_log_tail());
+    p_info->block_count   = p_session->last_block - p_info->first_block + 1;
+    p_info->duration_ms   = p_session->last_ms - p_session->start_ms;
+    p_info->epoch_start_s = p_session->epoch_start_s;
+    return NRF_SUCCESS;
+}
+
+
+ret_code_t session_index_lookup(uint16_t id, uint32_t from_ms, uint32_t to_ms,
+                                uint32_t * p_first, uint32_t * p_count)
+{
+    uint32_t          first_entry;
+    uint32_t          entry_count;
+    session_t const * p_session;
+
+    if (from_ms > to_ms)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_session = session_find(id, &first_entry, &entry_count);
+    if (p_session == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    uint32_t first = block_at(p_session, first_entry, entry_count, from_ms);
+    uint32_t end   = block_at(p_session, first_entry, entry_count, to_ms);
+
+    *p_first = first;
+    *p_count = end - first;
+    return NRF_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#ifndef SESSION_INDEX_H__
+#define SESSION_INDEX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+#include "sample_block.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Time index over the sample blocks stored in the flash log.
+ *
+ * @details A session is a run of consecutive block numbers (flash log sequence numbers). For
+ *          every SESSION_INDEX_INTERVAL blocks the local time of the block is kept, so the
+ *          block number of an index entry is implicit and an entry is 4 bytes. A time range is
+ *          turned into a block range with one binary search per bound and linear interpolation
+ *          between the two surrounding entries.
+ *
+ *          Times are local milliseconds since boot (see local_clock.h). Once a client provides the
+ *          wall-clock time, the epoch time of the session start is stored with the session.
+ *
+ *          Blocks the flash log erased are left out of the sessions: a lookup starts at the first
+ *          index entry the flash log still holds.
+ *
+ *          The index lives in RAM. At boot session_index_rebuild indexes the blocks still in the
+ *          flash log again from their sequence numbers and stored local times. The local clock
+ *          starts over at boot, so a block whose time does not follow the block before ends the
+ *          session, and sessions of earlier boots keep SESSION_INDEX_EPOCH_UNKNOWN.
+ */
+
+#define SESSION_INDEX_INTERVAL      16                                      /**< Blocks between index entries (96 s of recording). */
+#define SESSION_INDEX_ENTRY_COUNT   256                                     /**< Entries kept over all sessions; covers more blocks than the flash log holds. */
+#define SESSION_INDEX_SESSION_COUNT 8                                       /**< Most recent sessions kept. */
+
+#define SESSION_INDEX_MAX_GAP_MS    (SAMPLE_BLOCK_PERIOD_MS * 3 / 2)        /**< Longer gaps between blocks end a session; blocks of a recording are SAMPLE_BLOCK_PERIOD_MS apart, recordings at least two periods. */
+
+#define SESSION_INDEX_EPOCH_UNKNOWN 0                                       /**< Epoch start of a session that was never synced. */
+
+/**@brief Information about one session. */
+typedef struct
+{
+    uint16_t id;                                                            /**< Session number, incremented for every new session. */
+    uint32_t first_block;                                                   /**< First block of the session. */
+    uint32_t block_count;                                                   /**< Blocks added to the session so far. */
+    uint32_t duration_ms;                                                   /**< Time between the first and the last block. */
+    uint32_t epoch_start_s;                                                 /**< Wall-clock time of the first block, or SESSION_INDEX_EPOCH_UNKNOWN. */
+} session_index_info_t;
+
+/**@brief Function for starting a new session.
+ *
+ * @param[in] first_block   Block number the session starts at.
+ * @param[in] time_ms       Local time of the first block.
+ *
+ * @return Number of the new session.
+ */
+uint16_t session_index_start(uint32_t first_block, uint32_t time_ms);
+
+/**@brief Function for indexing the sample blocks stored in the flash log.
+ *
+ * @details Reads every block from the flash log tail to its head, so call it once at boot, after
+ *          flash_log_init and before the first block of this boot is added.
+ */
+void session_index_rebuild(void);
+
+/**@brief Function for adding a block to the current session.
+ *
+ * @details Starts a new session if the block does not directly follow the previous one in number
+ *          and time (at most SESSION_INDEX_MAX_GAP_MS later), or is the first block of this boot.
+ */
+void session_index_block_add(uint32_t block, uint32_t time_ms);
+
+/**@brief Function for recording the wall-clock time.
+ *
+ * @details The sessions of this boot share the local clock, so this stores the epoch time of the
+ *          start of every indexed session of this boot and of the sessions started later.
+ *
+ * @param[in] epoch_s   Current wall-clock time, in seconds since 1970.
+ * @param[in] now_ms    Local time the wall-clock time refers to.
+ */
+void session_index_epoch_set(uint32_t epoch_s, uint32_t now_ms);
+
+/**@brief Function for getting information about a session.
+ *
+ * @retval NRF_SUCCESS          Information returned.
+ * @retval NRF_ERROR_NOT_FOUND  The session is not (or no longer) indexed.
+ */
+ret_code_t session_index_info(uint16_t id, session_index_info_t * p_info);
+
+/**@brief Function for looking up the blocks recorded in a time range of a session.
+ *
+ * @param[in]  id           Session number.
+ * @param[in]  from_ms      Start of the range, relative to the session start.
+ * @param[in]  to_ms        End of the range (exclusive), relative to the session start.
+ * @param[out] p_first      First block in the range.
+ * @param[out] p_count      Number of blocks in the range.
+ *
+ * @retval NRF_SUCCESS              Block range returned; it can be empty.
+ * @retval NRF_ERROR_INVALID_PARAM  from_ms is after to_ms.
+ * @retval NRF_ERROR_NOT_FOUND      The session is not (or no longer) indexed.
+ */
+ret_code_t session_index_lookup(uint16_t id, uint32_t from_ms, uint32_t to_ms,
+                                uint32_t * p_first, uint32_t * p_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SESSION_INDEX_H__
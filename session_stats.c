@@ -0,0 +1,194 @@
+#include "session_stats.h"
+#include <string.h>
+#include "time_sync.h"
+
+/**@brief Running sums of the session going on. */
+typedef struct
+{
+    uint32_t start_ms;                                                      /**< Local start of the first stride. */
+    uint32_t last_ms;                                                       /**< Local end of the last stride. */
+    uint32_t moving_ms;
+    uint32_t steps;
+    uint64_t power_sum;                                                     /**< Power times duration. */
+    uint32_t gct_sum;
+    uint32_t vertical_osc_sum;
+    uint16_t power_max;
+    uint32_t zone_ms[SESSION_STATS_ZONE_COUNT];
+    uint32_t power_bins[SESSION_STATS_POWER_BINS];                          /**< Moving time in each power bin. */
+} session_t;
+
+static const uint16_t          m_zone_bounds[SESSION_STATS_ZONE_COUNT - 1] = SESSION_STATS_ZONE_BOUNDS;
+
+static session_t               m_session;
+static bool                    m_active;
+static session_stats_summary_t m_last;                                      /**< Last session kept. */
+static bool                    m_last_valid;
+static uint16_t                m_next_id;                                   /**< Number of the next session kept. */
+
+
+/**@brief Function for getting the power at a percentile of the moving time.
+ *
+ * @details Finds the bin the percentile falls into and interpolates linearly within it. The last
+ *          bin has no upper end, so the maximum is taken for it.
+ */
+static uint16_t power_percentile(uint8_t percent)
+{
+    uint64_t target = (uint64_t)m_session.moving_ms * percent / 100;
+    uint64_t below  = 0;
+
+    for (uint8_t bin = 0; bin < SESSION_STATS_POWER_BINS; bin++)
+    {
+        uint32_t weight = m_session.power_bins[bin];
+
+        if ((weight > 0) && (below + weight >= target))
+        {
+            uint32_t low   = (uint32_t)bin * SESSION_STATS_POWER_BIN_WIDTH;
+            uint32_t high  = (bin == SESSION_STATS_POWER_BINS - 1) ? m_session.power_max
+                                                                   : low + SESSION_STATS_POWER_BIN_WIDTH;
+            uint32_t power = low + (uint32_t)((high - low) * (target - below) / weight);
+
+            return (power < m_session.power_max) ? (uint16_t)power : m_session.power_max;
+        }
+        below += weight;
+    }
+    return m_session.power_max;
+}
+
+
+/**@brief Function for building the summary of the session going on.
+ */
+static void summary_build(session_stats_summary_t * p_summary)
+{
+    memset(p_summary, 0, sizeof(*p_summary));
+
+    p_summary->id         = m_next_id;
+    p_summary->flags      = SESSION_STATS_FLAG_ACTIVE;
+    p_summary->start      = m_session.start_ms;
+    p_summary->elapsed_ms = m_session.last_ms - m_session.start_ms;
+    p_summary->moving_ms  = m_session.moving_ms;
+    p_summary->steps      = m_session.steps;
+    p_summary->power_max  = m_session.power_max;
+    memcpy(p_summary->zone_ms, m_session.zone_ms, sizeof(p_summary->zone_ms));
+
+    if (time_sync_is_synced())
+    {
+        p_summary->flags |= SESSION_STATS_FLAG_SYNCED;
+        p_summary->start  = time_sync_stamp(m_session.start_ms);
+    }
+
+    if (m_session.moving_ms > 0)
+    {
+        p_summary->cadence   = (uint16_t)((uint64_t)m_session.steps * 60000 / m_session.moving_ms);
+        p_summary->power_avg = (uint16_t)(m_session.power_sum / m_session.moving_ms);
+        p_summary->power_p50 = power_percentile(50);
+        p_summary->power_p90 = power_percentile(90);
+    }
+    if (m_session.steps > 0)
+    {
+        p_summary->gct_ms          = (uint16_t)(m_session.gct_sum / m_session.steps);
+        p_summary->vertical_osc_mm = (uint16_t)(m_session.vertical_osc_sum / m_session.steps);
+    }
+}
+
+
+/**@brief Function for ending the session going on. */
+static session_stats_tick_t session_end(void)
+{
+    m_active = false;
+    if (m_session.moving_ms < SESSION_STATS_MIN_MOVING_MS)
+    {
+        return SESSION_STATS_DROPPED;
+    }
+
+    summary_build(&m_last);
+    m_last.flags &= ~SESSION_STATS_FLAG_ACTIVE;
+    m_last_valid  = true;
+    m_next_id++;
+    return SESSION_STATS_ENDED;
+}
+
+
+void session_stats_stride_add(stride_events_record_t const * p_stride)
+{
+    uint32_t start_ms = p_stride->local_ms - p_stride->duration_ms;
+    uint8_t  bin      = p_stride->power / SESSION_STATS_POWER_BIN_WIDTH;
+    uint8_t  zone     = 0;
+
+    if (m_active && ((int32_t)(start_ms - m_session.last_ms) >= SESSION_STATS_IDLE_MS))
+    {
+        // The tick missed the end.
+        (void)session_end();
+    }
+    if (!m_active)
+    {
+        memset(&m_session, 0, sizeof(m_session));
+        m_session.start_ms = start_ms;
+        m_active           = true;
+    }
+
+    if (bin >= SESSION_STATS_POWER_BINS)
+    {
+        bin = SESSION_STATS_POWER_BINS - 1;
+    }
+    while ((zone < SESSION_STATS_ZONE_COUNT - 1) && (p_stride->power >= m_zone_bounds[zone]))
+    {
+        zone++;
+    }
+
+    m_session.last_ms           = p_stride->local_ms;
+    m_session.moving_ms        += p_stride->duration_ms;
+    m_session.steps++;
+    m_session.power_sum        += (uint64_t)p_stride->power * p_stride->duration_ms;
+    m_session.gct_sum          += p_stride->gct_ms;
+    m_session.vertical_osc_sum += p_stride->vertical_osc_mm;
+    m_session.zone_ms[zone]    += p_stride->duration_ms;
+    m_session.power_bins[bin]  += p_stride->duration_ms;
+    if (p_stride->power > m_session.power_max)
+    {
+        m_session.power_max = p_stride->power;
+    }
+}
+
+
+session_stats_tick_t session_stats_tick(uint32_t now_ms)
+{
+    if (m_active && ((int32_t)(now_ms - m_session.last_ms) >= SESSION_STATS_IDLE_MS))
+    {
+        return session_end();
+    }
+    return SESSION_STATS_NONE;
+}
+
+
+bool session_stats_active(void)
+{
+    return m_active;
+}
+
+
+bool session_stats_get(session_stats_summary_t * p_summary)
+{
+    if (m_active)
+    {
+        summary_build(p_summary);
+        return true;
+    }
+    if (m_last_valid)
+    {
+        *p_summary = m_last;
+        return true;
+    }
+    return false;
+}
+
+
+void session_stats_restore(session_stats_summary_t const * p_summary)
+{
+    if (!m_last_valid)
+    {
+        m_last        = *p_summary;
+        m_last.flags &= ~SESSION_STATS_FLAG_ACTIVE;
+        m_last_valid  = true;
+    }
+    m_next_id = p_summary->id + 1;
+}
@@ -0,0 +1,102 @@
+#ifndef SESSION_STATS_H__
+#define SESSION_STATS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stride_events.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Summary of a running session, built stride by stride in constant memory.
+ *
+ * @details Fed with the strides of stride_events.h. A stride starts a session, and
+ *          SESSION_STATS_IDLE_MS without one ends it. Sessions moving for less than
+ *          SESSION_STATS_MIN_MOVING_MS are dropped, so the last summary kept stays.
+ *
+ *          Power is the mean magnitude of a stride, in 1/1024 g like the Power characteristic.
+ *          Its average, the percentiles and the zones are weighted with the stride duration,
+ *          so they are over time rather than over strides. The percentiles come from a
+ *          histogram of SESSION_STATS_POWER_BINS bins, interpolated within the bin, so they are
+ *          off by less than SESSION_STATS_POWER_BIN_WIDTH.
+ *
+ *          Moving time is the sum of the stride durations; pauses longer than
+ *          STRIDE_EVENTS_MAX_STRIDE_MS only count to the elapsed time.
+ *
+ *          The module only depends on the C library and time_sync.h, so hosts can build it as it
+ *          is.
+ */
+
+#define SESSION_STATS_IDLE_MS           60000                               /**< Time without a stride that ends a session. */
+#define SESSION_STATS_MIN_MOVING_MS     60000                               /**< Sessions moving for less are dropped. */
+#define SESSION_STATS_POWER_BINS        64
+#define SESSION_STATS_POWER_BIN_WIDTH   64                                  /**< In 1/1024 g; the last bin takes all power above. */
+#define SESSION_STATS_ZONE_COUNT        5
+#define SESSION_STATS_ZONE_BOUNDS       {1152, 1280, 1408, 1536}            /**< Lowest power of zones 2 to 5, in 1/1024 g. */
+
+#define SESSION_STATS_FLAG_ACTIVE       (1 << 0)                            /**< The session is still going on. */
+#define SESSION_STATS_FLAG_SYNCED       (1 << 1)                            /**< The start time is synced, else local. */
+
+/**@brief Session summary. Stored in flash as it is, so it has no padding. */
+typedef struct
+{
+    uint32_t start;                                                         /**< Start time, synced as in time_sync.h, else local ms. */
+    uint32_t elapsed_ms;                                                    /**< Time from the start to the end of the last stride. */
+    uint32_t moving_ms;
+    uint32_t steps;
+    uint32_t zone_ms[SESSION_STATS_ZONE_COUNT];                             /**< Moving time in each power zone. */
+    uint16_t id;                                                            /**< Session number, counts up across resets. */
+    uint16_t flags;                                                         /**< SESSION_STATS_FLAG_*. */
+    uint16_t cadence;                                                       /**< Average steps per minute. */
+    uint16_t power_avg;
+    uint16_t power_max;
+    uint16_t power_p50;
+    uint16_t power_p90;
+    uint16_t gct_ms;                                                        /**< Average ground contact time. */
+    uint16_t vertical_osc_mm;                                               /**< Average vertical oscillation. */
+    uint16_t reserved;
+} session_stats_summary_t;
+
+/**@brief What a tick did. */
+typedef enum
+{
+    SESSION_STATS_NONE,
+    SESSION_STATS_ENDED,                                                    /**< A session ended and is the last summary now. */
+    SESSION_STATS_DROPPED,                                                  /**< A session ended too short; the last summary is the one before. */
+} session_stats_tick_t;
+
+/**@brief Function for adding a stride; starts a session if none is going on. */
+void session_stats_stride_add(stride_events_record_t const * p_stride);
+
+/**@brief Function for ending the session once it is idle.
+ *
+ * @details Call about once a second.
+ *
+ * @param[in]  now_ms   Local time.
+ */
+session_stats_tick_t session_stats_tick(uint32_t now_ms);
+
+/**@brief Function for checking if a session is going on. */
+bool session_stats_active(void);
+
+/**@brief Function for getting the summary of the session going on, else of the last one kept.
+ *
+ * @return False if there was no session yet.
+ */
+bool session_stats_get(session_stats_summary_t * p_summary);
+
+/**@brief Function for restoring the last summary kept, e.g. from flash after a reset.
+ *
+ * @details Sessions are numbered on from it, the one going on too. It does not replace a
+ *          session kept since.
+ */
+void session_stats_restore(session_stats_summary_t const * p_summary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SESSION_STATS_H__
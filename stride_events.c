@@ -0,0 +1,194 @@
+#include "stride_events.h"
+#include <string.h>
+#include <math.h>
+
+#define SMOOTH_TAPS     4                                                   /**< Moving average applied to the magnitude. */
+#define MEAN_TAPS       64.0f                                               /**< Time constant of the running mean, in samples. */
+#define ENVELOPE_TAPS   128.0f                                              /**< Time constant the extremes decay to the mean with, in samples. */
+#define G_MS2           9.81f
+
+/**@brief Stride being measured, since the last peak. */
+typedef struct
+{
+    uint32_t contact_ms;
+    uint32_t magnitude_sum;
+    uint32_t samples;
+    uint16_t peak;
+    uint16_t low;
+} stride_t;
+
+static stride_events_record_t m_ring[STRIDE_EVENTS_RING_SIZE];
+static uint16_t               m_head;                                       /**< Sequence number of the next stride. */
+static uint16_t               m_count;                                      /**< Strides in the ring. */
+
+static uint16_t               m_taps[SMOOTH_TAPS];
+static uint32_t               m_tap_sum;
+static uint8_t                m_tap_next;
+static uint8_t                m_tap_count;
+static float                  m_mean;
+static float                  m_env_max;
+static float                  m_env_min;
+static uint16_t               m_prev[2];                                    /**< Smoothed magnitudes of the two samples before, newest first. */
+static uint32_t               m_prev_ms;                                    /**< Local time of m_prev[0]. */
+static bool                   m_peak_seen;                                  /**< m_last_peak_ms holds a peak. */
+static uint32_t               m_last_peak_ms;
+static stride_t               m_stride;
+
+
+/**@brief Function for smoothing the magnitude with a trailing moving average.
+ */
+static uint16_t magnitude_smooth(uint16_t magnitude)
+{
+    if (m_tap_count == SMOOTH_TAPS)
+    {
+        m_tap_sum -= m_taps[m_tap_next];
+    }
+    else
+    {
+        m_tap_count++;
+    }
+    m_taps[m_tap_next] = magnitude;
+    m_tap_sum         += magnitude;
+    m_tap_next         = (m_tap_next + 1) % SMOOTH_TAPS;
+
+    return (uint16_t)(m_tap_sum / m_tap_count);
+}
+
+
+/**@brief Function for adding the stride that ended at a peak to the ring.
+ */
+static void stride_add(uint32_t peak_ms)
+{
+    stride_events_record_t * p_record = &m_ring[m_head % STRIDE_EVENTS_RING_SIZE];
+    uint32_t                 duration = peak_ms - m_last_peak_ms;
+    uint32_t                 contact  = (m_stride.contact_ms < duration) ? m_stride.contact_ms : duration;
+    float                    flight_s = (float)(duration - contact) / 1000.0f;
+
+    p_record->seq             = m_head;
+    p_record->local_ms        = peak_ms;
+    p_record->duration_ms     = (uint16_t)duration;
+    p_record->gct_ms          = (uint16_t)contact;
+    p_record->vertical_osc_mm = (uint16_t)(G_MS2 * flight_s * flight_s / 8.0f * 1000.0f);
+    p_record->peak_mg         = (uint16_t)((uint32_t)m_stride.peak * 1000 / STRIDE_EVENTS_COUNTS_PER_G);
+    p_record->low_mg          = (uint16_t)((uint32_t)m_stride.low * 1000 / STRIDE_EVENTS_COUNTS_PER_G);
+    p_record->power           = (m_stride.samples > 0) ? (uint16_t)(m_stride.magnitude_sum / m_stride.samples) : 0;
+
+    m_head++;
+    if (m_count < STRIDE_EVENTS_RING_SIZE)
+    {
+        m_count++;
+    }
+}
+
+
+void stride_events_reset(void)
+{
+    memset(m_taps, 0, sizeof(m_taps));
+    m_tap_sum      = 0;
+    m_tap_next     = 0;
+    m_tap_count    = 0;
+    m_mean         = 0;
+    m_env_max      = 0;
+    m_env_min      = 0;
+    m_prev[0]      = 0;
+    m_prev[1]      = 0;
+    m_peak_seen    = false;
+    m_count        = 0;
+    memset(&m_stride, 0, sizeof(m_stride));
+}
+
+
+bool stride_events_push(int16_t x, int16_t y, int16_t z, uint32_t local_ms)
+{
+    float    magnitude = sqrtf((float)x * x + (float)y * y + (float)z * z);
+    uint16_t smoothed  = magnitude_smooth((uint16_t)fminf(magnitude, UINT16_MAX));
+    bool     added     = false;
+
+    if (m_tap_count < SMOOTH_TAPS)
+    {
+        // Settle the averages on the first full set of taps.
+        m_mean    = smoothed;
+        m_env_max = smoothed;
+        m_env_min = smoothed;
+        m_prev[1] = m_prev[0];
+        m_prev[0] = smoothed;
+        m_prev_ms = local_ms;
+        return false;
+    }
+
+    m_mean    += (smoothed - m_mean) / MEAN_TAPS;
+    m_env_max  = fmaxf(smoothed, m_env_max - (m_env_max - m_mean) / ENVELOPE_TAPS);
+    m_env_min  = fminf(smoothed, m_env_min + (m_mean - m_env_min) / ENVELOPE_TAPS);
+
+    // The sample before is a peak if it is above the threshold and higher than its neighbours.
+    float threshold = m_mean + (m_env_max - m_mean) / 2.0f;
+
+    if ((m_env_max - m_env_min >= STRIDE_EVENTS_MIN_SWING)
+        && (m_prev[0] > threshold) && (m_prev[0] >= m_prev[1]) && (m_prev[0] > smoothed))
+    {
+        uint32_t peak_ms = m_prev_ms;
+
+        if (!m_peak_seen || (peak_ms - m_last_peak_ms > STRIDE_EVENTS_MAX_STRIDE_MS))
+        {
+            m_peak_seen    = true;
+            m_last_peak_ms = peak_ms;
+            memset(&m_stride, 0, sizeof(m_stride));
+        }
+        else if (peak_ms - m_last_peak_ms >= STRIDE_EVENTS_MIN_STEP_MS)
+        {
+            stride_add(peak_ms);
+            added          = true;
+            m_last_peak_ms = peak_ms;
+            memset(&m_stride, 0, sizeof(m_stride));
+        }
+    }
+
+    // The current sample belongs to the stride after any peak found above.
+    if (smoothed > STRIDE_EVENTS_COUNTS_PER_G)
+    {
+        m_stride.contact_ms += local_ms - m_prev_ms;
+    }
+    m_stride.magnitude_sum += smoothed;
+    m_stride.samples++;
+    if (smoothed > m_stride.peak)
+    {
+        m_stride.peak = smoothed;
+    }
+    if ((m_stride.samples == 1) || (smoothed < m_stride.low))
+    {
+        m_stride.low = smoothed;
+    }
+
+    if (m_peak_seen && (local_ms - m_last_peak_ms > STRIDE_EVENTS_MAX_STRIDE_MS))
+    {
+        m_peak_seen = false;
+    }
+
+    m_prev[1] = m_prev[0];
+    m_prev[0] = smoothed;
+    m_prev_ms = local_ms;
+    return added;
+}
+
+
+uint16_t stride_events_head(void)
+{
+    return m_head;
+}
+
+
+uint16_t stride_events_oldest(void)
+{
+    return (uint16_t)(m_head - m_count);
+}
+
+
+bool stride_events_get(uint16_t seq, stride_events_record_t * p_record)
+{
+    if ((uint16_t)(m_head - seq - 1) >= m_count)
+    {
+        return false;
+    }
+    *p_record = m_ring[seq % STRIDE_EVENTS_RING_SIZE];
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef STRIDE_EVENTS_H__
+#define STRIDE_EVENTS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Step by step detection of strides, kept in a ring for clients to catch up.
+ *
+ * @details Works sample by sample. A stride is the time from one step peak to the next, at
+ *          least STRIDE_EVENTS_MIN_STEP_MS. The acceleration magnitude is smoothed with a short
+ *          moving average; the peak threshold is the middle between its running mean and a
+ *          decaying maximum. Ground contact is the time the magnitude stays above 1 g, the rest
+ *          of the stride is flight, and the vertical oscillation is g * t_flight^2 / 8.
+ *
+ *          This is the only step detector: running_metrics.h derives cadence, steps and distance
+ *          from the strides, and session_stats.h sums them up per session.
+ *
+ *          Every stride gets the next sequence number. The last STRIDE_EVENTS_RING_SIZE strides
+ *          stay in a ring, so a client that lost the link asks for the ones it missed by number.
+ *
+ *          Times are local milliseconds; see time_sync.h for converting them. The module only
+ *          depends on the C library, so hosts can build it as it is.
+ */
+
+#define STRIDE_EVENTS_RING_SIZE         64                                  /**< Strides kept, about 20 s of running; a power of two. */
+#define STRIDE_EVENTS_MAX_STRIDE_MS     2000                                /**< Longer gaps between peaks are pauses, not strides. */
+#define STRIDE_EVENTS_MIN_STEP_MS       240                                 /**< Minimum step period (250 steps/min). */
+#define STRIDE_EVENTS_COUNTS_PER_G      1024                                /**< Unit of the samples, the MMA8452 2 g range (12 bit). */
+#define STRIDE_EVENTS_MIN_SWING         (STRIDE_EVENTS_COUNTS_PER_G / 5)    /**< Magnitude swing below which the wearer is taken to stand still. */
+
+/**@brief One stride. */
+typedef struct
+{
+    uint16_t seq;                                                           /**< Sequence number, counts up by one per stride. */
+    uint32_t local_ms;                                                      /**< Local time of the peak that ended the stride. */
+    uint16_t duration_ms;                                                   /**< Time since the peak before. */
+    uint16_t gct_ms;                                                        /**< Ground contact time. */
+    uint16_t vertical_osc_mm;                                               /**< Vertical oscillation, 0 without a flight phase. */
+    uint16_t peak_mg;                                                       /**< Highest acceleration magnitude. */
+    uint16_t low_mg;                                                        /**< Lowest acceleration magnitude. */
+    uint16_t power;                                                         /**< Mean acceleration magnitude in 1/1024 g, as the Power characteristic. */
+} stride_events_record_t;
+
+/**@brief Function for dropping the detector state and all strides; numbering goes on. */
+void stride_events_reset(void);
+
+/**@brief Function for adding a sample.
+ *
+ * @param[in]  x, y, z      Sample, in 1/1024 g.
+ * @param[in]  local_ms     Local time of the sample.
+ *
+ * @return True if a stride completed; it is the newest one in the ring.
+ */
+bool stride_events_push(int16_t x, int16_t y, int16_t z, uint32_t local_ms);
+
+/**@brief Function for getting the sequence number the next stride will get. */
+uint16_t stride_events_head(void);
+
+/**@brief Function for getting the sequence number of the oldest stride in the ring. */
+uint16_t stride_events_oldest(void);
+
+/**@brief Function for getting a stride from the ring.
+ *
+ * @return True if the stride is still in the ring.
+ */
+bool stride_events_get(uint16_t seq, stride_events_record_t * p_record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STRIDE_EVENTS_H__
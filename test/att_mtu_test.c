@@ -0,0 +1,206 @@
+/* Checks how ble_cus.c sizes its notifications to the ATT MTU of each link: live packages and bulk
+ * downloads at the default MTU of 23, at 247, on two links with different MTUs, and across an MTU
+ * exchange in the middle of a stream. Runs over the fake SoftDevice of fake_sd.c, which rejects a
+ * notification longer than ATT MTU - 3. */
+#include <string.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "cus_fixture.h"
+#include "sample_pool.h"
+
+#define RECORDED        3000                                                /**< accl_arr values recorded. */
+
+/**@brief Notifications received on one link. */
+typedef struct
+{
+    uint32_t notifications;
+    uint32_t max_len;
+    uint32_t packages;                                                      /**< Live packages, in the order sent. */
+    uint32_t bulk_values;
+    uint32_t errors;                                                        /**< Packages or values not as sent. */
+} rx_t;
+
+static rx_t      m_rx[FAKE_SD_LINK_COUNT];
+static uint16_t  m_package_next;                                            /**< Block index of the next package made. */
+
+
+static void rx_handler(uint16_t conn_handle, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    rx_t * p_rx = &m_rx[conn_handle];
+
+    p_rx->notifications++;
+    p_rx->max_len = MAX(p_rx->max_len, len);
+
+    if (handle == m_cus.package_handles.value_handle)
+    {
+        // Whole packages; the last value of a package is its index.
+        if ((len % (SAMPLE_POOL_PACKAGE_LEN * sizeof(uint16_t))) != 0)
+        {
+            p_rx->errors++;
+        }
+        for (uint16_t i = 0; i + SAMPLE_POOL_PACKAGE_LEN * sizeof(uint16_t) <= len;
+             i += SAMPLE_POOL_PACKAGE_LEN * sizeof(uint16_t))
+        {
+            uint16_t index = uint16_decode(&p_data[i + (SAMPLE_POOL_PACKAGE_LEN - 1) * sizeof(uint16_t)]);
+
+            if (index != (uint16_t)p_rx->packages)
+            {
+                p_rx->errors++;
+            }
+            p_rx->packages++;
+        }
+    }
+    else if (handle == m_cus.bulk_handles.value_handle)
+    {
+        for (uint16_t i = 2; i < len; i += 2)
+        {
+            if ((int16_t)uint16_decode(&p_data[i]) != sample_pool_accl[p_rx->bulk_values])
+            {
+                p_rx->errors++;
+            }
+            p_rx->bulk_values++;
+        }
+    }
+}
+
+
+static void service_start(void)
+{
+    memset(m_rx, 0, sizeof(m_rx));
+    m_package_next = 0;
+
+    cus_fixture_start(NULL, rx_handler, RECORDED);
+    for (uint32_t i = 0; i < RECORDED; i++)
+    {
+        sample_pool_accl[i] = (short)(1000 - i * 3);
+    }
+}
+
+
+/**@brief Function for connecting a link and exchanging its ATT MTU, as nrf_ble_gatt reports it. */
+static void link_connect(uint16_t conn_handle, uint16_t att_mtu)
+{
+    fake_sd_connect(conn_handle, att_mtu);
+    ble_cus_att_mtu_set(&m_cus, conn_handle, att_mtu);
+}
+
+
+/**@brief Function for making packages as main.c does and sending whatever is queued. */
+static void packages_send(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (uint16_t j = 0; j < SAMPLE_POOL_PACKAGE_LEN - 1; j++)
+        {
+            sample_pool_package[j] = (uint16_t)(m_package_next * 16 + j);
+        }
+        sample_pool_package[SAMPLE_POOL_PACKAGE_LEN - 1] = m_package_next++;
+        package_update(&m_cus);
+
+        for (uint16_t conn = 0; conn < FAKE_SD_LINK_COUNT; conn++)
+        {
+            (void)fake_sd_conn_event(conn, FAKE_SD_TX_BUFFERS);
+        }
+    }
+}
+
+
+static void bulk_download(uint16_t conn_handle)
+{
+    uint8_t req[BLE_CUS_BULK_REQ_LEN];
+
+    fake_sd_notify_enable(conn_handle, m_cus.bulk_handles.cccd_handle);
+    uint16_encode(0, &req[0]);
+    uint16_encode(RECORDED, &req[2]);
+    fake_sd_write(conn_handle, m_cus.bulk_handles.value_handle, req, sizeof(req));
+    while (fake_sd_conn_event(conn_handle, FAKE_SD_TX_BUFFERS) > 0)
+    {
+    }
+}
+
+
+/**@brief One link at the given ATT MTU: live packages, then a bulk download. */
+static void single_link_check(uint16_t att_mtu, uint32_t package_len, uint32_t bulk_len)
+{
+    service_start();
+    link_connect(0, att_mtu);
+    fake_sd_notify_enable(0, m_cus.package_handles.cccd_handle);
+
+    // 120 packages fill whole notifications at both sizes.
+    packages_send(120);
+    CHECK_EQ(m_rx[0].packages, 120);
+    CHECK_EQ(m_rx[0].max_len, package_len);
+    CHECK_EQ(m_rx[0].notifications, 120 * SAMPLE_POOL_PACKAGE_LEN * sizeof(uint16_t) / package_len);
+    CHECK_EQ(m_rx[0].errors, 0);
+    printf("  MTU %3u: 120 packages in %3u notifications of %3u bytes",
+           att_mtu, (unsigned)m_rx[0].notifications, (unsigned)package_len);
+
+    m_rx[0].notifications = 0;
+    m_rx[0].max_len       = 0;
+    bulk_download(0);
+    CHECK_EQ(m_rx[0].bulk_values, RECORDED);
+    CHECK_EQ(m_rx[0].max_len, bulk_len);
+    CHECK_EQ(m_rx[0].notifications, (RECORDED * 2 + bulk_len - 3) / (bulk_len - 2));
+    CHECK_EQ(m_rx[0].errors, 0);
+    printf(", %u values in %4u bulk notifications\n", RECORDED, (unsigned)m_rx[0].notifications);
+}
+
+
+/**@brief Two links subscribed to packages, at MTU 23 and 247: packages fit the smaller one. */
+static void mixed_links_check(void)
+{
+    service_start();
+    link_connect(0, 247);
+    link_connect(1, BLE_GATT_ATT_MTU_DEFAULT);
+    fake_sd_notify_enable(0, m_cus.package_handles.cccd_handle);
+    fake_sd_notify_enable(1, m_cus.package_handles.cccd_handle);
+
+    packages_send(24);
+    for (uint16_t conn = 0; conn < FAKE_SD_LINK_COUNT; conn++)
+    {
+        CHECK_EQ(m_rx[conn].packages, 24);
+        CHECK_EQ(m_rx[conn].max_len, BLE_GATT_ATT_MTU_DEFAULT - 3);
+        CHECK_EQ(m_rx[conn].errors, 0);
+    }
+
+    // Once the small link is gone, packages grow to the MTU of the other one.
+    fake_sd_disconnect(1);
+    packages_send(24);
+    CHECK_EQ(m_rx[0].packages, 48);
+    CHECK_EQ(m_rx[0].max_len, SAMPLE_POOL_LIVE_LEN * sizeof(uint16_t));
+    CHECK_EQ(m_rx[0].errors, 0);
+}
+
+
+/**@brief The MTU exchange completes while packages are batched: none is lost or too long. */
+static void mtu_exchange_check(void)
+{
+    service_start();
+    link_connect(0, BLE_GATT_ATT_MTU_DEFAULT);
+    fake_sd_notify_enable(0, m_cus.package_handles.cccd_handle);
+
+    packages_send(5);
+    CHECK_EQ(m_rx[0].max_len, BLE_GATT_ATT_MTU_DEFAULT - 3);
+
+    fake_sd_mtu_set(0, 247);
+    ble_cus_att_mtu_set(&m_cus, 0, 247);
+    packages_send(7);
+    CHECK_EQ(m_rx[0].max_len, BLE_GATT_ATT_MTU_DEFAULT - 3);
+    packages_send(29);
+    CHECK_EQ(m_rx[0].max_len, SAMPLE_POOL_LIVE_LEN * sizeof(uint16_t));
+    CHECK_EQ(m_rx[0].packages, 5 + 7 + 29);
+    CHECK_EQ(m_rx[0].errors, 0);
+    CHECK_EQ(ble_cus_tx_stats()->errors, 0);
+}
+
+
+int main(void)
+{
+    printf("notification sizes per ATT MTU:\n");
+    single_link_check(BLE_GATT_ATT_MTU_DEFAULT, 20, 20);
+    single_link_check(247, SAMPLE_POOL_LIVE_LEN * sizeof(uint16_t), 244);
+    mixed_links_check();
+    mtu_exchange_check();
+
+    return test_result("att_mtu_test");
+}
@@ -0,0 +1,188 @@
+/* Runs bulk downloads of ble_cus.c over the fake SoftDevice of fake_sd.c and reports the
+ * throughput per connection interval, for both link profiles of link_profile.c. Connection events
+ * follow the air-time model of fake_sd_interval_run; the values received are checked against
+ * accl_arr. Also checks how Bulk requests are clipped and rejected. */
+#include <string.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "cus_fixture.h"
+#include "link_profile.h"
+#include "sample_pool.h"
+
+#define RECORDED                9000                                        /**< accl_arr values recorded, arr_counter. */
+
+static uint32_t  m_rx_values;                                               /**< Values received in order. */
+static uint32_t  m_rx_seq;                                                  /**< Sequence number expected next. */
+static uint32_t  m_rx_start;                                                /**< accl_arr index of the first value requested. */
+static uint32_t  m_rx_errors;
+static uint32_t  m_done_events;
+
+
+static void cus_evt_handler(ble_cus_t * p_cus, ble_cus_evt_t * p_evt)
+{
+    if (p_evt->evt_type == BLE_CUS_EVT_BULK_DONE)
+    {
+        m_done_events++;
+    }
+}
+
+
+/**@brief Function for checking a bulk notification: sequence number, then accl_arr values. */
+static void bulk_rx(uint16_t conn_handle, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    if (handle != m_cus.bulk_handles.value_handle)
+    {
+        return;
+    }
+    if ((uint16_decode(p_data) != (uint16_t)m_rx_seq) || ((len % 2) != 0))
+    {
+        m_rx_errors++;
+    }
+    m_rx_seq++;
+    for (uint16_t i = 2; i < len; i += 2)
+    {
+        if ((int16_t)uint16_decode(&p_data[i]) != sample_pool_accl[m_rx_start + m_rx_values])
+        {
+            m_rx_errors++;
+        }
+        m_rx_values++;
+    }
+}
+
+
+static void service_start(uint16_t att_mtu)
+{
+    // The link of the last run goes down first, so link_profile.c frees its slot.
+    fake_sd_disconnect(0);
+
+    cus_fixture_start(cus_evt_handler, bulk_rx, RECORDED);
+    fake_sd_connect(0, att_mtu);
+    ble_cus_att_mtu_set(&m_cus, 0, att_mtu);
+    fake_sd_notify_enable(0, m_cus.bulk_handles.cccd_handle);
+}
+
+
+static void bulk_request(uint16_t start, uint16_t count)
+{
+    uint8_t req[BLE_CUS_BULK_REQ_LEN];
+
+    uint16_encode(start, &req[0]);
+    uint16_encode(count, &req[2]);
+    m_rx_start  = start;
+    m_rx_values = 0;
+    m_rx_seq    = 0;
+    fake_sd_write(0, m_cus.bulk_handles.value_handle, req, sizeof(req));
+}
+
+
+/**@brief Function for running connection events until nothing is left to send.
+ *
+ * @return Connection events used.
+ */
+static uint32_t events_run(uint32_t interval_us)
+{
+    uint32_t events = 0;
+
+    while ((fake_sd_queued(0) > 0) && (events < 100000))
+    {
+        fake_sd_time_set((uint64_t)events * interval_us);
+        (void)fake_sd_interval_run(0, interval_us);
+        events++;
+    }
+    return events;
+}
+
+
+/**@brief Downloads all recorded values with every profile and connection interval. */
+static void throughput_run(void)
+{
+    static uint32_t const intervals_us[] = {7500, 15000, 30000, 50000, 100000};
+
+    for (uint32_t i = 0; i < RECORDED; i++)
+    {
+        sample_pool_accl[i] = (short)(i * 7 - 3000);
+    }
+
+    printf("  profile  interval  packets/event  events  duration  throughput  steady state\n");
+    for (link_profile_t profile = LINK_PROFILE_LIVE; profile <= LINK_PROFILE_BULK; profile++)
+    {
+        for (uint32_t i = 0; i < ARRAY_SIZE(intervals_us); i++)
+        {
+            uint32_t interval = intervals_us[i];
+            uint32_t event_us;
+            uint32_t per_event;
+            uint32_t events;
+            uint32_t duration_us;
+            double   kbps;
+
+            service_start(247);
+            CHECK_EQ(link_profile_set(0, profile), NRF_SUCCESS);
+            event_us  = fake_sd_conn_evt_ext() ? interval : MIN(interval, FAKE_SD_EVENT_LENGTH_US);
+            per_event = event_us / fake_sd_packet_us(fake_sd_phy(0), FAKE_SD_MAX_DATA_LEN);
+
+            m_done_events = 0;
+            bulk_request(0, RECORDED);
+            events = events_run(interval);
+
+            CHECK_EQ(m_rx_values, RECORDED);
+            CHECK_EQ(m_rx_errors, 0);
+            CHECK_EQ(m_done_events, 1);
+            CHECK(!ble_cus_link_transfer_active(&m_cus.links[0]));
+            // Only the last notification is not full.
+            CHECK_EQ(fake_sd_link_stats(0)->sent, (RECORDED * 2 + 241) / 242);
+            CHECK_EQ(events, (fake_sd_link_stats(0)->sent + per_event - 1) / per_event);
+
+            duration_us = (events - 1) * interval + event_us;
+            kbps        = fake_sd_link_stats(0)->sent_bytes * 1000.0 / duration_us;
+            printf("  %-7s  %5.1f ms  %13u  %6u  %5.0f ms  %5.1f kB/s  %7.1f kB/s\n",
+                   (profile == LINK_PROFILE_BULK) ? "bulk" : "live", interval / 1000.0,
+                   (unsigned)per_event, (unsigned)events, duration_us / 1000.0, kbps,
+                   per_event * FAKE_SD_MAX_DATA_LEN * 1000.0 / interval);
+        }
+    }
+}
+
+
+/**@brief Requests are clipped to the values recorded so far, and rejected if malformed. */
+static void request_check(void)
+{
+    uint8_t const short_req[BLE_CUS_BULK_REQ_LEN - 1] = {0, 0, 10};
+
+    // Past the recorded values: clipped to arr_counter, not to the end of accl_arr.
+    service_start(247);
+    bulk_request(RECORDED - 10, 500);
+    events_run(7500);
+    CHECK_EQ(m_rx_values, 10);
+    CHECK_EQ(m_rx_errors, 0);
+
+    // Nothing recorded at the start: nothing sent.
+    service_start(247);
+    bulk_request(RECORDED, 10);
+    CHECK_EQ(fake_sd_queued(0), 0);
+    CHECK(!ble_cus_link_transfer_active(&m_cus.links[0]));
+
+    // A request without recorded values stops a running transfer.
+    service_start(23);
+    m_done_events = 0;
+    bulk_request(0, RECORDED);
+    CHECK(ble_cus_link_transfer_active(&m_cus.links[0]));
+    bulk_request(RECORDED + 1, 10);
+    CHECK(!ble_cus_link_transfer_active(&m_cus.links[0]));
+    CHECK_EQ(m_done_events, 1);
+
+    // A short write is ignored and its bytes are not read.
+    service_start(247);
+    fake_sd_write(0, m_cus.bulk_handles.value_handle, short_req, sizeof(short_req));
+    CHECK_EQ(fake_sd_queued(0), 0);
+    CHECK(!ble_cus_link_transfer_active(&m_cus.links[0]));
+}
+
+
+int main(void)
+{
+    printf("bulk download of %u values at ATT MTU 247:\n", RECORDED);
+    throughput_run();
+    request_check();
+
+    return test_result("bulk_throughput_sim");
+}
@@ -0,0 +1,175 @@
+/* Simulates a client reading packages of accl_arr from ble_cus.c over the fake SoftDevice of
+ * fake_sd.c, the old way and with the Command characteristic, and counts the connection events:
+ *
+ * - Package Index, Package: a write with response of the index, then a read of Package. ATT has
+ *   one request outstanding, and its response comes in the connection event after it.
+ * - Command: READ_PACKAGE written without response, up to PACKETS_PER_EVENT per event while fewer
+ *   than BLE_CUS_CMD_RING_SIZE are unanswered; the responses are notifications, sent from the
+ *   connection event after the command on.
+ *
+ * Both directions take PACKETS_PER_EVENT packets per connection event, a common limit of phones.
+ * Every scenario runs in a child process. */
+#include <stdlib.h>
+#include <string.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "cus_fixture.h"
+#include "sample_pool.h"
+
+#define RECORDED            9000                                            /**< accl_arr values recorded, arr_counter. */
+#define PACKAGE_VALUES      (SAMPLE_POOL_PACKAGE_LEN - 1)                   /**< accl_arr values of a package; the last entry is the index. */
+#define PACKAGE_COUNT       48                                              /**< Packages the client reads. */
+#define PACKETS_PER_EVENT   6
+#define MAX_EVENTS          10000
+
+static uint32_t  m_answered;                                                /**< Command responses received. */
+static uint32_t  m_errors;                                                  /**< Responses with another tag, status or values than expected. */
+static uint32_t  m_latency_max;                                             /**< Most connection events from a command to its response. */
+static uint32_t  m_sent_event[256];                                         /**< Connection event each tag was written in. */
+static uint32_t  m_event;
+static uint8_t   m_rsp[BLE_CUS_CMD_RSP_MAX_LEN];                            /**< Last command response. */
+static uint16_t  m_rsp_len;
+
+
+/**@brief Function for checking that values are the ones of a package. */
+static bool package_matches(uint16_t idx, uint8_t const * p_values)
+{
+    for (uint32_t i = 0; i < PACKAGE_VALUES; i++)
+    {
+        if ((int16_t)uint16_decode(&p_values[2 * i]) != sample_pool_accl[idx * PACKAGE_VALUES + i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**@brief Function for checking a command response; the tag of READ_PACKAGE n is n. */
+static void rx_handler(uint16_t conn_handle, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    if (handle != m_cus.cmd_handles.value_handle)
+    {
+        return;
+    }
+    m_rsp_len = MIN(len, sizeof(m_rsp));
+    memcpy(m_rsp, p_data, m_rsp_len);
+    if ((p_data[0] != (uint8_t)m_answered) || (p_data[1] != BLE_CUS_CP_STATUS_SUCCESS) ||
+        (len != 2 + 2 * PACKAGE_VALUES) || !package_matches(p_data[0], &p_data[2]))
+    {
+        m_errors++;
+    }
+    m_latency_max = MAX(m_latency_max, m_event - m_sent_event[p_data[0]]);
+    m_answered++;
+}
+
+
+static void service_start(void)
+{
+    cus_fixture_start(NULL, rx_handler, RECORDED);
+    for (uint32_t i = 0; i < RECORDED; i++)
+    {
+        sample_pool_accl[i] = (short)(i * 7 - 30000);
+    }
+    fake_sd_connect(0, BLE_GATT_ATT_MTU_DEFAULT);
+}
+
+
+/**@brief Packages read with a write of Package Index and a read of Package each. */
+static void package_read_run(void)
+{
+    uint32_t errors = 0;
+
+    service_start();
+    m_event = 0;
+    for (uint16_t idx = 0; idx < PACKAGE_COUNT; idx++)
+    {
+        uint8_t           package[2 * SAMPLE_POOL_PACKAGE_LEN];
+        ble_gatts_value_t value = {.len = sizeof(package), .offset = 0, .p_value = package};
+
+        // Write request, write response.
+        fake_sd_write(0, m_cus.package_idx_handles.value_handle, &idx, sizeof(idx));
+        m_event += 2;
+
+        // Read request, read response.
+        CHECK_EQ(sd_ble_gatts_value_get(0, m_cus.package_handles.value_handle, &value), NRF_SUCCESS);
+        m_event += 2;
+
+        if ((uint16_decode(&package[2 * PACKAGE_VALUES]) != idx) || !package_matches(idx, package))
+        {
+            errors++;
+        }
+    }
+    CHECK_EQ(errors, 0);
+    printf("  %u packages in %u connection events\n", PACKAGE_COUNT, (unsigned)m_event);
+}
+
+
+/**@brief Packages read with READ_PACKAGE commands, several in flight. */
+static void command_run(void)
+{
+    uint32_t sent = 0;
+    uint8_t  cmd[4];
+
+    service_start();
+    fake_sd_notify_enable(0, m_cus.cmd_handles.cccd_handle);
+    m_answered    = 0;
+    m_errors      = 0;
+    m_latency_max = 0;
+
+    for (m_event = 0; (m_answered < PACKAGE_COUNT) && (m_event < MAX_EVENTS); m_event++)
+    {
+        // Responses queued before this event go out first.
+        (void)fake_sd_conn_event(0, PACKETS_PER_EVENT);
+
+        for (uint32_t i = 0; (i < PACKETS_PER_EVENT) && (sent < PACKAGE_COUNT) &&
+                             (sent - m_answered < BLE_CUS_CMD_RING_SIZE); i++)
+        {
+            cmd[0] = BLE_CUS_CMD_OP_READ_PACKAGE;
+            cmd[1] = (uint8_t)sent;
+            (void)uint16_encode((uint16_t)sent, &cmd[2]);
+            m_sent_event[sent] = m_event;
+            fake_sd_write(0, m_cus.cmd_handles.value_handle, cmd, sizeof(cmd));
+            sent++;
+        }
+    }
+    CHECK_EQ(m_answered, PACKAGE_COUNT);
+    CHECK_EQ(m_errors, 0);
+    CHECK_EQ(m_latency_max, 1);
+    CHECK(4 * m_event <= PACKAGE_COUNT);
+    printf("  %u packages in %u connection events, %.2f per package, answered after %u event\n",
+           PACKAGE_COUNT, (unsigned)m_event, (double)m_event / PACKAGE_COUNT, (unsigned)m_latency_max);
+}
+
+
+/**@brief A package past the recorded values is answered with OUT_OF_RANGE and the packages there
+ *        are; the values next to accl_arr are not read. */
+static void out_of_range_run(void)
+{
+    uint8_t  cmd[4] = {BLE_CUS_CMD_OP_READ_PACKAGE, 0};
+    uint16_t idx    = RECORDED / PACKAGE_VALUES;
+
+    service_start();
+    fake_sd_notify_enable(0, m_cus.cmd_handles.cccd_handle);
+    m_answered = 0;
+    m_errors   = 0;
+    m_event    = 0;
+
+    (void)uint16_encode(idx, &cmd[2]);
+    fake_sd_write(0, m_cus.cmd_handles.value_handle, cmd, sizeof(cmd));
+    (void)fake_sd_conn_event(0, PACKETS_PER_EVENT);
+    CHECK_EQ(m_answered, 1);
+    CHECK_EQ(m_rsp_len, 4);
+    CHECK_EQ(m_rsp[1], BLE_CUS_CP_STATUS_OUT_OF_RANGE);
+    CHECK_EQ(uint16_decode(&m_rsp[2]), idx);
+}
+
+
+int main(void)
+{
+    scenario("Package Index and Package:", package_read_run);
+    scenario("Command:", command_run);
+    scenario("Command past the recorded values:", out_of_range_run);
+
+    return test_result("command_sim");
+}
@@ -0,0 +1,155 @@
+/* Checks the hysteresis of conn_policy.c: the fast mode at once, slower modes only after
+ * CONN_POLICY_CALM_COUNT evaluations in a row with the queue drained, a restart of the count when
+ * the wanted mode changes, a retry after a refused request, and links kept apart. */
+#include "test_check.h"
+#include "conn_policy.h"
+#include "ble_conn_params.h"
+#include "app_util.h"
+
+static uint32_t              m_requests;                                    /**< Requests ble_conn_params accepted. */
+static uint16_t              m_request_conn_handle;
+static ble_gap_conn_params_t m_request_params;
+static ret_code_t            m_request_error;                               /**< Result of the next request. */
+
+
+ret_code_t ble_conn_params_change_conn_params(uint16_t conn_handle, ble_gap_conn_params_t * p_new_params)
+{
+    if (m_request_error != NRF_SUCCESS)
+    {
+        return m_request_error;
+    }
+    m_requests++;
+    m_request_conn_handle = conn_handle;
+    m_request_params      = *p_new_params;
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for evaluating a link a number of times with the same state. */
+static void evaluate(conn_policy_link_t * p_link, conn_policy_input_t const * p_input, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        conn_policy_update(p_link, p_input);
+    }
+}
+
+
+static void calm_run(void)
+{
+    conn_policy_link_t  link  = {0};
+    conn_policy_input_t input = {.conn_handle = 1, .live_subscribed = true};
+
+    // A new link waits for the calm period before the live mode is requested.
+    CHECK_EQ(link.mode, CONN_POLICY_MODE_NONE);
+    evaluate(&link, &input, CONN_POLICY_CALM_COUNT - 1);
+    CHECK_EQ(m_requests, 0);
+    evaluate(&link, &input, 1);
+    CHECK_EQ(m_requests, 1);
+    CHECK_EQ(link.mode, CONN_POLICY_MODE_LIVE);
+    CHECK_EQ(m_request_params.min_conn_interval, MSEC_TO_UNITS(50, UNIT_1_25_MS));
+
+    // The same mode is not requested again.
+    evaluate(&link, &input, 3 * CONN_POLICY_CALM_COUNT);
+    CHECK_EQ(m_requests, 1);
+
+    // Unsubscribed, then subscribed again halfway: the count starts over for the idle mode.
+    input.live_subscribed = false;
+    evaluate(&link, &input, CONN_POLICY_CALM_COUNT / 2);
+    input.live_subscribed = true;
+    evaluate(&link, &input, 1);
+    input.live_subscribed = false;
+    evaluate(&link, &input, CONN_POLICY_CALM_COUNT - 1);
+    CHECK_EQ(m_requests, 1);
+    evaluate(&link, &input, 1);
+    CHECK_EQ(m_requests, 2);
+    CHECK_EQ(link.mode, CONN_POLICY_MODE_IDLE);
+}
+
+
+static void fast_run(void)
+{
+    conn_policy_link_t  link  = {.mode = CONN_POLICY_MODE_LIVE};
+    conn_policy_input_t input = {.conn_handle = 1, .live_subscribed = true};
+
+    // A bulk transfer asks for the fast mode at once.
+    input.bulk_active = true;
+    evaluate(&link, &input, 1);
+    CHECK_EQ(m_requests, 1);
+    CHECK_EQ(link.mode, CONN_POLICY_MODE_FAST);
+    CHECK_EQ(m_request_params.slave_latency, 0);
+
+    // After it the fast mode stays while the queue is above CONN_POLICY_QUEUE_LOW.
+    input.bulk_active = false;
+    input.queue_depth = CONN_POLICY_QUEUE_LOW + 1;
+    evaluate(&link, &input, 3 * CONN_POLICY_CALM_COUNT);
+    CHECK_EQ(m_requests, 1);
+
+    // Drained, a short burst within the calm period restarts it.
+    input.queue_depth = CONN_POLICY_QUEUE_LOW;
+    evaluate(&link, &input, CONN_POLICY_CALM_COUNT - 1);
+    input.queue_depth = CONN_POLICY_QUEUE_LOW + 1;
+    evaluate(&link, &input, 1);
+    input.queue_depth = CONN_POLICY_QUEUE_LOW;
+    evaluate(&link, &input, CONN_POLICY_CALM_COUNT - 1);
+    CHECK_EQ(m_requests, 1);
+    CHECK_EQ(link.mode, CONN_POLICY_MODE_FAST);
+    evaluate(&link, &input, 1);
+    CHECK_EQ(m_requests, 2);
+    CHECK_EQ(link.mode, CONN_POLICY_MODE_LIVE);
+
+    // A backed up queue asks for the fast mode without a bulk transfer.
+    input.queue_depth = CONN_POLICY_QUEUE_HIGH;
+    evaluate(&link, &input, 1);
+    CHECK_EQ(m_requests, 3);
+    CHECK_EQ(link.mode, CONN_POLICY_MODE_FAST);
+}
+
+
+static void refused_run(void)
+{
+    conn_policy_link_t  link  = {.mode = CONN_POLICY_MODE_IDLE};
+    conn_policy_input_t input = {.conn_handle = 1, .bulk_active = true};
+
+    // A refused request keeps the mode and is made again at the next evaluation.
+    m_request_error = NRF_ERROR_BUSY;
+    evaluate(&link, &input, 1);
+    CHECK_EQ(link.mode, CONN_POLICY_MODE_IDLE);
+    m_request_error = NRF_SUCCESS;
+    evaluate(&link, &input, 1);
+    CHECK_EQ(m_requests, 1);
+    CHECK_EQ(link.mode, CONN_POLICY_MODE_FAST);
+    CHECK_EQ(conn_policy_request_count(), 1);
+}
+
+
+static void links_run(void)
+{
+    conn_policy_link_t  links[2] = {{.mode = CONN_POLICY_MODE_LIVE}, {.mode = CONN_POLICY_MODE_LIVE}};
+    conn_policy_input_t bulk     = {.conn_handle = 1, .live_subscribed = true, .bulk_active = true};
+    conn_policy_input_t live     = {.conn_handle = 2, .live_subscribed = true};
+    conn_policy_input_t free     = {.conn_handle = BLE_CONN_HANDLE_INVALID, .bulk_active = true};
+
+    // A bulk transfer on one link leaves the other, and a free slot is skipped.
+    for (uint32_t i = 0; i < 2 * CONN_POLICY_CALM_COUNT; i++)
+    {
+        conn_policy_update(&links[0], &bulk);
+        conn_policy_update(&links[1], &live);
+        conn_policy_update(&links[1], &free);
+    }
+    CHECK_EQ(m_requests, 1);
+    CHECK_EQ(m_request_conn_handle, 1);
+    CHECK_EQ(links[0].mode, CONN_POLICY_MODE_FAST);
+    CHECK_EQ(links[1].mode, CONN_POLICY_MODE_LIVE);
+}
+
+
+int main(void)
+{
+    scenario("Calm period:", calm_run);
+    scenario("Fast mode:", fast_run);
+    scenario("Refused request:", refused_run);
+    scenario("Two links:", links_run);
+
+    return test_result("conn_policy_test");
+}
@@ -0,0 +1,36 @@
+#include <string.h>
+#include "cus_fixture.h"
+
+ble_cus_t m_cus;
+
+
+static void sd_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
+{
+    ble_cus_on_ble_evt(p_ble_evt, p_context);
+}
+
+
+void cus_fixture_sd_reset(fake_sd_rx_handler_t rx_handler)
+{
+    memset(&m_cus, 0, sizeof(m_cus));
+    fake_sd_reset(sd_evt_handler, &m_cus);
+    fake_sd_rx_handler_set(rx_handler);
+}
+
+
+void cus_fixture_service_init(ble_cus_evt_handler_t evt_handler, uint32_t recorded)
+{
+    ble_cus_init_t init;
+
+    memset(&init, 0, sizeof(init));
+    init.evt_handler = evt_handler;
+    ble_cus_init(&m_cus, &init);
+    m_cus.arr_counter = recorded;
+}
+
+
+void cus_fixture_start(ble_cus_evt_handler_t evt_handler, fake_sd_rx_handler_t rx_handler, uint32_t recorded)
+{
+    cus_fixture_sd_reset(rx_handler);
+    cus_fixture_service_init(evt_handler, recorded);
+}
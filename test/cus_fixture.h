@@ -0,0 +1,31 @@
+/* Setup shared by the tests of ble_cus.c over the fake SoftDevice of fake_sd.c: the service under
+ * test, wired to the fake SoftDevice as main.c wires it to the SoftDevice. Built with CUS_SRCS. */
+#ifndef CUS_FIXTURE_H__
+#define CUS_FIXTURE_H__
+
+#include <stdint.h>
+#include "fake_sd.h"
+#include "ble_cus.h"
+
+extern ble_cus_t m_cus;                                                     /**< Service under test. */
+
+/**@brief Function for resetting the fake SoftDevice and clearing the service.
+ *
+ * @details SoftDevice configuration goes between this and cus_fixture_service_init, as in
+ *          ble_stack_init.
+ *
+ * @param[in] rx_handler    Handler of the notifications the centrals receive, NULL for none.
+ */
+void cus_fixture_sd_reset(fake_sd_rx_handler_t rx_handler);
+
+/**@brief Function for adding the service.
+ *
+ * @param[in] evt_handler   Service event handler, NULL for none.
+ * @param[in] recorded      accl_arr values recorded, arr_counter.
+ */
+void cus_fixture_service_init(ble_cus_evt_handler_t evt_handler, uint32_t recorded);
+
+/**@brief Function for cus_fixture_sd_reset followed by cus_fixture_service_init. */
+void cus_fixture_start(ble_cus_evt_handler_t evt_handler, fake_sd_rx_handler_t rx_handler, uint32_t recorded);
+
+#endif // CUS_FIXTURE_H__
@@ -0,0 +1,271 @@
+/* Benchmarks delta_codec.c on synthetic accelerometer signals in the 1/1024 g unit of the samples:
+ * the bytes per sample and notifications per second of the delta stream against raw x,y,z shorts,
+ * at the payload of the default ATT MTU and of ATT MTU 247, and the encode and decode time per
+ * sample on the host. Checks that every sample decodes as it was encoded, that a client joining
+ * late or losing a frame syncs up at the next keyframe, and the compression of a run. The times
+ * are of the host, for comparing changes to the codec, not of the nRF52. */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "delta_codec.h"
+
+#define DURATION_S      60
+#define MAX_RATE_HZ     400
+#define SAMPLE_COUNT    (DURATION_S * MAX_RATE_HZ)
+#define RAW_LEN         6                                                   /**< Bytes of a sample as x,y,z shorts. */
+#define PAYLOAD_MTU_23  20
+#define PAYLOAD_MTU_247 244
+#define TIMING_ROUNDS   20
+
+/**@brief Signal of a benchmark. */
+typedef enum
+{
+    SIGNAL_STILL,                                                           /**< On a table: gravity and sensor noise. */
+    SIGNAL_WALK,
+    SIGNAL_RUN,                                                             /**< Impacts of up to 5 g, in the 8 g range. */
+    SIGNAL_COUNT
+} signal_t;
+
+static char const * const m_signal_names[SIGNAL_COUNT] = {"still", "walk", "run"};
+
+static delta_codec_sample_t m_samples[SAMPLE_COUNT];
+static delta_codec_sample_t m_decoded[SAMPLE_COUNT];
+static uint8_t              m_frames[SAMPLE_COUNT * RAW_LEN];               /**< Frames one after the other. */
+static uint16_t             m_frame_lens[SAMPLE_COUNT];
+static uint32_t             m_frame_count;
+
+
+/**@brief Function for getting noise of about the given standard deviation. */
+static double noise(double sigma)
+{
+    double sum = 0;
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        sum += (double)rand() / RAND_MAX - 0.5;
+    }
+    return sum * sigma * 1.73;
+}
+
+
+/**@brief Function for making a signal, quantized as the sensor range has it. */
+static void signal_make(signal_t signal, uint32_t rate_hz, uint32_t count)
+{
+    double const step_hz   = (signal == SIGNAL_RUN) ? 2.9 : 1.8;
+    double const impact_g  = (signal == SIGNAL_RUN) ? 4.0 : 0.6;
+    int32_t const scale    = (signal == SIGNAL_RUN) ? 4 : 1;                /**< 8 g range: steps of 4. */
+    int32_t const limit    = 2048 * scale - scale;
+
+    srand(signal * 1000 + rate_hz);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        double t     = (double)i / rate_hz;
+        double phase = fmod(t * step_hz, 1.0);
+        double g[3]  = {0, 0, 1.0};
+
+        if (signal != SIGNAL_STILL)
+        {
+            // A sharp impact at foot strike, then the swing.
+            g[2] += impact_g * exp(-phase * 40.0) * sin(phase * 60.0) + 0.3 * sin(2 * M_PI * phase);
+            g[0] += 0.4 * sin(2 * M_PI * t * step_hz / 2) + 0.2 * exp(-phase * 25.0);
+            g[1] += 0.25 * sin(2 * M_PI * t * step_hz);
+        }
+        for (uint32_t a = 0; a < 3; a++)
+        {
+            int32_t v = (int32_t)lround((g[a] * 1024 + noise(3.0)) / scale) * scale;
+
+            m_samples[i].axis[a] = (int16_t)MAX(-limit, MIN(limit, v));
+        }
+    }
+}
+
+
+/**@brief Function for encoding samples into m_frames.
+ *
+ * @return Bytes of all frames.
+ */
+static uint32_t encode(uint32_t count, uint16_t max_len)
+{
+    delta_codec_enc_t enc;
+    uint32_t          bytes = 0;
+
+    delta_codec_enc_init(&enc, max_len);
+    m_frame_count = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint16_t len = delta_codec_push(&enc, &m_samples[i], i, &m_frames[bytes]);
+
+        if (len > 0)
+        {
+            CHECK(len <= max_len);
+            m_frame_lens[m_frame_count++] = len;
+            bytes += len;
+        }
+    }
+    m_frame_lens[m_frame_count] = delta_codec_flush(&enc, &m_frames[bytes]);
+    bytes += m_frame_lens[m_frame_count];
+    m_frame_count += (m_frame_lens[m_frame_count] > 0) ? 1 : 0;
+    return bytes;
+}
+
+
+/**@brief Function for getting the samples of an encoded frame, from its header. */
+static uint8_t frame_samples(uint8_t const * p_frame)
+{
+    return p_frame[1] & ~DELTA_CODEC_KEYFRAME;
+}
+
+
+/**@brief Function for decoding the frames from first_frame on, as a client that subscribes late,
+ *        with one frame lost, and comparing every sample decoded with the one encoded.
+ *
+ * @param[in]  first_frame  First frame received.
+ * @param[in]  lost_frame   Frame lost, UINT32_MAX for none.
+ * @param[out] p_skipped    Frames received but not decoded, until the decoder synced up.
+ *
+ * @return Samples decoded.
+ */
+static uint32_t decode(uint32_t first_frame, uint32_t lost_frame, uint32_t * p_skipped)
+{
+    delta_codec_dec_t dec;
+    uint32_t          offset  = 0;
+    uint32_t          sample  = 0;
+    uint32_t          decoded = 0;
+
+    delta_codec_dec_init(&dec);
+    *p_skipped = 0;
+    for (uint32_t f = 0; f < m_frame_count; f++)
+    {
+        uint8_t count = 0;
+
+        if ((f >= first_frame) && (f != lost_frame))
+        {
+            if (delta_codec_decode(&dec, &m_frames[offset], m_frame_lens[f], &m_decoded[sample], &count))
+            {
+                CHECK_EQ(count, frame_samples(&m_frames[offset]));
+                CHECK(memcmp(&m_decoded[sample], &m_samples[sample], count * sizeof(m_samples[0])) == 0);
+                decoded += count;
+            }
+            else
+            {
+                (*p_skipped)++;
+            }
+        }
+        sample += frame_samples(&m_frames[offset]);
+        offset += m_frame_lens[f];
+    }
+    return decoded;
+}
+
+
+/**@brief Function for decoding all frames once. */
+static void decode_all(void)
+{
+    delta_codec_dec_t dec;
+    uint32_t          offset = 0;
+    uint32_t          sample = 0;
+
+    delta_codec_dec_init(&dec);
+    for (uint32_t f = 0; f < m_frame_count; f++)
+    {
+        uint8_t count;
+
+        (void)delta_codec_decode(&dec, &m_frames[offset], m_frame_lens[f], &m_decoded[sample], &count);
+        sample += count;
+        offset += m_frame_lens[f];
+    }
+}
+
+
+/**@brief Compression and cost of the stream per signal, sample rate and payload length. */
+static void compression_run(void)
+{
+    static uint32_t const rates_hz[] = {100, 200, MAX_RATE_HZ};
+    static uint16_t const payloads[] = {PAYLOAD_MTU_23, PAYLOAD_MTU_247};
+
+    printf("delta stream against raw x,y,z shorts, %u s per signal:\n", DURATION_S);
+    printf("  signal  rate    payload  bytes/sample  ratio  notifications/s (raw)  encode    decode\n");
+    for (uint32_t s = 0; s < SIGNAL_COUNT; s++)
+    {
+        for (uint32_t r = 0; r < ARRAY_SIZE(rates_hz); r++)
+        {
+            uint32_t count = DURATION_S * rates_hz[r];
+
+            signal_make((signal_t)s, rates_hz[r], count);
+            for (uint32_t p = 0; p < ARRAY_SIZE(payloads); p++)
+            {
+                uint32_t bytes    = encode(count, payloads[p]);
+                uint32_t raw_per  = payloads[p] / RAW_LEN;
+                uint32_t skipped;
+                double   start;
+                double   enc_ns;
+                double   dec_ns;
+
+                CHECK_EQ(decode(0, UINT32_MAX, &skipped), count);
+                CHECK_EQ(skipped, 0);
+
+                start = test_now_us();
+                for (uint32_t i = 0; i < TIMING_ROUNDS; i++)
+                {
+                    (void)encode(count, payloads[p]);
+                }
+                enc_ns = (test_now_us() - start) * 1000.0 / TIMING_ROUNDS / count;
+                start  = test_now_us();
+                for (uint32_t i = 0; i < TIMING_ROUNDS; i++)
+                {
+                    decode_all();
+                }
+                dec_ns = (test_now_us() - start) * 1000.0 / TIMING_ROUNDS / count;
+
+                printf("  %-6s  %3u Hz  %3u      %5.2f         %4.2f   %6.1f (%6.1f)        %5.1f ns  %5.1f ns\n",
+                       m_signal_names[s], (unsigned)rates_hz[r], payloads[p], (double)bytes / count,
+                       (double)count * RAW_LEN / bytes, (double)m_frame_count / DURATION_S,
+                       (double)CEIL_DIV(count, raw_per) / DURATION_S, enc_ns, dec_ns);
+
+                // Keyframes and headers included, a run at the default MTU needs a third fewer
+                // bytes than raw; the impacts need wide deltas. With a long payload the frames hold
+                // DELTA_CODEC_MAX_SAMPLES, so there are more notifications than raw, but shorter.
+                if ((s == SIGNAL_RUN) && (payloads[p] == PAYLOAD_MTU_23))
+                {
+                    CHECK(3 * bytes < 2 * count * RAW_LEN);
+                }
+                CHECK(bytes < count * RAW_LEN);
+            }
+        }
+    }
+}
+
+
+/**@brief A client that subscribes in the middle of the stream, or loses a frame, decodes again
+ *        from the next keyframe on, within DELTA_CODEC_KEYFRAME_INTERVAL frames. */
+static void resync_run(void)
+{
+    uint32_t count = DURATION_S * 200;
+    uint32_t skipped;
+
+    printf("late subscription and lost frames:\n");
+    signal_make(SIGNAL_RUN, 200, count);
+    (void)encode(count, PAYLOAD_MTU_23);
+    CHECK(m_frame_count > 4 * DELTA_CODEC_KEYFRAME_INTERVAL);
+
+    for (uint32_t f = 1; f < 3 * DELTA_CODEC_KEYFRAME_INTERVAL; f += 5)
+    {
+        CHECK(decode(f, UINT32_MAX, &skipped) > 0);
+        CHECK(skipped < DELTA_CODEC_KEYFRAME_INTERVAL);
+        CHECK_EQ(skipped, (DELTA_CODEC_KEYFRAME_INTERVAL - f % DELTA_CODEC_KEYFRAME_INTERVAL) % DELTA_CODEC_KEYFRAME_INTERVAL);
+
+        CHECK(decode(0, f, &skipped) > 0);
+        CHECK(skipped < DELTA_CODEC_KEYFRAME_INTERVAL);
+    }
+}
+
+
+int main(void)
+{
+    compression_run();
+    resync_run();
+
+    return test_result("delta_codec_bench");
+}
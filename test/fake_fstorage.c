@@ -0,0 +1,263 @@
+#include "fake_fstorage.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "nrf_fstorage.h"
+#include "nrf_fstorage_sd.h"
+
+#define WORD_SIZE   4
+
+struct nrf_fstorage_api_s
+{
+    int unused;
+};
+
+nrf_fstorage_api_t nrf_fstorage_sd;
+
+/**@brief A queued operation. */
+typedef struct
+{
+    nrf_fstorage_t const * p_fs;
+    nrf_fstorage_evt_id_t  id;
+    uint32_t               addr;
+    void const           * p_src;
+    uint32_t               len;                                             /**< Bytes for a write, pages for an erase. */
+    void                 * p_param;
+    uint64_t               queued_ns;
+} op_t;
+
+static uint8_t * m_flash;                                                   /**< Shared mapping, see fake_fstorage.h. */
+static op_t      m_queue[FAKE_FSTORAGE_QUEUE_SIZE];
+static uint32_t  m_queue_first;
+static uint32_t  m_queue_count;
+static uint64_t  m_now_ns;
+static uint64_t  m_busy_until_ns;                                           /**< End of the last operation run. */
+
+
+static bool range_valid(nrf_fstorage_t const * p_fs, uint32_t addr, uint32_t len)
+{
+    return (addr >= p_fs->start_addr) && (addr + len <= p_fs->end_addr)
+           && (addr >= FAKE_FSTORAGE_START) && (addr + len <= FAKE_FSTORAGE_END);
+}
+
+
+static uint64_t op_duration(op_t const * p_op)
+{
+    if (p_op->id == NRF_FSTORAGE_EVT_ERASE_RESULT)
+    {
+        return (uint64_t)p_op->len * FAKE_FSTORAGE_PAGE_ERASE_NS;
+    }
+    return (uint64_t)(p_op->len / WORD_SIZE) * FAKE_FSTORAGE_WORD_WRITE_NS;
+}
+
+
+/**@brief Function for applying the first words of an operation to the flash. */
+static void op_apply(op_t const * p_op, uint32_t words)
+{
+    uint8_t * p_dest = fake_fstorage_mem(p_op->addr);
+
+    if (p_op->id == NRF_FSTORAGE_EVT_ERASE_RESULT)
+    {
+        uint32_t size = p_op->len * FAKE_FSTORAGE_PAGE_SIZE;
+
+        memset(p_dest, 0xFF, (words * WORD_SIZE < size) ? words * WORD_SIZE : size);
+    }
+    else
+    {
+        uint8_t const * p_src = p_op->p_src;
+        uint32_t        size  = (words * WORD_SIZE < p_op->len) ? words * WORD_SIZE : p_op->len;
+
+        for (uint32_t i = 0; i < size; i++)
+        {
+            p_dest[i] &= p_src[i];
+        }
+    }
+}
+
+
+static op_t * op_first(void)
+{
+    return (m_queue_count > 0) ? &m_queue[m_queue_first] : NULL;
+}
+
+
+static uint64_t op_end_ns(op_t const * p_op)
+{
+    uint64_t start = (p_op->queued_ns > m_busy_until_ns) ? p_op->queued_ns : m_busy_until_ns;
+
+    return start + op_duration(p_op);
+}
+
+
+/**@brief Function for running the first operation to its end and sending its event. */
+static void op_run(void)
+{
+    op_t               op  = *op_first();
+    nrf_fstorage_evt_t evt =
+    {
+        .id      = op.id,
+        .result  = NRF_SUCCESS,
+        .addr    = op.addr,
+        .p_src   = op.p_src,
+        .len     = op.len,
+        .p_param = op.p_param,
+    };
+
+    m_busy_until_ns = op_end_ns(&op);
+    m_queue_first   = (m_queue_first + 1) % FAKE_FSTORAGE_QUEUE_SIZE;
+    m_queue_count--;
+
+    op_apply(&op, UINT32_MAX);
+    if (op.p_fs->evt_handler != NULL)
+    {
+        op.p_fs->evt_handler(&evt);
+    }
+}
+
+
+static ret_code_t op_queue(nrf_fstorage_t const * p_fs, nrf_fstorage_evt_id_t id, uint32_t addr,
+                           void const * p_src, uint32_t len, void * p_param)
+{
+    if (m_queue_count >= FAKE_FSTORAGE_QUEUE_SIZE)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    m_queue[(m_queue_first + m_queue_count) % FAKE_FSTORAGE_QUEUE_SIZE] = (op_t)
+    {
+        .p_fs      = p_fs,
+        .id        = id,
+        .addr      = addr,
+        .p_src     = p_src,
+        .len       = len,
+        .p_param   = p_param,
+        .queued_ns = m_now_ns,
+    };
+    m_queue_count++;
+    return NRF_SUCCESS;
+}
+
+
+ret_code_t nrf_fstorage_init(nrf_fstorage_t * p_fs, nrf_fstorage_api_t * p_api, void * p_param)
+{
+    p_fs->p_api = p_api;
+    return NRF_SUCCESS;
+}
+
+
+ret_code_t nrf_fstorage_read(nrf_fstorage_t const * p_fs, uint32_t src, void * p_dest, uint32_t len)
+{
+    if (!range_valid(p_fs, src, len))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    memcpy(p_dest, fake_fstorage_mem(src), len);
+    return NRF_SUCCESS;
+}
+
+
+ret_code_t nrf_fstorage_write(nrf_fstorage_t const * p_fs, uint32_t dest, void const * p_src,
+                              uint32_t len, void * p_param)
+{
+    if (!range_valid(p_fs, dest, len) || ((dest % WORD_SIZE) != 0))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if ((len == 0) || ((len % WORD_SIZE) != 0))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    return op_queue(p_fs, NRF_FSTORAGE_EVT_WRITE_RESULT, dest, p_src, len, p_param);
+}
+
+
+ret_code_t nrf_fstorage_erase(nrf_fstorage_t const * p_fs, uint32_t page_addr, uint32_t len,
+                              void * p_param)
+{
+    if (!range_valid(p_fs, page_addr, len * FAKE_FSTORAGE_PAGE_SIZE)
+        || ((page_addr % FAKE_FSTORAGE_PAGE_SIZE) != 0))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    return op_queue(p_fs, NRF_FSTORAGE_EVT_ERASE_RESULT, page_addr, NULL, len, p_param);
+}
+
+
+void fake_fstorage_reset(void)
+{
+    if (m_flash == NULL)
+    {
+        m_flash = mmap(NULL, FAKE_FSTORAGE_END - FAKE_FSTORAGE_START, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (m_flash == MAP_FAILED)
+        {
+            abort();
+        }
+    }
+    memset(m_flash, 0xFF, FAKE_FSTORAGE_END - FAKE_FSTORAGE_START);
+    m_queue_first   = 0;
+    m_queue_count   = 0;
+    m_now_ns        = 0;
+    m_busy_until_ns = 0;
+}
+
+
+uint64_t fake_fstorage_now_ns(void)
+{
+    return m_now_ns;
+}
+
+
+void fake_fstorage_advance(uint64_t now_ns)
+{
+    while ((op_first() != NULL) && (op_end_ns(op_first()) <= now_ns))
+    {
+        op_run();
+    }
+    if (now_ns > m_now_ns)
+    {
+        m_now_ns = now_ns;
+    }
+}
+
+
+bool fake_fstorage_step(void)
+{
+    if (op_first() == NULL)
+    {
+        return false;
+    }
+    fake_fstorage_advance(op_end_ns(op_first()));
+    return true;
+}
+
+
+void fake_fstorage_flush(void)
+{
+    while (fake_fstorage_step())
+    {
+    }
+}
+
+
+uint32_t fake_fstorage_pending(void)
+{
+    return m_queue_count;
+}
+
+
+void fake_fstorage_power_cut(uint32_t words)
+{
+    if (op_first() != NULL)
+    {
+        op_apply(op_first(), words);
+    }
+    m_queue_first = 0;
+    m_queue_count = 0;
+}
+
+
+uint8_t * fake_fstorage_mem(uint32_t addr)
+{
+    return &m_flash[addr - FAKE_FSTORAGE_START];
+}
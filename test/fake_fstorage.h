@@ -0,0 +1,56 @@
+/* Fake nrf_fstorage over a RAM copy of the flash, with nRF52832 NVMC timing and power cuts.
+ *
+ * Operations are queued like the SoftDevice backend does and run when the test lets simulated
+ * time pass, one at a time: writes take FAKE_FSTORAGE_WORD_WRITE_NS per word and can only clear
+ * bits, erases take FAKE_FSTORAGE_PAGE_ERASE_NS. A power cut stops the operation in progress
+ * after a given number of words and drops the rest of the queue.
+ *
+ * The flash is mapped shared, so it outlives a fork(): a test can run every boot in a child
+ * process, which starts with the modules' static state as it is at reset. */
+#ifndef FAKE_FSTORAGE_H__
+#define FAKE_FSTORAGE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FAKE_FSTORAGE_START         0x6D000                                 /**< Flash covered by the fake. */
+#define FAKE_FSTORAGE_END           0x80000
+#define FAKE_FSTORAGE_PAGE_SIZE     0x1000
+#define FAKE_FSTORAGE_QUEUE_SIZE    16                                      /**< NRF_FSTORAGE_SD_QUEUE_SIZE. */
+
+#define FAKE_FSTORAGE_WORD_WRITE_NS 67500                                   /**< nRF52832 tWRITE, maximum. */
+#define FAKE_FSTORAGE_PAGE_ERASE_NS 85000000                                /**< nRF52832 tERASEPAGE, maximum. */
+
+/**@brief Function for erasing the whole fake flash and emptying the queue. Simulated time restarts at 0. */
+void fake_fstorage_reset(void);
+
+/**@brief Function for getting the simulated time. */
+uint64_t fake_fstorage_now_ns(void);
+
+/**@brief Function for letting simulated time pass, running the operations that end until then. */
+void fake_fstorage_advance(uint64_t now_ns);
+
+/**@brief Function for running one queued operation to its end, however long it takes.
+ *
+ * @return False if the queue was empty.
+ */
+bool fake_fstorage_step(void);
+
+/**@brief Function for running every queued operation. */
+void fake_fstorage_flush(void);
+
+/**@brief Function for getting the number of queued operations. */
+uint32_t fake_fstorage_pending(void);
+
+/**@brief Function for cutting the power.
+ *
+ * @details The next queued operation stops after @p words words: a write has programmed its first
+ *          words, an erase has erased the first words of the page. The rest of the queue is lost
+ *          and no event is sent.
+ */
+void fake_fstorage_power_cut(uint32_t words);
+
+/**@brief Function for getting the fake flash at an address, for setting up and checking images. */
+uint8_t * fake_fstorage_mem(uint32_t addr);
+
+#endif // FAKE_FSTORAGE_H__
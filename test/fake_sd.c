@@ -0,0 +1,820 @@
+#include "fake_sd.h"
+#include <string.h>
+#include "app_util.h"
+#include "local_clock.h"
+#include "nrf_sdh_ble.h"
+
+#define ATTR_COUNT          128                                             /**< Handles the fake hands out. */
+#define ATTR_MAX_LEN        64                                              /**< Longest attribute value kept. */
+#define CONN_NONE           FAKE_SD_LINK_COUNT                              /**< Attribute store of values without a connection. */
+
+/**@brief A notification in a TX buffer. */
+typedef struct
+{
+    uint16_t handle;
+    uint16_t len;
+    uint8_t  data[FAKE_SD_MAX_DATA_LEN];
+} packet_t;
+
+/**@brief The L2CAP channel of a link. */
+typedef struct
+{
+    bool       open;
+    uint16_t   peer_mtu;
+    uint16_t   tx_mps;                                                      /**< K-frame payload. */
+    uint16_t   credits;
+    ble_data_t rx_buf;                                                      /**< Buffer for the next SDU of the peer, if p_data is set. */
+    ble_data_t tx[FAKE_SD_L2CAP_TX_QUEUE];                                  /**< SDUs queued; the application keeps the data until BLE_L2CAP_EVT_CH_TX. */
+    uint32_t   tx_first;
+    uint32_t   tx_count;
+    uint32_t   tx_offset;                                                   /**< Bytes of the oldest SDU sent, counting its 2-byte length. */
+    uint16_t   credits_used;                                                /**< Credits of the oldest SDU. */
+} channel_t;
+
+typedef struct
+{
+    bool                 connected;
+    uint16_t             att_mtu;
+    uint8_t              phy;
+    packet_t             tx[FAKE_SD_TX_BUFFERS];
+    uint32_t             tx_first;
+    uint32_t             tx_count;
+    uint32_t             error;                                             /**< Injected error and number of calls left to fail. */
+    uint32_t             error_calls;
+    channel_t            channel;
+    fake_sd_link_stats_t stats;
+} link_t;
+
+typedef struct
+{
+    bool     set;
+    uint16_t len;
+    uint8_t  value[ATTR_MAX_LEN];
+} attr_t;
+
+static fake_sd_evt_handler_t m_evt_handler;
+static void                * m_context;
+static fake_sd_rx_handler_t  m_rx_handler;
+static link_t                m_links[FAKE_SD_LINK_COUNT];
+static attr_t                m_attrs[FAKE_SD_LINK_COUNT + 1][ATTR_COUNT];
+static uint16_t              m_next_handle;
+static uint64_t              m_now_us;
+static uint8_t               m_hvn_tx_queue_size;
+static bool                  m_conn_evt_ext;
+static uint32_t              m_cfg_max[BLE_CONN_CFG_L2CAP - BLE_CONN_CFG_GAP + 1];
+static fake_sd_l2cap_rx_handler_t m_l2cap_rx_handler;
+static uint8_t               m_l2cap_tx_queue_size;                         /**< SDUs per channel, 0 without channels. */
+static uint16_t              m_l2cap_tx_mps;
+
+// Observers of the modules linked in; the section is missing if none is.
+extern nrf_sdh_ble_evt_observer_t const __start_sdh_ble_observers[] __attribute__((weak));
+extern nrf_sdh_ble_evt_observer_t const __stop_sdh_ble_observers[] __attribute__((weak));
+
+
+static link_t * link_get(uint16_t conn_handle)
+{
+    if ((conn_handle >= FAKE_SD_LINK_COUNT) || !m_links[conn_handle].connected)
+    {
+        return NULL;
+    }
+    return &m_links[conn_handle];
+}
+
+
+static void evt_send(ble_evt_t * p_evt)
+{
+    for (nrf_sdh_ble_evt_observer_t const * p_obs = __start_sdh_ble_observers;
+         p_obs < __stop_sdh_ble_observers; p_obs++)
+    {
+        p_obs->handler(p_evt, p_obs->p_context);
+    }
+    if (m_evt_handler != NULL)
+    {
+        m_evt_handler(p_evt, m_context);
+    }
+}
+
+
+static void attr_store(uint32_t conn, uint16_t handle, void const * p_data, uint16_t len)
+{
+    if (handle < ATTR_COUNT)
+    {
+        attr_t * p_attr = &m_attrs[conn][handle];
+
+        p_attr->set = true;
+        p_attr->len = (len < ATTR_MAX_LEN) ? len : ATTR_MAX_LEN;
+        if (p_data != NULL)
+        {
+            memcpy(p_attr->value, p_data, p_attr->len);
+        }
+        else
+        {
+            // The SoftDevice zero-fills a value added without initial data.
+            memset(p_attr->value, 0, p_attr->len);
+        }
+    }
+}
+
+
+void fake_sd_reset(fake_sd_evt_handler_t evt_handler, void * p_context)
+{
+    m_evt_handler = evt_handler;
+    m_context     = p_context;
+    m_rx_handler  = NULL;
+    m_next_handle = BLE_GATT_HANDLE_START;
+    m_now_us      = 0;
+    memset(m_links, 0, sizeof(m_links));
+    memset(m_attrs, 0, sizeof(m_attrs));
+    m_hvn_tx_queue_size = FAKE_SD_TX_BUFFERS;
+    m_conn_evt_ext      = false;
+    memset(m_cfg_max, 0xFF, sizeof(m_cfg_max));
+    m_l2cap_rx_handler    = NULL;
+    m_l2cap_tx_queue_size = 0;
+    m_l2cap_tx_mps        = BLE_L2CAP_MPS_MIN;
+}
+
+
+void fake_sd_rx_handler_set(fake_sd_rx_handler_t rx_handler)
+{
+    m_rx_handler = rx_handler;
+}
+
+
+void fake_sd_connect(uint16_t conn_handle, uint16_t att_mtu)
+{
+    fake_sd_connect_bonded(conn_handle, att_mtu, NULL, 0);
+}
+
+
+void fake_sd_connect_bonded(uint16_t conn_handle, uint16_t att_mtu, uint16_t const * p_cccd_handles,
+                            uint32_t cccd_count)
+{
+    uint8_t const cccd[2] = {BLE_GATT_HVX_NOTIFICATION, 0};
+    ble_evt_t     evt;
+
+    memset(&m_links[conn_handle], 0, sizeof(link_t));
+    memset(m_attrs[conn_handle], 0, sizeof(m_attrs[conn_handle]));
+    m_links[conn_handle].connected = true;
+    m_links[conn_handle].att_mtu   = att_mtu;
+    m_links[conn_handle].phy       = BLE_GAP_PHY_1MBPS;
+    for (uint32_t i = 0; i < cccd_count; i++)
+    {
+        attr_store(conn_handle, p_cccd_handles[i], cccd, sizeof(cccd));
+    }
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id           = BLE_GAP_EVT_CONNECTED;
+    evt.evt.gap_evt.conn_handle = conn_handle;
+    evt_send(&evt);
+}
+
+
+void fake_sd_mtu_set(uint16_t conn_handle, uint16_t att_mtu)
+{
+    m_links[conn_handle].att_mtu = att_mtu;
+}
+
+
+void fake_sd_disconnect(uint16_t conn_handle)
+{
+    ble_evt_t evt;
+
+    if (m_links[conn_handle].channel.open)
+    {
+        m_links[conn_handle].channel.open = false;
+
+        memset(&evt, 0, sizeof(evt));
+        evt.header.evt_id             = BLE_L2CAP_EVT_CH_RELEASED;
+        evt.evt.l2cap_evt.conn_handle = conn_handle;
+        evt.evt.l2cap_evt.local_cid   = FAKE_SD_L2CAP_CID;
+        evt_send(&evt);
+    }
+
+    m_links[conn_handle].connected = false;
+    m_links[conn_handle].tx_count  = 0;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id                               = BLE_GAP_EVT_DISCONNECTED;
+    evt.evt.gap_evt.conn_handle                     = conn_handle;
+    evt.evt.gap_evt.params.disconnected.reason      = BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION;
+    evt_send(&evt);
+}
+
+
+void fake_sd_write(uint16_t conn_handle, uint16_t handle, void const * p_data, uint16_t len)
+{
+    // ble_gatts_evt_write_t ends with the written data.
+    union
+    {
+        ble_evt_t evt;
+        uint8_t   raw[sizeof(ble_evt_t) + FAKE_SD_MAX_DATA_LEN];
+    } buf;
+    ble_gatts_evt_write_t * p_write = &buf.evt.evt.gatts_evt.params.write;
+
+    attr_store(conn_handle, handle, p_data, len);
+
+    memset(&buf, 0, sizeof(buf));
+    buf.evt.header.evt_id             = BLE_GATTS_EVT_WRITE;
+    buf.evt.evt.gatts_evt.conn_handle = conn_handle;
+    p_write->handle                   = handle;
+    p_write->op                       = BLE_GATTS_OP_WRITE_REQ;
+    p_write->len                      = len;
+    memcpy(p_write->data, p_data, len);
+    evt_send(&buf.evt);
+}
+
+
+void fake_sd_notify_enable(uint16_t conn_handle, uint16_t cccd_handle)
+{
+    uint8_t const cccd[2] = {BLE_GATT_HVX_NOTIFICATION, 0};
+
+    fake_sd_write(conn_handle, cccd_handle, cccd, sizeof(cccd));
+}
+
+
+/**@brief Function for sending the oldest queued notification of a link over the air. */
+static void packet_send(uint16_t conn_handle, link_t * p_link)
+{
+    packet_t const * p_packet = &p_link->tx[p_link->tx_first];
+
+    p_link->tx_first = (p_link->tx_first + 1) % FAKE_SD_TX_BUFFERS;
+    p_link->tx_count--;
+    p_link->stats.sent++;
+    p_link->stats.sent_bytes += p_packet->len;
+
+    if (m_rx_handler != NULL)
+    {
+        m_rx_handler(conn_handle, p_packet->handle, p_packet->data, p_packet->len);
+    }
+}
+
+
+static void tx_complete_send(uint16_t conn_handle, uint32_t count)
+{
+    ble_evt_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id                              = BLE_GATTS_EVT_HVN_TX_COMPLETE;
+    evt.evt.gatts_evt.conn_handle                  = conn_handle;
+    evt.evt.gatts_evt.params.hvn_tx_complete.count = (uint8_t)count;
+    evt_send(&evt);
+}
+
+
+uint32_t fake_sd_conn_event(uint16_t conn_handle, uint32_t max_packets)
+{
+    link_t * p_link = link_get(conn_handle);
+    uint32_t sent   = 0;
+
+    if (p_link == NULL)
+    {
+        return 0;
+    }
+
+    while ((sent < max_packets) && (p_link->tx_count > 0))
+    {
+        packet_send(conn_handle, p_link);
+        sent++;
+    }
+    if (sent > 0)
+    {
+        tx_complete_send(conn_handle, sent);
+    }
+    return sent;
+}
+
+
+/**@brief Function for getting the air time of an LL packet of the given payload and its empty
+ *        acknowledgement. */
+static uint32_t ll_packet_us(uint8_t phy, uint16_t ll_len)
+{
+    // Packet: preamble, access address, header and CRC, 10 bytes on 1M and 11 on 2M. 150 us inter
+    // frame space after the packet and the ack.
+    uint32_t us_per_byte = (phy == BLE_GAP_PHY_2MBPS) ? 4 : 8;
+    uint32_t overhead    = (phy == BLE_GAP_PHY_2MBPS) ? 11 : 10;
+
+    return (ll_len + overhead) * us_per_byte + 150 + overhead * us_per_byte + 150;
+}
+
+
+/**@brief Function for getting the K-frames of the SDUs queued on a channel that still have to go. */
+static uint32_t kframes_left(channel_t const * p_channel)
+{
+    uint32_t frames = 0;
+
+    for (uint32_t i = 0; i < p_channel->tx_count; i++)
+    {
+        uint32_t len = p_channel->tx[(p_channel->tx_first + i) % FAKE_SD_L2CAP_TX_QUEUE].len + 2;
+
+        if (i == 0)
+        {
+            len -= p_channel->tx_offset;
+        }
+        frames += CEIL_DIV(len, p_channel->tx_mps);
+    }
+    return frames;
+}
+
+
+/**@brief Function for getting the payload of the next K-frame of a channel. */
+static uint16_t kframe_len(channel_t const * p_channel)
+{
+    return MIN(p_channel->tx_mps, p_channel->tx[p_channel->tx_first].len + 2 - p_channel->tx_offset);
+}
+
+
+/**@brief Function for sending the next K-frame of a channel over the air. When the SDU is
+ *        complete the peer gets it and gives its credits back. */
+static void kframe_send(uint16_t conn_handle, channel_t * p_channel)
+{
+    ble_data_t const sdu = p_channel->tx[p_channel->tx_first];
+    ble_evt_t        evt;
+
+    p_channel->tx_offset += kframe_len(p_channel);
+    p_channel->credits--;
+    p_channel->credits_used++;
+    if (p_channel->tx_offset < sdu.len + 2)
+    {
+        return;
+    }
+
+    p_channel->tx_first  = (p_channel->tx_first + 1) % FAKE_SD_L2CAP_TX_QUEUE;
+    p_channel->tx_count--;
+    p_channel->tx_offset = 0;
+    m_links[conn_handle].stats.sdus++;
+    m_links[conn_handle].stats.sdu_bytes += sdu.len;
+    if (m_l2cap_rx_handler != NULL)
+    {
+        m_l2cap_rx_handler(conn_handle, sdu.p_data, sdu.len);
+    }
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id                       = BLE_L2CAP_EVT_CH_CREDIT;
+    evt.evt.l2cap_evt.conn_handle           = conn_handle;
+    evt.evt.l2cap_evt.local_cid             = FAKE_SD_L2CAP_CID;
+    evt.evt.l2cap_evt.params.credit.credits = p_channel->credits_used;
+    p_channel->credits                     += p_channel->credits_used;
+    p_channel->credits_used                 = 0;
+    evt_send(&evt);
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id                   = BLE_L2CAP_EVT_CH_TX;
+    evt.evt.l2cap_evt.conn_handle       = conn_handle;
+    evt.evt.l2cap_evt.local_cid         = FAKE_SD_L2CAP_CID;
+    evt.evt.l2cap_evt.params.tx.sdu_buf = sdu;
+    evt_send(&evt);
+}
+
+
+uint32_t fake_sd_interval_run(uint16_t conn_handle, uint32_t interval_us)
+{
+    link_t * p_link   = link_get(conn_handle);
+    uint32_t event_us = m_conn_evt_ext ? interval_us : MIN(interval_us, FAKE_SD_EVENT_LENGTH_US);
+    uint32_t used_us  = 0;
+    uint32_t sent     = 0;
+
+    while (p_link != NULL)
+    {
+        channel_t * p_channel = &p_link->channel;
+        uint32_t    frames    = p_channel->open ? MIN(kframes_left(p_channel), p_channel->credits) : 0;
+        bool        last      = (p_link->tx_count + frames == 1);
+        uint32_t    packet_us;
+
+        if (p_link->tx_count > 0)
+        {
+            packet_us = fake_sd_packet_us(p_link->phy, p_link->tx[p_link->tx_first].len);
+        }
+        else if (frames > 0)
+        {
+            // L2CAP header, 4 bytes.
+            packet_us = ll_packet_us(p_link->phy, kframe_len(p_channel) + 4);
+        }
+        else
+        {
+            break;
+        }
+
+        if (used_us + packet_us > event_us)
+        {
+            break;
+        }
+        used_us += packet_us;
+        sent++;
+        if (p_link->tx_count > 0)
+        {
+            packet_send(conn_handle, p_link);
+            tx_complete_send(conn_handle, 1);
+        }
+        else
+        {
+            kframe_send(conn_handle, p_channel);
+        }
+
+        if (last)
+        {
+            // Nothing was queued behind it, so the event closed.
+            break;
+        }
+        p_link = link_get(conn_handle);
+    }
+    return sent;
+}
+
+
+uint32_t fake_sd_packet_us(uint8_t phy, uint16_t len)
+{
+    // L2CAP and ATT headers, 7 bytes.
+    return ll_packet_us(phy, len + 7);
+}
+
+
+void fake_sd_phy_request(uint16_t conn_handle, uint8_t phys)
+{
+    ble_evt_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id                                                   = BLE_GAP_EVT_PHY_UPDATE_REQUEST;
+    evt.evt.gap_evt.conn_handle                                         = conn_handle;
+    evt.evt.gap_evt.params.phy_update_request.peer_preferred_phys.tx_phys = phys;
+    evt.evt.gap_evt.params.phy_update_request.peer_preferred_phys.rx_phys = phys;
+    evt_send(&evt);
+}
+
+
+uint8_t fake_sd_phy(uint16_t conn_handle)
+{
+    return m_links[conn_handle].phy;
+}
+
+
+bool fake_sd_conn_evt_ext(void)
+{
+    return m_conn_evt_ext;
+}
+
+
+void fake_sd_cfg_max_set(uint32_t cfg_id, uint32_t max)
+{
+    m_cfg_max[cfg_id - BLE_CONN_CFG_GAP] = max;
+}
+
+
+uint8_t fake_sd_hvn_tx_queue_size(void)
+{
+    return m_hvn_tx_queue_size;
+}
+
+
+void fake_sd_l2cap_rx_handler_set(fake_sd_l2cap_rx_handler_t rx_handler)
+{
+    m_l2cap_rx_handler = rx_handler;
+}
+
+
+bool fake_sd_l2cap_connect(uint16_t conn_handle, uint16_t le_psm, uint16_t peer_mtu, uint16_t peer_mps,
+                           uint16_t credits)
+{
+    link_t  * p_link = link_get(conn_handle);
+    ble_evt_t evt;
+
+    if ((p_link == NULL) || (m_l2cap_tx_queue_size == 0) || p_link->channel.open)
+    {
+        return false;
+    }
+    memset(&p_link->channel, 0, sizeof(p_link->channel));
+    p_link->channel.peer_mtu = peer_mtu;
+    p_link->channel.tx_mps   = MIN(m_l2cap_tx_mps, peer_mps);
+    p_link->channel.credits  = credits;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id                                            = BLE_L2CAP_EVT_CH_SETUP_REQUEST;
+    evt.evt.l2cap_evt.conn_handle                                = conn_handle;
+    evt.evt.l2cap_evt.local_cid                                  = FAKE_SD_L2CAP_CID;
+    evt.evt.l2cap_evt.params.ch_setup_request.le_psm             = le_psm;
+    evt.evt.l2cap_evt.params.ch_setup_request.tx_params.tx_mtu   = peer_mtu;
+    evt.evt.l2cap_evt.params.ch_setup_request.tx_params.peer_mps = peer_mps;
+    evt.evt.l2cap_evt.params.ch_setup_request.tx_params.tx_mps   = p_link->channel.tx_mps;
+    evt.evt.l2cap_evt.params.ch_setup_request.tx_params.credits  = credits;
+    evt_send(&evt);
+
+    // sd_ble_l2cap_ch_setup opened it if the application accepted.
+    if (!p_link->channel.open)
+    {
+        return false;
+    }
+    ble_l2cap_ch_tx_params_t const tx_params = evt.evt.l2cap_evt.params.ch_setup_request.tx_params;
+
+    evt.header.evt_id                           = BLE_L2CAP_EVT_CH_SETUP;
+    evt.evt.l2cap_evt.params.ch_setup.tx_params = tx_params;
+    evt_send(&evt);
+    return true;
+}
+
+
+bool fake_sd_l2cap_write(uint16_t conn_handle, void const * p_data, uint16_t len)
+{
+    channel_t * p_channel = &m_links[conn_handle].channel;
+    ble_evt_t   evt;
+
+    if (!p_channel->open || (p_channel->rx_buf.p_data == NULL) || (len > p_channel->rx_buf.len))
+    {
+        return false;
+    }
+    memcpy(p_channel->rx_buf.p_data, p_data, len);
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id                   = BLE_L2CAP_EVT_CH_RX;
+    evt.evt.l2cap_evt.conn_handle       = conn_handle;
+    evt.evt.l2cap_evt.local_cid         = FAKE_SD_L2CAP_CID;
+    evt.evt.l2cap_evt.params.rx.sdu_len = len;
+    evt.evt.l2cap_evt.params.rx.sdu_buf = p_channel->rx_buf;
+
+    // The application gives a buffer back with sd_ble_l2cap_ch_rx.
+    p_channel->rx_buf.p_data = NULL;
+    evt_send(&evt);
+    return true;
+}
+
+
+uint32_t fake_sd_l2cap_queued(uint16_t conn_handle)
+{
+    return m_links[conn_handle].channel.tx_count;
+}
+
+
+uint8_t fake_sd_l2cap_tx_queue_size(void)
+{
+    return m_l2cap_tx_queue_size;
+}
+
+
+uint32_t fake_sd_queued(uint16_t conn_handle)
+{
+    return m_links[conn_handle].tx_count;
+}
+
+
+void fake_sd_hvx_error_set(uint16_t conn_handle, uint32_t err_code, uint32_t calls)
+{
+    m_links[conn_handle].error       = err_code;
+    m_links[conn_handle].error_calls = calls;
+}
+
+
+fake_sd_link_stats_t const * fake_sd_link_stats(uint16_t conn_handle)
+{
+    return &m_links[conn_handle].stats;
+}
+
+
+void fake_sd_time_set(uint64_t now_us)
+{
+    m_now_us = now_us;
+}
+
+
+uint64_t fake_sd_time_us(void)
+{
+    return m_now_us;
+}
+
+
+uint32_t local_clock_ms(void)
+{
+    return (uint32_t)(m_now_us / 1000);
+}
+
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    p_link->stats.hvx_calls++;
+    if (p_link->error_calls > 0)
+    {
+        p_link->error_calls--;
+        return p_link->error;
+    }
+    if (*p_hvx_params->p_len > p_link->att_mtu - 3)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    if (p_link->tx_count >= m_hvn_tx_queue_size)
+    {
+        p_link->stats.hvx_resources++;
+        return NRF_ERROR_RESOURCES;
+    }
+
+    packet_t * p_packet = &p_link->tx[(p_link->tx_first + p_link->tx_count) % FAKE_SD_TX_BUFFERS];
+
+    p_packet->handle = p_hvx_params->handle;
+    p_packet->len    = *p_hvx_params->p_len;
+    memcpy(p_packet->data, p_hvx_params->p_data, p_packet->len);
+    p_link->tx_count++;
+    if (p_link->tx_count > p_link->stats.max_queued)
+    {
+        p_link->stats.max_queued = p_link->tx_count;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint16_t fake_sd_attr_count(void)
+{
+    return m_next_handle - BLE_GATT_HANDLE_START;
+}
+
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type)
+{
+    *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid, uint16_t * p_handle)
+{
+    *p_handle = m_next_handle++;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle, ble_gatts_char_md_t const * p_char_md,
+                                         ble_gatts_attr_t const * p_attr_char_value,
+                                         ble_gatts_char_handles_t * p_handles)
+{
+    memset(p_handles, 0, sizeof(*p_handles));
+    m_next_handle++;                                                        // Declaration.
+    p_handles->value_handle = m_next_handle++;
+    if (p_char_md->char_props.notify || p_char_md->char_props.indicate)
+    {
+        p_handles->cccd_handle = m_next_handle++;
+    }
+    if (p_attr_char_value->init_len > 0)
+    {
+        attr_store(CONN_NONE, p_handles->value_handle, p_attr_char_value->p_value,
+                   p_attr_char_value->init_len);
+    }
+    return (m_next_handle < ATTR_COUNT) ? NRF_SUCCESS : NRF_ERROR_NO_MEM;
+}
+
+
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t * p_value)
+{
+    attr_store((conn_handle < FAKE_SD_LINK_COUNT) ? conn_handle : CONN_NONE, handle,
+               p_value->p_value, p_value->len);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_value_get(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t * p_value)
+{
+    attr_t const * p_attr = NULL;
+
+    if (handle >= ATTR_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((conn_handle < FAKE_SD_LINK_COUNT) && m_attrs[conn_handle][handle].set)
+    {
+        p_attr = &m_attrs[conn_handle][handle];
+    }
+    else
+    {
+        p_attr = &m_attrs[CONN_NONE][handle];
+    }
+
+    uint16_t len = (p_value->len < p_attr->len) ? p_value->len : p_attr->len;
+
+    memcpy(p_value->p_value, p_attr->value, len);
+    p_value->len = p_attr->len;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_cfg_set(uint32_t cfg_id, ble_cfg_t const * p_cfg, uint32_t app_ram_base)
+{
+    uint32_t value;
+
+    switch (cfg_id)
+    {
+        case BLE_CONN_CFG_GATTS:
+            value = p_cfg->conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size;
+            break;
+
+        case BLE_CONN_CFG_GATT:
+            value = p_cfg->conn_cfg.params.gatt_conn_cfg.att_mtu;
+            break;
+
+        case BLE_CONN_CFG_L2CAP:
+            value = (p_cfg->conn_cfg.params.l2cap_conn_cfg.ch_count > 0)
+                    ? p_cfg->conn_cfg.params.l2cap_conn_cfg.tx_queue_size : 0;
+            break;
+
+        default:
+            return NRF_ERROR_INVALID_PARAM;
+    }
+    if (value > m_cfg_max[cfg_id - BLE_CONN_CFG_GAP])
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    if (cfg_id == BLE_CONN_CFG_GATTS)
+    {
+        m_hvn_tx_queue_size = MIN(value, FAKE_SD_TX_BUFFERS);
+    }
+    if (cfg_id == BLE_CONN_CFG_L2CAP)
+    {
+        m_l2cap_tx_queue_size = MIN(value, FAKE_SD_L2CAP_TX_QUEUE);
+        m_l2cap_tx_mps        = p_cfg->conn_cfg.params.l2cap_conn_cfg.tx_mps;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_opt_set(uint32_t opt_id, ble_opt_t const * p_opt)
+{
+    if (opt_id != BLE_COMMON_OPT_CONN_EVT_EXT)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+    m_conn_evt_ext = p_opt->common_opt.conn_evt_ext.enable;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_phy_update(uint16_t conn_handle, ble_gap_phys_t const * p_gap_phys)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    // The peer takes 2M when asked for it and stays on 1M otherwise.
+    p_link->phy = (p_gap_phys->tx_phys == BLE_GAP_PHY_2MBPS) ? BLE_GAP_PHY_2MBPS : BLE_GAP_PHY_1MBPS;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_l2cap_ch_setup(uint16_t conn_handle, uint16_t * p_local_cid,
+                               ble_l2cap_ch_setup_params_t const * p_params)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if ((p_link == NULL) || (*p_local_cid != FAKE_SD_L2CAP_CID))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (p_params->status == BLE_L2CAP_CH_STATUS_CODE_SUCCESS)
+    {
+        p_link->channel.open   = true;
+        p_link->channel.rx_buf = p_params->rx_params.sdu_buf;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_l2cap_ch_rx(uint16_t conn_handle, uint16_t local_cid, ble_data_t const * p_sdu_buf)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if ((p_link == NULL) || !p_link->channel.open || (local_cid != FAKE_SD_L2CAP_CID))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_link->channel.rx_buf.p_data != NULL)
+    {
+        return NRF_ERROR_RESOURCES;
+    }
+    p_link->channel.rx_buf = *p_sdu_buf;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_l2cap_ch_tx(uint16_t conn_handle, uint16_t local_cid, ble_data_t const * p_sdu_buf)
+{
+    link_t    * p_link = link_get(conn_handle);
+    channel_t * p_channel;
+
+    if ((p_link == NULL) || !p_link->channel.open || (local_cid != FAKE_SD_L2CAP_CID))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    p_channel = &p_link->channel;
+    if (p_sdu_buf->len > p_channel->peer_mtu)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (p_channel->tx_count >= m_l2cap_tx_queue_size)
+    {
+        return NRF_ERROR_RESOURCES;
+    }
+    p_channel->tx[(p_channel->tx_first + p_channel->tx_count) % FAKE_SD_L2CAP_TX_QUEUE] = *p_sdu_buf;
+    p_channel->tx_count++;
+    return NRF_SUCCESS;
+}
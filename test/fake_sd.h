@@ -0,0 +1,167 @@
+/* Fake SoftDevice for the GATT server and L2CAP side of the host tests.
+ *
+ * Every link has LINK_PROFILE_HVN_TX_QUEUE_SIZE TX buffers: sd_ble_gatts_hvx copies a
+ * notification into a free one or fails with NRF_ERROR_RESOURCES, as the SoftDevice does. The
+ * notifications go over the air in connection events the test runs with fake_sd_conn_event,
+ * which ends with one BLE_GATTS_EVT_HVN_TX_COMPLETE for all of them. Attribute values are kept
+ * per connection, so CCCDs written by a client are read back by the service.
+ *
+ * Events go to the NRF_SDH_BLE_OBSERVERs of the modules linked in and to the handler given to
+ * fake_sd_reset, and local_clock_ms() follows the time of fake_sd_time_set.
+ *
+ * fake_sd_interval_run puts the links on the air: a connection event sends notifications while
+ * they fit its length at the PHY of the link, see fake_sd_packet_us, and a notification is queued
+ * behind the one on air. HVN_TX_COMPLETE comes for every notification acknowledged, so the
+ * service refills the buffer it frees in the same event. With a single TX buffer nothing is
+ * queued behind the notification on air, and the event ends after it.
+ *
+ * A link can have one L2CAP channel, which the peer opens with fake_sd_l2cap_connect. Its SDUs go
+ * out after the notifications, in K-frames of the MPS configured with sd_ble_cfg_set, one credit
+ * each; BLE_L2CAP_EVT_CH_TX comes when the last K-frame of an SDU is acknowledged, and the peer
+ * gives the credits back with BLE_L2CAP_EVT_CH_CREDIT when it has the whole SDU. */
+#ifndef FAKE_SD_H__
+#define FAKE_SD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "link_profile.h"
+#include "l2cap_bulk.h"
+
+#define FAKE_SD_LINK_COUNT      2                                           /**< Connection handles 0 and 1. */
+#define FAKE_SD_TX_BUFFERS      LINK_PROFILE_HVN_TX_QUEUE_SIZE              /**< TX buffers per link, unless sd_ble_cfg_set sets fewer. */
+#define FAKE_SD_MAX_DATA_LEN    244                                         /**< Longest notification, at ATT MTU 247. */
+#define FAKE_SD_EVENT_LENGTH_US 15000                                       /**< NRF_SDH_BLE_GAP_EVENT_LENGTH, without event length extension. */
+#define FAKE_SD_L2CAP_TX_QUEUE  L2CAP_BULK_TX_QUEUE_SIZE                    /**< Most SDUs queued per channel. */
+#define FAKE_SD_L2CAP_CID       0x0040                                      /**< Local CID of the channel of every link. */
+
+typedef void (*fake_sd_evt_handler_t)(ble_evt_t const * p_ble_evt, void * p_context);
+
+/**@brief Function called for every notification sent over the air. */
+typedef void (*fake_sd_rx_handler_t)(uint16_t conn_handle, uint16_t handle, uint8_t const * p_data,
+                                     uint16_t len);
+
+/**@brief Function called for every L2CAP SDU the peer receives. */
+typedef void (*fake_sd_l2cap_rx_handler_t)(uint16_t conn_handle, uint8_t const * p_data, uint16_t len);
+
+/**@brief Counters of one link. */
+typedef struct
+{
+    uint32_t hvx_calls;
+    uint32_t hvx_resources;                                                 /**< Calls failed with NRF_ERROR_RESOURCES. */
+    uint32_t sent;                                                          /**< Notifications sent over the air. */
+    uint32_t sent_bytes;                                                    /**< Their payload. */
+    uint32_t max_queued;                                                    /**< Most TX buffers used at a time. */
+    uint32_t sdus;                                                          /**< L2CAP SDUs sent over the air. */
+    uint32_t sdu_bytes;                                                     /**< Their length. */
+} fake_sd_link_stats_t;
+
+/**@brief Function for starting over with no links, no attributes and time 0. */
+void fake_sd_reset(fake_sd_evt_handler_t evt_handler, void * p_context);
+
+/**@brief Function for setting the function that gets the notifications sent. */
+void fake_sd_rx_handler_set(fake_sd_rx_handler_t rx_handler);
+
+/**@brief Function for connecting a link: sends BLE_GAP_EVT_CONNECTED. */
+void fake_sd_connect(uint16_t conn_handle, uint16_t att_mtu);
+
+/**@brief Function for connecting a bonded peer: its notification CCCDs are restored before
+ *        BLE_GAP_EVT_CONNECTED, as the peer manager does with sd_ble_gatts_sys_attr_set.
+ */
+void fake_sd_connect_bonded(uint16_t conn_handle, uint16_t att_mtu, uint16_t const * p_cccd_handles,
+                            uint32_t cccd_count);
+
+/**@brief Function for changing the ATT MTU of a link, after an exchange. */
+void fake_sd_mtu_set(uint16_t conn_handle, uint16_t att_mtu);
+
+/**@brief Function for disconnecting a link: drops its TX buffers and sends BLE_GAP_EVT_DISCONNECTED. */
+void fake_sd_disconnect(uint16_t conn_handle);
+
+/**@brief Function for a client write: stores the value and sends BLE_GATTS_EVT_WRITE. */
+void fake_sd_write(uint16_t conn_handle, uint16_t handle, void const * p_data, uint16_t len);
+
+/**@brief Function for a client enabling notifications on a CCCD. */
+void fake_sd_notify_enable(uint16_t conn_handle, uint16_t cccd_handle);
+
+/**@brief Function for running a connection event.
+ *
+ * @details Sends up to max_packets queued notifications in order, then reports them with one
+ *          BLE_GATTS_EVT_HVN_TX_COMPLETE.
+ *
+ * @return Notifications sent.
+ */
+uint32_t fake_sd_conn_event(uint16_t conn_handle, uint32_t max_packets);
+
+/**@brief Function for getting the attributes added: services, characteristic declarations,
+ *        values and CCCDs.
+ */
+uint16_t fake_sd_attr_count(void);
+
+/**@brief Function for getting the TX buffers in use on a link. */
+uint32_t fake_sd_queued(uint16_t conn_handle);
+
+/**@brief Function for making the next sd_ble_gatts_hvx calls on a link fail. */
+void fake_sd_hvx_error_set(uint16_t conn_handle, uint32_t err_code, uint32_t calls);
+
+/**@brief Function for running one connection interval of a link on the air.
+ *
+ * @return Packets sent: notifications and K-frames.
+ */
+uint32_t fake_sd_interval_run(uint16_t conn_handle, uint32_t interval_us);
+
+/**@brief Function for getting the air time of a notification and its empty acknowledgement. */
+uint32_t fake_sd_packet_us(uint8_t phy, uint16_t len);
+
+/**@brief Function for sending BLE_GAP_EVT_PHY_UPDATE_REQUEST from the peer. */
+void fake_sd_phy_request(uint16_t conn_handle, uint8_t phys);
+
+/**@brief Function for getting the PHY of a link: the one last asked for with sd_ble_gap_phy_update,
+ *        1M for BLE_GAP_PHY_AUTO. */
+uint8_t fake_sd_phy(uint16_t conn_handle);
+
+/**@brief Function for getting the connection event length extension option. */
+bool fake_sd_conn_evt_ext(void);
+
+/**@brief Function for limiting what sd_ble_cfg_set accepts, as if the SoftDevice RAM were short.
+ *
+ * @details A configuration whose hvn_tx_queue_size, att_mtu or L2CAP tx_queue_size (0 without
+ *          channels) is above max fails with NRF_ERROR_NO_MEM.
+ */
+void fake_sd_cfg_max_set(uint32_t cfg_id, uint32_t max);
+
+/**@brief Function for getting the TX buffers per link configured with sd_ble_cfg_set. */
+uint8_t fake_sd_hvn_tx_queue_size(void);
+
+/**@brief Function for setting the function that gets the L2CAP SDUs sent. */
+void fake_sd_l2cap_rx_handler_set(fake_sd_l2cap_rx_handler_t rx_handler);
+
+/**@brief Function for the peer opening an L2CAP channel.
+ *
+ * @details Sends BLE_L2CAP_EVT_CH_SETUP_REQUEST, then BLE_L2CAP_EVT_CH_SETUP if the application
+ *          accepted it with sd_ble_l2cap_ch_setup. Nothing happens if no channel is configured.
+ *
+ * @return True if the channel is open.
+ */
+bool fake_sd_l2cap_connect(uint16_t conn_handle, uint16_t le_psm, uint16_t peer_mtu, uint16_t peer_mps,
+                           uint16_t credits);
+
+/**@brief Function for the peer sending an SDU: fills the buffer given with sd_ble_l2cap_ch_rx and
+ *        sends BLE_L2CAP_EVT_CH_RX.
+ *
+ * @return False if there was no buffer for it.
+ */
+bool fake_sd_l2cap_write(uint16_t conn_handle, void const * p_data, uint16_t len);
+
+/**@brief Function for getting the SDUs queued on the channel of a link. */
+uint32_t fake_sd_l2cap_queued(uint16_t conn_handle);
+
+/**@brief Function for getting the SDUs per channel configured with sd_ble_cfg_set, 0 without channels. */
+uint8_t fake_sd_l2cap_tx_queue_size(void);
+
+fake_sd_link_stats_t const * fake_sd_link_stats(uint16_t conn_handle);
+
+void fake_sd_time_set(uint64_t now_us);
+
+uint64_t fake_sd_time_us(void);
+
+#endif // FAKE_SD_H__
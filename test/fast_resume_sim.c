@@ -0,0 +1,148 @@
+/* Simulates a central reconnecting to ble_cus.c over the fake SoftDevice of fake_sd.c and measures
+ * the time from the connection to the first power notification on the air:
+ *
+ * - discovery: no cache, the central discovers the table and writes the power CCCD;
+ * - cached:    the central reads the DB hash, finds it matches and writes the power CCCD;
+ * - bonded:    the peer manager restores the CCCDs before the service sees the link.
+ *
+ * The central has one ATT request outstanding, answered in the connection event it is sent in; at
+ * the default ATT MTU every 128-bit attribute takes a response of its own, so discovery takes a
+ * connection event per attribute. The power is sent every BLE_CUS_NOTIFY_INTERVAL_DEFAULT_MS by
+ * the timer of main.c, whose phase to the connection is swept. The first connection event after
+ * BLE_GAP_EVT_CONNECTED is 1. Every scenario runs in a child process. */
+#include <stdlib.h>
+#include <string.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "cus_fixture.h"
+
+#define INTERVAL_MS     30                                                  /**< MAX_CONN_INTERVAL of main.c. */
+#define PHASE_STEP_MS   10                                                  /**< Step of the timer phases tried. */
+#define MAX_EVENTS      1000
+
+/**@brief Way the central gets to its subscription. */
+typedef enum
+{
+    RECONNECT_DISCOVERY,
+    RECONNECT_CACHED,
+    RECONNECT_BONDED,
+    RECONNECT_COUNT
+} reconnect_t;
+
+static char const * const m_reconnect_names[RECONNECT_COUNT] = {"discovery", "cached", "bonded"};
+
+static uint32_t  m_power_event;                                             /**< Connection event of the first power notification, 0 before it. */
+static uint32_t  m_event;                                                   /**< Connection event running. */
+
+
+static void rx_handler(uint16_t conn_handle, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    if ((handle == m_cus.power_handles.value_handle) && (m_power_event == 0))
+    {
+        m_power_event = m_event;
+    }
+}
+
+
+/**@brief Function for running one reconnect.
+ *
+ * @param[in] reconnect  Way the central subscribes.
+ * @param[in] phase_ms   Time of the first power timer tick after the connection.
+ *
+ * @return Time from the connection to the first power notification, in ms.
+ */
+static uint32_t reconnect_run(reconnect_t reconnect, uint32_t phase_ms)
+{
+    uint32_t requests;                                                      /**< ATT requests before the CCCD write. */
+    uint32_t tick_ms = phase_ms;
+
+    cus_fixture_start(NULL, rx_handler, 0);
+    m_power_event = 0;
+    m_event       = 0;
+
+    requests = (reconnect == RECONNECT_DISCOVERY) ? fake_sd_attr_count() : 1;
+    if (reconnect == RECONNECT_BONDED)
+    {
+        fake_sd_connect_bonded(0, BLE_GATT_ATT_MTU_DEFAULT, &m_cus.power_handles.cccd_handle, 1);
+    }
+    else
+    {
+        fake_sd_connect(0, BLE_GATT_ATT_MTU_DEFAULT);
+    }
+
+    for (m_event = 1; (m_power_event == 0) && (m_event < MAX_EVENTS); m_event++)
+    {
+        fake_sd_time_set((uint64_t)m_event * INTERVAL_MS * 1000);
+
+        // Timer ticks since the last event, as notification_timeout_handler1 does.
+        while (tick_ms <= m_event * INTERVAL_MS)
+        {
+            if (ble_cus_subscribed(&m_cus, BLE_CUS_SUB_POWER))
+            {
+                power_update(&m_cus);
+            }
+            tick_ms += m_cus.config.notify_interval_ms;
+        }
+
+        if ((reconnect != RECONNECT_BONDED) && (m_event == requests + 1))
+        {
+            fake_sd_notify_enable(0, m_cus.power_handles.cccd_handle);
+        }
+        (void)fake_sd_interval_run(0, INTERVAL_MS * 1000);
+    }
+    CHECK(m_power_event > 0);
+    return m_power_event * INTERVAL_MS;
+}
+
+
+/**@brief Time to the first power notification per way of reconnecting, over the timer phases. */
+static void latency_run(void)
+{
+    uint32_t worst[RECONNECT_COUNT];
+
+    printf("  reconnect   first power notification at %u ms interval\n", INTERVAL_MS);
+    for (uint32_t r = 0; r < RECONNECT_COUNT; r++)
+    {
+        uint32_t best = UINT32_MAX;
+
+        worst[r] = 0;
+        for (uint32_t phase = PHASE_STEP_MS; phase <= BLE_CUS_NOTIFY_INTERVAL_DEFAULT_MS; phase += PHASE_STEP_MS)
+        {
+            uint32_t ms = reconnect_run((reconnect_t)r, phase);
+
+            best     = MIN(best, ms);
+            worst[r] = MAX(worst[r], ms);
+        }
+        printf("  %-10s  %4u to %4u ms\n", m_reconnect_names[r], (unsigned)best, (unsigned)worst[r]);
+    }
+    printf("  discovery of %u attributes\n", fake_sd_attr_count());
+
+    // A bonded central gets the power in the first connection event, whatever the timer does.
+    CHECK_EQ(worst[RECONNECT_BONDED], INTERVAL_MS);
+    CHECK(worst[RECONNECT_CACHED] <= 2 * INTERVAL_MS + BLE_CUS_NOTIFY_INTERVAL_DEFAULT_MS + INTERVAL_MS);
+    CHECK(worst[RECONNECT_CACHED] < worst[RECONNECT_DISCOVERY]);
+}
+
+
+/**@brief A bonded central that did not subscribe to the power gets nothing until it does. */
+static void unsubscribed_run(void)
+{
+    cus_fixture_start(NULL, rx_handler, 0);
+    m_power_event = 0;
+
+    fake_sd_connect_bonded(0, BLE_GATT_ATT_MTU_DEFAULT, &m_cus.metrics_handles.cccd_handle, 1);
+    CHECK(!ble_cus_subscribed(&m_cus, BLE_CUS_SUB_POWER));
+    CHECK(ble_cus_subscribed(&m_cus, BLE_CUS_SUB_METRICS));
+    m_event = 1;
+    (void)fake_sd_interval_run(0, INTERVAL_MS * 1000);
+    CHECK_EQ(m_power_event, 0);
+}
+
+
+int main(void)
+{
+    scenario("time from connection to the first power notification:", latency_run);
+    scenario("bonded central not subscribed to the power:", unsubscribed_run);
+
+    return test_result("fast_resume_sim");
+}
@@ -0,0 +1,425 @@
+/* Runs flash_log.c on the fake flash of fake_fstorage.c:
+ *
+ * - power cuts at every slot of a record write, on the first lap, at the wrap and further round
+ *   the ring, at several points of the write;
+ * - power cuts in the erase and header write of every page change of the first two laps;
+ * - the cost of a mount at every fill level, against a scan of the whole area;
+ * - the sustained append rate with nRF52832 flash timing.
+ *
+ * Every boot runs in a child process, so flash_log.c starts from its reset state each time. */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "fake_fstorage.h"
+#include "flash_log.h"
+
+#define LAP_PAGES           (2 * FLASH_LOG_PAGE_COUNT + 1)                  /**< Base images kept, one per filled page. */
+#define AREA_SIZE           (FLASH_LOG_PAGE_COUNT * FLASH_LOG_PAGE_SIZE)
+#define RECORD_WORDS        (FLASH_LOG_RECORD_SIZE / 4)
+#define PAGE_WORDS          (FLASH_LOG_PAGE_SIZE / 4)
+#define MOUNT_RUNS          200
+
+/**@brief Results a child boot hands back to the test. */
+typedef struct
+{
+    uint32_t mount_reads;
+    double   mount_us;
+    uint32_t appended;
+    uint32_t dropped;
+    uint64_t sim_ns;
+} shared_t;
+
+static uint8_t    m_bases[LAP_PAGES][AREA_SIZE];                            /**< Flash images with k pages filled. */
+static shared_t * m_shared;
+
+// Set by the test before a boot, read by the boot.
+static uint32_t   m_count;                                                  /**< Records to append. */
+static uint32_t   m_cut_op;                                                 /**< Queued operation the power cut hits. */
+static uint32_t   m_cut_words;
+static uint32_t   m_head;                                                   /**< Expected head, tail and torn record. */
+static uint32_t   m_tail;
+static uint32_t   m_torn;
+static uint32_t   m_interval_ms;
+
+
+/**@brief Function for making the payload of a record; no byte is 0xFF, so a torn write shows. */
+static void payload_make(uint32_t seq, uint8_t * p_data)
+{
+    for (uint32_t i = 0; i < FLASH_LOG_DATA_SIZE; i++)
+    {
+        p_data[i] = (uint8_t)((seq * 7 + i * 13 + (seq >> 8)) % 0xFF);
+    }
+}
+
+
+/**@brief Function for getting the tail while the page with head_page_seq is the newest. */
+static uint32_t tail_for(uint32_t head_page_seq)
+{
+    if (head_page_seq + 1 < FLASH_LOG_PAGE_COUNT)
+    {
+        return 0;
+    }
+    return (head_page_seq + 1 - FLASH_LOG_PAGE_COUNT) * FLASH_LOG_SLOTS_PER_PAGE;
+}
+
+
+/**@brief Function for getting the tail once records up to head were appended. */
+static uint32_t tail_of_head(uint32_t head)
+{
+    return (head == 0) ? 0 : tail_for((head - 1) / FLASH_LOG_SLOTS_PER_PAGE);
+}
+
+
+static void (*mp_boot_run)(void);
+
+
+static void boot_run(void)
+{
+    CHECK_EQ(flash_log_init(), NRF_SUCCESS);
+    mp_boot_run();
+}
+
+
+/**@brief Function for running a boot in a child process and collecting its failed checks. */
+static void boot(void (*p_run)(void))
+{
+    mp_boot_run = p_run;
+    scenario(NULL, boot_run);
+}
+
+
+static void image_load(uint8_t const * p_image)
+{
+    memcpy(fake_fstorage_mem(FLASH_LOG_START_ADDR), p_image, AREA_SIZE);
+}
+
+
+static void image_save(uint8_t * p_image)
+{
+    memcpy(p_image, fake_fstorage_mem(FLASH_LOG_START_ADDR), AREA_SIZE);
+}
+
+
+static void records_append(uint32_t count)
+{
+    uint8_t data[FLASH_LOG_DATA_SIZE];
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t seq  = flash_log_head();
+        uint32_t got  = UINT32_MAX;
+
+        payload_make(seq, data);
+        CHECK_EQ(flash_log_append(data, sizeof(data), &got), NRF_SUCCESS);
+        CHECK_EQ(got, seq);
+        fake_fstorage_flush();
+    }
+}
+
+
+/**@brief Function for checking head, tail and every record in between. */
+static void log_check(void)
+{
+    uint8_t  expected[FLASH_LOG_DATA_SIZE];
+    uint8_t  data[FLASH_LOG_DATA_SIZE];
+    uint16_t len;
+    uint32_t bad = 0;
+
+    CHECK_EQ(flash_log_head(), m_head);
+    CHECK_EQ(flash_log_tail(), m_tail);
+    CHECK(flash_log_head() - flash_log_tail() <= FLASH_LOG_PAGE_COUNT * FLASH_LOG_SLOTS_PER_PAGE);
+    if (flash_log_head() - flash_log_tail() > FLASH_LOG_PAGE_COUNT * FLASH_LOG_SLOTS_PER_PAGE)
+    {
+        return;
+    }
+
+    for (uint32_t seq = flash_log_tail(); seq < flash_log_head(); seq++)
+    {
+        ret_code_t err_code = flash_log_read(seq, data, &len);
+
+        payload_make(seq, expected);
+        if (seq == m_torn)
+        {
+            bad += (err_code != NRF_ERROR_INVALID_DATA);
+        }
+        else
+        {
+            bad += (err_code != NRF_SUCCESS) || (len != sizeof(data)) || memcmp(data, expected, len);
+        }
+    }
+    CHECK_EQ(bad, 0);
+}
+
+
+static void boot_append(void)
+{
+    records_append(m_count);
+}
+
+
+/**@brief Boot that appends m_count records, queues one more and cuts the power in one of the
+ *        operations that one queued. */
+static void boot_append_cut(void)
+{
+    uint8_t data[FLASH_LOG_DATA_SIZE];
+
+    records_append(m_count);
+    payload_make(flash_log_head(), data);
+    CHECK_EQ(flash_log_append(data, sizeof(data), NULL), NRF_SUCCESS);
+
+    for (uint32_t i = 0; i < m_cut_op; i++)
+    {
+        CHECK(fake_fstorage_step());
+    }
+    fake_fstorage_power_cut(m_cut_words);
+}
+
+
+static void boot_check_append(void)
+{
+    log_check();
+    records_append(m_count);
+}
+
+
+static void boot_check(void)
+{
+    log_check();
+}
+
+
+/**@brief Function for building an image with k full pages for every k up to two laps. */
+static void bases_build(void)
+{
+    fake_fstorage_reset();
+    image_save(m_bases[0]);
+    for (uint32_t k = 1; k < LAP_PAGES; k++)
+    {
+        m_count = FLASH_LOG_SLOTS_PER_PAGE;
+        boot(boot_append);
+        image_save(m_bases[k]);
+    }
+}
+
+
+/**@brief Power cut in the write of the record in every slot of a page.
+ *
+ * @details The page follows the k full pages of a base image. A cut after 0 words loses the record,
+ *          a cut after more leaves a torn record that fails its CRC; either way the log mounts
+ *          with the records before and goes on after it.
+ */
+static void torn_records_check(uint32_t k)
+{
+    static const uint32_t cut_words[] = {0, 1, 2, 4, RECORD_WORDS - 1};
+    uint32_t              base        = k * FLASH_LOG_SLOTS_PER_PAGE;
+    int                   failures    = m_test_failures;
+
+    for (uint32_t slot = 0; slot < FLASH_LOG_SLOTS_PER_PAGE; slot++)
+    {
+        for (uint32_t i = 0; i < ARRAY_SIZE(cut_words); i++)
+        {
+            image_load(m_bases[k]);
+            m_count     = slot;
+            m_cut_op    = (slot == 0) ? 2 : 0;                              // After the erase and header write.
+            m_cut_words = cut_words[i];
+            boot(boot_append_cut);
+
+            m_head  = base + slot + ((cut_words[i] > 0) ? 1 : 0);
+            m_tail  = tail_for(k);
+            m_torn  = (cut_words[i] > 0) ? base + slot : UINT32_MAX;
+            m_count = 3;
+            boot(boot_check_append);
+
+            m_head += m_count;
+            m_tail  = tail_of_head(m_head);
+            boot(boot_check);
+        }
+    }
+    printf("torn record in every slot after %2u full pages: %s\n", (unsigned)k,
+           (m_test_failures == failures) ? "ok" : "FAILED");
+}
+
+
+/**@brief Power cut while the page after k full pages is erased or gets its header.
+ *
+ * @details The page being erased held the oldest records, so they are gone as soon as the erase
+ *          starts, unless it has not.
+ */
+static void page_change_check(uint32_t k)
+{
+    static const struct
+    {
+        uint32_t op;                                                        /**< 0 erase, 1 header write. */
+        uint32_t words;
+    } cuts[] = {{0, 0}, {0, 1}, {0, 2}, {0, PAGE_WORDS / 2}, {0, PAGE_WORDS - 1},
+                {1, 0}, {1, 1}, {1, 2}};
+
+    uint32_t base     = k * FLASH_LOG_SLOTS_PER_PAGE;
+    int      failures = m_test_failures;
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(cuts); i++)
+    {
+        bool started = (cuts[i].op > 0) || (cuts[i].words > 0);
+
+        image_load(m_bases[k]);
+        m_count     = 0;
+        m_cut_op    = cuts[i].op;
+        m_cut_words = cuts[i].words;
+        boot(boot_append_cut);
+
+        // The page opened gets page_seq k; once its erase started, the records it held are gone.
+        m_head  = base;
+        m_tail  = started ? tail_for(k) : tail_of_head(base);
+        m_torn  = UINT32_MAX;
+        m_count = 2 * FLASH_LOG_SLOTS_PER_PAGE;
+        boot(boot_check_append);
+
+        m_head += m_count;
+        m_tail  = tail_of_head(m_head);
+        boot(boot_check);
+    }
+    if (m_test_failures != failures)
+    {
+        printf("power cut at the page change after %u full pages: FAILED\n", (unsigned)k);
+    }
+}
+
+
+static void boot_mount_cost(void)
+{
+    uint32_t reads = flash_log_stats()->mount_reads;
+    double   start = test_now_us();
+
+    for (uint32_t i = 0; i < MOUNT_RUNS; i++)
+    {
+        CHECK_EQ(flash_log_init(), NRF_SUCCESS);
+    }
+    m_shared->mount_us    = (test_now_us() - start) / MOUNT_RUNS;
+    m_shared->mount_reads = (flash_log_stats()->mount_reads - reads) / MOUNT_RUNS;
+    log_check();
+}
+
+
+/**@brief Function for measuring the reads of a mount at every fill level of the first two laps. */
+static void mount_cost_measure(void)
+{
+    uint32_t max_reads = 0;
+    uint32_t sum_reads = 0;
+    double   max_us    = 0;
+    uint32_t mounts    = 0;
+
+    for (uint32_t k = 0; k + 1 < LAP_PAGES; k++)
+    {
+        for (uint32_t slot = 0; slot < FLASH_LOG_SLOTS_PER_PAGE; slot += 9)
+        {
+            image_load(m_bases[k]);
+            m_count = slot;
+            boot(boot_append);
+
+            m_head = k * FLASH_LOG_SLOTS_PER_PAGE + slot;
+            m_tail = tail_of_head(m_head);
+            m_torn = UINT32_MAX;
+            boot(boot_mount_cost);
+
+            max_reads  = MAX(max_reads, m_shared->mount_reads);
+            max_us     = MAX(max_us, m_shared->mount_us);
+            sum_reads += m_shared->mount_reads;
+            mounts++;
+        }
+    }
+    printf("mount: %.1f reads on average, %u at most, %.2f us at most on the host;"
+           " a full scan reads %u\n",
+           (double)sum_reads / mounts, (unsigned)max_reads, max_us,
+           FLASH_LOG_PAGE_COUNT * (1 + FLASH_LOG_SLOTS_PER_PAGE));
+    // Page 0, 4 headers of the binary search or the last page, 7 slots and 2 headers after the head.
+    CHECK(max_reads <= 1 + 4 + 7 + 2);
+}
+
+
+/**@brief Boot that appends a record every m_interval_ms (as fast as the queue takes them if 0)
+ *        for three laps of simulated flash time. */
+static void boot_sustained(void)
+{
+    uint8_t  data[FLASH_LOG_DATA_SIZE] = {0};
+    uint32_t records                   = 3 * FLASH_LOG_PAGE_COUNT * FLASH_LOG_SLOTS_PER_PAGE;
+    uint32_t written                   = flash_log_stats()->records_written;
+
+    m_shared->appended = 0;
+    m_shared->dropped  = 0;
+    for (uint32_t i = 0; i < records; i++)
+    {
+        if (m_interval_ms > 0)
+        {
+            fake_fstorage_advance((uint64_t)i * m_interval_ms * 1000000);
+        }
+        while ((m_interval_ms == 0) && (flash_log_append(data, sizeof(data), NULL) == NRF_ERROR_NO_MEM))
+        {
+            CHECK(fake_fstorage_step());
+        }
+        if ((m_interval_ms > 0) && (flash_log_append(data, sizeof(data), NULL) != NRF_SUCCESS))
+        {
+            m_shared->dropped++;
+        }
+    }
+    fake_fstorage_flush();
+    m_shared->appended = flash_log_stats()->records_written - written;
+    m_shared->sim_ns   = fake_fstorage_now_ns();
+    CHECK_EQ(flash_log_stats()->errors, 0);
+}
+
+
+static void sustained_rate_measure(void)
+{
+    static const uint32_t intervals_ms[] = {60, 30, 20, 15, 12, 10, 8, 5};
+
+    fake_fstorage_reset();
+    m_interval_ms = 0;
+    boot(boot_sustained);
+    printf("sustained: %.0f records/s, %.1f kB/s of payload, with %.1f us per word write and"
+           " %.0f ms per page erase\n",
+           m_shared->appended * 1e9 / m_shared->sim_ns,
+           m_shared->appended * 1e6 * FLASH_LOG_DATA_SIZE / m_shared->sim_ns,
+           FAKE_FSTORAGE_WORD_WRITE_NS / 1e3, FAKE_FSTORAGE_PAGE_ERASE_NS / 1e6);
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(intervals_ms); i++)
+    {
+        fake_fstorage_reset();
+        m_interval_ms = intervals_ms[i];
+        boot(boot_sustained);
+        printf("a record every %2u ms: %u of %u dropped\n", (unsigned)intervals_ms[i],
+               (unsigned)m_shared->dropped, (unsigned)(m_shared->dropped + m_shared->appended));
+
+        // A sample block every 30 ms at 100 Hz sampling, 60 ms at the default 50 Hz.
+        if (intervals_ms[i] >= 30)
+        {
+            CHECK_EQ(m_shared->dropped, 0);
+        }
+    }
+}
+
+
+int main(void)
+{
+    m_shared = mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    CHECK(m_shared != MAP_FAILED);
+
+    bases_build();
+
+    torn_records_check(0);
+    torn_records_check(FLASH_LOG_PAGE_COUNT - 1);                           // Opens page 0 again: the wrap.
+    torn_records_check(FLASH_LOG_PAGE_COUNT);
+    torn_records_check(FLASH_LOG_PAGE_COUNT + 6);
+
+    for (uint32_t k = 0; k + 2 < LAP_PAGES; k++)
+    {
+        page_change_check(k);
+    }
+    printf("power cut in every page change of two laps: %s\n", (m_test_failures == 0) ? "ok" : "FAILED");
+
+    mount_cost_measure();
+    sustained_rate_measure();
+
+    return test_result("flash_log_sim");
+}
@@ -0,0 +1,407 @@
+/* Checks l2cap_bulk.c over the fake SoftDevice of fake_sd.c: the channel configuration when the
+ * SoftDevice RAM is short, channel setup, requests while a download runs, flash log downloads at
+ * the smallest peer MTUs, and the throughput of
+ * a download over the channel against the GATT bulk characteristic of ble_cus.c, both with the
+ * bulk profile of link_profile.c under the air-time model of fake_sd_interval_run. Every scenario
+ * runs in a child process, so the modules start without links. */
+#include <stdlib.h>
+#include <string.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "cus_fixture.h"
+#include "fake_fstorage.h"
+#include "flash_log.h"
+#include "l2cap_bulk.h"
+#include "link_profile.h"
+#include "sample_block.h"
+#include "sample_pool.h"
+
+#define CONN_CFG_TAG    1
+#define RECORDED        9000                                                /**< accl_arr values recorded. */
+#define PEER_MTU        1000
+#define PEER_MPS        247
+#define PEER_CREDITS    16
+
+/**@brief SDUs received. */
+typedef struct
+{
+    uint32_t sdus;
+    uint16_t seq_first;                                                     /**< Sequence number of the first SDU. */
+    bool     blocks;                                                        /**< The SDUs carry flash log blocks. */
+    uint32_t values;                                                        /**< accl_arr values from first_value on, or blocks. */
+    uint32_t first_value;
+    uint32_t ends;                                                          /**< SDUs with only the sequence number. */
+    uint32_t errors;                                                        /**< SDUs out of sequence, values not as sent. */
+} rx_t;
+
+static rx_t      m_rx;
+static uint32_t  m_gatt_values;
+static uint32_t  m_started;
+static uint32_t  m_done;
+
+
+static void l2cap_evt_handler(l2cap_bulk_evt_t const * p_evt)
+{
+    if (p_evt->evt_type == L2CAP_BULK_EVT_STARTED)
+    {
+        m_started++;
+    }
+    else
+    {
+        m_done++;
+    }
+}
+
+
+static void sdu_rx(uint16_t conn_handle, uint8_t const * p_data, uint16_t len)
+{
+    uint16_t seq = uint16_decode(p_data);
+
+    if (seq != (uint16_t)(m_rx.seq_first + m_rx.sdus))
+    {
+        m_rx.errors++;
+    }
+    m_rx.sdus++;
+    if (len == 2)
+    {
+        m_rx.ends++;
+    }
+    for (uint16_t i = 2; m_rx.blocks && (i < len); i += 1 + p_data[i])
+    {
+        if ((p_data[i] != SAMPLE_BLOCK_LEN) || (i + 1 + p_data[i] > len))
+        {
+            m_rx.errors++;
+        }
+        m_rx.values++;
+    }
+    for (uint16_t i = 2; !m_rx.blocks && (i < len); i += 2)
+    {
+        if ((int16_t)uint16_decode(&p_data[i]) != sample_pool_accl[m_rx.first_value + m_rx.values])
+        {
+            m_rx.errors++;
+        }
+        m_rx.values++;
+    }
+}
+
+
+static void gatt_rx(uint16_t conn_handle, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    if (handle == m_cus.bulk_handles.value_handle)
+    {
+        m_gatt_values += (len - 2) / 2;
+    }
+}
+
+
+/**@brief Function for configuring the channel as ble_stack_init does, with RAM for cfg_max SDUs,
+ *        and connecting link 0 with the bulk profile. */
+static void service_start(uint32_t cfg_max)
+{
+    memset(&m_rx, 0, sizeof(m_rx));
+    m_gatt_values = 0;
+    m_started     = 0;
+    m_done        = 0;
+
+    cus_fixture_sd_reset(gatt_rx);
+    fake_sd_l2cap_rx_handler_set(sdu_rx);
+    fake_sd_cfg_max_set(BLE_CONN_CFG_L2CAP, cfg_max);
+    CHECK_EQ(l2cap_bulk_cfg_set(CONN_CFG_TAG, 0), NRF_SUCCESS);
+    CHECK_EQ(fake_sd_l2cap_tx_queue_size(), l2cap_bulk_tx_queue_size());
+    l2cap_bulk_init(l2cap_evt_handler, &m_cus.arr_counter);
+    cus_fixture_service_init(NULL, RECORDED);
+    for (uint32_t i = 0; i < RECORDED; i++)
+    {
+        sample_pool_accl[i] = (short)(i * 13 - 7000);
+    }
+
+    fake_sd_connect(0, 247);
+    ble_cus_att_mtu_set(&m_cus, 0, 247);
+    CHECK_EQ(link_profile_set(0, LINK_PROFILE_BULK), NRF_SUCCESS);
+}
+
+
+/**@brief Function for writing a request on the channel. */
+static void l2cap_request(uint8_t source, uint32_t first, uint32_t count)
+{
+    uint8_t req[L2CAP_BULK_REQ_LEN];
+
+    req[0] = source;
+    (void)uint32_encode(first, &req[1]);
+    (void)uint32_encode(count, &req[5]);
+    CHECK(fake_sd_l2cap_write(0, req, sizeof(req)));
+}
+
+
+/**@brief Function for running connection events until nothing is left to send.
+ *
+ * @return Connection events used.
+ */
+static uint32_t events_run(uint32_t interval_us)
+{
+    uint32_t events = 0;
+
+    while ((l2cap_bulk_active(0) || (fake_sd_l2cap_queued(0) > 0) ||
+            ble_cus_link_transfer_active(&m_cus.links[0]) || (fake_sd_queued(0) > 0)) &&
+           (events < 100000))
+    {
+        fake_sd_time_set((uint64_t)events * interval_us);
+        (void)fake_sd_interval_run(0, interval_us);
+        events++;
+    }
+    return events;
+}
+
+
+/**@brief The channel queues fewer SDUs, then none, as the SoftDevice RAM gets shorter. */
+static void cfg_run(void)
+{
+    service_start(UINT32_MAX);
+    CHECK_EQ(l2cap_bulk_tx_queue_size(), L2CAP_BULK_TX_QUEUE_SIZE);
+    CHECK(fake_sd_l2cap_connect(0, L2CAP_BULK_PSM, PEER_MTU, PEER_MPS, PEER_CREDITS));
+
+    // nrf_sdh_ble_enable ran out of RAM: the fallbacks of ble_stack_init.
+    CHECK_EQ(l2cap_bulk_cfg_reduce(CONN_CFG_TAG, 0), NRF_SUCCESS);
+    CHECK_EQ(l2cap_bulk_tx_queue_size(), L2CAP_BULK_TX_QUEUE_SIZE_MIN);
+    CHECK_EQ(fake_sd_l2cap_tx_queue_size(), L2CAP_BULK_TX_QUEUE_SIZE_MIN);
+    CHECK_EQ(l2cap_bulk_cfg_disable(CONN_CFG_TAG, 0), NRF_SUCCESS);
+    CHECK_EQ(l2cap_bulk_tx_queue_size(), 0);
+    CHECK_EQ(fake_sd_l2cap_tx_queue_size(), 0);
+    CHECK_EQ(l2cap_bulk_cfg_reduce(CONN_CFG_TAG, 0), NRF_SUCCESS);
+    CHECK_EQ(l2cap_bulk_tx_queue_size(), 0);
+    fake_sd_disconnect(0);
+
+    service_start(L2CAP_BULK_TX_QUEUE_SIZE - 1);
+    CHECK_EQ(l2cap_bulk_tx_queue_size(), L2CAP_BULK_TX_QUEUE_SIZE_MIN);
+    fake_sd_disconnect(0);
+
+    // No channel: the peer cannot open one, downloads use GATT.
+    service_start(L2CAP_BULK_TX_QUEUE_SIZE_MIN - 1);
+    CHECK_EQ(l2cap_bulk_tx_queue_size(), 0);
+    CHECK(!fake_sd_l2cap_connect(0, L2CAP_BULK_PSM, PEER_MTU, PEER_MPS, PEER_CREDITS));
+}
+
+
+/**@brief Channels on another PSM, or a second one, are refused. */
+static void setup_run(void)
+{
+    service_start(UINT32_MAX);
+    fake_sd_connect(1, 247);
+    CHECK(!fake_sd_l2cap_connect(0, L2CAP_BULK_PSM + 1, PEER_MTU, PEER_MPS, PEER_CREDITS));
+    CHECK(fake_sd_l2cap_connect(0, L2CAP_BULK_PSM, PEER_MTU, PEER_MPS, PEER_CREDITS));
+    CHECK(!fake_sd_l2cap_connect(1, L2CAP_BULK_PSM, PEER_MTU, PEER_MPS, PEER_CREDITS));
+
+    // Gone with the link: the other one can open it.
+    fake_sd_disconnect(0);
+    CHECK(fake_sd_l2cap_connect(1, L2CAP_BULK_PSM, PEER_MTU, PEER_MPS, PEER_CREDITS));
+}
+
+
+/**@brief A download ends with the end SDU. A request while it runs is ignored, so the sequence
+ *        numbers stay one stream; a stop request ends the stream with the end SDU, and the next
+ *        download starts over at 0. */
+static void requests_run(void)
+{
+    uint8_t const short_req[L2CAP_BULK_REQ_LEN - 1] = {L2CAP_BULK_SOURCE_ACCL};
+
+    service_start(UINT32_MAX);
+    CHECK(fake_sd_l2cap_connect(0, L2CAP_BULK_PSM, PEER_MTU, PEER_MPS, PEER_CREDITS));
+
+    l2cap_request(L2CAP_BULK_SOURCE_ACCL, 100, 1000);
+    CHECK(l2cap_bulk_active(0));
+    CHECK_EQ(m_started, 1);
+    m_rx.first_value = 100;
+    events_run(7500);
+    CHECK_EQ(m_rx.values, 1000);
+    CHECK_EQ(m_rx.ends, 1);
+    CHECK_EQ(m_rx.sdus, CEIL_DIV(1000 * 2, L2CAP_BULK_SDU_MAX_LEN - 2) + 1);
+    CHECK_EQ(m_done, 1);
+
+    // Another request in the middle: ignored.
+    memset(&m_rx, 0, sizeof(m_rx));
+    l2cap_request(L2CAP_BULK_SOURCE_ACCL, 0, RECORDED);
+    (void)fake_sd_interval_run(0, 7500);
+    l2cap_request(L2CAP_BULK_SOURCE_ACCL, 5000, 10);
+    CHECK(fake_sd_l2cap_write(0, short_req, sizeof(short_req)));
+    CHECK_EQ(m_started, 2);
+    (void)fake_sd_interval_run(0, 7500);
+
+    // Stopped: the SDUs queued and the end SDU still go out, the end SDU once one is sent.
+    l2cap_request(L2CAP_BULK_SOURCE_ACCL, 0, 0);
+    CHECK_EQ(m_done, 1);
+    events_run(7500);
+    CHECK(!l2cap_bulk_active(0));
+    CHECK_EQ(m_done, 2);
+    CHECK(m_rx.values < RECORDED);
+    CHECK_EQ(m_rx.ends, 1);
+    CHECK_EQ(m_rx.errors, 0);
+
+    // A new download starts over at 0, after the end SDU of the last one.
+    memset(&m_rx, 0, sizeof(m_rx));
+    m_rx.first_value = 20;
+    l2cap_request(L2CAP_BULK_SOURCE_ACCL, 20, 30);
+    events_run(7500);
+    CHECK_EQ(m_rx.values, 30);
+    CHECK_EQ(m_rx.sdus, 2);
+    CHECK_EQ(m_rx.ends, 1);
+    CHECK_EQ(m_rx.errors, 0);
+    CHECK_EQ(m_started, 3);
+
+    // A stop without a download is not an event.
+    l2cap_request(L2CAP_BULK_SOURCE_ACCL, 0, 0);
+    CHECK_EQ(m_done, 3);
+
+    // Clipped to the values recorded, not to the end of accl_arr.
+    memset(&m_rx, 0, sizeof(m_rx));
+    m_rx.first_value = RECORDED - 10;
+    l2cap_request(L2CAP_BULK_SOURCE_ACCL, RECORDED - 10, 100);
+    events_run(7500);
+    CHECK_EQ(m_rx.values, 10);
+    CHECK_EQ(m_rx.ends, 1);
+    CHECK_EQ(m_rx.errors, 0);
+    m_cus.arr_counter = 0;
+    l2cap_request(L2CAP_BULK_SOURCE_ACCL, 0, 100);
+    CHECK(!l2cap_bulk_active(0));
+    CHECK_EQ(m_started, 4);
+}
+
+
+/**@brief At the minimum peer MTU of 23 bytes no flash log block fits into an SDU: the request is
+ *        empty rather than a download of end SDUs that never completes, and accl_arr values still
+ *        come. At 27 bytes every SDU carries one block. */
+static void flash_log_run(void)
+{
+    uint16_t const samples[SAMPLE_BLOCK_SAMPLES] = {0};
+
+    service_start(UINT32_MAX);
+    fake_fstorage_reset();
+    CHECK_EQ(flash_log_init(), NRF_SUCCESS);
+    sample_block_init();
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        CHECK_EQ(sample_block_append(samples, (i + 1) * SAMPLE_BLOCK_PERIOD_MS, NULL), NRF_SUCCESS);
+    }
+    fake_fstorage_flush();
+
+    CHECK(fake_sd_l2cap_connect(0, L2CAP_BULK_PSM, BLE_L2CAP_MTU_MIN, BLE_L2CAP_MTU_MIN, PEER_CREDITS));
+    m_rx.blocks = true;
+    l2cap_request(L2CAP_BULK_SOURCE_FLASH_LOG, 0, 5);
+    CHECK(!l2cap_bulk_active(0));
+    events_run(7500);
+    CHECK_EQ(m_rx.sdus, 0);
+    CHECK_EQ(m_started, 0);
+
+    m_rx.blocks      = false;
+    m_rx.first_value = RECORDED - 10;
+    l2cap_request(L2CAP_BULK_SOURCE_ACCL, RECORDED - 10, 10);
+    events_run(7500);
+    CHECK_EQ(m_rx.values, 10);
+    CHECK_EQ(m_rx.sdus, 2);
+    CHECK_EQ(m_done, 1);
+    fake_sd_disconnect(0);
+
+    memset(&m_rx, 0, sizeof(m_rx));
+    m_rx.blocks = true;
+    fake_sd_connect(0, 247);
+    CHECK(fake_sd_l2cap_connect(0, L2CAP_BULK_PSM, SAMPLE_BLOCK_LEN + 5, BLE_L2CAP_MTU_MIN, PEER_CREDITS));
+    l2cap_request(L2CAP_BULK_SOURCE_FLASH_LOG, 0, 5);
+    CHECK(l2cap_bulk_active(0));
+    events_run(7500);
+    CHECK_EQ(m_rx.values, 5);
+    CHECK_EQ(m_rx.sdus, 6);
+    CHECK_EQ(m_rx.ends, 1);
+    CHECK_EQ(m_rx.errors, 0);
+    CHECK_EQ(m_done, 2);
+}
+
+
+/**@brief Function for downloading all recorded values over GATT or the channel.
+ *
+ * @return Throughput of the values in kB/s, from the first connection event to the end of the last.
+ */
+static double download_run(bool l2cap, uint32_t cfg_max, uint32_t interval_us)
+{
+    uint32_t events;
+    uint32_t event_us;
+
+    service_start(cfg_max);
+    if (l2cap)
+    {
+        CHECK(fake_sd_l2cap_connect(0, L2CAP_BULK_PSM, PEER_MTU, PEER_MPS, PEER_CREDITS));
+        l2cap_request(L2CAP_BULK_SOURCE_ACCL, 0, RECORDED);
+    }
+    else
+    {
+        uint8_t req[BLE_CUS_BULK_REQ_LEN];
+
+        fake_sd_notify_enable(0, m_cus.bulk_handles.cccd_handle);
+        uint16_encode(0, &req[0]);
+        uint16_encode(RECORDED, &req[2]);
+        fake_sd_write(0, m_cus.bulk_handles.value_handle, req, sizeof(req));
+    }
+    events = events_run(interval_us);
+
+    CHECK_EQ(l2cap ? m_rx.values : m_gatt_values, RECORDED);
+    CHECK_EQ(m_rx.errors, 0);
+
+    event_us = fake_sd_conn_evt_ext() ? interval_us : MIN(interval_us, FAKE_SD_EVENT_LENGTH_US);
+    fake_sd_disconnect(0);
+
+    return RECORDED * 2 * 1000.0 / ((events - 1) * interval_us + event_us);
+}
+
+
+/**@brief Download throughput over GATT and over the channel per interval. */
+static void throughput_run(void)
+{
+    static uint32_t const intervals_us[] = {7500, 15000, 30000, 50000, 100000};
+    double                gatt[ARRAY_SIZE(intervals_us)];
+    double                l2cap[ARRAY_SIZE(intervals_us)];
+    double                l2cap_min[ARRAY_SIZE(intervals_us)];
+
+    printf("  path              ");
+    for (uint32_t j = 0; j < ARRAY_SIZE(intervals_us); j++)
+    {
+        printf("  %5.1f ms", intervals_us[j] / 1000.0);
+    }
+    printf("   (kB/s)\n");
+
+    for (uint32_t j = 0; j < ARRAY_SIZE(intervals_us); j++)
+    {
+        gatt[j]      = download_run(false, UINT32_MAX, intervals_us[j]);
+        l2cap[j]     = download_run(true, UINT32_MAX, intervals_us[j]);
+        l2cap_min[j] = download_run(true, L2CAP_BULK_TX_QUEUE_SIZE_MIN, intervals_us[j]);
+
+        CHECK(l2cap[j] >= gatt[j]);
+        CHECK(l2cap_min[j] == l2cap[j]);
+    }
+
+    printf("  GATT, 8 queued    ");
+    for (uint32_t j = 0; j < ARRAY_SIZE(intervals_us); j++)
+    {
+        printf("  %8.1f", gatt[j]);
+    }
+    printf("\n  L2CAP, %u queued   ", L2CAP_BULK_TX_QUEUE_SIZE);
+    for (uint32_t j = 0; j < ARRAY_SIZE(intervals_us); j++)
+    {
+        printf("  %8.1f", l2cap[j]);
+    }
+    printf("\n  L2CAP, %u queued   ", L2CAP_BULK_TX_QUEUE_SIZE_MIN);
+    for (uint32_t j = 0; j < ARRAY_SIZE(intervals_us); j++)
+    {
+        printf("  %8.1f", l2cap_min[j]);
+    }
+    printf("\n");
+}
+
+
+int main(void)
+{
+    scenario("channel configuration when the SoftDevice RAM is short:", cfg_run);
+    scenario("channel setup:", setup_run);
+    scenario("requests while a download runs:", requests_run);
+    scenario("flash log downloads at the smallest peer MTUs:", flash_log_run);
+    scenario("download throughput with the bulk profile at ATT MTU 247:", throughput_run);
+
+    return test_result("l2cap_bulk_sim");
+}
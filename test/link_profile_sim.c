@@ -0,0 +1,244 @@
+/* Checks link_profile.c over the fake SoftDevice of fake_sd.c: the notification queue it
+ * configures when the SoftDevice RAM is short, the event length extension and PHY of each profile
+ * on two links, and the throughput a bulk download of ble_cus.c reaches per profile, queue size
+ * and ATT MTU under the air-time model of fake_sd_interval_run. Link scenarios run in a child
+ * process, so link_profile.c starts without links. */
+#include <stdlib.h>
+#include <string.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "cus_fixture.h"
+#include "link_profile.h"
+#include "sample_pool.h"
+
+#define CONN_CFG_TAG    1
+#define RECORDED        9000                                                /**< accl_arr values recorded, arr_counter. */
+
+/**@brief One link setup of the throughput table. */
+typedef struct
+{
+    link_profile_t profile;
+    uint32_t       cfg_max;                                                 /**< Largest queue the SoftDevice RAM allows. */
+    uint16_t       att_mtu;
+} setup_t;
+
+static uint32_t const m_intervals_us[] = {7500, 15000, 30000, 50000, 100000};
+
+static uint32_t  m_rx_values;
+static uint32_t  m_rx_errors;
+
+
+static void bulk_rx(uint16_t conn_handle, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    if (handle != m_cus.bulk_handles.value_handle)
+    {
+        return;
+    }
+    for (uint16_t i = 2; i < len; i += 2)
+    {
+        if ((int16_t)uint16_decode(&p_data[i]) != sample_pool_accl[m_rx_values])
+        {
+            m_rx_errors++;
+        }
+        m_rx_values++;
+    }
+}
+
+
+/**@brief Function for configuring the queue as ble_stack_init does, with RAM for cfg_max
+ *        notifications per link, and enabling the SoftDevice with what was accepted. */
+static void queue_configure(uint32_t cfg_max)
+{
+    ble_cfg_t cfg;
+
+    fake_sd_cfg_max_set(BLE_CONN_CFG_GATTS, cfg_max);
+    CHECK_EQ(link_profile_cfg_set(CONN_CFG_TAG, 0), NRF_SUCCESS);
+
+    // Without an accepted configuration the SoftDevice keeps its default.
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.conn_cfg.conn_cfg_tag                            = CONN_CFG_TAG;
+    cfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = link_profile_hvn_tx_queue_size();
+    CHECK_EQ(sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &cfg, 0), NRF_SUCCESS);
+    CHECK_EQ(fake_sd_hvn_tx_queue_size(), link_profile_hvn_tx_queue_size());
+}
+
+
+/**@brief The queue falls back to LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN, then to the default. */
+static void cfg_run(void)
+{
+    cus_fixture_sd_reset(NULL);
+    queue_configure(UINT32_MAX);
+    CHECK_EQ(link_profile_hvn_tx_queue_size(), LINK_PROFILE_HVN_TX_QUEUE_SIZE);
+
+    // nrf_sdh_ble_enable ran out of RAM: the first fallback of ble_stack_init.
+    CHECK_EQ(link_profile_cfg_reduce(CONN_CFG_TAG, 0), NRF_SUCCESS);
+    CHECK_EQ(link_profile_hvn_tx_queue_size(), LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN);
+    CHECK_EQ(fake_sd_hvn_tx_queue_size(), LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN);
+
+    cus_fixture_sd_reset(NULL);
+    queue_configure(LINK_PROFILE_HVN_TX_QUEUE_SIZE - 1);
+    CHECK_EQ(link_profile_hvn_tx_queue_size(), LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN);
+
+    cus_fixture_sd_reset(NULL);
+    queue_configure(BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT);
+    CHECK_EQ(link_profile_hvn_tx_queue_size(), BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT);
+
+    // Already below the smaller queue: reducing does not grow it.
+    CHECK_EQ(link_profile_cfg_reduce(CONN_CFG_TAG, 0), NRF_SUCCESS);
+    CHECK_EQ(link_profile_hvn_tx_queue_size(), BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT);
+}
+
+
+/**@brief Event length extension is on while any link uses the bulk profile; the PHY is per link. */
+static void profiles_run(void)
+{
+    cus_fixture_sd_reset(NULL);
+    fake_sd_connect(0, 247);
+    fake_sd_connect(1, 247);
+    CHECK(!fake_sd_conn_evt_ext());
+    CHECK_EQ(link_profile_get(0), LINK_PROFILE_LIVE);
+    CHECK_EQ(link_profile_set(FAKE_SD_LINK_COUNT, LINK_PROFILE_BULK), NRF_ERROR_NOT_FOUND);
+
+    CHECK_EQ(link_profile_set(0, LINK_PROFILE_BULK), NRF_SUCCESS);
+    CHECK_EQ(link_profile_get(0), LINK_PROFILE_BULK);
+    CHECK(fake_sd_conn_evt_ext());
+    CHECK_EQ(fake_sd_phy(0), BLE_GAP_PHY_2MBPS);
+    CHECK_EQ(fake_sd_phy(1), BLE_GAP_PHY_1MBPS);
+
+    // The peer asks for a PHY update: each link answers with its own profile.
+    fake_sd_phy_request(0, BLE_GAP_PHY_1MBPS | BLE_GAP_PHY_2MBPS);
+    fake_sd_phy_request(1, BLE_GAP_PHY_1MBPS | BLE_GAP_PHY_2MBPS);
+    CHECK_EQ(fake_sd_phy(0), BLE_GAP_PHY_2MBPS);
+    CHECK_EQ(fake_sd_phy(1), BLE_GAP_PHY_1MBPS);
+
+    // Both links bulk, one goes back to live: still on for the other.
+    CHECK_EQ(link_profile_set(1, LINK_PROFILE_BULK), NRF_SUCCESS);
+    CHECK_EQ(link_profile_set(0, LINK_PROFILE_LIVE), NRF_SUCCESS);
+    CHECK(fake_sd_conn_evt_ext());
+    CHECK_EQ(fake_sd_phy(0), BLE_GAP_PHY_1MBPS);
+
+    // The bulk link goes down: off.
+    fake_sd_disconnect(1);
+    CHECK(!fake_sd_conn_evt_ext());
+
+    // A new link on the free slot starts live.
+    fake_sd_connect(1, 247);
+    CHECK_EQ(link_profile_get(1), LINK_PROFILE_LIVE);
+    CHECK(!fake_sd_conn_evt_ext());
+}
+
+
+/**@brief Function for downloading all recorded values at the given interval.
+ *
+ * @return Throughput in kB/s, from the first connection event to the end of the last one.
+ */
+static double download_run(setup_t const * p_setup, uint32_t interval_us)
+{
+    uint8_t  req[BLE_CUS_BULK_REQ_LEN];
+    uint32_t events = 0;
+    uint32_t event_us;
+
+    m_rx_values = 0;
+    m_rx_errors = 0;
+
+    cus_fixture_sd_reset(bulk_rx);
+    queue_configure(p_setup->cfg_max);
+    cus_fixture_service_init(NULL, RECORDED);
+
+    fake_sd_connect(0, p_setup->att_mtu);
+    ble_cus_att_mtu_set(&m_cus, 0, p_setup->att_mtu);
+    CHECK_EQ(link_profile_set(0, p_setup->profile), NRF_SUCCESS);
+    fake_sd_notify_enable(0, m_cus.bulk_handles.cccd_handle);
+
+    uint16_encode(0, &req[0]);
+    uint16_encode(RECORDED, &req[2]);
+    fake_sd_write(0, m_cus.bulk_handles.value_handle, req, sizeof(req));
+    while ((fake_sd_queued(0) > 0) && (events < 100000))
+    {
+        fake_sd_time_set((uint64_t)events * interval_us);
+        (void)fake_sd_interval_run(0, interval_us);
+        events++;
+    }
+
+    CHECK_EQ(m_rx_values, RECORDED);
+    CHECK_EQ(m_rx_errors, 0);
+    CHECK_EQ(ble_cus_tx_stats()->errors, 0);
+
+    event_us = fake_sd_conn_evt_ext() ? interval_us : MIN(interval_us, FAKE_SD_EVENT_LENGTH_US);
+    fake_sd_disconnect(0);
+
+    return fake_sd_link_stats(0)->sent_bytes * 1000.0 / ((events - 1) * interval_us + event_us);
+}
+
+
+/**@brief Bulk download throughput per setup and interval.
+ *
+ *        The smaller queue keeps a notification behind the one on air, so it loses nothing; the
+ *        default queue of one sends a single notification per event, and ATT MTU 23 pays the
+ *        packet overhead for 18 bytes of values. That is the order of the fallbacks in
+ *        ble_stack_init: the queue first, the MTU second.
+ */
+static void throughput_run(void)
+{
+    static setup_t const setups[] =
+    {
+        {LINK_PROFILE_LIVE, UINT32_MAX,                          247},
+        {LINK_PROFILE_LIVE, LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN,  247},
+        {LINK_PROFILE_LIVE, BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT, 247},
+        {LINK_PROFILE_LIVE, UINT32_MAX,                          BLE_GATT_ATT_MTU_DEFAULT},
+        {LINK_PROFILE_BULK, UINT32_MAX,                          247},
+        {LINK_PROFILE_BULK, LINK_PROFILE_HVN_TX_QUEUE_SIZE_MIN,  247},
+        {LINK_PROFILE_BULK, BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT, 247},
+        {LINK_PROFILE_BULK, UINT32_MAX,                          BLE_GATT_ATT_MTU_DEFAULT},
+    };
+    double kbps[ARRAY_SIZE(setups)][ARRAY_SIZE(m_intervals_us)];
+
+    for (uint32_t i = 0; i < RECORDED; i++)
+    {
+        sample_pool_accl[i] = (short)(i * 11 - 5000);
+    }
+
+    printf("  profile  queue  MTU ");
+    for (uint32_t j = 0; j < ARRAY_SIZE(m_intervals_us); j++)
+    {
+        printf("  %5.1f ms", m_intervals_us[j] / 1000.0);
+    }
+    printf("   (kB/s)\n");
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(setups); i++)
+    {
+        printf("  %-7s", (setups[i].profile == LINK_PROFILE_BULK) ? "bulk" : "live");
+        for (uint32_t j = 0; j < ARRAY_SIZE(m_intervals_us); j++)
+        {
+            kbps[i][j] = download_run(&setups[i], m_intervals_us[j]);
+            if (j == 0)
+            {
+                printf("  %5u  %3u ", link_profile_hvn_tx_queue_size(), setups[i].att_mtu);
+            }
+            printf("  %8.1f", kbps[i][j]);
+        }
+        printf("\n");
+    }
+
+    for (uint32_t j = 0; j < ARRAY_SIZE(m_intervals_us); j++)
+    {
+        for (uint32_t i = 0; i < ARRAY_SIZE(setups); i += 4)
+        {
+            // Queue of 8, of 2, of 1, and ATT MTU 23, for each profile.
+            CHECK(kbps[i + 1][j] == kbps[i][j]);
+            CHECK(kbps[i + 2][j] < kbps[i][j]);
+            CHECK(kbps[i + 3][j] < kbps[i][j]);
+        }
+        CHECK(kbps[4][j] >= kbps[0][j]);
+    }
+}
+
+
+int main(void)
+{
+    scenario("queue size when the SoftDevice RAM is short:", cfg_run);
+    scenario("profiles on two links:", profiles_run);
+    scenario("bulk download throughput at ATT MTU 247 and 23:", throughput_run);
+
+    return test_result("link_profile_sim");
+}
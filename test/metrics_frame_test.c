@@ -0,0 +1,178 @@
+/* Checks metrics_frame.c: every combination of flags round-trips, truncated frames and unknown
+ * versions are rejected, fields of a newer encoder are skipped, and the sequence number of
+ * ble_cus_metrics_update wraps from 0xFFFF to 0 in the frames sent over the fake SoftDevice. */
+#include <string.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "cus_fixture.h"
+#include "metrics_frame.h"
+
+#define FLAGS_ALL       (METRICS_FRAME_POWER | METRICS_FRAME_CADENCE | METRICS_FRAME_GCT | \
+                         METRICS_FRAME_VERTICAL_OSC | METRICS_FRAME_STEPS | METRICS_FRAME_TIMESTAMP)
+
+static uint16_t  m_rx_seq[8];                                               /**< Sequence numbers of the frames received. */
+static uint32_t  m_rx_count;
+
+
+/**@brief Function for getting the frame with the given flags, every byte of a field different. */
+static metrics_frame_t frame_make(uint8_t flags, uint16_t seq)
+{
+    metrics_frame_t frame =
+    {
+        .flags           = flags,
+        .seq             = seq,
+        .power           = 0xA1A2,
+        .cadence         = 0xB1,
+        .gct_ms          = 0xC1C2,
+        .vertical_osc_mm = 0xD1D2,
+        .steps           = 0xE1E2E3E4,
+        .timestamp       = 0xF1F2F3F4,
+    };
+
+    return frame;
+}
+
+
+/**@brief Function for getting the encoded length of the given flags. */
+static uint16_t frame_len(uint8_t flags)
+{
+    uint16_t len = METRICS_FRAME_HEADER_LEN;
+
+    len += (flags & METRICS_FRAME_POWER)        ? 2 : 0;
+    len += (flags & METRICS_FRAME_CADENCE)      ? 1 : 0;
+    len += (flags & METRICS_FRAME_GCT)          ? 2 : 0;
+    len += (flags & METRICS_FRAME_VERTICAL_OSC) ? 2 : 0;
+    len += (flags & METRICS_FRAME_STEPS)        ? 4 : 0;
+    len += (flags & METRICS_FRAME_TIMESTAMP)    ? 4 : 0;
+    return len;
+}
+
+
+/**@brief Function for checking a decoded frame: flagged fields as sent, the others 0. */
+static void frame_check(metrics_frame_t const * p_decoded, metrics_frame_t const * p_sent)
+{
+    uint8_t flags = p_sent->flags;
+
+    CHECK_EQ(p_decoded->flags, flags);
+    CHECK_EQ(p_decoded->seq, p_sent->seq);
+    CHECK_EQ(p_decoded->power,           (flags & METRICS_FRAME_POWER)        ? p_sent->power           : 0);
+    CHECK_EQ(p_decoded->cadence,         (flags & METRICS_FRAME_CADENCE)      ? p_sent->cadence         : 0);
+    CHECK_EQ(p_decoded->gct_ms,          (flags & METRICS_FRAME_GCT)          ? p_sent->gct_ms          : 0);
+    CHECK_EQ(p_decoded->vertical_osc_mm, (flags & METRICS_FRAME_VERTICAL_OSC) ? p_sent->vertical_osc_mm : 0);
+    CHECK_EQ(p_decoded->steps,           (flags & METRICS_FRAME_STEPS)        ? p_sent->steps           : 0);
+    CHECK_EQ(p_decoded->timestamp,       (flags & METRICS_FRAME_TIMESTAMP)    ? p_sent->timestamp       : 0);
+}
+
+
+/**@brief Every flag combination round-trips at its exact length; every shorter frame is rejected. */
+static void round_trip_check(void)
+{
+    for (uint32_t flags = 0; flags <= FLAGS_ALL; flags++)
+    {
+        metrics_frame_t const sent = frame_make((uint8_t)flags, (uint16_t)(flags * 0x0101));
+        metrics_frame_t       decoded;
+        uint8_t               buf[METRICS_FRAME_MAX_LEN];
+        uint16_t              len;
+
+        len = metrics_frame_encode(&sent, buf);
+        CHECK_EQ(len, frame_len((uint8_t)flags));
+        CHECK(len <= METRICS_FRAME_MAX_LEN);
+        CHECK_EQ(buf[0], METRICS_FRAME_VERSION);
+
+        CHECK(metrics_frame_decode(buf, len, &decoded));
+        frame_check(&decoded, &sent);
+
+        for (uint16_t short_len = 0; short_len < len; short_len++)
+        {
+            CHECK(!metrics_frame_decode(buf, short_len, &decoded));
+        }
+    }
+}
+
+
+/**@brief The byte order on the air is little endian, as documented in metrics_frame.h. */
+static void layout_check(void)
+{
+    metrics_frame_t const sent = frame_make(METRICS_FRAME_POWER | METRICS_FRAME_STEPS, 0x1234);
+    uint8_t const         expected[] = {METRICS_FRAME_VERSION, METRICS_FRAME_POWER | METRICS_FRAME_STEPS,
+                                        0x34, 0x12, 0xA2, 0xA1, 0xE4, 0xE3, 0xE2, 0xE1};
+    uint8_t               buf[METRICS_FRAME_MAX_LEN];
+
+    CHECK_EQ(metrics_frame_encode(&sent, buf), sizeof(expected));
+    CHECK(memcmp(buf, expected, sizeof(expected)) == 0);
+}
+
+
+/**@brief A frame of a newer encoder: unknown flags are kept and their trailing bytes skipped. An
+ *        unknown version is rejected. */
+static void compatibility_check(void)
+{
+    metrics_frame_t const sent = frame_make(FLAGS_ALL, 7);
+    metrics_frame_t       decoded;
+    uint8_t               buf[METRICS_FRAME_MAX_LEN + 4];
+    uint16_t              len;
+
+    len        = metrics_frame_encode(&sent, buf);
+    buf[1]    |= 0x40;
+    buf[len++] = 0x55;
+    buf[len++] = 0x66;
+    CHECK(metrics_frame_decode(buf, len, &decoded));
+    CHECK_EQ(decoded.flags, FLAGS_ALL | 0x40);
+    decoded.flags = FLAGS_ALL;
+    frame_check(&decoded, &sent);
+
+    buf[0] = METRICS_FRAME_VERSION + 1;
+    CHECK(!metrics_frame_decode(buf, len, &decoded));
+    CHECK_EQ(decoded.flags, 0);
+}
+
+
+static void metrics_rx(uint16_t conn_handle, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    metrics_frame_t decoded;
+
+    if (handle != m_cus.metrics_handles.value_handle)
+    {
+        return;
+    }
+    CHECK(metrics_frame_decode(p_data, len, &decoded));
+    if (m_rx_count < ARRAY_SIZE(m_rx_seq))
+    {
+        m_rx_seq[m_rx_count] = decoded.seq;
+    }
+    m_rx_count++;
+}
+
+
+/**@brief The frames sent by ble_cus_metrics_update count on across the 16-bit wrap. */
+static void seq_wrap_check(void)
+{
+    cus_fixture_start(NULL, metrics_rx, 0);
+    fake_sd_connect(0, BLE_GATT_ATT_MTU_DEFAULT);
+    fake_sd_notify_enable(0, m_cus.metrics_handles.cccd_handle);
+
+    m_cus.metrics_seq = 0xFFFE;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        metrics_frame_t frame = frame_make(FLAGS_ALL, 0);
+
+        CHECK_EQ(ble_cus_metrics_update(&m_cus, &frame), NRF_SUCCESS);
+        (void)fake_sd_conn_event(0, FAKE_SD_TX_BUFFERS);
+    }
+    CHECK_EQ(m_rx_count, 4);
+    CHECK_EQ(m_rx_seq[0], 0xFFFE);
+    CHECK_EQ(m_rx_seq[1], 0xFFFF);
+    CHECK_EQ(m_rx_seq[2], 0);
+    CHECK_EQ(m_rx_seq[3], 1);
+}
+
+
+int main(void)
+{
+    round_trip_check();
+    layout_check();
+    compatibility_check();
+    seq_wrap_check();
+
+    return test_result("metrics_frame_test");
+}
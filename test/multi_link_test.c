@@ -0,0 +1,256 @@
+/* Checks how ble_cus.c shares the radio between two links over the fake SoftDevice of fake_sd.c:
+ * a bulk download on one link does not delay live notifications on the other, nor drop them on
+ * its own link, two downloads progress side by side, and a link that stops taking notifications
+ * does not hold up the other. Connection events follow fake_sd_interval_run; every scenario runs in a child
+ * process, so the queues start empty. */
+#include <stdlib.h>
+#include <string.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "cus_fixture.h"
+#include "sample_pool.h"
+
+#define RECORDED        9000                                                /**< accl_arr values recorded, arr_counter. */
+#define INTERVAL_US     7500
+#define LIVE_PER_EVENT  2                                                   /**< Live notifications made every interval. */
+#define LIVE_LEN        8
+#define BULK_PER_EVENT  3                                                   /**< 244-byte notifications per 7.5 ms event on 1M. */
+#define BULK_EVENTS     CEIL_DIV((RECORDED * 2 + 241) / 242, BULK_PER_EVENT)  /**< Events of a download alone. */
+#define LIVE_LAG_EVENTS CEIL_DIV(BLE_CUS_BULK_IN_FLIGHT_MAX, BULK_PER_EVENT)  /**< Events a live notification waits behind the bulk ones on its link. */
+
+/**@brief Notifications received on one link. */
+typedef struct
+{
+    uint32_t live;
+    uint16_t live_last;                                                     /**< Number of the last live notification. */
+    uint32_t bulk_values;
+    uint32_t errors;                                                        /**< Live notifications out of order, or values not as sent. */
+} rx_t;
+
+static rx_t               m_rx[FAKE_SD_LINK_COUNT];
+static uint16_t           m_live_next;                                      /**< Number of the next live notification made. */
+static ble_cus_tx_stats_t m_stats;                                          /**< Counters when the scenario started. */
+
+
+static void rx_handler(uint16_t conn_handle, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    rx_t * p_rx = &m_rx[conn_handle];
+
+    if (handle == m_cus.power_handles.value_handle)
+    {
+        uint16_t n = uint16_decode(p_data);
+
+        if ((p_rx->live > 0) && (n != (uint16_t)(p_rx->live_last + 1)))
+        {
+            p_rx->errors++;
+        }
+        p_rx->live_last = n;
+        p_rx->live++;
+    }
+    else if (handle == m_cus.bulk_handles.value_handle)
+    {
+        for (uint16_t i = 2; i < len; i += 2)
+        {
+            if ((int16_t)uint16_decode(&p_data[i]) != sample_pool_accl[p_rx->bulk_values])
+            {
+                p_rx->errors++;
+            }
+            p_rx->bulk_values++;
+        }
+    }
+}
+
+
+/**@brief Function for connecting both links, a phone at ATT MTU 247 on link 0 and a watch at the
+ *        default MTU on link 1. */
+static void service_start(void)
+{
+    cus_fixture_start(NULL, rx_handler, RECORDED);
+    for (uint32_t i = 0; i < RECORDED; i++)
+    {
+        sample_pool_accl[i] = (short)(2000 - i * 5);
+    }
+
+    fake_sd_connect(0, 247);
+    ble_cus_att_mtu_set(&m_cus, 0, 247);
+    fake_sd_connect(1, BLE_GATT_ATT_MTU_DEFAULT);
+    ble_cus_att_mtu_set(&m_cus, 1, BLE_GATT_ATT_MTU_DEFAULT);
+    m_stats = *ble_cus_tx_stats();
+}
+
+
+#define STATS_DELTA(field)  (ble_cus_tx_stats()->field - m_stats.field)
+
+
+static void bulk_request(uint16_t conn_handle)
+{
+    uint8_t req[BLE_CUS_BULK_REQ_LEN];
+
+    fake_sd_notify_enable(conn_handle, m_cus.bulk_handles.cccd_handle);
+    uint16_encode(0, &req[0]);
+    uint16_encode(RECORDED, &req[2]);
+    fake_sd_write(conn_handle, m_cus.bulk_handles.value_handle, req, sizeof(req));
+}
+
+
+/**@brief Function for running one connection interval: the live notifications of the interval
+ *        are made, then both links get their connection event. */
+static void interval_run(uint32_t n, uint32_t live_count)
+{
+    uint8_t data[LIVE_LEN] = {0};
+
+    fake_sd_time_set((uint64_t)n * INTERVAL_US);
+    for (uint32_t i = 0; i < live_count; i++)
+    {
+        uint16_encode(m_live_next++, data);
+        (void)ble_cus_notify(&m_cus, m_cus.power_handles.value_handle, data, sizeof(data));
+    }
+    for (uint16_t conn = 0; conn < FAKE_SD_LINK_COUNT; conn++)
+    {
+        (void)fake_sd_interval_run(conn, INTERVAL_US);
+    }
+}
+
+
+/**@brief A download on the phone while the watch shows live power: every live notification
+ *        reaches the watch in the interval it was made, and the download is as fast as alone. */
+static void bulk_other_link_run(void)
+{
+    uint32_t events = 0;
+
+    service_start();
+    fake_sd_notify_enable(1, m_cus.power_handles.cccd_handle);
+    bulk_request(0);
+
+    while (ble_cus_link_transfer_active(&m_cus.links[0]) || (fake_sd_queued(0) > 0))
+    {
+        interval_run(events++, LIVE_PER_EVENT);
+        CHECK_EQ(m_rx[1].live, events * LIVE_PER_EVENT);
+        CHECK_EQ(ble_cus_tx_queue_depth(&m_cus, 1), 0);
+        if (events > 10 * BULK_EVENTS)
+        {
+            break;
+        }
+    }
+    CHECK_EQ(m_rx[0].bulk_values, RECORDED);
+    CHECK_EQ(events, BULK_EVENTS);
+    CHECK_EQ(m_rx[0].live, 0);
+    CHECK_EQ(m_rx[0].errors, 0);
+    CHECK_EQ(m_rx[1].errors, 0);
+    CHECK_EQ(STATS_DELTA(dropped_full), 0);
+    printf("  %u values in %u events, %u live notifications on the other link\n",
+           RECORDED, (unsigned)events, (unsigned)m_rx[1].live);
+}
+
+
+/**@brief Live power on the link that downloads: the bulk transfer leaves it TX buffers, so none
+ *        is dropped. It goes out behind the bulk notifications already in flight, which takes
+ *        LIVE_LAG_EVENTS events at most. */
+static void bulk_same_link_run(void)
+{
+    uint32_t events = 0;
+
+    service_start();
+    fake_sd_notify_enable(0, m_cus.power_handles.cccd_handle);
+    fake_sd_notify_enable(1, m_cus.power_handles.cccd_handle);
+    bulk_request(0);
+
+    while (ble_cus_link_transfer_active(&m_cus.links[0]) || (fake_sd_queued(0) > 0))
+    {
+        interval_run(events++, LIVE_PER_EVENT);
+        CHECK(m_rx[0].live + LIVE_LAG_EVENTS * LIVE_PER_EVENT >= events * LIVE_PER_EVENT);
+        CHECK_EQ(m_rx[1].live, events * LIVE_PER_EVENT);
+        if (events > 10 * BULK_EVENTS)
+        {
+            break;
+        }
+    }
+    CHECK_EQ(m_rx[0].live, events * LIVE_PER_EVENT);
+    CHECK_EQ(m_rx[0].bulk_values, RECORDED);
+    CHECK_EQ(m_rx[0].errors, 0);
+    CHECK_EQ(m_rx[1].errors, 0);
+    CHECK_EQ(STATS_DELTA(dropped_full), 0);
+    printf("  %u values in %u events with %u live notifications on the same link\n",
+           RECORDED, (unsigned)events, (unsigned)m_rx[0].live);
+}
+
+
+/**@brief Downloads on both links at once progress side by side. */
+static void bulk_both_links_run(void)
+{
+    uint32_t events = 0;
+
+    service_start();
+    ble_cus_att_mtu_set(&m_cus, 1, 247);
+    fake_sd_mtu_set(1, 247);
+    bulk_request(0);
+    bulk_request(1);
+
+    while ((ble_cus_link_transfer_active(&m_cus.links[0]) || (fake_sd_queued(0) > 0) ||
+            ble_cus_link_transfer_active(&m_cus.links[1]) || (fake_sd_queued(1) > 0)) &&
+           (events <= 10 * BULK_EVENTS))
+    {
+        interval_run(events++, 0);
+        CHECK(MAX(m_rx[0].bulk_values, m_rx[1].bulk_values) -
+              MIN(m_rx[0].bulk_values, m_rx[1].bulk_values) <= 3 * 121);
+    }
+    CHECK_EQ(m_rx[0].bulk_values, RECORDED);
+    CHECK_EQ(m_rx[1].bulk_values, RECORDED);
+    CHECK_EQ(events, BULK_EVENTS);
+    CHECK_EQ(m_rx[0].errors, 0);
+    CHECK_EQ(m_rx[1].errors, 0);
+}
+
+
+/**@brief The watch stops taking notifications: its queue fills and drops, while the phone keeps
+ *        getting every live notification and its download. */
+static void stalled_link_run(void)
+{
+    uint32_t events = 0;
+
+    service_start();
+    fake_sd_notify_enable(0, m_cus.power_handles.cccd_handle);
+    fake_sd_notify_enable(1, m_cus.power_handles.cccd_handle);
+    bulk_request(0);
+
+    while ((ble_cus_link_transfer_active(&m_cus.links[0]) || (fake_sd_queued(0) > 0)) &&
+           (events <= 10 * BULK_EVENTS))
+    {
+        uint8_t data[LIVE_LEN] = {0};
+
+        fake_sd_time_set((uint64_t)events * INTERVAL_US);
+        for (uint32_t i = 0; i < LIVE_PER_EVENT; i++)
+        {
+            uint16_encode(m_live_next++, data);
+            (void)ble_cus_notify(&m_cus, m_cus.power_handles.value_handle, data, sizeof(data));
+        }
+        (void)fake_sd_interval_run(0, INTERVAL_US);
+        events++;
+        CHECK(m_rx[0].live + LIVE_LAG_EVENTS * LIVE_PER_EVENT >= events * LIVE_PER_EVENT);
+    }
+    CHECK_EQ(m_rx[0].live, events * LIVE_PER_EVENT);
+    CHECK_EQ(m_rx[0].bulk_values, RECORDED);
+    CHECK_EQ(m_rx[0].errors, 0);
+    CHECK_EQ(m_rx[1].live, 0);
+    CHECK_EQ(fake_sd_queued(1), FAKE_SD_TX_BUFFERS);
+    CHECK_EQ(ble_cus_tx_queue_depth(&m_cus, 1), BLE_CUS_TX_QUEUE_SIZE);
+    CHECK_EQ(STATS_DELTA(dropped_full), events * LIVE_PER_EVENT - FAKE_SD_TX_BUFFERS - BLE_CUS_TX_QUEUE_SIZE);
+
+    // The watch comes back and gets what was queued, in order.
+    while (fake_sd_interval_run(1, INTERVAL_US) > 0)
+    {
+    }
+    CHECK_EQ(m_rx[1].live, FAKE_SD_TX_BUFFERS + BLE_CUS_TX_QUEUE_SIZE);
+    CHECK_EQ(m_rx[1].errors, 0);
+}
+
+
+int main(void)
+{
+    scenario("bulk download on one link, live power on the other:", bulk_other_link_run);
+    scenario("bulk download and live power on the same link:", bulk_same_link_run);
+    scenario("bulk downloads on both links:", bulk_both_links_run);
+    scenario("one link stops taking notifications:", stalled_link_run);
+
+    return test_result("multi_link_test");
+}
@@ -0,0 +1,93 @@
+/* Checks that running_metrics.c counts the strides of stride_events.c: a synthetic run at 50 Hz
+ * with a pause, steps and distance counted with no update in between, as when no client is
+ * subscribed, and cadence, ground contact and the standstill from the updates. */
+#include <stdlib.h>
+#include <math.h>
+#include "test_check.h"
+#include "running_metrics.h"
+
+#define SAMPLE_MS       20                                                  /**< 50 Hz, the default sampling timer. */
+#define G               1024
+
+static uint32_t m_now_ms;
+static uint32_t m_strides;                                                  /**< Strides stride_events_push reported. */
+
+
+/**@brief Function for running at a cadence: each step a ground contact of 40 % of it, where the
+ *        magnitude rises to 2.5 g, then a flight at 0.2 g. */
+static void run(uint32_t cadence, uint32_t duration_ms)
+{
+    uint32_t const step_ms = 60000 / cadence;
+
+    for (uint32_t t = 0; t < duration_ms; t += SAMPLE_MS)
+    {
+        float   phase = (float)(t % step_ms) / step_ms;
+        int16_t z     = (phase < 0.4f) ? (int16_t)(G + 1.5f * G * sinf((float)M_PI * phase / 0.4f))
+                                       : (int16_t)(G / 5);
+
+        m_now_ms += SAMPLE_MS;
+        if (stride_events_push(0, 0, z, m_now_ms))
+        {
+            stride_events_record_t stride;
+
+            CHECK(stride_events_get(stride_events_head() - 1, &stride));
+            running_metrics_stride_add(&stride);
+            m_strides++;
+        }
+    }
+}
+
+
+/**@brief Function for standing still. */
+static void stand(uint32_t duration_ms)
+{
+    for (uint32_t t = 0; t < duration_ms; t += SAMPLE_MS)
+    {
+        m_now_ms += SAMPLE_MS;
+        CHECK(!stride_events_push(0, 0, G, m_now_ms));
+    }
+}
+
+
+int main(void)
+{
+    running_metrics_t const * p_metrics = running_metrics_get();
+    uint32_t                  distance_cm;
+
+    // Ten minutes without an update, like without a client.
+    run(170, 600000);
+    CHECK_EQ(p_metrics->steps, m_strides);
+    CHECK(fabsf(m_strides - 170.0f * 10) < 5);
+    CHECK(p_metrics->distance_cm > 50 * m_strides);
+    CHECK(p_metrics->distance_cm < 150 * m_strides);
+
+    running_metrics_update(m_now_ms);
+    CHECK(abs((int)p_metrics->cadence - 170) <= 2);
+    CHECK(p_metrics->running);
+    CHECK(abs((int)p_metrics->gct_ms - 60000 / 170 * 2 / 5) <= 3 * SAMPLE_MS);
+    CHECK(p_metrics->vertical_osc_mm > 0);
+    CHECK(abs((int)p_metrics->speed_cm_s - p_metrics->step_length_cm * p_metrics->cadence / 60) <= 2);
+    printf("%u steps in 10 min at 170 steps/min: %u m, cadence %u, step %u cm, contact %u ms, "
+           "oscillation %u mm\n", (unsigned)p_metrics->steps, (unsigned)(p_metrics->distance_cm / 100),
+           p_metrics->cadence, p_metrics->step_length_cm, p_metrics->gct_ms, p_metrics->vertical_osc_mm);
+
+    // A pause longer than the window: standing still, the totals stay.
+    distance_cm = p_metrics->distance_cm;
+    stand(RUNNING_METRICS_WINDOW_MS + 1000);
+    running_metrics_update(m_now_ms);
+    CHECK_EQ(p_metrics->cadence, 0);
+    CHECK_EQ(p_metrics->speed_cm_s, 0);
+    CHECK(!p_metrics->running);
+    CHECK_EQ(p_metrics->distance_cm, distance_cm);
+
+    // Walking on after the pause, with the distance set by the SC control point.
+    running_metrics_distance_set(100000);
+    run(110, 60000);
+    running_metrics_update(m_now_ms);
+    CHECK(abs((int)p_metrics->cadence - 110) <= 2);
+    CHECK(!p_metrics->running);
+    CHECK(abs((int)p_metrics->steps - 110) <= 2);
+    CHECK(p_metrics->distance_cm > 100000 + 50 * p_metrics->steps);
+
+    return test_result("running_metrics_test");
+}
@@ -0,0 +1,167 @@
+/* Checks the struct-of-arrays kernels of sample_soa.c against the interleaved reference kernels
+ * on the same samples, and times both layouts on the host. The on-target cycle counts come from
+ * sample_soa_benchmark (SAMPLE_SOA_BENCHMARK_ENABLED). */
+#include <stdlib.h>
+#include <string.h>
+#include "test_check.h"
+#include "sample_soa.h"
+
+#define TIMING_RUNS     2000
+
+static uint16_t m_aos_head;                                                 /**< Next write position in sample_pool_window. */
+
+
+/**@brief Function for pushing a sample to both layouts, as the sampling timer does. */
+static void sample_push(int16_t x, int16_t y, int16_t z)
+{
+    sample_pool_window[m_aos_head] = x;
+    m_aos_head = (m_aos_head + 1) % SAMPLE_POOL_WINDOW_LEN;
+    sample_pool_window[m_aos_head] = y;
+    m_aos_head = (m_aos_head + 1) % SAMPLE_POOL_WINDOW_LEN;
+    sample_pool_window[m_aos_head] = z;
+    m_aos_head = (m_aos_head + 1) % SAMPLE_POOL_WINDOW_LEN;
+
+    sample_soa_push(x, y, z);
+}
+
+
+static int16_t sample_random(int16_t range)
+{
+    return (int16_t)(rand() % (2 * range + 1) - range);
+}
+
+
+/**@brief Function for comparing every kernel of both layouts on the current window. */
+static void kernels_compare(int16_t const * p_coeffs, uint32_t taps)
+{
+    uint16_t aos_mag[SAMPLE_SOA_WINDOW_LEN];
+    uint16_t soa_mag[SAMPLE_SOA_WINDOW_LEN];
+    int16_t  aos_fir[SAMPLE_SOA_WINDOW_LEN];
+    int16_t  soa_fir[SAMPLE_SOA_WINDOW_LEN];
+    int16_t  interleaved[SAMPLE_POOL_WINDOW_LEN];
+
+    sample_aos_magnitude(sample_pool_window, m_aos_head, aos_mag);
+    sample_soa_magnitude(soa_mag);
+    CHECK(memcmp(aos_mag, soa_mag, sizeof(aos_mag)) == 0);
+
+    for (uint32_t axis = 0; axis < SAMPLE_SOA_AXIS_COUNT; axis++)
+    {
+        uint32_t aos_count = sample_aos_fir(sample_pool_window, m_aos_head, (sample_soa_axis_t)axis,
+                                            p_coeffs, taps, aos_fir);
+        uint32_t soa_count = sample_soa_fir((sample_soa_axis_t)axis, p_coeffs, taps, soa_fir);
+
+        CHECK_EQ(soa_count, SAMPLE_SOA_WINDOW_LEN - taps + 1);
+        CHECK_EQ(aos_count, soa_count);
+        CHECK(memcmp(aos_fir, soa_fir, soa_count * sizeof(int16_t)) == 0);
+    }
+
+    CHECK_EQ(sample_soa_interleave(0, SAMPLE_SOA_WINDOW_LEN, interleaved), SAMPLE_SOA_WINDOW_LEN);
+    for (uint32_t i = 0; i < SAMPLE_POOL_WINDOW_LEN; i++)
+    {
+        CHECK_EQ(interleaved[i], sample_pool_window[(m_aos_head + i) % SAMPLE_POOL_WINDOW_LEN]);
+    }
+}
+
+
+/**@brief Function for timing the magnitude and the FIR on all axes, for both layouts. */
+static void kernels_time(int16_t const * p_coeffs, uint32_t taps)
+{
+    static uint16_t magnitude[SAMPLE_SOA_WINDOW_LEN];
+    static int16_t  filtered[SAMPLE_SOA_WINDOW_LEN];
+    double          start;
+    double          aos_mag;
+    double          soa_mag;
+    double          aos_fir;
+    double          soa_fir;
+
+    start = test_now_us();
+    for (uint32_t run = 0; run < TIMING_RUNS; run++)
+    {
+        sample_aos_magnitude(sample_pool_window, m_aos_head, magnitude);
+    }
+    aos_mag = (test_now_us() - start) / TIMING_RUNS;
+
+    start = test_now_us();
+    for (uint32_t run = 0; run < TIMING_RUNS; run++)
+    {
+        sample_soa_magnitude(magnitude);
+    }
+    soa_mag = (test_now_us() - start) / TIMING_RUNS;
+
+    start = test_now_us();
+    for (uint32_t run = 0; run < TIMING_RUNS; run++)
+    {
+        for (uint32_t axis = 0; axis < SAMPLE_SOA_AXIS_COUNT; axis++)
+        {
+            (void)sample_aos_fir(sample_pool_window, m_aos_head, (sample_soa_axis_t)axis,
+                                 p_coeffs, taps, filtered);
+        }
+    }
+    aos_fir = (test_now_us() - start) / TIMING_RUNS;
+
+    start = test_now_us();
+    for (uint32_t run = 0; run < TIMING_RUNS; run++)
+    {
+        for (uint32_t axis = 0; axis < SAMPLE_SOA_AXIS_COUNT; axis++)
+        {
+            (void)sample_soa_fir((sample_soa_axis_t)axis, p_coeffs, taps, filtered);
+        }
+    }
+    soa_fir = (test_now_us() - start) / TIMING_RUNS;
+
+    printf("  host, %d samples: magnitude interleaved %.2f us, SoA %.2f us; "
+           "%u-tap FIR x3 interleaved %.2f us, SoA %.2f us\n",
+           SAMPLE_SOA_WINDOW_LEN, aos_mag, soa_mag, (unsigned)taps, aos_fir, soa_fir);
+}
+
+
+int main(void)
+{
+    // 8-tap moving average, and a gain of 5 that saturates at 8 g.
+    static int16_t const average[8] = {4096, 4096, 4096, 4096, 4096, 4096, 4096, 4096};
+    static int16_t const loud[10]   = {16384, 16384, 16384, 16384, 16384, 16384, 16384, 16384,
+                                       16384, 16384};
+    int16_t              out[SAMPLE_SOA_WINDOW_LEN];
+
+    srand(1);
+
+    // Every head position, so the window wraps at each possible sample in both layouts.
+    for (uint32_t i = 0; i < 3 * SAMPLE_SOA_WINDOW_LEN; i++)
+    {
+        sample_push(sample_random(2048), sample_random(2048), sample_random(2048));
+        if (i >= SAMPLE_SOA_WINDOW_LEN)
+        {
+            kernels_compare(average, 8);
+        }
+    }
+
+    // Samples at 8 g saturate the 16-bit output the same way in both layouts.
+    for (uint32_t i = 0; i < SAMPLE_SOA_WINDOW_LEN; i++)
+    {
+        sample_push(8192, -8192, (i % 2) ? 8192 : -8192);
+    }
+    kernels_compare(loud, 10);
+    CHECK_EQ(sample_soa_fir(SAMPLE_SOA_AXIS_X, loud, 10, out), SAMPLE_SOA_WINDOW_LEN - 9);
+    CHECK_EQ(out[0], INT16_MAX);
+    CHECK_EQ(sample_soa_fir(SAMPLE_SOA_AXIS_Y, loud, 10, out), SAMPLE_SOA_WINDOW_LEN - 9);
+    CHECK_EQ(out[0], INT16_MIN);
+    CHECK_EQ(sample_soa_fir(SAMPLE_SOA_AXIS_Z, loud, 10, out), SAMPLE_SOA_WINDOW_LEN - 9);
+    CHECK_EQ(out[0], 0);
+
+    // Taps the kernels refuse.
+    CHECK_EQ(sample_soa_fir(SAMPLE_SOA_AXIS_X, average, 0, out), 0);
+    CHECK_EQ(sample_soa_fir(SAMPLE_SOA_AXIS_X, average, 7, out), 0);
+    CHECK_EQ(sample_soa_fir(SAMPLE_SOA_AXIS_X, average, SAMPLE_SOA_FIR_MAX_TAPS + 2, out), 0);
+
+    // Interleaving clips to the end of the window.
+    CHECK_EQ(sample_soa_interleave(SAMPLE_SOA_WINDOW_LEN - 2, 10, out), 2);
+    CHECK_EQ(sample_soa_interleave(SAMPLE_SOA_WINDOW_LEN, 1, out), 0);
+
+    for (uint32_t i = 0; i < SAMPLE_SOA_WINDOW_LEN; i++)
+    {
+        sample_push(sample_random(2048), sample_random(2048), sample_random(2048));
+    }
+    kernels_time(average, 8);
+
+    return test_result("sample_soa_test");
+}
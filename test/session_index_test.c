@@ -0,0 +1,457 @@
+/* Checks session_index.c on long sessions with jittered block times against the exact block of
+ * every time, at both ends of a session and once the oldest entries are overwritten, and the
+ * rebuild of the index from sample blocks stored by several boots on the fake flash of
+ * fake_fstorage.c. Then records hours of sessions at 50 Hz through the decimation of
+ * sample_block.c, as main.c does, and looks up minutes 30 to 35 of a session that is not the last
+ * one, before and after a reboot. Every scenario runs in a child process, so the modules start
+ * from their reset state. */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "fake_fstorage.h"
+#include "flash_log.h"
+#include "sample_block.h"
+#include "session_index.h"
+
+#define BLOCK_MS        SAMPLE_BLOCK_PERIOD_MS
+#define JITTER_MS       4
+#define MAX_BLOCKS      8000
+#define SAMPLE_MS       20                                                  /**< Sampling period at 50 Hz. */
+#define MINUTE_MS       60000
+
+/**@brief Blocks of one session as they were added. */
+typedef struct
+{
+    uint32_t first_block;
+    uint32_t count;
+    uint32_t time_ms[MAX_BLOCKS];                                           /**< Local time of every block. */
+} session_ref_t;
+
+static session_ref_t m_ref;
+
+
+/**@brief Function for making the times of a session's blocks, BLOCK_MS apart with some jitter. */
+static void ref_make(uint32_t first_block, uint32_t count, uint32_t start_ms)
+{
+    m_ref.first_block = first_block;
+    m_ref.count       = count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        m_ref.time_ms[i] = start_ms + i * BLOCK_MS + (uint32_t)(rand() % (JITTER_MS + 1));
+    }
+}
+
+
+/**@brief Function for getting the first block at or after a time relative to the session start,
+ *        searching from block first_kept on. */
+static uint32_t ref_block_at(uint32_t first_kept, uint32_t time_ms)
+{
+    uint32_t i = first_kept - m_ref.first_block;
+
+    while ((i < m_ref.count) && (m_ref.time_ms[i] - m_ref.time_ms[0] < time_ms))
+    {
+        i++;
+    }
+    return m_ref.first_block + i;
+}
+
+
+/**@brief Function for comparing lookups over the whole session with the exact blocks.
+ *
+ * @details Between index entries the block is interpolated, so with jittered times it can be one
+ *          off; at an entry and at both ends of the session it is exact.
+ */
+static void lookups_check(uint16_t id, uint32_t first_kept)
+{
+    session_index_info_t info;
+    uint32_t             first;
+    uint32_t             count;
+    uint32_t             exact    = 0;
+    uint32_t             lookups  = 0;
+    uint32_t             max_off  = 0;
+    uint32_t             duration = m_ref.time_ms[m_ref.count - 1] - m_ref.time_ms[0];
+
+    CHECK_EQ(session_index_info(id, &info), NRF_SUCCESS);
+    CHECK_EQ(info.first_block, m_ref.first_block);
+    CHECK_EQ(info.block_count, m_ref.count);
+    CHECK_EQ(info.duration_ms, duration);
+
+    for (uint32_t time_ms = 0; time_ms <= duration + 2 * BLOCK_MS; time_ms += 7)
+    {
+        uint32_t expected = ref_block_at(first_kept, time_ms);
+        uint32_t off;
+
+        CHECK_EQ(session_index_lookup(id, time_ms, time_ms, &first, &count), NRF_SUCCESS);
+        CHECK_EQ(count, 0);
+        off      = (first > expected) ? first - expected : expected - first;
+        max_off  = MAX(max_off, off);
+        exact   += (off == 0);
+        lookups++;
+    }
+    CHECK(max_off <= 1);
+
+    // Index entries.
+    for (uint32_t block = first_kept; block < m_ref.first_block + m_ref.count; block += SESSION_INDEX_INTERVAL)
+    {
+        uint32_t time_ms = m_ref.time_ms[block - m_ref.first_block] - m_ref.time_ms[0];
+
+        CHECK_EQ(session_index_lookup(id, time_ms, time_ms, &first, &count), NRF_SUCCESS);
+        CHECK_EQ(first, block);
+    }
+
+    // Start of the session, or of what is still indexed of it.
+    CHECK_EQ(session_index_lookup(id, 0, 1, &first, &count), NRF_SUCCESS);
+    CHECK_EQ(first, first_kept);
+    CHECK_EQ(count, ref_block_at(first_kept, 1) - first_kept);
+
+    // The whole session, its last block alone, and past its end.
+    CHECK_EQ(session_index_lookup(id, 0, duration + 1, &first, &count), NRF_SUCCESS);
+    CHECK_EQ(first + count, m_ref.first_block + m_ref.count);
+    CHECK_EQ(session_index_lookup(id, duration, duration + 1, &first, &count), NRF_SUCCESS);
+    CHECK_EQ(first, m_ref.first_block + m_ref.count - 1);
+    CHECK_EQ(count, 1);
+    CHECK_EQ(session_index_lookup(id, duration + 1, UINT32_MAX, &first, &count), NRF_SUCCESS);
+    CHECK_EQ(count, 0);
+
+    printf("  session %u, %u blocks: %u lookups, %.1f %% exact, at most %u block off\n",
+           (unsigned)id, (unsigned)m_ref.count, (unsigned)lookups, 100.0 * exact / lookups,
+           (unsigned)max_off);
+}
+
+
+/**@brief A session of 3000 blocks, longer than the flash log holds. */
+static void long_session_run(void)
+{
+    ref_make(40, 3000, 12345);
+    for (uint32_t i = 0; i < m_ref.count; i++)
+    {
+        session_index_block_add(m_ref.first_block + i, m_ref.time_ms[i]);
+    }
+    lookups_check(0, m_ref.first_block);
+}
+
+
+/**@brief A session of 7000 blocks: the first entries are overwritten, so its start is no longer
+ *        indexed and lookups start at the oldest entry kept. */
+static void overwritten_session_run(void)
+{
+    uint32_t entries = (7000 - 1) / SESSION_INDEX_INTERVAL + 1;
+
+    ref_make(0, 7000, 500);
+    for (uint32_t i = 0; i < m_ref.count; i++)
+    {
+        session_index_block_add(m_ref.first_block + i, m_ref.time_ms[i]);
+    }
+    lookups_check(0, (entries - SESSION_INDEX_ENTRY_COUNT) * SESSION_INDEX_INTERVAL);
+}
+
+
+/**@brief Function for recording blocks as main.c does. */
+static void blocks_record(uint32_t count, uint32_t start_ms)
+{
+    uint16_t samples[SAMPLE_BLOCK_SAMPLES] = {0};
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t block;
+        uint32_t time_ms = start_ms + i * BLOCK_MS;
+
+        CHECK_EQ(sample_block_append(samples, time_ms, &block), NRF_SUCCESS);
+        session_index_block_add(block, time_ms);
+        fake_fstorage_flush();
+    }
+}
+
+
+static void boot_init(void)
+{
+    CHECK_EQ(flash_log_init(), NRF_SUCCESS);
+    sample_block_init();
+    session_index_rebuild();
+}
+
+
+/**@brief First boot: one session of 700 blocks. */
+static void boot1_run(void)
+{
+    boot_init();
+    blocks_record(700, 250);
+}
+
+
+/**@brief Second boot: the clock starts over, so a new session; then a recording two periods
+ *        after the last, as sample_block.c starts it at the soonest. */
+static void boot2_run(void)
+{
+    boot_init();
+    blocks_record(1500, 180);
+    blocks_record(300, 180 + 1501 * BLOCK_MS);
+}
+
+
+/**@brief Checks a rebuilt session against the blocks recorded. */
+static void rebuilt_check(uint16_t id, uint32_t first_block, uint32_t count)
+{
+    session_index_info_t info;
+    uint32_t             first;
+    uint32_t             n;
+    uint32_t             duration = (count - 1) * BLOCK_MS;
+
+    CHECK_EQ(session_index_info(id, &info), NRF_SUCCESS);
+    CHECK_EQ(info.first_block, first_block);
+    CHECK_EQ(info.block_count, count);
+    CHECK_EQ(info.duration_ms, duration);
+    CHECK_EQ(info.epoch_start_s, SESSION_INDEX_EPOCH_UNKNOWN);
+
+    // Blocks are exactly BLOCK_MS apart here, so the interpolation is exact everywhere.
+    for (uint32_t i = 0; i < count; i += 5)
+    {
+        CHECK_EQ(session_index_lookup(id, i * BLOCK_MS, i * BLOCK_MS + 1, &first, &n), NRF_SUCCESS);
+        CHECK_EQ(first, first_block + i);
+        CHECK_EQ(n, 1);
+    }
+    CHECK_EQ(session_index_lookup(id, 0, duration + 1, &first, &n), NRF_SUCCESS);
+    CHECK_EQ(first, first_block);
+    CHECK_EQ(n, count);
+}
+
+
+/**@brief Third boot: the index is rebuilt from the flash log, which lost its oldest pages and
+ *        holds one torn block; then this boot records a session of its own. */
+static void boot3_run(void)
+{
+    session_index_info_t info;
+    uint32_t             tail;
+    double               start;
+
+    CHECK_EQ(flash_log_init(), NRF_SUCCESS);
+    sample_block_init();
+    tail  = flash_log_tail();
+    start = test_now_us();
+    session_index_rebuild();
+    printf("  rebuilt %u blocks in %.0f us on the host\n", (unsigned)(flash_log_head() - tail),
+           test_now_us() - start);
+
+    // 2500 blocks were recorded, a lap holds 2032.
+    CHECK_EQ(tail, 508);
+    CHECK_EQ(flash_log_head(), 2500);
+
+    rebuilt_check(0, tail, 700 - tail);
+    rebuilt_check(1, 700, 1000 - 700);
+    rebuilt_check(2, 1001, 2200 - 1001);
+    rebuilt_check(3, 2200, 300);
+    CHECK_EQ(session_index_info(4, &info), NRF_ERROR_NOT_FOUND);
+
+    // The first block of this boot starts a session even though its time follows the last one.
+    blocks_record(10, 180 + 1801 * BLOCK_MS);
+    CHECK_EQ(session_index_info(4, &info), NRF_SUCCESS);
+    CHECK_EQ(info.first_block, 2500);
+    CHECK_EQ(info.block_count, 10);
+
+    // Only this boot's sessions can be put on the wall clock.
+    session_index_epoch_set(1700000000, 180 + 1811 * BLOCK_MS);
+    CHECK_EQ(session_index_info(3, &info), NRF_SUCCESS);
+    CHECK_EQ(info.epoch_start_s, SESSION_INDEX_EPOCH_UNKNOWN);
+    CHECK_EQ(session_index_info(4, &info), NRF_SUCCESS);
+    CHECK_EQ(info.epoch_start_s, 1700000000 - 10 * BLOCK_MS / 1000);
+}
+
+
+/**@brief Recordings of the decimated history: length, and idle time before them. The first one
+ *        loses its start when the flash log wraps; the fifth starts right after the fourth. */
+static uint32_t const m_recording_min[] = {60, 30, 35, 20, 40, 25};
+static uint32_t const m_idle_ms[]       = {3000, 600000, 3600000, 900000, 300, 7200000};
+
+#define LOOKUP_SESSION  4
+#define LOOKUP_FROM_MS  (30 * MINUTE_MS)
+#define LOOKUP_TO_MS    (35 * MINUTE_MS)
+
+/**@brief Block numbers and times of the recordings, shared with the boot after them. */
+typedef struct
+{
+    uint32_t first_block[ARRAY_SIZE(m_recording_min)];
+    uint32_t first_ms[ARRAY_SIZE(m_recording_min)];                         /**< Local time of the first block. */
+    uint32_t last_block[ARRAY_SIZE(m_recording_min)];
+    uint32_t pages_erased;
+} recordings_t;
+
+static recordings_t * mp_recordings;
+
+
+/**@brief Function for recording sessions at 50 Hz as main.c does while session_stats has one.
+ *
+ * @details x counts the averages of a recording, y is the recording number, so the values of a
+ *          block tell where it was recorded.
+ */
+static void history_record_run(void)
+{
+    uint32_t now_ms = 0;
+
+    boot_init();
+    for (uint32_t r = 0; r < ARRAY_SIZE(m_recording_min); r++)
+    {
+        uint32_t start_ms;
+        uint32_t blocks = 0;
+
+        now_ms  += m_idle_ms[r];
+        start_ms = now_ms;
+        for (; now_ms - start_ms < m_recording_min[r] * MINUTE_MS; now_ms += SAMPLE_MS)
+        {
+            int16_t  x = (int16_t)((now_ms - start_ms) / SAMPLE_BLOCK_SAMPLE_MS);
+            uint32_t block;
+            uint32_t block_ms;
+
+            if (sample_block_sample_add(x, (int16_t)r, -1024, now_ms, &block, &block_ms))
+            {
+                session_index_block_add(block, block_ms);
+                fake_fstorage_flush();
+                if (blocks++ == 0)
+                {
+                    mp_recordings->first_block[r] = block;
+                    mp_recordings->first_ms[r]    = block_ms;
+                }
+                mp_recordings->last_block[r] = block;
+                CHECK_EQ(block_ms, mp_recordings->first_ms[r] + (blocks - 1) * SAMPLE_BLOCK_PERIOD_MS);
+            }
+        }
+        sample_block_record_stop();
+
+        // A recording gets a block per period, less the one cut by the end.
+        CHECK(blocks + 1 >= m_recording_min[r] * MINUTE_MS / SAMPLE_BLOCK_PERIOD_MS);
+        CHECK(blocks <= m_recording_min[r] * MINUTE_MS / SAMPLE_BLOCK_PERIOD_MS);
+    }
+    mp_recordings->pages_erased = flash_log_stats()->pages_erased;
+}
+
+
+/**@brief Function for looking up minutes 30 to 35 of a session and checking the blocks returned.
+ *
+ * @param[in] first_x   Average count of the first block of the session, not 0 for a session the
+ *                      flash log lost the start of.
+ */
+static void history_lookup_check(uint32_t first_x)
+{
+    session_index_info_t info;
+    uint32_t             first;
+    uint32_t             count;
+    uint8_t              data[FLASH_LOG_DATA_SIZE];
+    uint16_t             len;
+
+    CHECK_EQ(session_index_info(LOOKUP_SESSION, &info), NRF_SUCCESS);
+    CHECK_EQ(info.first_block, mp_recordings->first_block[LOOKUP_SESSION]);
+    CHECK_EQ(info.block_count, mp_recordings->last_block[LOOKUP_SESSION] - info.first_block + 1);
+
+    // Five minutes are 50 blocks; every one of them holds the averages of its own 6 s.
+    CHECK_EQ(session_index_lookup(LOOKUP_SESSION, LOOKUP_FROM_MS, LOOKUP_TO_MS, &first, &count), NRF_SUCCESS);
+    CHECK_EQ(count, (LOOKUP_TO_MS - LOOKUP_FROM_MS) / SAMPLE_BLOCK_PERIOD_MS);
+    for (uint32_t block = first; block < first + count; block++)
+    {
+        uint32_t j = block - info.first_block;
+
+        CHECK_EQ(flash_log_read(block, data, &len), NRF_SUCCESS);
+        CHECK_EQ(len, SAMPLE_BLOCK_LEN);
+        CHECK_EQ(uint32_decode(&data[SAMPLE_BLOCK_LEN - SAMPLE_BLOCK_TIMESTAMP_LEN]) - mp_recordings->first_ms[LOOKUP_SESSION],
+                 LOOKUP_FROM_MS + (block - first) * SAMPLE_BLOCK_PERIOD_MS);
+        for (uint32_t i = 0; i < SAMPLE_BLOCK_SAMPLES / 3; i++)
+        {
+            CHECK_EQ((int16_t)uint16_decode(&data[6 * i]), first_x + 3 * j + i);
+            CHECK_EQ((int16_t)uint16_decode(&data[6 * i + 2]), LOOKUP_SESSION);
+            CHECK_EQ((int16_t)uint16_decode(&data[6 * i + 4]), -1024);
+        }
+    }
+    printf("  session %u, minutes 30 to 35: blocks %u to %u\n", LOOKUP_SESSION, (unsigned)first,
+           (unsigned)(first + count - 1));
+}
+
+
+/**@brief Function for checking that every recording is a session of its own, and the lookup. */
+static void history_check(void)
+{
+    session_index_info_t info;
+    uint32_t             tail = flash_log_tail();
+    uint32_t             first;
+    uint32_t             count;
+    uint8_t              data[FLASH_LOG_DATA_SIZE];
+    uint16_t             len;
+
+    for (uint32_t r = 0; r < ARRAY_SIZE(m_recording_min); r++)
+    {
+        CHECK_EQ(session_index_info(r, &info), NRF_SUCCESS);
+        CHECK_EQ(info.first_block, MAX(tail, mp_recordings->first_block[r]));
+        CHECK_EQ(info.block_count, mp_recordings->last_block[r] - info.first_block + 1);
+    }
+    CHECK_EQ(session_index_info(ARRAY_SIZE(m_recording_min), &info), NRF_ERROR_NOT_FOUND);
+
+    // What is left of the first session is still found, from an index entry on.
+    CHECK_EQ(session_index_lookup(0, 0, m_recording_min[0] * MINUTE_MS, &first, &count), NRF_SUCCESS);
+    CHECK(first >= tail);
+    CHECK(first < tail + SESSION_INDEX_INTERVAL);
+    CHECK(count > 0);
+    CHECK_EQ(flash_log_read(first, data, &len), NRF_SUCCESS);
+    history_lookup_check(0);
+}
+
+
+/**@brief Hours of sessions: the flash log keeps all but the start of the first, and minutes 30 to
+ *        35 of the fifth are found with one lookup. */
+static void history_run(void)
+{
+    uint32_t recorded_min = 0;
+
+    history_record_run();
+    for (uint32_t r = 0; r < ARRAY_SIZE(m_recording_min); r++)
+    {
+        recorded_min += m_recording_min[r];
+    }
+    printf("  %u min recorded in %u blocks, %u kept, %u pages erased: a page every %.1f min of recording\n",
+           (unsigned)recorded_min, (unsigned)flash_log_head(), (unsigned)(flash_log_head() - flash_log_tail()),
+           (unsigned)mp_recordings->pages_erased, (double)recorded_min / mp_recordings->pages_erased);
+
+    // The first session lost its start, the other ones are kept whole.
+    CHECK(flash_log_tail() > mp_recordings->first_block[0]);
+    CHECK(flash_log_tail() < mp_recordings->last_block[0]);
+    CHECK(mp_recordings->pages_erased <= FLASH_LOG_PAGE_COUNT + 1);
+    history_check();
+}
+
+
+/**@brief The next boot rebuilds the same sessions from the flash log. */
+static void history_reboot_run(void)
+{
+    boot_init();
+    history_check();
+}
+
+
+/**@brief Function for tearing a stored block: changes a data byte, so it fails its CRC. */
+static void block_tear(uint32_t block)
+{
+    uint32_t page = (block / FLASH_LOG_SLOTS_PER_PAGE) % FLASH_LOG_PAGE_COUNT;
+    uint32_t slot = block % FLASH_LOG_SLOTS_PER_PAGE;
+
+    *fake_fstorage_mem(FLASH_LOG_START_ADDR + page * FLASH_LOG_PAGE_SIZE + FLASH_LOG_PAGE_HEADER_SIZE
+                       + slot * FLASH_LOG_RECORD_SIZE + 8) ^= 0x5A;
+}
+
+
+int main(void)
+{
+    scenario("long session:", long_session_run);
+    scenario("session longer than the index:", overwritten_session_run);
+
+    printf("rebuild after three boots:\n");
+    fake_fstorage_reset();
+    scenario(NULL, boot1_run);
+    scenario(NULL, boot2_run);
+    block_tear(1000);
+    scenario(NULL, boot3_run);
+
+    fake_fstorage_reset();
+    mp_recordings = mmap(NULL, sizeof(*mp_recordings), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    scenario("decimated sessions at 50 Hz:", history_run);
+    scenario("after a reboot:", history_reboot_run);
+
+    return test_result("session_index_test");
+}
@@ -0,0 +1,253 @@
+/* Checks session_stats.c against a batch computation over every stride of long synthetic sessions:
+ * a marathon with intervals, pauses and a sprint finish, an easy run, a session too short to be
+ * kept, and a stride that comes after the idle time without a tick in between. Sums, averages,
+ * maxima and zones have to match exactly, the percentiles within a histogram bin. */
+#include <stdlib.h>
+#include <string.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "session_stats.h"
+
+#define MAX_STRIDES     40000
+
+/**@brief Strides of a session as they were added, for the batch computation. */
+typedef struct
+{
+    uint32_t               count;
+    stride_events_record_t strides[MAX_STRIDES];
+} session_ref_t;
+
+static session_ref_t  m_ref;
+static uint32_t       m_now_ms = 1000;
+static uint16_t       m_seq;
+static uint16_t const m_zone_bounds[SESSION_STATS_ZONE_COUNT - 1] = SESSION_STATS_ZONE_BOUNDS;
+
+
+static int power_compare(void const * p_a, void const * p_b)
+{
+    return (int)((stride_events_record_t const *)p_a)->power - (int)((stride_events_record_t const *)p_b)->power;
+}
+
+
+/**@brief Function for adding one stride to the module and to the reference, and ticking every
+ *        second of it as main.c does. */
+static void stride_add(uint16_t duration_ms, uint16_t power)
+{
+    stride_events_record_t stride =
+    {
+        .seq             = m_seq++,
+        .duration_ms     = duration_ms,
+        .gct_ms          = (uint16_t)(duration_ms * 2 / 5),
+        .vertical_osc_mm = (uint16_t)(60 + power % 40),
+        .peak_mg         = (uint16_t)(power * 3),
+        .power           = power,
+    };
+
+    for (uint32_t t = m_now_ms / 1000 * 1000 + 1000; t <= m_now_ms + duration_ms; t += 1000)
+    {
+        CHECK_EQ(session_stats_tick(t), SESSION_STATS_NONE);
+    }
+    m_now_ms       += duration_ms;
+    stride.local_ms = m_now_ms;
+    session_stats_stride_add(&stride);
+
+    CHECK(m_ref.count < MAX_STRIDES);
+    m_ref.strides[m_ref.count++] = stride;
+}
+
+
+/**@brief Function for idling without strides; no tick ends the session before SESSION_STATS_IDLE_MS. */
+static void idle(uint32_t pause_ms, bool ticks)
+{
+    uint32_t last_ms = m_now_ms;
+
+    for (uint32_t t = m_now_ms / 1000 * 1000 + 1000; ticks && (t <= m_now_ms + pause_ms); t += 1000)
+    {
+        session_stats_tick_t tick = session_stats_tick(t);
+
+        CHECK_EQ(tick, ((t - last_ms >= SESSION_STATS_IDLE_MS) && (t - 1000 - last_ms < SESSION_STATS_IDLE_MS))
+                       ? SESSION_STATS_ENDED : SESSION_STATS_NONE);
+    }
+    m_now_ms += pause_ms;
+}
+
+
+/**@brief Function for getting the power at a percentile of the moving time, over every stride. */
+static uint16_t ref_percentile(uint8_t percent, uint32_t moving_ms)
+{
+    static stride_events_record_t sorted[MAX_STRIDES];
+    uint64_t                      target = (uint64_t)moving_ms * percent / 100;
+    uint64_t                      below  = 0;
+
+    memcpy(sorted, m_ref.strides, m_ref.count * sizeof(sorted[0]));
+    qsort(sorted, m_ref.count, sizeof(sorted[0]), power_compare);
+    for (uint32_t i = 0; i < m_ref.count; i++)
+    {
+        below += sorted[i].duration_ms;
+        if (below >= target)
+        {
+            return sorted[i].power;
+        }
+    }
+    return sorted[m_ref.count - 1].power;
+}
+
+
+/**@brief Function for comparing a summary with the batch computation over the reference strides. */
+static void summary_check(session_stats_summary_t const * p_summary)
+{
+    uint32_t moving_ms = 0;
+    uint64_t power_sum = 0;
+    uint32_t gct_sum   = 0;
+    uint32_t osc_sum   = 0;
+    uint16_t power_max = 0;
+    uint32_t zone_ms[SESSION_STATS_ZONE_COUNT] = {0};
+    uint16_t p50;
+    uint16_t p90;
+
+    for (uint32_t i = 0; i < m_ref.count; i++)
+    {
+        stride_events_record_t const * p_stride = &m_ref.strides[i];
+        uint8_t                        zone     = 0;
+
+        while ((zone < SESSION_STATS_ZONE_COUNT - 1) && (p_stride->power >= m_zone_bounds[zone]))
+        {
+            zone++;
+        }
+        moving_ms     += p_stride->duration_ms;
+        power_sum     += (uint64_t)p_stride->power * p_stride->duration_ms;
+        gct_sum       += p_stride->gct_ms;
+        osc_sum       += p_stride->vertical_osc_mm;
+        power_max      = MAX(power_max, p_stride->power);
+        zone_ms[zone] += p_stride->duration_ms;
+    }
+    p50 = ref_percentile(50, moving_ms);
+    p90 = ref_percentile(90, moving_ms);
+
+    CHECK_EQ(p_summary->start, m_ref.strides[0].local_ms - m_ref.strides[0].duration_ms);
+    CHECK_EQ(p_summary->elapsed_ms, m_ref.strides[m_ref.count - 1].local_ms - p_summary->start);
+    CHECK_EQ(p_summary->moving_ms, moving_ms);
+    CHECK_EQ(p_summary->steps, m_ref.count);
+    CHECK_EQ(p_summary->cadence, (uint64_t)m_ref.count * 60000 / moving_ms);
+    CHECK_EQ(p_summary->power_avg, power_sum / moving_ms);
+    CHECK_EQ(p_summary->power_max, power_max);
+    CHECK_EQ(p_summary->gct_ms, gct_sum / m_ref.count);
+    CHECK_EQ(p_summary->vertical_osc_mm, osc_sum / m_ref.count);
+    CHECK(memcmp(p_summary->zone_ms, zone_ms, sizeof(zone_ms)) == 0);
+    CHECK(abs((int)p_summary->power_p50 - (int)p50) < SESSION_STATS_POWER_BIN_WIDTH);
+    CHECK(abs((int)p_summary->power_p90 - (int)p90) < SESSION_STATS_POWER_BIN_WIDTH);
+
+    printf("  %5u steps, %6.1f min moving of %6.1f, cadence %u, power avg %u max %u, "
+           "p50 %u (%u), p90 %u (%u)\n",
+           (unsigned)p_summary->steps, p_summary->moving_ms / 60000.0, p_summary->elapsed_ms / 60000.0,
+           p_summary->cadence, p_summary->power_avg, p_summary->power_max,
+           p_summary->power_p50, p50, p_summary->power_p90, p90);
+}
+
+
+/**@brief A marathon of about three hours: warm-up, intervals, traffic lights, a climb where power
+ *        and cadence drop, and a sprint into the last histogram bin. */
+static void marathon_run(void)
+{
+    session_stats_summary_t summary;
+
+    m_ref.count = 0;
+    for (uint32_t km = 0; km < 42; km++)
+    {
+        for (uint32_t i = 0; i < 700; i++)
+        {
+            uint16_t duration = (uint16_t)(340 + rand() % 40 + ((km >= 30) && (km < 33) ? 60 : 0));
+            uint16_t power    = (uint16_t)(1100 + (km % 5) * 90 + rand() % 120 - ((km >= 30) && (km < 33) ? 150 : 0));
+
+            stride_add(duration, power);
+        }
+        if (km % 7 == 3)
+        {
+            // Traffic light: a gap too long to be a stride, not the end of the session.
+            idle(20000 + rand() % 20000, true);
+        }
+    }
+    for (uint32_t i = 0; i < 300; i++)
+    {
+        stride_add((uint16_t)(300 + rand() % 20), (uint16_t)(3900 + rand() % 600));
+    }
+
+    CHECK(session_stats_active());
+    CHECK(session_stats_get(&summary));
+    CHECK(summary.flags & SESSION_STATS_FLAG_ACTIVE);
+    CHECK(!(summary.flags & SESSION_STATS_FLAG_SYNCED));
+    summary_check(&summary);
+
+    idle(SESSION_STATS_IDLE_MS + 5000, true);
+    CHECK(!session_stats_active());
+    CHECK(session_stats_get(&summary));
+    CHECK(!(summary.flags & SESSION_STATS_FLAG_ACTIVE));
+    CHECK_EQ(summary.id, 0);
+    summary_check(&summary);
+}
+
+
+/**@brief A session moving for less than SESSION_STATS_MIN_MOVING_MS is dropped and the marathon
+ *        stays the last summary. Then an easy run whose end the ticks miss: the next stride ends
+ *        it and starts a session of its own. */
+static void short_and_missed_end_run(void)
+{
+    session_stats_summary_t summary;
+    session_stats_summary_t marathon;
+
+    CHECK(session_stats_get(&marathon));
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        stride_add(400, 1000);
+    }
+    idle(SESSION_STATS_IDLE_MS - 1000, true);
+    CHECK_EQ(session_stats_tick(m_now_ms + 1000), SESSION_STATS_DROPPED);
+    CHECK(session_stats_get(&summary));
+    CHECK(memcmp(&summary, &marathon, sizeof(summary)) == 0);
+
+    m_ref.count = 0;
+    m_now_ms   += 3600000;
+    for (uint32_t i = 0; i < 6000; i++)
+    {
+        stride_add((uint16_t)(380 + rand() % 60), (uint16_t)(950 + rand() % 200));
+    }
+    CHECK(session_stats_get(&summary));
+    CHECK_EQ(summary.id, 1);
+    summary_check(&summary);
+
+    // No ticks during the idle time, e.g. a busy main loop; the stride after it ends the session.
+    idle(2 * SESSION_STATS_IDLE_MS, false);
+    m_now_ms += 400;
+    session_stats_stride_add(&(stride_events_record_t){.seq = m_seq++, .local_ms = m_now_ms,
+                                                       .duration_ms = 400, .power = 1000});
+    CHECK(session_stats_active());
+    CHECK(session_stats_get(&summary));
+    CHECK_EQ(summary.id, 2);
+    CHECK_EQ(summary.steps, 1);
+}
+
+
+/**@brief A summary restored from flash numbers the sessions on, but does not replace the one kept
+ *        since the reset. */
+static void restore_run(void)
+{
+    session_stats_summary_t summary;
+    session_stats_summary_t stored = {0};
+
+    stored.id = 41;
+    session_stats_restore(&stored);
+    CHECK(session_stats_get(&summary));
+    CHECK_EQ(summary.id, 42);
+}
+
+
+int main(void)
+{
+    srand(7);
+    printf("batch against incremental:\n");
+    marathon_run();
+    short_and_missed_end_run();
+    restore_run();
+
+    return test_result("session_stats_test");
+}
@@ -0,0 +1,21 @@
+/* Host stand-in for the nRF5 SDK header of the same name: an error stops the test program. */
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sdk_errors.h"
+
+#define APP_ERROR_CHECK(ERR_CODE)                                                       \
+    do                                                                                  \
+    {                                                                                   \
+        uint32_t _err = (ERR_CODE);                                                     \
+        if (_err != NRF_SUCCESS)                                                        \
+        {                                                                               \
+            printf("%s:%d: APP_ERROR_CHECK failed: 0x%x\n", __FILE__, __LINE__,        \
+                   (unsigned)_err);                                                     \
+            abort();                                                                    \
+        }                                                                               \
+    } while (0)
+
+#endif // APP_ERROR_H__
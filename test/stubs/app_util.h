@@ -0,0 +1,51 @@
+/* Host stand-in for the nRF5 SDK header of the same name. */
+#ifndef APP_UTIL_H__
+#define APP_UTIL_H__
+
+#include <stdint.h>
+
+#define STATIC_ASSERT(x)                    _Static_assert(x, #x)
+#define ARRAY_SIZE(a)                       (sizeof(a) / sizeof((a)[0]))
+#define MIN(a, b)                           ((a) < (b) ? (a) : (b))
+#define MAX(a, b)                           ((a) < (b) ? (b) : (a))
+#define CEIL_DIV(A, B)                      (((A) + (B) - 1) / (B))
+#define MSEC_TO_UNITS(TIME, RESOLUTION)     (((TIME) * 1000) / (RESOLUTION))
+#define __ALIGN(n)                          __attribute__((aligned(n)))
+
+enum
+{
+    UNIT_0_625_MS = 625,
+    UNIT_1_25_MS  = 1250,
+    UNIT_10_MS    = 10000
+};
+
+static inline uint8_t uint16_encode(uint16_t value, uint8_t * p_encoded_data)
+{
+    p_encoded_data[0] = (uint8_t)value;
+    p_encoded_data[1] = (uint8_t)(value >> 8);
+    return sizeof(uint16_t);
+}
+
+static inline uint8_t uint32_encode(uint32_t value, uint8_t * p_encoded_data)
+{
+    p_encoded_data[0] = (uint8_t)value;
+    p_encoded_data[1] = (uint8_t)(value >> 8);
+    p_encoded_data[2] = (uint8_t)(value >> 16);
+    p_encoded_data[3] = (uint8_t)(value >> 24);
+    return sizeof(uint32_t);
+}
+
+static inline uint16_t uint16_decode(uint8_t const * p_encoded_data)
+{
+    return (uint16_t)(p_encoded_data[0] | (p_encoded_data[1] << 8));
+}
+
+static inline uint32_t uint32_decode(uint8_t const * p_encoded_data)
+{
+    return (uint32_t)p_encoded_data[0]
+           | ((uint32_t)p_encoded_data[1] << 8)
+           | ((uint32_t)p_encoded_data[2] << 16)
+           | ((uint32_t)p_encoded_data[3] << 24);
+}
+
+#endif // APP_UTIL_H__
@@ -0,0 +1,15 @@
+/* Host stand-in for the nRF5 SDK header of the same name. The tests are single threaded, so
+ * critical regions are plain blocks. */
+#ifndef APP_UTIL_PLATFORM_H__
+#define APP_UTIL_PLATFORM_H__
+
+#include <stdint.h>
+#include "nrf.h"
+
+#define CRITICAL_REGION_ENTER()     do {
+#define CRITICAL_REGION_EXIT()      } while (0)
+
+#define APP_IRQ_PRIORITY_LOW        6
+#define APP_IRQ_PRIORITY_LOWEST     7
+
+#endif // APP_UTIL_PLATFORM_H__
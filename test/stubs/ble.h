@@ -0,0 +1,473 @@
+/* Host stand-in for the SoftDevice headers (ble.h, ble_gap.h, ble_gatts.h, ble_l2cap.h): the
+ * types, constants and calls the modules under test use. The sd_* calls are implemented by the
+ * tests, mostly through fake_sd.c. */
+#ifndef BLE_H__
+#define BLE_H__
+
+#include <stdint.h>
+#include "nrf_error.h"
+
+#define BLE_CONN_HANDLE_INVALID                         0xFFFF
+#define BLE_ERROR_INVALID_CONN_HANDLE                   0x3002
+#define BLE_GATT_HANDLE_INVALID                         0x0000
+#define BLE_GATT_HANDLE_START                           0x0001
+#define BLE_GATT_ATT_MTU_DEFAULT                        23
+
+#define BLE_GATT_HVX_NOTIFICATION                       0x01
+#define BLE_GATT_HVX_INDICATION                         0x02
+
+#define BLE_GATTS_VLOC_STACK                            1
+#define BLE_GATTS_VLOC_USER                             2
+#define BLE_GATTS_SRVC_TYPE_PRIMARY                     1
+#define BLE_GATTS_VAR_ATTR_LEN_MAX                      512
+#define BLE_GATTS_AUTHORIZE_TYPE_READ                   1
+#define BLE_GATTS_AUTHORIZE_TYPE_WRITE                  2
+#define BLE_GATTS_OP_WRITE_REQ                          1
+#define BLE_GATTS_OP_WRITE_CMD                          2
+#define BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT             1
+
+#define BLE_UUID_TYPE_BLE                               1
+#define BLE_UUID_TYPE_VENDOR_BEGIN                      2
+
+#define BLE_GATT_STATUS_SUCCESS                         0x0000
+#define BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED      0x0103
+#define BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH   0x010D
+#define BLE_GATT_STATUS_ATTERR_APP_BEGIN                0x0180
+#define BLE_GATT_STATUS_ATTERR_OUT_OF_RANGE             0x01FF
+
+#define BLE_GAP_PHY_AUTO                                0
+#define BLE_GAP_PHY_1MBPS                               1
+#define BLE_GAP_PHY_2MBPS                               2
+#define BLE_GAP_ADV_SET_DATA_SIZE_MAX                   31
+#define BLE_GAP_ADV_SET_HANDLE_NOT_SET                  0xFF
+#define BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION       0x13
+
+#define BLE_L2CAP_CID_INVALID                           0x0000
+#define BLE_L2CAP_MTU_MIN                               23
+#define BLE_L2CAP_MPS_MIN                               23
+#define BLE_L2CAP_CH_STATUS_CODE_SUCCESS                0x0000
+#define BLE_L2CAP_CH_STATUS_CODE_LE_PSM_NOT_SUPPORTED   0x0002
+#define BLE_L2CAP_CH_STATUS_CODE_NO_RESOURCES           0x0004
+
+enum
+{
+    BLE_GAP_EVT_CONNECTED = 0x10,
+    BLE_GAP_EVT_DISCONNECTED,
+    BLE_GAP_EVT_CONN_PARAM_UPDATE,
+    BLE_GAP_EVT_PHY_UPDATE_REQUEST,
+    BLE_GAP_EVT_PHY_UPDATE,
+    BLE_GAP_EVT_DATA_LENGTH_UPDATE_REQUEST,
+    BLE_GAP_EVT_ADV_SET_TERMINATED,
+
+    BLE_GATTC_EVT_TIMEOUT = 0x30,
+
+    BLE_GATTS_EVT_WRITE = 0x50,
+    BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST = 0x52,
+    BLE_GATTS_EVT_HVC,
+    BLE_GATTS_EVT_SYS_ATTR_MISSING,
+    BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST,
+    BLE_GATTS_EVT_TIMEOUT,
+    BLE_GATTS_EVT_HVN_TX_COMPLETE,
+
+    BLE_L2CAP_EVT_CH_SETUP_REQUEST = 0x70,
+    BLE_L2CAP_EVT_CH_SETUP_REFUSED,
+    BLE_L2CAP_EVT_CH_SETUP,
+    BLE_L2CAP_EVT_CH_RELEASED,
+    BLE_L2CAP_EVT_CH_SDU_BUF_RELEASED,
+    BLE_L2CAP_EVT_CH_CREDIT,
+    BLE_L2CAP_EVT_CH_RX,
+    BLE_L2CAP_EVT_CH_TX,
+};
+
+typedef struct
+{
+    uint16_t uuid;
+    uint8_t  type;
+} ble_uuid_t;
+
+typedef struct
+{
+    uint8_t uuid128[16];
+} ble_uuid128_t;
+
+typedef struct
+{
+    uint8_t * p_data;
+    uint16_t  len;
+} ble_data_t;
+
+// GAP
+
+typedef struct
+{
+    uint8_t sm : 4;
+    uint8_t lv : 4;
+} ble_gap_conn_sec_mode_t;
+
+#define BLE_GAP_CONN_SEC_MODE_SET_OPEN(ptr)     do { (ptr)->sm = 1; (ptr)->lv = 1; } while (0)
+
+typedef struct
+{
+    uint16_t min_conn_interval;
+    uint16_t max_conn_interval;
+    uint16_t slave_latency;
+    uint16_t conn_sup_timeout;
+} ble_gap_conn_params_t;
+
+typedef struct
+{
+    uint8_t tx_phys;
+    uint8_t rx_phys;
+} ble_gap_phys_t;
+
+typedef struct
+{
+    ble_gap_conn_params_t conn_params;
+    uint8_t               role;
+} ble_gap_evt_connected_t;
+
+typedef struct
+{
+    uint8_t reason;
+} ble_gap_evt_disconnected_t;
+
+typedef struct
+{
+    ble_gap_conn_params_t conn_params;
+} ble_gap_evt_conn_param_update_t;
+
+typedef struct
+{
+    ble_gap_phys_t peer_preferred_phys;
+} ble_gap_evt_phy_update_request_t;
+
+typedef struct
+{
+    uint8_t status;
+    uint8_t tx_phy;
+    uint8_t rx_phy;
+} ble_gap_evt_phy_update_t;
+
+typedef struct
+{
+    uint16_t conn_handle;
+    union
+    {
+        ble_gap_evt_connected_t          connected;
+        ble_gap_evt_disconnected_t       disconnected;
+        ble_gap_evt_conn_param_update_t  conn_param_update;
+        ble_gap_evt_phy_update_request_t phy_update_request;
+        ble_gap_evt_phy_update_t         phy_update;
+    } params;
+} ble_gap_evt_t;
+
+// GATT server
+
+typedef struct
+{
+    uint16_t value_handle;
+    uint16_t user_desc_handle;
+    uint16_t cccd_handle;
+    uint16_t sccd_handle;
+} ble_gatts_char_handles_t;
+
+typedef struct
+{
+    ble_gap_conn_sec_mode_t read_perm;
+    ble_gap_conn_sec_mode_t write_perm;
+    uint8_t                 vlen    : 1;
+    uint8_t                 vloc    : 2;
+    uint8_t                 rd_auth : 1;
+    uint8_t                 wr_auth : 1;
+} ble_gatts_attr_md_t;
+
+typedef struct
+{
+    uint8_t broadcast      : 1;
+    uint8_t read           : 1;
+    uint8_t write_wo_resp  : 1;
+    uint8_t write          : 1;
+    uint8_t notify         : 1;
+    uint8_t indicate       : 1;
+    uint8_t auth_signed_wr : 1;
+} ble_gatt_char_props_t;
+
+typedef struct
+{
+    uint8_t reliable_wr : 1;
+    uint8_t wr_aux      : 1;
+} ble_gatt_char_ext_props_t;
+
+typedef struct
+{
+    ble_gatt_char_props_t       char_props;
+    ble_gatt_char_ext_props_t   char_ext_props;
+    uint8_t const             * p_char_user_desc;
+    uint16_t                    char_user_desc_max_size;
+    uint16_t                    char_user_desc_size;
+    void const                * p_char_pf;
+    ble_gatts_attr_md_t const * p_user_desc_md;
+    ble_gatts_attr_md_t const * p_cccd_md;
+    ble_gatts_attr_md_t const * p_sccd_md;
+} ble_gatts_char_md_t;
+
+typedef struct
+{
+    ble_uuid_t const          * p_uuid;
+    ble_gatts_attr_md_t const * p_attr_md;
+    uint16_t                    init_len;
+    uint16_t                    init_offs;
+    uint16_t                    max_len;
+    uint8_t                   * p_value;
+} ble_gatts_attr_t;
+
+typedef struct
+{
+    uint16_t  len;
+    uint16_t  offset;
+    uint8_t * p_value;
+} ble_gatts_value_t;
+
+typedef struct
+{
+    uint16_t        handle;
+    uint8_t         type;
+    uint16_t        offset;
+    uint16_t      * p_len;
+    uint8_t const * p_data;
+} ble_gatts_hvx_params_t;
+
+typedef struct
+{
+    uint16_t   handle;
+    ble_uuid_t uuid;
+    uint8_t    op;
+    uint8_t    auth_required;
+    uint16_t   offset;
+    uint16_t   len;
+    uint8_t    data[1];                                                     /**< Variable length, as in the SoftDevice. */
+} ble_gatts_evt_write_t;
+
+typedef struct
+{
+    uint8_t type;
+    union
+    {
+        ble_gatts_evt_write_t write;
+    } request;
+} ble_gatts_evt_rw_authorize_request_t;
+
+typedef struct
+{
+    uint16_t handle;
+} ble_gatts_evt_hvc_t;
+
+typedef struct
+{
+    uint8_t hint;
+} ble_gatts_evt_sys_attr_missing_t;
+
+typedef struct
+{
+    uint16_t client_rx_mtu;
+} ble_gatts_evt_exchange_mtu_request_t;
+
+typedef struct
+{
+    uint8_t count;
+} ble_gatts_evt_hvn_tx_complete_t;
+
+typedef struct
+{
+    uint16_t conn_handle;
+    union
+    {
+        ble_gatts_evt_write_t                write;
+        ble_gatts_evt_rw_authorize_request_t authorize_request;
+        ble_gatts_evt_hvc_t                  hvc;
+        ble_gatts_evt_sys_attr_missing_t     sys_attr_missing;
+        ble_gatts_evt_exchange_mtu_request_t exchange_mtu_request;
+        ble_gatts_evt_hvn_tx_complete_t      hvn_tx_complete;
+    } params;
+} ble_gatts_evt_t;
+
+typedef struct
+{
+    uint16_t conn_handle;
+} ble_gattc_evt_t;
+
+// L2CAP
+
+typedef struct
+{
+    uint16_t   rx_mtu;
+    uint16_t   rx_mps;
+    ble_data_t sdu_buf;
+} ble_l2cap_ch_rx_params_t;
+
+typedef struct
+{
+    uint16_t tx_mtu;
+    uint16_t peer_mps;
+    uint16_t tx_mps;
+    uint16_t credits;
+} ble_l2cap_ch_tx_params_t;
+
+typedef struct
+{
+    ble_l2cap_ch_rx_params_t rx_params;
+    uint16_t                 le_psm;
+    uint16_t                 status;
+} ble_l2cap_ch_setup_params_t;
+
+typedef struct
+{
+    ble_l2cap_ch_tx_params_t tx_params;
+    uint16_t                 le_psm;
+} ble_l2cap_evt_ch_setup_request_t;
+
+typedef struct
+{
+    ble_l2cap_ch_tx_params_t tx_params;
+} ble_l2cap_evt_ch_setup_t;
+
+typedef struct
+{
+    uint16_t credits;
+} ble_l2cap_evt_ch_credit_t;
+
+typedef struct
+{
+    uint16_t   sdu_len;
+    ble_data_t sdu_buf;
+} ble_l2cap_evt_ch_rx_t;
+
+typedef struct
+{
+    ble_data_t sdu_buf;
+} ble_l2cap_evt_ch_tx_t;
+
+typedef struct
+{
+    uint16_t conn_handle;
+    uint16_t local_cid;
+    union
+    {
+        ble_l2cap_evt_ch_setup_request_t ch_setup_request;
+        ble_l2cap_evt_ch_setup_t         ch_setup;
+        ble_l2cap_evt_ch_credit_t        credit;
+        ble_l2cap_evt_ch_rx_t            rx;
+        ble_l2cap_evt_ch_tx_t            tx;
+    } params;
+} ble_l2cap_evt_t;
+
+// Configuration and options
+
+enum
+{
+    BLE_CONN_CFG_GAP = 0x20,
+    BLE_CONN_CFG_GATTC,
+    BLE_CONN_CFG_GATTS,
+    BLE_CONN_CFG_GATT,
+    BLE_CONN_CFG_L2CAP,
+};
+
+#define BLE_COMMON_OPT_CONN_EVT_EXT                     0x02
+
+typedef struct
+{
+    uint8_t  conn_count;
+    uint16_t event_length;
+} ble_gap_conn_cfg_t;
+
+typedef struct
+{
+    uint8_t hvn_tx_queue_size;
+} ble_gatts_conn_cfg_t;
+
+typedef struct
+{
+    uint16_t att_mtu;
+} ble_gatt_conn_cfg_t;
+
+typedef struct
+{
+    uint16_t rx_mps;
+    uint16_t tx_mps;
+    uint8_t  rx_queue_size;
+    uint8_t  tx_queue_size;
+    uint8_t  ch_count;
+} ble_l2cap_conn_cfg_t;
+
+typedef struct
+{
+    uint8_t conn_cfg_tag;
+    union
+    {
+        ble_gap_conn_cfg_t   gap_conn_cfg;
+        ble_gatts_conn_cfg_t gatts_conn_cfg;
+        ble_gatt_conn_cfg_t  gatt_conn_cfg;
+        ble_l2cap_conn_cfg_t l2cap_conn_cfg;
+    } params;
+} ble_conn_cfg_t;
+
+typedef union
+{
+    ble_conn_cfg_t conn_cfg;
+} ble_cfg_t;
+
+typedef struct
+{
+    uint8_t enable : 1;
+} ble_common_opt_conn_evt_ext_t;
+
+typedef struct
+{
+    ble_common_opt_conn_evt_ext_t conn_evt_ext;
+} ble_common_opt_t;
+
+typedef union
+{
+    ble_common_opt_t common_opt;
+} ble_opt_t;
+
+// Events
+
+typedef struct
+{
+    uint16_t evt_id;
+    uint16_t evt_len;
+} ble_evt_hdr_t;
+
+typedef struct
+{
+    ble_evt_hdr_t header;
+    union
+    {
+        ble_gap_evt_t   gap_evt;
+        ble_gatts_evt_t gatts_evt;
+        ble_gattc_evt_t gattc_evt;
+        ble_l2cap_evt_t l2cap_evt;
+    } evt;
+} ble_evt_t;
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type);
+uint32_t sd_ble_uuid_encode(ble_uuid_t const * p_uuid, uint8_t * p_uuid_le_len, uint8_t * p_uuid_le);
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid, uint16_t * p_handle);
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle, ble_gatts_char_md_t const * p_char_md,
+                                         ble_gatts_attr_t const * p_attr_char_value,
+                                         ble_gatts_char_handles_t * p_handles);
+uint32_t sd_ble_gatts_attr_get(uint16_t handle, ble_uuid_t * p_uuid, ble_gatts_attr_md_t * p_md);
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t * p_value);
+uint32_t sd_ble_gatts_value_get(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t * p_value);
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params);
+uint32_t sd_ble_cfg_set(uint32_t cfg_id, ble_cfg_t const * p_cfg, uint32_t app_ram_base);
+uint32_t sd_ble_opt_set(uint32_t opt_id, ble_opt_t const * p_opt);
+uint32_t sd_ble_gap_phy_update(uint16_t conn_handle, ble_gap_phys_t const * p_gap_phys);
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code);
+uint32_t sd_ble_l2cap_ch_setup(uint16_t conn_handle, uint16_t * p_local_cid,
+                               ble_l2cap_ch_setup_params_t const * p_params);
+uint32_t sd_ble_l2cap_ch_rx(uint16_t conn_handle, uint16_t local_cid, ble_data_t const * p_sdu_buf);
+uint32_t sd_ble_l2cap_ch_tx(uint16_t conn_handle, uint16_t local_cid, ble_data_t const * p_sdu_buf);
+
+#endif // BLE_H__
@@ -0,0 +1,11 @@
+/* Host stand-in for the nRF5 SDK header of the same name; tests define the function they call. */
+#ifndef BLE_CONN_PARAMS_H__
+#define BLE_CONN_PARAMS_H__
+
+#include <stdint.h>
+#include "ble.h"
+#include "sdk_errors.h"
+
+ret_code_t ble_conn_params_change_conn_params(uint16_t conn_handle, ble_gap_conn_params_t * p_new_params);
+
+#endif // BLE_CONN_PARAMS_H__
@@ -0,0 +1,28 @@
+/* Host stand-in for the nRF5 SDK header of the same name. */
+#ifndef BLE_SRV_COMMON_H__
+#define BLE_SRV_COMMON_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+
+#define BLE_CCCD_VALUE_LEN  2
+
+typedef struct
+{
+    ble_gap_conn_sec_mode_t cccd_write_perm;
+    ble_gap_conn_sec_mode_t read_perm;
+    ble_gap_conn_sec_mode_t write_perm;
+} ble_srv_cccd_security_mode_t;
+
+static inline bool ble_srv_is_notification_enabled(uint8_t const * p_encoded_data)
+{
+    return (p_encoded_data[0] & BLE_GATT_HVX_NOTIFICATION) != 0;
+}
+
+static inline bool ble_srv_is_indication_enabled(uint8_t const * p_encoded_data)
+{
+    return (p_encoded_data[0] & BLE_GATT_HVX_INDICATION) != 0;
+}
+
+#endif // BLE_SRV_COMMON_H__
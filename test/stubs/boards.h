@@ -0,0 +1,5 @@
+/* Host stand-in for the nRF5 SDK header of the same name; nothing of it is used on the host. */
+#ifndef BOARDS_H
+#define BOARDS_H
+
+#endif // BOARDS_H
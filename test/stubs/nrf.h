@@ -0,0 +1,14 @@
+/* Host stand-in for the MDK header of the same name. */
+#ifndef NRF_H__
+#define NRF_H__
+
+#include <stdint.h>
+
+#define __INLINE            inline
+#define __STATIC_INLINE     static inline
+#define __PACKED            __attribute__((packed))
+
+static inline void __DSB(void) {}
+static inline void NVIC_SystemReset(void) {}
+
+#endif // NRF_H__
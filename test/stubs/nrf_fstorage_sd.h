@@ -0,0 +1,9 @@
+/* Host stand-in for the nRF5 SDK header of the same name. */
+#ifndef NRF_FSTORAGE_SD_H__
+#define NRF_FSTORAGE_SD_H__
+
+#include "nrf_fstorage.h"
+
+extern nrf_fstorage_api_t nrf_fstorage_sd;
+
+#endif // NRF_FSTORAGE_SD_H__
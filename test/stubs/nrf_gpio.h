@@ -0,0 +1,5 @@
+/* Host stand-in for the nRF5 SDK header of the same name; nothing of it is used on the host. */
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+
+#endif // NRF_GPIO_H__
@@ -0,0 +1,19 @@
+/* Host stand-in for the nRF5 SDK logger: messages are printed when built with -DTEST_LOG=1. */
+#ifndef NRF_LOG_H__
+#define NRF_LOG_H__
+
+#include <stdio.h>
+
+#ifndef TEST_LOG
+#define TEST_LOG 0
+#endif
+
+#define NRF_LOG_PRINT(...)  do { if (TEST_LOG) { printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+#define NRF_LOG_ERROR(...)      NRF_LOG_PRINT(__VA_ARGS__)
+#define NRF_LOG_WARNING(...)    NRF_LOG_PRINT(__VA_ARGS__)
+#define NRF_LOG_INFO(...)       NRF_LOG_PRINT(__VA_ARGS__)
+#define NRF_LOG_DEBUG(...)      NRF_LOG_PRINT(__VA_ARGS__)
+#define NRF_LOG_RAW_INFO(...)   NRF_LOG_PRINT(__VA_ARGS__)
+
+#endif // NRF_LOG_H__
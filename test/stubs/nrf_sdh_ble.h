@@ -0,0 +1,25 @@
+/* Host stand-in for the nRF5 SDK header of the same name. Observers are kept in a section, as on
+ * the device, and fake_sd.c passes every event to all of them. Priorities are not kept. */
+#ifndef NRF_SDH_BLE_H__
+#define NRF_SDH_BLE_H__
+
+#include "ble.h"
+#include "sdk_config.h"
+
+typedef void (*nrf_sdh_ble_evt_handler_t)(ble_evt_t const * p_ble_evt, void * p_context);
+
+typedef struct
+{
+    nrf_sdh_ble_evt_handler_t handler;
+    void                    * p_context;
+} nrf_sdh_ble_evt_observer_t;
+
+#define NRF_SDH_BLE_OBSERVER(_name, _prio, _handler, _context)                          \
+    static nrf_sdh_ble_evt_observer_t const _name                                       \
+        __attribute__((section("sdh_ble_observers"), used, aligned(sizeof(void *)))) =  \
+    {                                                                                   \
+        .handler   = _handler,                                                          \
+        .p_context = _context                                                           \
+    }
+
+#endif // NRF_SDH_BLE_H__
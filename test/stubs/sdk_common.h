@@ -0,0 +1,21 @@
+/* Host stand-in for the nRF5 SDK header of the same name. */
+#ifndef SDK_COMMON_H__
+#define SDK_COMMON_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include "nrf_error.h"
+#include "sdk_errors.h"
+#include "app_util.h"
+#include "sdk_config.h"
+
+#define UNUSED_PARAMETER(X)     ((void)(X))
+#define UNUSED_VARIABLE(X)      ((void)(X))
+#define UNUSED_RETURN_VALUE(X)  ((void)(X))
+
+#define VERIFY_PARAM_NOT_NULL(p)    do { if ((p) == NULL) { return NRF_ERROR_NULL; } } while (0)
+#define VERIFY_SUCCESS(e)           do { uint32_t _e = (e); if (_e != NRF_SUCCESS) { return _e; } } while (0)
+
+#endif // SDK_COMMON_H__
@@ -0,0 +1,10 @@
+/* Host stand-in for pca10040/s132/config/sdk_config.h: only the settings the modules under test
+ * read, with the values of the firmware configuration. */
+#ifndef SDK_CONFIG_H
+#define SDK_CONFIG_H
+
+#define NRF_SDH_BLE_GATT_MAX_MTU_SIZE       247
+#define NRF_SDH_BLE_PERIPHERAL_LINK_COUNT   2
+#define NRF_SDH_BLE_GAP_DATA_LENGTH         251
+
+#endif // SDK_CONFIG_H
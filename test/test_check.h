@@ -0,0 +1,79 @@
+/* Checks shared by the host tests. Each test is one program that exits non-zero if a check failed. */
+#ifndef TEST_CHECK_H__
+#define TEST_CHECK_H__
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static int m_test_failures;
+
+#define CHECK(cond)                                                                     \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(cond))                                                                    \
+        {                                                                               \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);             \
+            m_test_failures++;                                                          \
+        }                                                                               \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                      \
+    do                                                                                  \
+    {                                                                                   \
+        long long _a = (long long)(actual);                                             \
+        long long _e = (long long)(expected);                                           \
+        if (_a != _e)                                                                   \
+        {                                                                               \
+            printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual,  \
+                   _a, _e);                                                             \
+            m_test_failures++;                                                          \
+        }                                                                               \
+    } while (0)
+
+/**@brief Function for getting a monotonic time stamp, for host timings. */
+static inline double test_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**@brief Function for printing the verdict; returns the exit code of the test. */
+static inline int test_result(char const * p_name)
+{
+    printf("%s: %s (%d failed checks)\n", p_name, (m_test_failures == 0) ? "passed" : "FAILED",
+           m_test_failures);
+    return (m_test_failures == 0) ? 0 : 1;
+}
+
+/**@brief Function for running a scenario in a child process and collecting its failed checks, so
+ *        every scenario starts with the modules in their reset state.
+ *
+ * @param[in] p_name    Heading printed before the scenario, NULL for none.
+ */
+static inline void scenario(char const * p_name, void (*p_run)(void))
+{
+    int   status;
+    pid_t pid;
+
+    if (p_name != NULL)
+    {
+        printf("%s\n", p_name);
+    }
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        p_run();
+        fflush(stdout);
+        _exit((m_test_failures < 255) ? m_test_failures : 255);
+    }
+    CHECK(pid > 0);
+    waitpid(pid, &status, 0);
+    m_test_failures += WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+#endif // TEST_CHECK_H__
@@ -0,0 +1,220 @@
+/* Simulates the exchanges of time_sync.c between a central and a device whose clocks drift apart,
+ * over a link that delays every message by up to a connection interval and sometimes much longer.
+ * Checks the drift estimate, the timestamps while exchanges go on and after they stop, a step of
+ * the central clock, and a local clock that wraps. */
+#include <stdlib.h>
+#include <math.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "time_sync.h"
+
+#define EXCHANGE_PERIOD_MS  5000                                            /**< Time between exchanges. */
+#define RUN_MS              (20 * 60 * 1000)
+#define HOLDOVER_MS         (10 * 60 * 1000)                                /**< Time checked after the last exchange. */
+#define CONGESTED_PERCENT   10                                              /**< Messages held up by retransmissions. */
+#define CONGESTED_MS        300
+#define CENTRAL_START_MS    1700000000000ULL                                /**< Central time at local time 0, Unix time. */
+#define PROCESSING_MS       2                                               /**< Device time between request and answer. */
+#define SYNCED_MS           (TIME_SYNC_DRIFT_MIN_SPAN_MS + 4 * TIME_SYNC_SLOT_MS)  /**< Time the drift is known by, with a slot or two of exchanges left out. */
+
+/**@brief Largest drift error: the offset of an exchange is off by up to an interval, over the time
+ *        the exchanges kept span. */
+#define DRIFT_ERROR_MAX_PPM(interval_ms)    ((interval_ms) * 1e6 / (TIME_SYNC_SAMPLE_COUNT * TIME_SYNC_SLOT_MS))
+
+/**@brief Clocks and link of one run. */
+typedef struct
+{
+    int32_t  drift_ppm;                                                     /**< Central clock rate relative to the local one, minus 1. */
+    uint32_t interval_ms;                                                   /**< Connection interval. */
+    uint32_t local_start;                                                   /**< Local time at the start. */
+} sim_t;
+
+/**@brief Errors of one run. */
+typedef struct
+{
+    double drift_error_ppm;
+    double synced_error_ms;                                                 /**< Largest timestamp error once the drift is known. */
+    double holdover_error_ms;                                               /**< Largest timestamp error after the last exchange. */
+} sim_result_t;
+
+static sim_t const * mp_sim;
+
+
+/**@brief Function for getting the central time of a local time, as the central's clock has it. */
+static double central_at(uint32_t local_elapsed_ms)
+{
+    return (double)CENTRAL_START_MS + local_elapsed_ms * (1.0 + mp_sim->drift_ppm * 1e-6);
+}
+
+
+/**@brief Function for getting the delay of one message: to the next connection event, and a
+ *        few events more when it is congested. */
+static uint32_t link_delay_ms(void)
+{
+    uint32_t delay = 1 + (uint32_t)rand() % mp_sim->interval_ms;
+
+    if ((uint32_t)rand() % 100 < CONGESTED_PERCENT)
+    {
+        delay += CONGESTED_MS + (uint32_t)rand() % mp_sim->interval_ms;
+    }
+    return delay;
+}
+
+
+/**@brief Function for running one exchange with the request arriving at the given local time.
+ *
+ * @return Result of adding it.
+ */
+static time_sync_result_t exchange_run(uint32_t local_elapsed_ms, double central_step_ms)
+{
+    time_sync_exchange_t exchange;
+    uint32_t             up   = link_delay_ms();
+    uint32_t             down = link_delay_ms();
+
+    // The central timestamps the request when it sends it, up ms before it arrives.
+    exchange.t1 = (uint64_t)llround(central_at(local_elapsed_ms - up) + central_step_ms);
+    exchange.t2 = mp_sim->local_start + local_elapsed_ms;
+    exchange.t3 = exchange.t2 + PROCESSING_MS;
+    exchange.t4 = (uint64_t)llround(central_at(local_elapsed_ms + PROCESSING_MS + down) + central_step_ms);
+
+    return time_sync_exchange_add(&exchange);
+}
+
+
+/**@brief Function for getting the error of the timestamp of a local time, in ms. */
+static double stamp_error_ms(uint32_t local_elapsed_ms, double central_step_ms)
+{
+    uint64_t central = time_sync_central_ms(mp_sim->local_start + local_elapsed_ms);
+
+    return (double)(int64_t)(central - CENTRAL_START_MS)
+           - (central_at(local_elapsed_ms) + central_step_ms - (double)CENTRAL_START_MS);
+}
+
+
+static sim_result_t sim_run(sim_t const * p_sim)
+{
+    sim_result_t       result = {0};
+    time_sync_status_t status;
+    uint32_t           t;
+
+    mp_sim = p_sim;
+    srand(p_sim->drift_ppm * 1000 + p_sim->interval_ms);
+    time_sync_reset();
+    CHECK(!time_sync_is_synced());
+    CHECK_EQ(time_sync_stamp(p_sim->local_start), TIME_SYNC_STAMP_UNKNOWN);
+
+    for (t = EXCHANGE_PERIOD_MS; t <= RUN_MS; t += EXCHANGE_PERIOD_MS)
+    {
+        CHECK_EQ(exchange_run(t, 0), TIME_SYNC_ACCEPTED);
+        CHECK(time_sync_is_synced());
+
+        // Data between this exchange and the next one.
+        if (t >= SYNCED_MS)
+        {
+            for (uint32_t dt = 0; dt < EXCHANGE_PERIOD_MS; dt += 500)
+            {
+                result.synced_error_ms = fmax(result.synced_error_ms, fabs(stamp_error_ms(t + dt, 0)));
+            }
+        }
+    }
+    t -= EXCHANGE_PERIOD_MS;
+
+    time_sync_status_get(&status);
+    CHECK_EQ(status.samples, TIME_SYNC_SAMPLE_COUNT);
+    result.drift_error_ppm = fabs(status.drift_ppb / 1000.0 - p_sim->drift_ppm);
+
+    // The central goes away; timestamps follow the drift estimate.
+    for (uint32_t dt = 0; dt <= HOLDOVER_MS; dt += 1000)
+    {
+        result.holdover_error_ms = fmax(result.holdover_error_ms, fabs(stamp_error_ms(t + dt, 0)));
+    }
+    return result;
+}
+
+
+/**@brief Drift and timestamp errors for several drifts and connection intervals. */
+static void drift_run(void)
+{
+    static int32_t const  drifts_ppm[]   = {-250, -40, 0, 20, 150, 400};
+    static uint32_t const intervals_ms[] = {8, 30, 100};
+
+    printf("drift and timestamp errors, exchanges every %u s for %u min, %u%% congested:\n",
+           EXCHANGE_PERIOD_MS / 1000, RUN_MS / 60000, CONGESTED_PERCENT);
+    printf("  drift  interval  drift error  synced error  error %u min on\n", HOLDOVER_MS / 60000);
+    for (uint32_t i = 0; i < ARRAY_SIZE(drifts_ppm); i++)
+    {
+        for (uint32_t j = 0; j < ARRAY_SIZE(intervals_ms); j++)
+        {
+            sim_t const  sim    = {.drift_ppm = drifts_ppm[i], .interval_ms = intervals_ms[j]};
+            sim_result_t result = sim_run(&sim);
+
+            printf("  %+4d ppm  %4u ms    %5.1f ppm      %5.1f ms       %6.1f ms\n",
+                   (int)drifts_ppm[i], (unsigned)intervals_ms[j], result.drift_error_ppm,
+                   result.synced_error_ms, result.holdover_error_ms);
+
+            // The exchange with the shortest round trip is off by up to half of it.
+            CHECK(result.synced_error_ms <= intervals_ms[j]);
+            CHECK(result.drift_error_ppm <= DRIFT_ERROR_MAX_PPM(intervals_ms[j]));
+            CHECK(result.holdover_error_ms <= intervals_ms[j] + result.drift_error_ppm * 1e-6 * HOLDOVER_MS + 1);
+        }
+    }
+}
+
+
+/**@brief The central clock steps, e.g. after an NTP correction on the phone: the estimate starts
+ *        over, and a round trip that is too long is rejected. */
+static void step_run(void)
+{
+    sim_t const sim  = {.drift_ppm = 60, .interval_ms = 30};
+    double      step = 3600000.0;
+    uint32_t    t;
+
+    printf("step of the central clock:\n");
+    mp_sim = &sim;
+    srand(1);
+    time_sync_reset();
+    for (t = EXCHANGE_PERIOD_MS; t <= RUN_MS / 2; t += EXCHANGE_PERIOD_MS)
+    {
+        CHECK_EQ(exchange_run(t, 0), TIME_SYNC_ACCEPTED);
+    }
+
+    CHECK_EQ(exchange_run(t, step), TIME_SYNC_RESTARTED);
+    CHECK(fabs(stamp_error_ms(t, step)) <= sim.interval_ms + CONGESTED_MS);
+    for (t += EXCHANGE_PERIOD_MS; t <= RUN_MS; t += EXCHANGE_PERIOD_MS)
+    {
+        CHECK_EQ(exchange_run(t, step), TIME_SYNC_ACCEPTED);
+    }
+    CHECK(fabs(stamp_error_ms(t, step)) <= sim.interval_ms);
+
+    time_sync_exchange_t const slow =
+    {
+        .t1 = CENTRAL_START_MS + t,
+        .t2 = t,
+        .t3 = t + PROCESSING_MS,
+        .t4 = CENTRAL_START_MS + t + TIME_SYNC_MAX_DELAY_MS + PROCESSING_MS + 1,
+    };
+    CHECK_EQ(time_sync_exchange_add(&slow), TIME_SYNC_REJECTED);
+}
+
+
+/**@brief The local millisecond clock wraps after 49.7 days, in the middle of the exchanges. */
+static void wrap_run(void)
+{
+    sim_t const  sim    = {.drift_ppm = -80, .interval_ms = 30, .local_start = UINT32_MAX - RUN_MS / 2};
+    sim_result_t result = sim_run(&sim);
+
+    printf("local clock wrapping: drift error %.1f ppm, synced error %.1f ms\n",
+           result.drift_error_ppm, result.synced_error_ms);
+    CHECK(result.synced_error_ms <= sim.interval_ms);
+    CHECK(result.drift_error_ppm <= DRIFT_ERROR_MAX_PPM(sim.interval_ms));
+}
+
+
+int main(void)
+{
+    drift_run();
+    step_run();
+    wrap_run();
+
+    return test_result("time_sync_sim");
+}
@@ -0,0 +1,294 @@
+/* Checks the notification TX queue of ble_cus.c against the fake SoftDevice of fake_sd.c: back
+ * pressure with NRF_ERROR_RESOURCES, drops when the queue is full, refused notifications, and
+ * BLE_GATTS_EVT_HVN_TX_COMPLETE for several notifications at once while a bulk transfer shares
+ * the TX buffers, and a keyframe on the delta stream after a dropped frame. Every scenario runs in a child process, so the queues start empty. */
+#include <stdlib.h>
+#include <string.h>
+#include "test_check.h"
+#include "app_util.h"
+#include "cus_fixture.h"
+#include "delta_codec.h"
+#include "sample_pool.h"
+
+#define LIVE_LEN        8                                                   /**< Length of the test notifications. */
+
+static uint16_t           m_live_next;                                      /**< Number of the next live notification made. */
+static uint16_t           m_live_rx[64];                                    /**< Numbers of the live notifications received. */
+static uint32_t           m_live_rx_count;
+static uint32_t           m_bulk_rx_count;
+static uint8_t            m_delta_rx_key;                                   /**< Keyframe flag of the last delta frame received. */
+static uint32_t           m_delta_rx_count;
+static ble_cus_tx_stats_t m_stats;                                          /**< Counters when the scenario started. */
+
+
+static void rx_handler(uint16_t conn_handle, uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    if (handle == m_cus.power_handles.value_handle)
+    {
+        if (m_live_rx_count < ARRAY_SIZE(m_live_rx))
+        {
+            m_live_rx[m_live_rx_count] = uint16_decode(p_data);
+        }
+        m_live_rx_count++;
+    }
+    else if (handle == m_cus.bulk_handles.value_handle)
+    {
+        m_bulk_rx_count++;
+    }
+    else if (handle == m_cus.delta_handles.value_handle)
+    {
+        m_delta_rx_key = p_data[1] & DELTA_CODEC_KEYFRAME;
+        m_delta_rx_count++;
+    }
+}
+
+
+/**@brief Function for connecting one client at ATT MTU 247, subscribed to the power. */
+static void service_start(void)
+{
+    cus_fixture_start(NULL, rx_handler, SAMPLE_POOL_ACCL_LEN - 1);
+    fake_sd_connect(0, 247);
+    ble_cus_att_mtu_set(&m_cus, 0, 247);
+    fake_sd_notify_enable(0, m_cus.power_handles.cccd_handle);
+    while (fake_sd_conn_event(0, FAKE_SD_TX_BUFFERS) > 0)
+    {
+    }
+    m_live_rx_count = 0;
+    m_stats         = *ble_cus_tx_stats();
+}
+
+
+/**@brief Function for sending a live notification that carries its number. */
+static uint32_t live_notify(void)
+{
+    uint8_t data[LIVE_LEN] = {0};
+
+    uint16_encode(m_live_next++, data);
+    return ble_cus_notify(&m_cus, m_cus.power_handles.value_handle, data, sizeof(data));
+}
+
+
+/**@brief Function for checking that the live notifications received are numbered first to last,
+ *        without the ones listed as dropped. */
+static void live_rx_check(uint16_t first, uint16_t last, uint16_t dropped)
+{
+    uint32_t i = 0;
+
+    for (uint16_t n = first; n <= last; n++)
+    {
+        if (n == dropped)
+        {
+            continue;
+        }
+        CHECK_EQ(m_live_rx[i], n);
+        i++;
+    }
+    CHECK_EQ(m_live_rx_count, i);
+}
+
+
+#define STATS_DELTA(field)  (ble_cus_tx_stats()->field - m_stats.field)
+
+
+/**@brief The SoftDevice takes 8 notifications, the queue 8 more, the next one is dropped. The queue
+ *        drains in order as TX buffers free up, a few at a time. */
+static void backpressure_run(void)
+{
+    service_start();
+
+    for (uint32_t i = 0; i < FAKE_SD_TX_BUFFERS + BLE_CUS_TX_QUEUE_SIZE; i++)
+    {
+        CHECK_EQ(live_notify(), NRF_SUCCESS);
+    }
+    CHECK_EQ(fake_sd_queued(0), FAKE_SD_TX_BUFFERS);
+    CHECK_EQ(ble_cus_tx_queue_depth(&m_cus, 0), BLE_CUS_TX_QUEUE_SIZE);
+    CHECK(fake_sd_link_stats(0)->hvx_resources > 0);
+
+    CHECK_EQ(live_notify(), NRF_ERROR_NO_MEM);
+    CHECK_EQ(STATS_DELTA(dropped_full), 1);
+    CHECK_EQ(ble_cus_tx_stats()->max_depth, BLE_CUS_TX_QUEUE_SIZE);
+
+    // Three buffers free: three queued notifications move to the SoftDevice.
+    CHECK_EQ(fake_sd_conn_event(0, 3), 3);
+    CHECK_EQ(ble_cus_tx_queue_depth(&m_cus, 0), BLE_CUS_TX_QUEUE_SIZE - 3);
+    CHECK_EQ(fake_sd_queued(0), FAKE_SD_TX_BUFFERS);
+    CHECK_EQ(m_cus.links[0].in_flight, FAKE_SD_TX_BUFFERS);
+
+    // One HVN_TX_COMPLETE for all eight: the queue empties.
+    CHECK_EQ(fake_sd_conn_event(0, FAKE_SD_TX_BUFFERS), FAKE_SD_TX_BUFFERS);
+    CHECK_EQ(ble_cus_tx_queue_depth(&m_cus, 0), 0);
+    CHECK_EQ(fake_sd_queued(0), BLE_CUS_TX_QUEUE_SIZE - 3);
+    CHECK_EQ(m_cus.links[0].in_flight, BLE_CUS_TX_QUEUE_SIZE - 3);
+
+    while (fake_sd_conn_event(0, 2) > 0)
+    {
+    }
+    CHECK_EQ(m_cus.links[0].in_flight, 0);
+    live_rx_check(0, FAKE_SD_TX_BUFFERS + BLE_CUS_TX_QUEUE_SIZE, FAKE_SD_TX_BUFFERS + BLE_CUS_TX_QUEUE_SIZE);
+    CHECK_EQ(STATS_DELTA(queued), FAKE_SD_TX_BUFFERS + BLE_CUS_TX_QUEUE_SIZE);
+    CHECK_EQ(STATS_DELTA(sent), FAKE_SD_TX_BUFFERS + BLE_CUS_TX_QUEUE_SIZE);
+    CHECK_EQ(STATS_DELTA(errors), 0);
+}
+
+
+/**@brief A notification the SoftDevice refuses with another error is counted and dropped; the
+ *        ones behind it still go out. */
+static void refused_run(void)
+{
+    service_start();
+
+    fake_sd_hvx_error_set(0, NRF_ERROR_INVALID_STATE, 1);
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        CHECK_EQ(live_notify(), NRF_SUCCESS);
+    }
+    while (fake_sd_conn_event(0, FAKE_SD_TX_BUFFERS) > 0)
+    {
+    }
+    live_rx_check(1, 2, UINT16_MAX);
+    CHECK_EQ(STATS_DELTA(errors), 1);
+    CHECK_EQ(STATS_DELTA(sent), 2);
+    CHECK_EQ(m_cus.links[0].in_flight, 0);
+
+    // Too long for the link: refused before it is queued.
+    uint8_t data[BLE_CUS_MAX_DATA_LEN + 1] = {0};
+
+    ble_cus_att_mtu_set(&m_cus, 0, BLE_GATT_ATT_MTU_DEFAULT);
+    CHECK_EQ(ble_cus_notify(&m_cus, m_cus.power_handles.value_handle, data, 21), NRF_ERROR_INVALID_LENGTH);
+    CHECK_EQ(STATS_DELTA(queued), 3);
+}
+
+
+/**@brief A bulk transfer keeps BLE_CUS_BULK_IN_FLIGHT_MAX notifications in the SoftDevice; live
+ *        notifications get the other buffers, and go first when a HVN_TX_COMPLETE frees several. */
+static void shared_buffers_run(void)
+{
+    uint8_t req[BLE_CUS_BULK_REQ_LEN];
+
+    service_start();
+    fake_sd_notify_enable(0, m_cus.bulk_handles.cccd_handle);
+    uint16_encode(0, &req[0]);
+    uint16_encode(6000, &req[2]);
+    fake_sd_write(0, m_cus.bulk_handles.value_handle, req, sizeof(req));
+
+    CHECK_EQ(fake_sd_queued(0), BLE_CUS_BULK_IN_FLIGHT_MAX);
+    CHECK_EQ(m_cus.links[0].in_flight, BLE_CUS_BULK_IN_FLIGHT_MAX);
+
+    // Two live notifications fit the buffers left, the third waits in the queue.
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        CHECK_EQ(live_notify(), NRF_SUCCESS);
+    }
+    CHECK_EQ(fake_sd_queued(0), FAKE_SD_TX_BUFFERS);
+    CHECK_EQ(ble_cus_tx_queue_depth(&m_cus, 0), 1);
+
+    // Five sent, one event: the waiting live notification goes first, then bulk up to its limit.
+    CHECK_EQ(fake_sd_conn_event(0, 5), 5);
+    CHECK_EQ(ble_cus_tx_queue_depth(&m_cus, 0), 0);
+    CHECK_EQ(m_cus.links[0].in_flight, BLE_CUS_BULK_IN_FLIGHT_MAX);
+    CHECK_EQ(fake_sd_queued(0), BLE_CUS_BULK_IN_FLIGHT_MAX);
+    CHECK_EQ(m_bulk_rx_count, 5);
+
+    while (fake_sd_conn_event(0, FAKE_SD_TX_BUFFERS) > 0)
+    {
+    }
+    live_rx_check(0, 2, UINT16_MAX);
+    CHECK_EQ(m_bulk_rx_count, (6000 * 2 + 241) / 242);
+    CHECK_EQ(m_cus.links[0].in_flight, 0);
+    CHECK(fake_sd_link_stats(0)->max_queued <= FAKE_SD_TX_BUFFERS);
+}
+
+
+/**@brief A HVN_TX_COMPLETE counting more than the service has in flight, as after notifications
+ *        sent by another module, does not wrap the count around. */
+static void count_overflow_run(void)
+{
+    ble_evt_t evt;
+
+    service_start();
+    CHECK_EQ(live_notify(), NRF_SUCCESS);
+    CHECK_EQ(m_cus.links[0].in_flight, 1);
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id                              = BLE_GATTS_EVT_HVN_TX_COMPLETE;
+    evt.evt.gatts_evt.conn_handle                  = 0;
+    evt.evt.gatts_evt.params.hvn_tx_complete.count = 5;
+    ble_cus_on_ble_evt(&evt, &m_cus);
+    CHECK_EQ(m_cus.links[0].in_flight, 0);
+}
+
+
+/**@brief Queued notifications are dropped and counted when the link goes down. */
+static void disconnect_run(void)
+{
+    service_start();
+    for (uint32_t i = 0; i < FAKE_SD_TX_BUFFERS + 4; i++)
+    {
+        CHECK_EQ(live_notify(), NRF_SUCCESS);
+    }
+    fake_sd_disconnect(0);
+    CHECK_EQ(STATS_DELTA(dropped_disconnected), 4);
+    CHECK_EQ(live_notify(), NRF_ERROR_INVALID_STATE);
+    CHECK_EQ(STATS_DELTA(dropped_disconnected), 5);
+}
+
+
+/**@brief Function for adding delta samples until a frame is sent or dropped.
+ *
+ * @return Frames dropped so far in the scenario.
+ */
+static uint32_t delta_frame_make(void)
+{
+    uint32_t queued  = STATS_DELTA(queued);
+    uint32_t dropped = STATS_DELTA(dropped_full);
+
+    for (uint32_t i = 0; (STATS_DELTA(queued) == queued) && (STATS_DELTA(dropped_full) == dropped) && (i < 1000); i++)
+    {
+        ble_cus_delta_update(&m_cus, (int16_t)(rand() % 64), (int16_t)(rand() % 64), 1024);
+    }
+    return STATS_DELTA(dropped_full);
+}
+
+
+/**@brief The frame after one dropped from a full queue is a keyframe, so the client syncs up
+ *        again at once instead of at the next periodic keyframe. */
+static void delta_drop_run(void)
+{
+    uint32_t frames = 0;
+
+    service_start();
+    fake_sd_notify_enable(0, m_cus.delta_handles.cccd_handle);
+    while (delta_frame_make() == 0)
+    {
+        frames++;
+    }
+    CHECK_EQ(frames, FAKE_SD_TX_BUFFERS + BLE_CUS_TX_QUEUE_SIZE);
+    while (fake_sd_conn_event(0, FAKE_SD_TX_BUFFERS) > 0)
+    {
+    }
+    CHECK_EQ(m_delta_rx_count, frames);
+
+    // Not a periodic keyframe: DELTA_CODEC_KEYFRAME_INTERVAL frames after the first one is the
+    // frame dropped.
+    CHECK_EQ(delta_frame_make(), 1);
+    CHECK_EQ(fake_sd_conn_event(0, FAKE_SD_TX_BUFFERS), 1);
+    CHECK_EQ(m_delta_rx_count, frames + 1);
+    CHECK(m_delta_rx_key);
+
+    CHECK_EQ(delta_frame_make(), 1);
+    CHECK_EQ(fake_sd_conn_event(0, FAKE_SD_TX_BUFFERS), 1);
+    CHECK(!m_delta_rx_key);
+}
+
+
+int main(void)
+{
+    scenario("back pressure and a full queue:", backpressure_run);
+    scenario("refused notifications:", refused_run);
+    scenario("TX buffers shared with a bulk transfer:", shared_buffers_run);
+    scenario("HVN_TX_COMPLETE counting more than in flight:", count_overflow_run);
+    scenario("disconnect with notifications queued:", disconnect_run);
+    scenario("a delta frame dropped from a full queue:", delta_drop_run);
+
+    return test_result("tx_queue_test");
+}
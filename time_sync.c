@@ -0,0 +1,209 @@
+#include "time_sync.h"
+#include <string.h>
+#include <math.h>
+
+/**@brief One exchange as kept for the estimate. */
+typedef struct
+{
+    uint32_t local_ms;                                                      /**< Local time of the offset, between t2 and t3. */
+    int64_t  offset_ms;                                                     /**< Central - local. */
+    uint16_t delay_ms;
+} sample_t;
+
+static sample_t m_samples[TIME_SYNC_SAMPLE_COUNT];
+static uint8_t  m_count;
+static uint8_t  m_next;                                                     /**< Slot after the newest one. */
+static uint32_t m_slot_start;                                               /**< Local time the newest slot started. */
+
+static uint32_t m_ref_local;                                                /**< Local time the fit is relative to. */
+static int64_t  m_ref_local_ext;                                            /**< m_ref_local with the wraps of the local clock counted. */
+static int64_t  m_ref_offset;                                               /**< Whole part of the offset at m_ref_local. */
+static double   m_ref_frac;                                                 /**< Rest of the offset at m_ref_local. */
+static double   m_drift;                                                    /**< Offset change per local ms. */
+static uint16_t m_min_delay;
+
+
+/**@brief Function for counting the wraps of a local time within 24 days of the reference. Kept over
+ *        a reset, so offsets stay continuous when the local clock wraps between two exchanges.
+ */
+static int64_t local_unwrap(uint32_t local_ms)
+{
+    return m_ref_local_ext + (int32_t)(local_ms - m_ref_local);
+}
+
+
+static double offset_at(uint32_t local_ms)
+{
+    return m_ref_frac + m_drift * (double)(int32_t)(local_ms - m_ref_local);
+}
+
+
+/**@brief Function for fitting the offset over the exchanges with a short round trip.
+ */
+static void fit(void)
+{
+    sample_t const * p_newest = &m_samples[(m_next + TIME_SYNC_SAMPLE_COUNT - 1) % TIME_SYNC_SAMPLE_COUNT];
+    double           w_sum    = 0;
+    double           x_sum    = 0;
+    double           y_sum    = 0;
+    double           xx_sum   = 0;
+    double           xy_sum   = 0;
+    double           x_min    = 0;
+    double           x_max    = 0;
+    uint32_t         used     = 0;
+    uint32_t         limit;
+
+    m_min_delay = UINT16_MAX;
+    for (uint32_t i = 0; i < m_count; i++)
+    {
+        if (m_samples[i].delay_ms < m_min_delay)
+        {
+            m_min_delay = m_samples[i].delay_ms;
+        }
+    }
+    limit = 4 * (uint32_t)m_min_delay + TIME_SYNC_DELAY_MARGIN_MS;
+
+    // Relative to the newest exchange, so the doubles only hold small values.
+    for (uint32_t i = 0; i < m_count; i++)
+    {
+        sample_t const * p_sample = &m_samples[i];
+
+        if (p_sample->delay_ms > limit)
+        {
+            continue;
+        }
+
+        // The error is up to half the delay; weight by its inverse square.
+        double w = 1.0 / ((1.0 + p_sample->delay_ms) * (1.0 + p_sample->delay_ms));
+        double x = (double)(int32_t)(p_sample->local_ms - p_newest->local_ms);
+        double y = (double)(p_sample->offset_ms - p_newest->offset_ms);
+
+        w_sum  += w;
+        x_sum  += w * x;
+        y_sum  += w * y;
+        xx_sum += w * x * x;
+        xy_sum += w * x * y;
+        x_min   = fmin(x_min, x);
+        x_max   = fmax(x_max, x);
+        used++;
+    }
+
+    if ((used >= TIME_SYNC_DRIFT_MIN_SAMPLES) && (x_max - x_min >= TIME_SYNC_DRIFT_MIN_SPAN_MS))
+    {
+        double denom = w_sum * xx_sum - x_sum * x_sum;
+
+        if (denom > 0)
+        {
+            double max = TIME_SYNC_DRIFT_MAX_PPM * 1e-6;
+
+            m_drift = fmax(-max, fmin(max, (w_sum * xy_sum - x_sum * y_sum) / denom));
+        }
+    }
+    // Without the span the last drift estimate is kept.
+
+    m_ref_local_ext = local_unwrap(p_newest->local_ms);
+    m_ref_local     = p_newest->local_ms;
+    m_ref_offset = p_newest->offset_ms;
+    m_ref_frac   = (y_sum - m_drift * x_sum) / w_sum;
+}
+
+
+void time_sync_reset(void)
+{
+    m_count = 0;
+    m_next  = 0;
+    m_drift = 0;
+}
+
+
+time_sync_result_t time_sync_exchange_add(time_sync_exchange_t const * p_exchange)
+{
+    time_sync_result_t result = TIME_SYNC_ACCEPTED;
+    int64_t            delay  = (int64_t)(p_exchange->t4 - p_exchange->t1)
+                                - (int64_t)(uint32_t)(p_exchange->t3 - p_exchange->t2);
+    sample_t           sample;
+
+    if ((p_exchange->t4 < p_exchange->t1) || (delay < 0) || (delay > TIME_SYNC_MAX_DELAY_MS))
+    {
+        return TIME_SYNC_REJECTED;
+    }
+
+    sample.local_ms  = p_exchange->t2 + (uint32_t)(p_exchange->t3 - p_exchange->t2) / 2;
+    sample.offset_ms = ((int64_t)(p_exchange->t1 + p_exchange->t4) - 2 * local_unwrap(p_exchange->t2)
+                        - (int64_t)(uint32_t)(p_exchange->t3 - p_exchange->t2)) / 2;
+    sample.delay_ms  = (uint16_t)delay;
+
+    if (m_count > 0)
+    {
+        double error = (double)(sample.offset_ms - m_ref_offset) - offset_at(sample.local_ms);
+
+        if (fabs(error) > TIME_SYNC_STEP_MS)
+        {
+            time_sync_reset();
+            result = TIME_SYNC_RESTARTED;
+        }
+    }
+
+    if ((m_count > 0) && (sample.local_ms - m_slot_start < TIME_SYNC_SLOT_MS))
+    {
+        sample_t * p_newest = &m_samples[(m_next + TIME_SYNC_SAMPLE_COUNT - 1) % TIME_SYNC_SAMPLE_COUNT];
+
+        if (sample.delay_ms < p_newest->delay_ms)
+        {
+            *p_newest = sample;
+        }
+    }
+    else
+    {
+        m_samples[m_next] = sample;
+        m_next            = (m_next + 1) % TIME_SYNC_SAMPLE_COUNT;
+        m_slot_start      = sample.local_ms;
+        if (m_count < TIME_SYNC_SAMPLE_COUNT)
+        {
+            m_count++;
+        }
+    }
+
+    fit();
+    return result;
+}
+
+
+bool time_sync_is_synced(void)
+{
+    return (m_count > 0);
+}
+
+
+uint64_t time_sync_central_ms(uint32_t local_ms)
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+    return (uint64_t)(local_unwrap(local_ms) + m_ref_offset + (int64_t)llround(offset_at(local_ms)));
+}
+
+
+uint32_t time_sync_stamp(uint32_t local_ms)
+{
+    if (m_count == 0)
+    {
+        return TIME_SYNC_STAMP_UNKNOWN;
+    }
+    return (uint32_t)time_sync_central_ms(local_ms);
+}
+
+
+void time_sync_status_get(time_sync_status_t * p_status)
+{
+    memset(p_status, 0, sizeof(time_sync_status_t));
+    if (m_count == 0)
+    {
+        return;
+    }
+
+    p_status->samples   = m_count;
+    p_status->delay_ms  = m_min_delay;
+    p_status->drift_ppb = (int32_t)lround(m_drift * 1e9);
+}
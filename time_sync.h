@@ -0,0 +1,102 @@
+#ifndef TIME_SYNC_H__
+#define TIME_SYNC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@file
+ *
+ * @brief Offset and drift of the local clock against the clock of the central.
+ *
+ * @details An exchange works like NTP: the central sends its time t1, the device notes its
+ *          receive time t2 and its send time t3, the central notes t4 when the answer arrives and
+ *          sends it in a follow-up. The exchange gives the offset (central - local) at the local
+ *          time (t2 + t3) / 2 and the round trip delay (t4 - t1) - (t3 - t2); the offset is off
+ *          by at most half the delay.
+ *
+ *          Of the exchanges in every TIME_SYNC_SLOT_MS the one with the shortest delay is kept, for
+ *          the last TIME_SYNC_SAMPLE_COUNT slots. Those with a delay close to the shortest one are
+ *          fitted with a line weighted by 1 / delay^2: the slope is the drift, once
+ *          TIME_SYNC_DRIFT_MIN_SAMPLES of them span TIME_SYNC_DRIFT_MIN_SPAN_MS. The long baseline
+ *          keeps the error of up to a connection interval per exchange from swamping a drift of a
+ *          few ppm. An offset that jumps by more than TIME_SYNC_STEP_MS from the fit is taken as a step of the central clock and starts the
+ *          estimate over.
+ *
+ *          Central times are milliseconds on any 64-bit timeline, e.g. Unix time. Timestamps sent
+ *          with the data are its low 32 bits; the central adds the high bits of its current time.
+ *
+ *          Local times are milliseconds of a 32-bit clock, which may wrap between exchanges and
+ *          while data is stamped, as long as they stay within 24 days of the last exchange.
+ *
+ *          The module only depends on the C library, so hosts can build it as it is.
+ */
+
+#define TIME_SYNC_SAMPLE_COUNT          16                                  /**< Exchanges kept for the estimate, one per slot. */
+#define TIME_SYNC_SLOT_MS               30000                               /**< Time of one slot. */
+#define TIME_SYNC_MAX_DELAY_MS          1000                                /**< Exchanges with a longer round trip are rejected. */
+#define TIME_SYNC_DELAY_MARGIN_MS       8                                   /**< Exchanges up to four times the shortest delay plus this are used. */
+#define TIME_SYNC_STEP_MS               500                                 /**< Offset change taken as a step of the central clock. */
+#define TIME_SYNC_DRIFT_MIN_SAMPLES     4                                   /**< Fewest exchanges for a drift estimate. */
+#define TIME_SYNC_DRIFT_MIN_SPAN_MS     120000                              /**< Shortest time the exchanges have to span for a drift estimate. */
+#define TIME_SYNC_DRIFT_MAX_PPM         500                                 /**< Larger drifts are clipped; covers the RC oscillator. */
+
+#define TIME_SYNC_STAMP_UNKNOWN         0xFFFFFFFF                          /**< Timestamp while the clock is not synced. */
+
+/**@brief Result of adding an exchange. */
+typedef enum
+{
+    TIME_SYNC_ACCEPTED,
+    TIME_SYNC_REJECTED,                                                     /**< Negative or too long round trip. */
+    TIME_SYNC_RESTARTED,                                                    /**< Step of the central clock; the estimate starts over with this exchange. */
+} time_sync_result_t;
+
+/**@brief One exchange. */
+typedef struct
+{
+    uint64_t t1;                                                            /**< Central time of the request. */
+    uint32_t t2;                                                            /**< Local time the request arrived. */
+    uint32_t t3;                                                            /**< Local time the answer was sent. */
+    uint64_t t4;                                                            /**< Central time the answer arrived. */
+} time_sync_exchange_t;
+
+/**@brief State of the estimate. */
+typedef struct
+{
+    uint8_t  samples;                                                       /**< Exchanges kept, one per slot. */
+    uint16_t delay_ms;                                                      /**< Shortest round trip among them. */
+    int32_t  drift_ppb;                                                     /**< Central clock rate relative to the local one, minus 1. */
+} time_sync_status_t;
+
+/**@brief Function for dropping the estimate, e.g. when another central takes over. */
+void time_sync_reset(void);
+
+/**@brief Function for adding an exchange to the estimate. */
+time_sync_result_t time_sync_exchange_add(time_sync_exchange_t const * p_exchange);
+
+/**@brief Function for checking whether an estimate exists. */
+bool time_sync_is_synced(void);
+
+/**@brief Function for converting a local time to central time.
+ *
+ * @return Central time in ms, or 0 while the clock is not synced.
+ */
+uint64_t time_sync_central_ms(uint32_t local_ms);
+
+/**@brief Function for getting the timestamp of a local time, as sent with the data.
+ *
+ * @return Low 32 bits of the central time in ms, or TIME_SYNC_STAMP_UNKNOWN.
+ */
+uint32_t time_sync_stamp(uint32_t local_ms);
+
+/**@brief Function for getting the state of the estimate. */
+void time_sync_status_get(time_sync_status_t * p_status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIME_SYNC_H__